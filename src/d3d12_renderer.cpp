@@ -1,8 +1,10 @@
 #include "d3d12_renderer.h"
+#include "parallel.h"
 #include <d3dcompiler.h>
 #include <cstdio>
 #include <cmath>
 #include <cfloat>
+#include <algorithm>
 #include <vector>
 
 #include "imgui.h"
@@ -119,15 +121,15 @@ static bool CreateShadowDepthBuffer(D3D12Renderer* renderer)
 
 static bool CreateConeShadowMaps(D3D12Renderer* renderer)
 {
-    // Create Texture2DArray for all cone light shadow maps
+    // Create the shadow atlas; every cone light renders into its own tile
     D3D12_HEAP_PROPERTIES heapProps = {};
     heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
 
     D3D12_RESOURCE_DESC texDesc = {};
     texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    texDesc.Width = D3D12Renderer::CONE_SHADOW_MAP_SIZE;
-    texDesc.Height = D3D12Renderer::CONE_SHADOW_MAP_SIZE;
-    texDesc.DepthOrArraySize = MAX_CONE_LIGHTS;
+    texDesc.Width = SHADOW_ATLAS_SIZE;
+    texDesc.Height = SHADOW_ATLAS_SIZE;
+    texDesc.DepthOrArraySize = 1;
     texDesc.MipLevels = 1;
     texDesc.Format = DXGI_FORMAT_R32_TYPELESS;  // Typeless for DSV/SRV flexibility
     texDesc.SampleDesc.Count = 1;
@@ -145,13 +147,13 @@ static bool CreateConeShadowMaps(D3D12Renderer* renderer)
         &clearValue,
         IID_PPV_ARGS(&renderer->coneShadowMaps))))
     {
-        OutputDebugStringA("Failed to create cone shadow maps texture array\n");
+        OutputDebugStringA("Failed to create shadow atlas texture\n");
         return false;
     }
 
-    // Create DSV descriptor heap (one DSV per array slice)
+    // Create DSV descriptor heap (tiles are selected with the viewport)
     D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
-    dsvHeapDesc.NumDescriptors = MAX_CONE_LIGHTS;
+    dsvHeapDesc.NumDescriptors = 1;
     dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
 
     if (FAILED(renderer->device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&renderer->coneShadowDsvHeap))))
@@ -160,27 +162,17 @@ static bool CreateConeShadowMaps(D3D12Renderer* renderer)
         return false;
     }
 
-    // Create DSV for each array slice
-    UINT dsvDescriptorSize = renderer->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
-    D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = renderer->coneShadowDsvHeap->GetCPUDescriptorHandleForHeapStart();
-
-    for (UINT i = 0; i < MAX_CONE_LIGHTS; ++i)
-    {
-        D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
-        dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-        dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
-        dsvDesc.Texture2DArray.FirstArraySlice = i;
-        dsvDesc.Texture2DArray.ArraySize = 1;
-        dsvDesc.Texture2DArray.MipSlice = 0;
-
-        renderer->device->CreateDepthStencilView(renderer->coneShadowMaps.Get(), &dsvDesc, dsvHandle);
-        dsvHandle.ptr += dsvDescriptorSize;
-    }
+    D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+    dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+    dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+    dsvDesc.Texture2D.MipSlice = 0;
+    renderer->device->CreateDepthStencilView(renderer->coneShadowMaps.Get(), &dsvDesc,
+        renderer->coneShadowDsvHeap->GetCPUDescriptorHandleForHeapStart());
 
     // Create SRV descriptor heap (shader visible, for sampling in main pass)
-    // 2 descriptors: cone shadow maps (t2) and horizon maps (t3)
+    // 3 descriptors: shadow atlas (t2), horizon maps (t3) and the angular horizon map (t6)
     D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.NumDescriptors = 2;
+    srvHeapDesc.NumDescriptors = 3;
     srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
@@ -190,15 +182,13 @@ static bool CreateConeShadowMaps(D3D12Renderer* renderer)
         return false;
     }
 
-    // Create SRV for the entire texture array
+    // Create SRV for the atlas
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
     srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.Texture2DArray.MostDetailedMip = 0;
-    srvDesc.Texture2DArray.MipLevels = 1;
-    srvDesc.Texture2DArray.FirstArraySlice = 0;
-    srvDesc.Texture2DArray.ArraySize = MAX_CONE_LIGHTS;
+    srvDesc.Texture2D.MostDetailedMip = 0;
+    srvDesc.Texture2D.MipLevels = 1;
 
     renderer->device->CreateShaderResourceView(
         renderer->coneShadowMaps.Get(),
@@ -215,6 +205,9 @@ static const char* g_HorizonComputeShaderSource = R"(
 // Height map from top-down rendering
 Texture2D<float> heightMap : register(t0);
 
+// (min, max) depth of the 2^L x 2^L cells of the height map at mip L - 1
+Texture2D<float2> depthPyramid : register(t1);
+
 // Output horizon map (one slice per light) - stores required light height for visibility
 RWTexture2DArray<float> horizonMaps : register(u0);
 
@@ -227,9 +220,25 @@ cbuffer HorizonParams : register(b0)
     uint mapSize;
     float nearPlaneY;    // World Y at depth=0
     float farPlaneY;     // World Y at depth=1
-    float padding;
+    uint partialTrace;   // Only re-trace texels whose ray crosses dirtyRect
+    uint2 texelOffset;   // Dispatch covers the light's range rect
+    uint2 texelCount;
+    float4 dirtyRect;    // Changed height map region in texels: min.xy, max.zw
 };
 
+// Whether the segment from p0 to p1 touches the rect (slab test)
+bool SegmentCrossesRect(float2 p0, float2 p1, float4 rect)
+{
+    float2 invDir = 1.0 / (p1 - p0);
+    float2 t0 = (rect.xy - p0) * invDir;
+    float2 t1 = (rect.zw - p0) * invDir;
+    float2 tNear = min(t0, t1);
+    float2 tFar = max(t0, t1);
+    float enter = max(max(tNear.x, tNear.y), 0.0);
+    float exit = min(min(tFar.x, tFar.y), 1.0);
+    return enter <= exit;
+}
+
 // Convert depth buffer value to world-space Y height
 float DepthToWorldY(float depth)
 {
@@ -237,14 +246,58 @@ float DepthToWorldY(float depth)
     return nearPlaneY + depth * (farPlaneY - nearPlaneY);
 }
 
+// World XZ distance from the traced texel to a sample
+float SampleDistance(float2 sampleTexel, float2 worldXZ)
+{
+    float2 sampleUV = sampleTexel / float(mapSize);
+    float2 sampleWorldXZ = float2(worldMin.x + sampleUV.x * worldSize,
+                                  worldMin.z + sampleUV.y * worldSize);
+    return length(sampleWorldXZ - worldXZ);
+}
+
+// Ray parameter where the line leaves the box
+float ExitParameter(float2 origin, float2 invDir, float2 boxMin, float2 boxMax)
+{
+    float2 tMax = max((boxMin - origin) * invDir, (boxMax - origin) * invDir);
+    return min(tMax.x, tMax.y);
+}
+
+// Whether the linear march still samples at this step
+bool IsStepInRange(float2 origin, float2 dir, float2 worldXZ, float distToLight, int step)
+{
+    if (step >= int(mapSize))
+        return false;
+    float2 sampleTexel = origin + dir * float(step);
+    if (sampleTexel.x < 0 || sampleTexel.x >= float(mapSize) ||
+        sampleTexel.y < 0 || sampleTexel.y >= float(mapSize))
+        return false;
+    return SampleDistance(sampleTexel, worldXZ) <= distToLight;
+}
+
+bool IsStepInCell(float2 origin, float2 dir, int step, int level, int2 cell)
+{
+    int2 texel = int2(origin + dir * float(step));
+    return all((texel >> level) == cell);
+}
+
 [numthreads(16, 16, 1)]
 void CSMain(uint3 dispatchThreadId : SV_DispatchThreadID)
 {
-    if (dispatchThreadId.x >= mapSize || dispatchThreadId.y >= mapSize)
+    if (dispatchThreadId.x >= texelCount.x || dispatchThreadId.y >= texelCount.y)
         return;
 
+    uint2 texel = dispatchThreadId.xy + texelOffset;
+
+    // Light unchanged: texels whose ray misses the changed region keep their value
+    if (partialTrace != 0)
+    {
+        float2 lightTexel = (lightPos.xz - worldMin.xz) / worldSize * float(mapSize);
+        if (!SegmentCrossesRect(float2(texel) + 0.5, lightTexel, dirtyRect))
+            return;
+    }
+
     // Convert texel to world XZ position
-    float2 uv = (float2(dispatchThreadId.xy) + 0.5) / float(mapSize);
+    float2 uv = (float2(texel) + 0.5) / float(mapSize);
     float2 worldXZ;
     worldXZ.x = worldMin.x + uv.x * worldSize;
     worldXZ.y = worldMin.z + uv.y * worldSize;
@@ -256,7 +309,7 @@ void CSMain(uint3 dispatchThreadId : SV_DispatchThreadID)
     // If light is directly above this texel, no horizon occlusion
     if (distToLightXZ < 0.001)
     {
-        horizonMaps[uint3(dispatchThreadId.xy, lightIndex)] = -1000.0;  // Any height is visible
+        horizonMaps[uint3(texel, lightIndex)] = -1000.0;  // Any height is visible
         return;
     }
 
@@ -266,48 +319,239 @@ void CSMain(uint3 dispatchThreadId : SV_DispatchThreadID)
     // The light must be above this height to illuminate this texel
     float maxRequiredHeight = -1000.0;  // Start very low (no occlusion)
 
-    float2 currentTexel = float2(dispatchThreadId.xy) + 0.5;
-
-    // Trace in texel steps toward the light
-    int maxSteps = int(mapSize);
-    for (int step = 1; step < maxSteps; ++step)
+    float2 currentTexel = float2(texel) + 0.5;
+
+    // Walk the min / max depth pyramid instead of one texel per step: a cell whose
+    // samples cannot raise maxRequiredHeight is skipped as a whole, a cell of a
+    // single height only needs its first and last sample. Takes the same
+    // samples as the plain march (see Horizon_TraceTexelHierarchical in
+    // horizon.cpp, which proves the result identical on the CPU).
+    //
+    // Sample positions and distances never decrease along the ray, so the
+    // march covers steps 1..lastStep and the steps inside a cell are a
+    // contiguous range. Both ends are estimated, then fixed up.
+    float2 invDir = 1.0 / dirToLight;
+    float distToLightTexels = distToLightXZ / worldSize * float(mapSize);
+    float mapExit = ExitParameter(currentTexel, invDir, float2(0, 0), float2(mapSize, mapSize));
+    int lastStep = int(clamp(min(distToLightTexels, mapExit), 0.0, float(mapSize - 1)));
+    [loop] while (IsStepInRange(currentTexel, dirToLight, worldXZ, distToLightXZ, lastStep + 1))
+        lastStep++;
+    [loop] while (lastStep >= 1 && !IsStepInRange(currentTexel, dirToLight, worldXZ, distToLightXZ, lastStep))
+        lastStep--;
+
+    int levelCount = firstbithigh(mapSize) + 1;
+    int level = 0;
+    int step = 1;
+    [loop] while (step <= lastStep)
     {
-        // Move one texel toward the light
         float2 sampleTexel = currentTexel + dirToLight * float(step);
+        int2 texelPos = int2(sampleTexel);
+        float firstDist = SampleDistance(sampleTexel, worldXZ);
 
-        // Check bounds
-        if (sampleTexel.x < 0 || sampleTexel.x >= float(mapSize) ||
-            sampleTexel.y < 0 || sampleTexel.y >= float(mapSize))
-            break;
+        [loop] for (;;)
+        {
+            int2 cell = texelPos >> level;
+            float2 depthRange;
+            if (level == 0)
+                depthRange = heightMap.Load(int3(texelPos, 0)).xx;
+            else
+                depthRange = depthPyramid.Load(int3(cell, level - 1));
+            float maxHeight = DepthToWorldY(depthRange.x);
+            float minHeight = DepthToWorldY(depthRange.y);
+
+            // Steps [step, exitStep] land in this cell, at distances
+            // [firstDist, lastDist] with heights in [minHeight, maxHeight]
+            bool flat = (minHeight == maxHeight) && firstDist > 0.001;
+            bool belowMax = maxHeight >= 0.0 && firstDist > 0.001 &&
+                            maxHeight * distToLightXZ / firstDist <= maxRequiredHeight;
+            bool refine = maxHeight >= 0.0 && !flat && !belowMax;
+
+            int exitStep = step;
+            if (!refine)
+            {
+                float cellSize = float(1 << level);
+                float cellExit = ExitParameter(currentTexel, invDir, float2(cell) * cellSize, float2(cell + 1) * cellSize);
+                exitStep = int(clamp(cellExit, float(step), float(lastStep)));
+                [loop] while (exitStep < lastStep && IsStepInCell(currentTexel, dirToLight, exitStep + 1, level, cell))
+                    exitStep++;
+                [loop] while (exitStep > step && !IsStepInCell(currentTexel, dirToLight, exitStep, level, cell))
+                    exitStep--;
+                float lastDist = SampleDistance(currentTexel + dirToLight * float(exitStep), worldXZ);
+
+                if (belowMax || lastDist <= 0.001)
+                {
+                    // Nothing in the cell can raise the maximum
+                }
+                else if (flat)
+                {
+                    // The required height is monotonic along the steps
+                    maxRequiredHeight = max(maxRequiredHeight, maxHeight * distToLightXZ / firstDist);
+                    maxRequiredHeight = max(maxRequiredHeight, maxHeight * distToLightXZ / lastDist);
+                }
+                else
+                {
+                    // All heights below zero
+                    refine = maxHeight * distToLightXZ / lastDist > maxRequiredHeight;
+                }
+            }
+
+            if (!refine)
+            {
+                step = exitStep + 1;
+                level = min(level + 1, levelCount - 1);
+                break;
+            }
+            if (level == 0)
+            {
+                // Sample within 0.001 of the texel, never counts
+                step++;
+                break;
+            }
+            level--;
+        }
+    }
+
+    // Store the minimum height the light needs to be at to illuminate this texel
+    horizonMaps[uint3(texel, lightIndex)] = maxRequiredHeight;
+}
+)";
 
-        // Get world XZ of sample
-        float2 sampleUV = sampleTexel / float(mapSize);
-        float2 sampleWorldXZ = float2(worldMin.x + sampleUV.x * worldSize,
-                                       worldMin.z + sampleUV.y * worldSize);
+// Depth pyramid for the hierarchical horizon trace: level L (cells of 2^L
+// texels) lives at mip L - 1, down to a single cell
+static constexpr uint32_t HORIZON_PYRAMID_MIPS = 10;
+static_assert((SceneState::HORIZON_MAP_SIZE >> HORIZON_PYRAMID_MIPS) == 1, "Pyramid must end at one cell");
+
+// horizonSrvUavHeap: 0 height map SRV, 1 horizon maps UAV, 2 horizon maps SRV,
+// 3 angular map UAV, then the pyramid SRV (all mips) and a UAV and an SRV per
+// pyramid mip
+static constexpr UINT HORIZON_ANGULAR_UAV_DESCRIPTOR = 3;
+static constexpr UINT HORIZON_PYRAMID_SRV_DESCRIPTOR = 4;
+static constexpr UINT HORIZON_PYRAMID_MIP_UAV_DESCRIPTOR = 5;
+static constexpr UINT HORIZON_PYRAMID_MIP_SRV_DESCRIPTOR = HORIZON_PYRAMID_MIP_UAV_DESCRIPTOR + HORIZON_PYRAMID_MIPS;
+static constexpr UINT HORIZON_DESCRIPTOR_COUNT = HORIZON_PYRAMID_MIP_SRV_DESCRIPTOR + HORIZON_PYRAMID_MIPS;
+
+// Builds one mip of the (min, max) depth pyramid from the height map (first
+// mip) or from the previous mip
+static const char* g_HorizonPyramidShaderSource = R"(
+Texture2D<float> heightMap : register(t0);
+Texture2D<float2> sourceLevel : register(t1);
+RWTexture2D<float2> destLevel : register(u0);
 
-        // Distance from our texel to this sample
-        float sampleDistXZ = length(sampleWorldXZ - worldXZ);
+cbuffer PyramidParams : register(b0)
+{
+    uint destSize;
+    uint fromHeightMap;
+};
 
-        // Have we passed the light?
-        if (sampleDistXZ > distToLightXZ)
-            break;
+[numthreads(8, 8, 1)]
+void CSDownsample(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+    if (dispatchThreadId.x >= destSize || dispatchThreadId.y >= destSize)
+        return;
+
+    int2 source = int2(dispatchThreadId.xy) * 2;
+    float2 range = float2(1.0e30, -1.0e30);
+    for (int i = 0; i < 4; ++i)
+    {
+        int3 texel = int3(source + int2(i & 1, i >> 1), 0);
+        float2 value;
+        if (fromHeightMap != 0)
+            value = heightMap.Load(texel).xx;
+        else
+            value = sourceLevel.Load(texel);
+        range = float2(min(range.x, value.x), max(range.y, value.y));
+    }
+    destLevel[dispatchThreadId.xy] = range;
+}
+)";
 
-        // Sample depth and convert to world Y height
-        float depthSample = heightMap.Load(int3(int2(sampleTexel), 0));
-        float sampleHeight = DepthToWorldY(depthSample);
+// Angular horizon map (HorizonAngularMap in horizon.h): the steepest occluder
+// per texel and azimuth, one thread per texel and direction. Same walk as
+// Horizon_TraceAngular.
+static const char* g_HorizonAngularShaderSource = R"(
+Texture2D<float> heightMap : register(t0);
+Texture2D<float2> depthPyramid : register(t1);
+RWTexture2DArray<float2> angularHorizon : register(u0);    // (tangent, distance), one slice per direction
 
-        // Calculate what height the light would need to be at to clear this obstacle
-        // Using similar triangles: requiredHeight / distToLight = sampleHeight / sampleDist
-        // requiredHeight = sampleHeight * distToLight / sampleDist
-        if (sampleDistXZ > 0.001)
+cbuffer AngularParams : register(b0)
+{
+    float worldSize;
+    uint mapSize;
+    float nearPlaneY;
+    float farPlaneY;
+    float range;          // Occluders are searched up to this distance
+    uint angularSize;
+    uint angleCount;
+};
+
+// Ray parameter where the line leaves the box
+float ExitParameter(float2 origin, float2 invDir, float2 boxMin, float2 boxMax)
+{
+    float2 tMax = max((boxMin - origin) * invDir, (boxMax - origin) * invDir);
+    return min(tMax.x, tMax.y);
+}
+
+[numthreads(8, 8, 1)]
+void CSAngular(uint3 dispatchThreadId : SV_DispatchThreadID)
+{
+    if (dispatchThreadId.x >= angularSize || dispatchThreadId.y >= angularSize)
+        return;
+
+    float angle = float(dispatchThreadId.z) * (6.28318530718 / float(angleCount));
+    float2 dir = float2(cos(angle), sin(angle));
+    float2 invDir = 1.0 / dir;
+    float2 origin = (float2(dispatchThreadId.xy) + 0.5) * (float(mapSize) / float(angularSize));
+    float metersPerTexel = worldSize / float(mapSize);
+    float maxT = range / metersPerTexel;
+    int levelCount = firstbithigh(mapSize) + 1;
+
+    // Start one texel out so the receiver's own texel does not count. Cells
+    // that cannot beat the tangent at their entry distance are stepped over,
+    // texels are sampled at their entry point.
+    float maxTangent = 0.0;
+    float maxDist = 1.0e30;
+    int level = 0;
+    float t = 1.0;
+    [loop] while (t <= maxT)
+    {
+        float2 samplePos = origin + dir * t;
+        if (any(samplePos < 0.0) || any(samplePos >= float(mapSize)))
+            break;
+        int2 texel = int2(samplePos);
+        float sampleDist = t * metersPerTexel;
+
+        [loop] for (;;)
         {
-            float requiredHeight = sampleHeight * distToLightXZ / sampleDistXZ;
-            maxRequiredHeight = max(maxRequiredHeight, requiredHeight);
+            int2 cell = texel >> level;
+            float minDepth;
+            if (level == 0)
+                minDepth = heightMap.Load(int3(texel, 0));
+            else
+                minDepth = depthPyramid.Load(int3(cell, level - 1)).x;
+            float maxHeight = nearPlaneY + minDepth * (farPlaneY - nearPlaneY);
+
+            bool raises = maxHeight > maxTangent * sampleDist;
+            if (raises && level > 0)
+            {
+                level--;
+                continue;
+            }
+            if (raises)
+            {
+                maxTangent = maxHeight / sampleDist;
+                maxDist = sampleDist;
+            }
+
+            // Continue just past the cell; the nudge guarantees progress
+            float cellSize = float(1 << level);
+            float exitT = ExitParameter(origin, invDir, float2(cell) * cellSize, float2(cell + 1) * cellSize);
+            t = max(exitT, t) + 0.001;
+            level = min(level + 1, levelCount - 1);
+            break;
         }
     }
 
-    // Store the minimum height the light needs to be at to illuminate this texel
-    horizonMaps[uint3(dispatchThreadId.xy, lightIndex)] = maxRequiredHeight;
+    angularHorizon[dispatchThreadId] = float2(maxTangent, maxDist);
 }
 )";
 
@@ -342,32 +586,51 @@ static bool CreateHorizonMappingResources(D3D12Renderer* renderer)
         return false;
     }
 
-    // Create horizon maps texture array (R32_FLOAT, one per light)
-    D3D12_RESOURCE_DESC horizonMapsDesc = {};
-    horizonMapsDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    horizonMapsDesc.Width = D3D12Renderer::HORIZON_MAP_SIZE;
-    horizonMapsDesc.Height = D3D12Renderer::HORIZON_MAP_SIZE;
-    horizonMapsDesc.DepthOrArraySize = MAX_CONE_LIGHTS;
-    horizonMapsDesc.MipLevels = 1;
-    horizonMapsDesc.Format = DXGI_FORMAT_R32_FLOAT;
-    horizonMapsDesc.SampleDesc.Count = 1;
-    horizonMapsDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    // Min / max depth pyramid of the height map, written by CSDownsample and read by CSMain
+    D3D12_RESOURCE_DESC pyramidDesc = heightMapDesc;
+    pyramidDesc.Width = D3D12Renderer::HORIZON_MAP_SIZE / 2;
+    pyramidDesc.Height = D3D12Renderer::HORIZON_MAP_SIZE / 2;
+    pyramidDesc.MipLevels = HORIZON_PYRAMID_MIPS;
+    pyramidDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+    pyramidDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 
     if (FAILED(renderer->device->CreateCommittedResource(
         &defaultHeapProps,
         D3D12_HEAP_FLAG_NONE,
-        &horizonMapsDesc,
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+        &pyramidDesc,
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
         nullptr,
-        IID_PPV_ARGS(&renderer->horizonMaps))))
+        IID_PPV_ARGS(&renderer->horizonDepthPyramid))))
     {
-        OutputDebugStringA("Failed to create horizon maps texture array\n");
+        OutputDebugStringA("Failed to create horizon depth pyramid\n");
+        return false;
+    }
+
+    // Angular horizon map, one slice per direction. Only read by the pixel
+    // shader between rebuilds, so that is its resting state.
+    D3D12_RESOURCE_DESC angularDesc = heightMapDesc;
+    angularDesc.Width = HORIZON_ANGULAR_MAP_SIZE;
+    angularDesc.Height = HORIZON_ANGULAR_MAP_SIZE;
+    angularDesc.DepthOrArraySize = HORIZON_ANGLE_COUNT;
+    angularDesc.MipLevels = 1;
+    angularDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+    angularDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+    if (FAILED(renderer->device->CreateCommittedResource(
+        &defaultHeapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &angularDesc,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+        nullptr,
+        IID_PPV_ARGS(&renderer->horizonAngularMap))))
+    {
+        OutputDebugStringA("Failed to create angular horizon map\n");
         return false;
     }
 
-    // Create descriptor heap for horizon mapping (SRV for height map, UAV for horizon maps, SRV for horizon maps)
+    // Create descriptor heap for horizon mapping (SRV for height map, UAV for horizon maps, SRV for horizon maps, pyramid views)
     D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
-    heapDesc.NumDescriptors = 3;  // Height map SRV, horizon maps UAV, horizon maps SRV
+    heapDesc.NumDescriptors = HORIZON_DESCRIPTOR_COUNT;
     heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
@@ -377,46 +640,64 @@ static bool CreateHorizonMappingResources(D3D12Renderer* renderer)
         return false;
     }
 
-    UINT descriptorSize = renderer->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    D3D12_CPU_DESCRIPTOR_HANDLE heapHandle = renderer->horizonSrvUavHeap->GetCPUDescriptorHandleForHeapStart();
-
-    // Descriptor 0: Height map SRV
+    // Descriptor 0: Height map SRV (the horizon map views are added by CreateHorizonMaps)
     D3D12_SHADER_RESOURCE_VIEW_DESC heightSrvDesc = {};
     heightSrvDesc.Format = DXGI_FORMAT_R32_FLOAT;
     heightSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     heightSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     heightSrvDesc.Texture2D.MipLevels = 1;
-    renderer->device->CreateShaderResourceView(renderer->horizonHeightMap.Get(), &heightSrvDesc, heapHandle);
-
-    // Descriptor 1: Horizon maps UAV
-    heapHandle.ptr += descriptorSize;
-    D3D12_UNORDERED_ACCESS_VIEW_DESC horizonUavDesc = {};
-    horizonUavDesc.Format = DXGI_FORMAT_R32_FLOAT;
-    horizonUavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
-    horizonUavDesc.Texture2DArray.MipSlice = 0;
-    horizonUavDesc.Texture2DArray.FirstArraySlice = 0;
-    horizonUavDesc.Texture2DArray.ArraySize = MAX_CONE_LIGHTS;
-    renderer->device->CreateUnorderedAccessView(renderer->horizonMaps.Get(), nullptr, &horizonUavDesc, heapHandle);
-
-    // Descriptor 2: Horizon maps SRV (for main shader sampling)
-    heapHandle.ptr += descriptorSize;
-    D3D12_SHADER_RESOURCE_VIEW_DESC horizonSrvDesc = {};
-    horizonSrvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-    horizonSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
-    horizonSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    horizonSrvDesc.Texture2DArray.MipLevels = 1;
-    horizonSrvDesc.Texture2DArray.FirstArraySlice = 0;
-    horizonSrvDesc.Texture2DArray.ArraySize = MAX_CONE_LIGHTS;
-    renderer->device->CreateShaderResourceView(renderer->horizonMaps.Get(), &horizonSrvDesc, heapHandle);
+    renderer->device->CreateShaderResourceView(renderer->horizonHeightMap.Get(), &heightSrvDesc,
+        renderer->horizonSrvUavHeap->GetCPUDescriptorHandleForHeapStart());
 
-    // Create compute root signature
-    D3D12_ROOT_PARAMETER computeParams[3] = {};
+    UINT descriptorSize = renderer->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    D3D12_CPU_DESCRIPTOR_HANDLE heapStart = renderer->horizonSrvUavHeap->GetCPUDescriptorHandleForHeapStart();
+
+    // Angular map UAV (the main pass SRV is added by CreateHorizonMaps)
+    D3D12_UNORDERED_ACCESS_VIEW_DESC angularUavDesc = {};
+    angularUavDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+    angularUavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+    angularUavDesc.Texture2DArray.ArraySize = HORIZON_ANGLE_COUNT;
+    D3D12_CPU_DESCRIPTOR_HANDLE angularHandle = heapStart;
+    angularHandle.ptr += HORIZON_ANGULAR_UAV_DESCRIPTOR * descriptorSize;
+    renderer->device->CreateUnorderedAccessView(renderer->horizonAngularMap.Get(), nullptr, &angularUavDesc, angularHandle);
+
+    // Pyramid views: all mips for the trace, one UAV + SRV per mip for the downsample
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC pyramidSrvDesc = {};
+    pyramidSrvDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+    pyramidSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    pyramidSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    pyramidSrvDesc.Texture2D.MipLevels = HORIZON_PYRAMID_MIPS;
+    D3D12_CPU_DESCRIPTOR_HANDLE pyramidHandle = heapStart;
+    pyramidHandle.ptr += HORIZON_PYRAMID_SRV_DESCRIPTOR * descriptorSize;
+    renderer->device->CreateShaderResourceView(renderer->horizonDepthPyramid.Get(), &pyramidSrvDesc, pyramidHandle);
+
+    for (UINT mip = 0; mip < HORIZON_PYRAMID_MIPS; ++mip)
+    {
+        D3D12_UNORDERED_ACCESS_VIEW_DESC mipUavDesc = {};
+        mipUavDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+        mipUavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+        mipUavDesc.Texture2D.MipSlice = mip;
+        pyramidHandle = heapStart;
+        pyramidHandle.ptr += (HORIZON_PYRAMID_MIP_UAV_DESCRIPTOR + mip) * descriptorSize;
+        renderer->device->CreateUnorderedAccessView(renderer->horizonDepthPyramid.Get(), nullptr, &mipUavDesc, pyramidHandle);
+
+        D3D12_SHADER_RESOURCE_VIEW_DESC mipSrvDesc = pyramidSrvDesc;
+        mipSrvDesc.Texture2D.MostDetailedMip = mip;
+        mipSrvDesc.Texture2D.MipLevels = 1;
+        pyramidHandle = heapStart;
+        pyramidHandle.ptr += (HORIZON_PYRAMID_MIP_SRV_DESCRIPTOR + mip) * descriptorSize;
+        renderer->device->CreateShaderResourceView(renderer->horizonDepthPyramid.Get(), &mipSrvDesc, pyramidHandle);
+    }
+
+    // Create compute root signature (shared by the trace and the pyramid downsample)
+    D3D12_ROOT_PARAMETER computeParams[4] = {};
 
     // Constant buffer with light params at b0
     computeParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
     computeParams[0].Constants.ShaderRegister = 0;
     computeParams[0].Constants.RegisterSpace = 0;
-    computeParams[0].Constants.Num32BitValues = 12;  // float3 lightPos, float worldSize, float3 worldMin, uint lightIndex, uint mapSize, float3 padding
+    computeParams[0].Constants.Num32BitValues = 20;  // HorizonParams: light, map placement, dispatch rect, dirty rect
     computeParams[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 
     // Height map SRV at t0
@@ -443,8 +724,20 @@ static bool CreateHorizonMappingResources(D3D12Renderer* renderer)
     computeParams[2].DescriptorTable.pDescriptorRanges = &uavRange;
     computeParams[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 
+    // Depth pyramid SRV at t1 (all mips, or the source mip for the downsample)
+    D3D12_DESCRIPTOR_RANGE pyramidRange = {};
+    pyramidRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+    pyramidRange.NumDescriptors = 1;
+    pyramidRange.BaseShaderRegister = 1;
+    pyramidRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+    computeParams[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    computeParams[3].DescriptorTable.NumDescriptorRanges = 1;
+    computeParams[3].DescriptorTable.pDescriptorRanges = &pyramidRange;
+    computeParams[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
     D3D12_ROOT_SIGNATURE_DESC computeRootSigDesc = {};
-    computeRootSigDesc.NumParameters = 3;
+    computeRootSigDesc.NumParameters = 4;
     computeRootSigDesc.pParameters = computeParams;
     computeRootSigDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
 
@@ -488,6 +781,93 @@ static bool CreateHorizonMappingResources(D3D12Renderer* renderer)
         return false;
     }
 
+    ComPtr<ID3DBlob> pyramidShader;
+    if (FAILED(D3DCompile(g_HorizonPyramidShaderSource, strlen(g_HorizonPyramidShaderSource), "horizon_pyramid.hlsl", nullptr, nullptr,
+        "CSDownsample", "cs_5_0", compileFlags, 0, &pyramidShader, &error)))
+    {
+        if (error) OutputDebugStringA((char*)error->GetBufferPointer());
+        return false;
+    }
+
+    computePsoDesc.CS = { pyramidShader->GetBufferPointer(), pyramidShader->GetBufferSize() };
+    if (FAILED(renderer->device->CreateComputePipelineState(&computePsoDesc, IID_PPV_ARGS(&renderer->horizonPyramidPSO))))
+    {
+        OutputDebugStringA("Failed to create horizon pyramid PSO\n");
+        return false;
+    }
+
+    ComPtr<ID3DBlob> angularShader;
+    if (FAILED(D3DCompile(g_HorizonAngularShaderSource, strlen(g_HorizonAngularShaderSource), "horizon_angular.hlsl", nullptr, nullptr,
+        "CSAngular", "cs_5_0", compileFlags, 0, &angularShader, &error)))
+    {
+        if (error) OutputDebugStringA((char*)error->GetBufferPointer());
+        return false;
+    }
+
+    computePsoDesc.CS = { angularShader->GetBufferPointer(), angularShader->GetBufferSize() };
+    if (FAILED(renderer->device->CreateComputePipelineState(&computePsoDesc, IID_PPV_ARGS(&renderer->horizonAngularPSO))))
+    {
+        OutputDebugStringA("Failed to create angular horizon PSO\n");
+        return false;
+    }
+
+    OutputDebugStringA("Horizon mapping resources created successfully\n");
+    return true;
+}
+
+// Per-light horizon map array and its views. Needs the heaps from
+// CreateHorizonMappingResources and CreateConeShadowMaps.
+static bool CreateHorizonMaps(D3D12Renderer* renderer)
+{
+    D3D12_HEAP_PROPERTIES defaultHeapProps = {};
+    defaultHeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    // Create horizon maps texture array (R32_FLOAT, one per shadowed light)
+    D3D12_RESOURCE_DESC horizonMapsDesc = {};
+    horizonMapsDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    horizonMapsDesc.Width = D3D12Renderer::HORIZON_MAP_SIZE;
+    horizonMapsDesc.Height = D3D12Renderer::HORIZON_MAP_SIZE;
+    horizonMapsDesc.DepthOrArraySize = (UINT16)renderer->horizonSliceCount;
+    horizonMapsDesc.MipLevels = 1;
+    horizonMapsDesc.Format = DXGI_FORMAT_R32_FLOAT;
+    horizonMapsDesc.SampleDesc.Count = 1;
+    horizonMapsDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+    if (FAILED(renderer->device->CreateCommittedResource(
+        &defaultHeapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &horizonMapsDesc,
+        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+        nullptr,
+        IID_PPV_ARGS(&renderer->horizonMaps))))
+    {
+        OutputDebugStringA("Failed to create horizon maps texture array\n");
+        return false;
+    }
+
+    // Descriptor 1: Horizon maps UAV
+    UINT descriptorSize = renderer->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    D3D12_CPU_DESCRIPTOR_HANDLE heapHandle = renderer->horizonSrvUavHeap->GetCPUDescriptorHandleForHeapStart();
+    heapHandle.ptr += descriptorSize;
+    D3D12_UNORDERED_ACCESS_VIEW_DESC horizonUavDesc = {};
+    horizonUavDesc.Format = DXGI_FORMAT_R32_FLOAT;
+    horizonUavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+    horizonUavDesc.Texture2DArray.MipSlice = 0;
+    horizonUavDesc.Texture2DArray.FirstArraySlice = 0;
+    horizonUavDesc.Texture2DArray.ArraySize = renderer->horizonSliceCount;
+    renderer->device->CreateUnorderedAccessView(renderer->horizonMaps.Get(), nullptr, &horizonUavDesc, heapHandle);
+
+    // Descriptor 2: Horizon maps SRV (for main shader sampling)
+    heapHandle.ptr += descriptorSize;
+    D3D12_SHADER_RESOURCE_VIEW_DESC horizonSrvDesc = {};
+    horizonSrvDesc.Format = DXGI_FORMAT_R32_FLOAT;
+    horizonSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+    horizonSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    horizonSrvDesc.Texture2DArray.MipLevels = 1;
+    horizonSrvDesc.Texture2DArray.FirstArraySlice = 0;
+    horizonSrvDesc.Texture2DArray.ArraySize = renderer->horizonSliceCount;
+    renderer->device->CreateShaderResourceView(renderer->horizonMaps.Get(), &horizonSrvDesc, heapHandle);
+
     // Add horizon maps SRV to coneShadowSrvHeap at descriptor slot 1 for main render pass
     UINT mainHeapDescriptorSize = renderer->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
     D3D12_CPU_DESCRIPTOR_HANDLE mainHeapHandle = renderer->coneShadowSrvHeap->GetCPUDescriptorHandleForHeapStart();
@@ -499,10 +879,16 @@ static bool CreateHorizonMappingResources(D3D12Renderer* renderer)
     horizonMainSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     horizonMainSrvDesc.Texture2DArray.MipLevels = 1;
     horizonMainSrvDesc.Texture2DArray.FirstArraySlice = 0;
-    horizonMainSrvDesc.Texture2DArray.ArraySize = MAX_CONE_LIGHTS;
+    horizonMainSrvDesc.Texture2DArray.ArraySize = renderer->horizonSliceCount;
     renderer->device->CreateShaderResourceView(renderer->horizonMaps.Get(), &horizonMainSrvDesc, mainHeapHandle);
 
-    OutputDebugStringA("Horizon mapping resources created successfully\n");
+    // Angular horizon map SRV at descriptor slot 2 (t6)
+    mainHeapHandle.ptr += mainHeapDescriptorSize;
+    D3D12_SHADER_RESOURCE_VIEW_DESC angularSrvDesc = horizonMainSrvDesc;
+    angularSrvDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+    angularSrvDesc.Texture2DArray.ArraySize = HORIZON_ANGLE_COUNT;
+    renderer->device->CreateShaderResourceView(renderer->horizonAngularMap.Get(), &angularSrvDesc, mainHeapHandle);
+
     return true;
 }
 
@@ -524,19 +910,52 @@ cbuffer CameraConstants : register(b0)
     float horizonWorldMinX;
     float horizonWorldMinZ;
     float horizonWorldSize;
+    float shadowedLightCount;
+    float3 cameraForward;
+    float lightCullingMode;
+    float clusterTileSize;
+    float clusterCountX;
+    float clusterCountY;
+    float clusterCountZ;
+    float clusterNearZ;
+    float clusterDepthScale;
+    float lightGridSize;
+    float useAngularHorizon;
 };
 
+// Shading parameters of one light, unpacked by UnpackConeLight
 struct ConeLight
 {
     float4 positionAndRange;
     float4 directionAndCosOuter;
     float4 colorAndCosInner;
+    float4 shadowTile;              // Atlas texel rect (x, y, size, 0); size 0 = no shadow map
+};
+
+// Quantized light and the parameters shared by its class, see light_pack.h
+struct PackedConeLight
+{
+    uint cell;
+    uint offset;
+    uint direction;
+    uint heightAndClass;
+    uint shadowTile;
+};
+
+struct LightClass
+{
+    float4 rangeAndCos;             // (range, cos outer, cos inner, 0)
+    float4 color;
 };
 
-StructuredBuffer<ConeLight> coneLights : register(t0);
+StructuredBuffer<PackedConeLight> coneLights : register(t0);
 StructuredBuffer<float4x4> lightMatrices : register(t1);
-Texture2DArray<float> coneShadowMaps : register(t2);
+Texture2D<float> shadowAtlas : register(t2);
 Texture2DArray<float> horizonMaps : register(t3);
+StructuredBuffer<uint2> clusterRanges : register(t4);      // (offset, count) per froxel / grid cell
+StructuredBuffer<uint> clusterLightIndices : register(t5);
+Texture2DArray<float2> angularHorizon : register(t6);          // (tangent, distance), one slice per direction
+StructuredBuffer<LightClass> lightClasses : register(t7);
 SamplerComparisonState shadowSampler : register(s0);
 SamplerState linearSampler : register(s1);
 
@@ -545,6 +964,7 @@ struct VSInput
     float3 position : POSITION;
     float3 normal : NORMAL;
     float2 uv : TEXCOORD;
+    float4 instance : INSTANCE;     // (posX, posZ, dirX, dirZ), see CarInstance
 };
 
 struct PSInput
@@ -555,18 +975,84 @@ struct PSInput
     float2 uv : TEXCOORD;
 };
 
+// Car space to world space, same as Scene_TransformInstanceVertex
+float3 RotateInstance(float4 instance, float3 v)
+{
+    float2 right = float2(instance.w, -instance.z);
+    return float3(right.x * v.x + instance.z * v.z, v.y, right.y * v.x + instance.w * v.z);
+}
+
 PSInput VSMain(VSInput input)
 {
     PSInput output;
-    output.worldPos = input.position;
-    output.position = mul(viewProjection, float4(input.position, 1.0));
-    output.normal = input.normal;
+    output.worldPos = RotateInstance(input.instance, input.position) + float3(input.instance.x, 0.0, input.instance.y);
+    output.position = mul(viewProjection, float4(output.worldPos, 1.0));
+    output.normal = RotateInstance(input.instance, input.normal);
     output.uv = input.uv;
     return output;
 }
 
+// Light unpacking, same as LightPack_Decode
+float UnpackSnorm16(uint bits)
+{
+    return max((float)((int)(bits << 16) >> 16) / 32767.0, -1.0);
+}
+
+// Cell index (int16) and offset (unorm16) to world units; 16 = LIGHT_PACK_CELL_SIZE
+float UnpackCoordinate(uint cell, uint offset)
+{
+    return ((float)((int)(cell << 16) >> 16) + (float)offset * (1.0 / 65535.0)) * 16.0;
+}
+
+float4 UnpackShadowTile(uint tile)
+{
+    uint sizeCode = tile >> 24;
+    return float4(tile & 0xfff, (tile >> 12) & 0xfff, sizeCode ? (float)(1u << (sizeCode - 1)) : 0.0, 0.0);
+}
+
+ConeLight UnpackConeLight(int lightIndex)
+{
+    PackedConeLight packed = coneLights[lightIndex];
+    LightClass lightClass = lightClasses[packed.heightAndClass >> 16];
+
+    // Octahedral direction, +Y / -Y hemispheres
+    float u = UnpackSnorm16(packed.direction & 0xffff);
+    float v = UnpackSnorm16(packed.direction >> 16);
+    float3 direction = float3(u, 1.0 - abs(u) - abs(v), v);
+    if (direction.y < 0.0)
+    {
+        direction.x = (1.0 - abs(v)) * (u >= 0.0 ? 1.0 : -1.0);
+        direction.z = (1.0 - abs(u)) * (v >= 0.0 ? 1.0 : -1.0);
+    }
+
+    ConeLight light;
+    light.positionAndRange = float4(UnpackCoordinate(packed.cell & 0xffff, packed.offset & 0xffff),
+                                    f16tof32(packed.heightAndClass & 0xffff),
+                                    UnpackCoordinate(packed.cell >> 16, packed.offset >> 16),
+                                    lightClass.rangeAndCos.x);
+    light.directionAndCosOuter = float4(normalize(direction), lightClass.rangeAndCos.y);
+    light.colorAndCosInner = float4(lightClass.color.xyz, lightClass.rangeAndCos.z);
+    light.shadowTile = UnpackShadowTile(packed.shadowTile);
+    return light;
+}
+
+// Depth stored in the light's atlas tile; 0 outside the tile, like an
+// out-of-bounds Load from a texture of the tile's size
+float LoadShadowAtlas(float4 shadowTile, float2 shadowUV)
+{
+    // int() truncates toward zero
+    float2 texel = shadowUV * shadowTile.z;
+    if (any(texel <= -1.0) || any(texel >= shadowTile.z))
+        return 0.0;
+    return shadowAtlas.Load(int3(int2(shadowTile.xy) + int2(texel), 0));
+}
+
 float CalculateShadow(float3 worldPos, int lightIndex)
 {
+    float4 shadowTile = UnpackShadowTile(coneLights[lightIndex].shadowTile);
+    if (shadowTile.z <= 0.0)
+        return 1.0;
+
     float4x4 lightVP = lightMatrices[lightIndex];
     float4 lightSpacePos = mul(lightVP, float4(worldPos, 1.0));
 
@@ -586,8 +1072,7 @@ float CalculateShadow(float3 worldPos, int lightIndex)
         return 1.0;
 
     // Sample shadow map
-    int3 texCoord = int3(shadowUV * 256.0, lightIndex);
-    float shadowDepth = coneShadowMaps.Load(int4(texCoord, 0));
+    float shadowDepth = LoadShadowAtlas(shadowTile, shadowUV);
 
     // DEBUG: Show colors based on comparison
     // projCoords.z is our depth, shadowDepth is stored depth
@@ -631,9 +1116,66 @@ float3 IntensityToHeatColor(float intensity)
     return HSVtoRGB(hue, 1.0, 1.0);
 }
 
+float HorizonClearance(float lightY, float requiredHeight)
+{
+    // Soft shadow with linear ramp
+    float bias = 0.1;
+    float softness = 1.5;
+    return saturate((lightY - (requiredHeight + bias)) / softness);
+}
+
+// Shadow from the angular horizon map: the occluder stored for a direction
+// only counts if it lies before the light. Bilinear over the 4 nearest
+// texels, linear between the 2 directions around the light.
+float CalculateAngularHorizonShadow(float3 worldPos, float3 lightPos)
+{
+    float2 uv;
+    uv.x = (worldPos.x - horizonWorldMinX) / horizonWorldSize;
+    uv.y = (worldPos.z - horizonWorldMinZ) / horizonWorldSize;
+    if (uv.x < 0.0 || uv.x > 1.0 || uv.y < 0.0 || uv.y > 1.0)
+        return 1.0;
+
+    float2 toLight = lightPos.xz - worldPos.xz;
+    float distToLight = length(toLight);
+    if (distToLight < 0.001)
+        return 1.0;
+
+    uint size, sizeY, angleCount;
+    angularHorizon.GetDimensions(size, sizeY, angleCount);
+
+    float azimuth = atan2(toLight.y, toLight.x) * float(angleCount) / 6.28318530718;
+    if (azimuth < 0.0)
+        azimuth += float(angleCount);
+    int dir0 = min(int(azimuth), int(angleCount) - 1);
+    int dir1 = (dir0 + 1) % int(angleCount);
+    float dirWeight = azimuth - float(dir0);
+
+    float2 texelPos = uv * float(size) - 0.5;
+    float2 base = floor(texelPos);
+    float2 weight = texelPos - base;
+
+    float shadow = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        int2 offset = int2(i & 1, i >> 1);
+        int2 texel = clamp(int2(base) + offset, 0, int(size) - 1);
+        float2 h0 = angularHorizon.Load(int4(texel, dir0, 0));
+        float2 h1 = angularHorizon.Load(int4(texel, dir1, 0));
+        // Nothing before the light: only the ground is in the way
+        float s0 = HorizonClearance(lightPos.y, (h0.y <= distToLight) ? h0.x * distToLight : 0.0);
+        float s1 = HorizonClearance(lightPos.y, (h1.y <= distToLight) ? h1.x * distToLight : 0.0);
+        float2 w = lerp(1.0 - weight, weight, float2(offset));
+        shadow += w.x * w.y * lerp(s0, s1, dirWeight);
+    }
+    return shadow;
+}
+
 // Calculate horizon-based shadow using precomputed required light heights
 float CalculateHorizonShadow(float3 worldPos, float3 lightPos, int lightIndex)
 {
+    if (useAngularHorizon > 0.5)
+        return CalculateAngularHorizonShadow(worldPos, lightPos);
+
     // Convert world position to horizon map UV
     float2 uv;
     uv.x = (worldPos.x - horizonWorldMinX) / horizonWorldSize;
@@ -645,12 +1187,7 @@ float CalculateHorizonShadow(float3 worldPos, float3 lightPos, int lightIndex)
 
     // Sample horizon map at mip level 2 for hardware-blurred soft shadows
     float requiredHeight = horizonMaps.SampleLevel(linearSampler, float3(uv, lightIndex), 2.0);
-
-    // Soft shadow with linear ramp
-    float bias = 0.1;
-    float softness = 1.5;
-    float clearance = lightPos.y - (requiredHeight + bias);
-    return saturate(clearance / softness);
+    return HorizonClearance(lightPos.y, requiredHeight);
 }
 
 float3 CalculateConeLightContribution(float3 worldPos, float3 normal, ConeLight light, int lightIndex)
@@ -675,18 +1212,18 @@ float3 CalculateConeLightContribution(float3 worldPos, float3 normal, ConeLight
     distAtten = pow(distAtten, falloffExponent);
     float ndotl = saturate(dot(normal, toLightNorm));
 
-    // Compute shadow (skip if disabled)
+    // Compute shadow (skip if disabled or the light cannot be shadowed)
     float shadow = 1.0;
-    if (disableShadows < 0.5)
+    if (disableShadows < 0.5 && lightIndex < (int)shadowedLightCount)
     {
         if (useHorizonMapping > 0.5)
         {
             // Use horizon mapping for shadows
             shadow = CalculateHorizonShadow(worldPos, lightPos, lightIndex);
         }
-        else
+        else if (light.shadowTile.z > 0.0)
         {
-            // Use traditional shadow mapping
+            // Use traditional shadow mapping (lights without an atlas tile stay unshadowed)
             float4x4 lightVP = lightMatrices[lightIndex];
             float4 lightSpacePos = mul(lightVP, float4(worldPos, 1.0));
             float3 projCoords = lightSpacePos.xyz / lightSpacePos.w;
@@ -694,8 +1231,7 @@ float3 CalculateConeLightContribution(float3 worldPos, float3 normal, ConeLight
             float2 shadowUV = projCoords.xy * 0.5 + 0.5;
             shadowUV.y = 1.0 - shadowUV.y;
 
-            int3 texCoord = int3(shadowUV * 256.0, lightIndex);
-            float shadowDepth = coneShadowMaps.Load(int4(texCoord, 0));
+            float shadowDepth = LoadShadowAtlas(light.shadowTile, shadowUV);
 
             // Shadow comparison: lit if fragment depth <= shadow depth + bias
             shadow = (projCoords.z <= shadowDepth + shadowBias) ? 1.0 : 0.0;
@@ -705,6 +1241,40 @@ float3 CalculateConeLightContribution(float3 worldPos, float3 normal, ConeLight
     return lightColor * ndotl * coneAtten * distAtten * shadow;
 }
 
+// Same as LightClusters_GetClusterIndex
+uint GetClusterIndex(float2 pixel, float3 worldPos)
+{
+    uint2 tile = min(uint2(max(pixel / clusterTileSize, 0.0)), uint2(clusterCountX, clusterCountY) - 1);
+    float viewDepth = dot(worldPos - cameraPos, cameraForward);
+    uint slice = min((uint)(log(max(viewDepth, clusterNearZ) / clusterNearZ) * clusterDepthScale), (uint)clusterCountZ - 1);
+    return (slice * (uint)clusterCountY + tile.y) * (uint)clusterCountX + tile.x;
+}
+
+// Same as LightGrid_GetCellIndex (the grid covers the horizon map bounds)
+uint GetLightGridCell(float3 worldPos)
+{
+    float2 uv = (worldPos.xz - float2(horizonWorldMinX, horizonWorldMinZ)) / horizonWorldSize;
+    int2 cell = clamp(int2(floor(uv * lightGridSize)), 0, (int)lightGridSize - 1);
+    return (uint)cell.y * (uint)lightGridSize + (uint)cell.x;
+}
+
+// Lights to shade for a pixel: clusterLightIndices[first, first + count) with
+// clustered or grid culling, otherwise lights [0, count)
+bool GetPixelLights(float2 pixel, float3 worldPos, out uint first, out uint count)
+{
+    int mode = (int)lightCullingMode;
+    if (mode == 1 || mode == 2)
+    {
+        uint2 range = clusterRanges[(mode == 1) ? GetClusterIndex(pixel, worldPos) : GetLightGridCell(worldPos)];
+        first = range.x;
+        count = range.y;
+        return true;
+    }
+    first = 0;
+    count = (uint)numConeLights;
+    return false;
+}
+
 // Convert light count to heat map color (green -> yellow -> red)
 float3 LightCountToColor(int count)
 {
@@ -727,15 +1297,20 @@ float3 LightCountToColor(int count)
 
 float4 PSMain(PSInput input) : SV_TARGET
 {
+    uint firstLight, lightCount;
+    bool culled = GetPixelLights(input.position.xy, input.worldPos, firstLight, lightCount);
+
     // Debug mode: show light overlap heat map
     if (debugLightOverlap > 0.5)
     {
-        int lightCount = (int)numConeLights;
         float overlapCount = 0.0;
 
-        for (int i = 0; i < lightCount; i++)
+        for (uint j = 0; j < lightCount; j++)
         {
-            float3 contribution = CalculateConeLightContribution(input.worldPos, input.normal, coneLights[i], i);
+            int i = (int)j;
+            if (culled)
+                i = (int)clusterLightIndices[firstLight + j];
+            float3 contribution = CalculateConeLightContribution(input.worldPos, input.normal, UnpackConeLight(i), i);
             // Count as 1.0 if any light contribution
             float total = dot(contribution, float3(1, 1, 1));
             overlapCount += step(0.000001, total);
@@ -775,10 +1350,12 @@ float4 PSMain(PSInput input) : SV_TARGET
         color = boxColor * (ambientIntensity + (1.0 - ambientIntensity) * ndotl);
     }
 
-    int lightCount = (int)numConeLights;
-    for (int i = 0; i < lightCount; i++)
+    for (uint j = 0; j < lightCount; j++)
     {
-        color += CalculateConeLightContribution(input.worldPos, input.normal, coneLights[i], i) * coneLightIntensity;
+        int i = (int)j;
+        if (culled)
+            i = (int)clusterLightIndices[firstLight + j];
+        color += CalculateConeLightContribution(input.worldPos, input.normal, UnpackConeLight(i), i) * coneLightIntensity;
     }
 
     float dist = length(input.worldPos - cameraPos);
@@ -800,8 +1377,12 @@ cbuffer CameraConstants : register(b0)
 
 struct VSInput
 {
-    float3 position : POSITION;
+    float3 position : POSITION;     // Unit cone
     float3 color : COLOR;
+    float3 axisX : CONE0;           // DebugConeInstance
+    float3 axisY : CONE1;
+    float3 axisZ : CONE2;
+    float3 origin : CONE3;
 };
 
 struct PSInput
@@ -812,8 +1393,10 @@ struct PSInput
 
 PSInput VSMain(VSInput input)
 {
+    float3 worldPos = input.origin + input.axisX * input.position.x + input.axisY * input.position.y + input.axisZ * input.position.z;
+
     PSInput output;
-    output.position = mul(viewProjection, float4(input.position, 1.0));
+    output.position = mul(viewProjection, float4(worldPos, 1.0));
     output.color = input.color;
     return output;
 }
@@ -836,6 +1419,7 @@ struct VSInput
     float3 position : POSITION;
     float3 normal : NORMAL;
     float2 uv : TEXCOORD;
+    float4 instance : INSTANCE;     // (posX, posZ, dirX, dirZ), see CarInstance
 };
 
 struct PSInput
@@ -845,20 +1429,25 @@ struct PSInput
 
 PSInput VSMain(VSInput input)
 {
+    float2 right = float2(input.instance.w, -input.instance.z);
+    float3 p = input.position;
+    float3 worldPos = float3(input.instance.x + right.x * p.x + input.instance.z * p.z,
+                             p.y,
+                             input.instance.y + right.y * p.x + input.instance.w * p.z);
+
     PSInput output;
-    output.position = mul(shadowViewProjection, float4(input.position, 1.0));
+    output.position = mul(shadowViewProjection, float4(worldPos, 1.0));
     return output;
 }
 )";
 
 static const char* g_FullscreenShaderSource = R"(
-Texture2DArray<float> depthTexture : register(t0);
+Texture2D<float> depthTexture : register(t0);
 SamplerState depthSampler : register(s0);
 
-cbuffer SliceIndex : register(b0)
+cbuffer AtlasTile : register(b0)
 {
-    int sliceIndex;
-    int3 padding;
+    float4 tileRect;    // (offset, scale) in atlas UV; scale 0 = no tile
 };
 
 struct VSOutput
@@ -879,7 +1468,9 @@ VSOutput VSMain(uint vertexID : SV_VertexID)
 
 float4 PSMain(VSOutput input) : SV_TARGET
 {
-    float depth = depthTexture.Sample(depthSampler, float3(input.uv, sliceIndex));
+    float depth = 1.0;
+    if (tileRect.z > 0.0)
+        depth = depthTexture.Sample(depthSampler, tileRect.xy + input.uv * tileRect.zw);
     // Remap depth for better visualization
     // Depth 1.0 = far (cleared value), depth < 1.0 = geometry
     // Scale and invert for visibility: near objects = white, far = darker
@@ -899,7 +1490,9 @@ static bool CreatePipelineState(D3D12Renderer* renderer)
     // - Descriptor table for cone shadow maps (t2)
     // - Root constants for shadow pass view-projection (b1) - 16 floats
     // - Descriptor table for horizon maps (t3)
-    D3D12_ROOT_PARAMETER rootParams[6] = {};
+    // - SRVs for the light cluster ranges / indices (t4, t5)
+    // - SRV for the light classes (t7)
+    D3D12_ROOT_PARAMETER rootParams[9] = {};
 
     // Camera constants CBV at b0
     rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
@@ -939,19 +1532,39 @@ static bool CreatePipelineState(D3D12Renderer* renderer)
     rootParams[4].Constants.Num32BitValues = 16;
     rootParams[4].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
 
-    // Horizon maps descriptor table at t3
-    D3D12_DESCRIPTOR_RANGE horizonMapRange = {};
-    horizonMapRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-    horizonMapRange.NumDescriptors = 1;
-    horizonMapRange.BaseShaderRegister = 3;
-    horizonMapRange.RegisterSpace = 0;
-    horizonMapRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+    // Horizon maps descriptor table: per-light maps at t3, angular map at t6
+    D3D12_DESCRIPTOR_RANGE horizonMapRanges[2] = {};
+    horizonMapRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+    horizonMapRanges[0].NumDescriptors = 1;
+    horizonMapRanges[0].BaseShaderRegister = 3;
+    horizonMapRanges[0].RegisterSpace = 0;
+    horizonMapRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+    horizonMapRanges[1] = horizonMapRanges[0];
+    horizonMapRanges[1].BaseShaderRegister = 6;
 
     rootParams[5].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-    rootParams[5].DescriptorTable.NumDescriptorRanges = 1;
-    rootParams[5].DescriptorTable.pDescriptorRanges = &horizonMapRange;
+    rootParams[5].DescriptorTable.NumDescriptorRanges = 2;
+    rootParams[5].DescriptorTable.pDescriptorRanges = horizonMapRanges;
     rootParams[5].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
+    // Light cluster ranges SRV at t4
+    rootParams[6].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+    rootParams[6].Descriptor.ShaderRegister = 4;
+    rootParams[6].Descriptor.RegisterSpace = 0;
+    rootParams[6].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+    // Light cluster indices SRV at t5
+    rootParams[7].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+    rootParams[7].Descriptor.ShaderRegister = 5;
+    rootParams[7].Descriptor.RegisterSpace = 0;
+    rootParams[7].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+    // Light classes SRV at t7
+    rootParams[8].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+    rootParams[8].Descriptor.ShaderRegister = 7;
+    rootParams[8].Descriptor.RegisterSpace = 0;
+    rootParams[8].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
     // Static samplers
     D3D12_STATIC_SAMPLER_DESC staticSamplers[2] = {};
 
@@ -976,7 +1589,7 @@ static bool CreatePipelineState(D3D12Renderer* renderer)
     staticSamplers[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
     D3D12_ROOT_SIGNATURE_DESC rootSigDesc = {};
-    rootSigDesc.NumParameters = 6;
+    rootSigDesc.NumParameters = 9;
     rootSigDesc.pParameters = rootParams;
     rootSigDesc.NumStaticSamplers = 2;
     rootSigDesc.pStaticSamplers = staticSamplers;
@@ -1019,11 +1632,12 @@ static bool CreatePipelineState(D3D12Renderer* renderer)
         return false;
     }
 
-    // Input layout
+    // Input layout: mesh vertices in slot 0, CarInstance per instance in slot 1
     D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,  D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,  D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,       0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "INSTANCE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,  D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
     };
 
     // Create PSO
@@ -1069,9 +1683,14 @@ static bool CreatePipelineState(D3D12Renderer* renderer)
         return false;
     }
 
+    // Unit cone vertices in slot 0, DebugConeInstance per light in slot 1
     D3D12_INPUT_ELEMENT_DESC debugInputLayout[] = {
         { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,  D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
         { "COLOR",    0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "CONE",     0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0,  D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "CONE",     1, DXGI_FORMAT_R32G32B32_FLOAT, 1, 12, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "CONE",     2, DXGI_FORMAT_R32G32B32_FLOAT, 1, 24, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "CONE",     3, DXGI_FORMAT_R32G32B32_FLOAT, 1, 36, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
     };
 
     D3D12_GRAPHICS_PIPELINE_STATE_DESC debugPsoDesc = {};
@@ -1148,11 +1767,11 @@ static bool CreateFullscreenPipeline(D3D12Renderer* renderer)
 
     D3D12_ROOT_PARAMETER rootParams[2] = {};
 
-    // Root constant for slice index at b0
+    // Root constants for the atlas tile rect at b0
     rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
     rootParams[0].Constants.ShaderRegister = 0;
     rootParams[0].Constants.RegisterSpace = 0;
-    rootParams[0].Constants.Num32BitValues = 4;  // sliceIndex + padding
+    rootParams[0].Constants.Num32BitValues = 4;  // tileRect
     rootParams[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
     // SRV descriptor table for texture
@@ -1265,357 +1884,14 @@ static bool CreateFullscreenPipeline(D3D12Renderer* renderer)
     return true;
 }
 
-static void AddBox(std::vector<Vertex>& verts, std::vector<uint32_t>& inds,
-                   float cx, float cy, float cz, float sx, float sy, float sz)
-{
-    // Box half-sizes
-    float hx = sx * 0.5f;
-    float hy = sy * 0.5f;
-    float hz = sz * 0.5f;
-
-    uint32_t base = (uint32_t)verts.size();
-
-    // Front face (Z+)
-    verts.push_back({{ cx - hx, cy - hy, cz + hz }, { 0, 0, 1 }, { 0, 0 }});
-    verts.push_back({{ cx + hx, cy - hy, cz + hz }, { 0, 0, 1 }, { 1, 0 }});
-    verts.push_back({{ cx + hx, cy + hy, cz + hz }, { 0, 0, 1 }, { 1, 1 }});
-    verts.push_back({{ cx - hx, cy + hy, cz + hz }, { 0, 0, 1 }, { 0, 1 }});
-
-    // Back face (Z-)
-    verts.push_back({{ cx + hx, cy - hy, cz - hz }, { 0, 0, -1 }, { 0, 0 }});
-    verts.push_back({{ cx - hx, cy - hy, cz - hz }, { 0, 0, -1 }, { 1, 0 }});
-    verts.push_back({{ cx - hx, cy + hy, cz - hz }, { 0, 0, -1 }, { 1, 1 }});
-    verts.push_back({{ cx + hx, cy + hy, cz - hz }, { 0, 0, -1 }, { 0, 1 }});
-
-    // Right face (X+)
-    verts.push_back({{ cx + hx, cy - hy, cz + hz }, { 1, 0, 0 }, { 0, 0 }});
-    verts.push_back({{ cx + hx, cy - hy, cz - hz }, { 1, 0, 0 }, { 1, 0 }});
-    verts.push_back({{ cx + hx, cy + hy, cz - hz }, { 1, 0, 0 }, { 1, 1 }});
-    verts.push_back({{ cx + hx, cy + hy, cz + hz }, { 1, 0, 0 }, { 0, 1 }});
-
-    // Left face (X-)
-    verts.push_back({{ cx - hx, cy - hy, cz - hz }, { -1, 0, 0 }, { 0, 0 }});
-    verts.push_back({{ cx - hx, cy - hy, cz + hz }, { -1, 0, 0 }, { 1, 0 }});
-    verts.push_back({{ cx - hx, cy + hy, cz + hz }, { -1, 0, 0 }, { 1, 1 }});
-    verts.push_back({{ cx - hx, cy + hy, cz - hz }, { -1, 0, 0 }, { 0, 1 }});
-
-    // Top face (Y+)
-    verts.push_back({{ cx - hx, cy + hy, cz + hz }, { 0, 1, 0 }, { 0, 0 }});
-    verts.push_back({{ cx + hx, cy + hy, cz + hz }, { 0, 1, 0 }, { 1, 0 }});
-    verts.push_back({{ cx + hx, cy + hy, cz - hz }, { 0, 1, 0 }, { 1, 1 }});
-    verts.push_back({{ cx - hx, cy + hy, cz - hz }, { 0, 1, 0 }, { 0, 1 }});
-
-    // Bottom face (Y-)
-    verts.push_back({{ cx - hx, cy - hy, cz - hz }, { 0, -1, 0 }, { 0, 0 }});
-    verts.push_back({{ cx + hx, cy - hy, cz - hz }, { 0, -1, 0 }, { 1, 0 }});
-    verts.push_back({{ cx + hx, cy - hy, cz + hz }, { 0, -1, 0 }, { 1, 1 }});
-    verts.push_back({{ cx - hx, cy - hy, cz + hz }, { 0, -1, 0 }, { 0, 1 }});
-
-    // Indices for 6 faces (2 triangles each) - counter-clockwise winding
-    uint32_t faceIndices[] = {
-        0, 2, 1, 0, 3, 2,       // front
-        4, 6, 5, 4, 7, 6,       // back
-        8, 10, 9, 8, 11, 10,    // right
-        12, 14, 13, 12, 15, 14, // left
-        16, 18, 17, 16, 19, 18, // top
-        20, 22, 21, 20, 23, 22  // bottom
-    };
-
-    for (uint32_t i : faceIndices)
-        inds.push_back(base + i);
-}
-
-// Add a rotated box aligned to a direction (forward = direction of travel)
-static void AddOrientedBox(std::vector<Vertex>& verts, std::vector<uint32_t>& inds,
-                           const Vec3& center, const Vec3& forward, float sx, float sy, float sz)
-{
-    // Build orientation basis
-    Vec3 fwd = forward.normalized();
-    Vec3 up(0, 1, 0);
-    Vec3 right = cross(up, fwd).normalized();  // Changed order for correct handedness
-
-    // Box half-sizes: X=width, Y=height, Z=length (forward)
-    float hx = sx * 0.5f;
-    float hy = sy * 0.5f;
-    float hz = sz * 0.5f;
-
-    uint32_t base = (uint32_t)verts.size();
-
-    // Helper to transform local position to world
-    auto toWorld = [&](float lx, float ly, float lz) -> Vec3 {
-        return center + right * lx + up * ly + fwd * lz;
-    };
-
-    // Helper to transform local normal to world
-    auto normalToWorld = [&](float nx, float ny, float nz) -> Vec3 {
-        return (right * nx + up * ny + fwd * nz).normalized();
-    };
-
-    // Front face (forward +Z local = +fwd world)
-    Vec3 nFront = normalToWorld(0, 0, 1);
-    Vec3 p0 = toWorld(-hx, -hy, hz); verts.push_back({{p0.x, p0.y, p0.z}, {nFront.x, nFront.y, nFront.z}, {0,0}});
-    Vec3 p1 = toWorld( hx, -hy, hz); verts.push_back({{p1.x, p1.y, p1.z}, {nFront.x, nFront.y, nFront.z}, {1,0}});
-    Vec3 p2 = toWorld( hx,  hy, hz); verts.push_back({{p2.x, p2.y, p2.z}, {nFront.x, nFront.y, nFront.z}, {1,1}});
-    Vec3 p3 = toWorld(-hx,  hy, hz); verts.push_back({{p3.x, p3.y, p3.z}, {nFront.x, nFront.y, nFront.z}, {0,1}});
-
-    // Back face (-Z local = -fwd world)
-    Vec3 nBack = normalToWorld(0, 0, -1);
-    Vec3 p4 = toWorld( hx, -hy, -hz); verts.push_back({{p4.x, p4.y, p4.z}, {nBack.x, nBack.y, nBack.z}, {0,0}});
-    Vec3 p5 = toWorld(-hx, -hy, -hz); verts.push_back({{p5.x, p5.y, p5.z}, {nBack.x, nBack.y, nBack.z}, {1,0}});
-    Vec3 p6 = toWorld(-hx,  hy, -hz); verts.push_back({{p6.x, p6.y, p6.z}, {nBack.x, nBack.y, nBack.z}, {1,1}});
-    Vec3 p7 = toWorld( hx,  hy, -hz); verts.push_back({{p7.x, p7.y, p7.z}, {nBack.x, nBack.y, nBack.z}, {0,1}});
-
-    // Right face (+X local = +right world)
-    Vec3 nRight = normalToWorld(1, 0, 0);
-    Vec3 p8  = toWorld(hx, -hy,  hz); verts.push_back({{p8.x,  p8.y,  p8.z},  {nRight.x, nRight.y, nRight.z}, {0,0}});
-    Vec3 p9  = toWorld(hx, -hy, -hz); verts.push_back({{p9.x,  p9.y,  p9.z},  {nRight.x, nRight.y, nRight.z}, {1,0}});
-    Vec3 p10 = toWorld(hx,  hy, -hz); verts.push_back({{p10.x, p10.y, p10.z}, {nRight.x, nRight.y, nRight.z}, {1,1}});
-    Vec3 p11 = toWorld(hx,  hy,  hz); verts.push_back({{p11.x, p11.y, p11.z}, {nRight.x, nRight.y, nRight.z}, {0,1}});
-
-    // Left face (-X local = -right world)
-    Vec3 nLeft = normalToWorld(-1, 0, 0);
-    Vec3 p12 = toWorld(-hx, -hy, -hz); verts.push_back({{p12.x, p12.y, p12.z}, {nLeft.x, nLeft.y, nLeft.z}, {0,0}});
-    Vec3 p13 = toWorld(-hx, -hy,  hz); verts.push_back({{p13.x, p13.y, p13.z}, {nLeft.x, nLeft.y, nLeft.z}, {1,0}});
-    Vec3 p14 = toWorld(-hx,  hy,  hz); verts.push_back({{p14.x, p14.y, p14.z}, {nLeft.x, nLeft.y, nLeft.z}, {1,1}});
-    Vec3 p15 = toWorld(-hx,  hy, -hz); verts.push_back({{p15.x, p15.y, p15.z}, {nLeft.x, nLeft.y, nLeft.z}, {0,1}});
-
-    // Top face (+Y local = +up world)
-    Vec3 nTop = normalToWorld(0, 1, 0);
-    Vec3 p16 = toWorld(-hx, hy,  hz); verts.push_back({{p16.x, p16.y, p16.z}, {nTop.x, nTop.y, nTop.z}, {0,0}});
-    Vec3 p17 = toWorld( hx, hy,  hz); verts.push_back({{p17.x, p17.y, p17.z}, {nTop.x, nTop.y, nTop.z}, {1,0}});
-    Vec3 p18 = toWorld( hx, hy, -hz); verts.push_back({{p18.x, p18.y, p18.z}, {nTop.x, nTop.y, nTop.z}, {1,1}});
-    Vec3 p19 = toWorld(-hx, hy, -hz); verts.push_back({{p19.x, p19.y, p19.z}, {nTop.x, nTop.y, nTop.z}, {0,1}});
-
-    // Bottom face (-Y local = -up world)
-    Vec3 nBottom = normalToWorld(0, -1, 0);
-    Vec3 p20 = toWorld(-hx, -hy, -hz); verts.push_back({{p20.x, p20.y, p20.z}, {nBottom.x, nBottom.y, nBottom.z}, {0,0}});
-    Vec3 p21 = toWorld( hx, -hy, -hz); verts.push_back({{p21.x, p21.y, p21.z}, {nBottom.x, nBottom.y, nBottom.z}, {1,0}});
-    Vec3 p22 = toWorld( hx, -hy,  hz); verts.push_back({{p22.x, p22.y, p22.z}, {nBottom.x, nBottom.y, nBottom.z}, {1,1}});
-    Vec3 p23 = toWorld(-hx, -hy,  hz); verts.push_back({{p23.x, p23.y, p23.z}, {nBottom.x, nBottom.y, nBottom.z}, {0,1}});
-
-    // Indices for 6 faces (2 triangles each)
-    uint32_t faceIndices[] = {
-        0, 2, 1, 0, 3, 2,       // front
-        4, 6, 5, 4, 7, 6,       // back
-        8, 10, 9, 8, 11, 10,    // right
-        12, 14, 13, 12, 15, 14, // left
-        16, 18, 17, 16, 19, 18, // top
-        20, 22, 21, 20, 23, 22  // bottom
-    };
-
-    for (uint32_t i : faceIndices)
-        inds.push_back(base + i);
-}
-
-// Helper function to get position and direction on the oval track
-// Progress: 0-1 around the track
-// Returns position and forward direction
-static void GetTrackPositionAndDirection(float progress, float straightLength, float radius,
-                                          Vec3& outPos, Vec3& outDir)
-{
-    const float PI = 3.14159265f;
-
-    // Track layout (counterclockwise):
-    // - Bottom straight: progress 0 to 0.25 (going +X)
-    // - Right semicircle: progress 0.25 to 0.5 (turning around)
-    // - Top straight: progress 0.5 to 0.75 (going -X)
-    // - Left semicircle: progress 0.75 to 1.0 (turning around)
-
-    float totalStraight = straightLength * 2.0f;
-    float totalCurve = 2.0f * PI * radius;
-    float totalLength = totalStraight + totalCurve;
-
-    float straightFraction = totalStraight / totalLength;
-    float curveFraction = totalCurve / totalLength;
-    float singleStraightFrac = straightFraction * 0.5f;
-    float singleCurveFrac = curveFraction * 0.5f;
-
-    float halfStraight = straightLength * 0.5f;
-
-    if (progress < singleStraightFrac)
-    {
-        // Bottom straight (going +X direction)
-        float t = progress / singleStraightFrac;
-        outPos = Vec3(-halfStraight + t * straightLength, 0, -radius);
-        outDir = Vec3(1, 0, 0);
-    }
-    else if (progress < singleStraightFrac + singleCurveFrac)
-    {
-        // Right semicircle
-        float t = (progress - singleStraightFrac) / singleCurveFrac;
-        float angle = -PI * 0.5f + t * PI;  // -90 to +90 degrees
-        outPos = Vec3(halfStraight + cosf(angle) * radius, 0, sinf(angle) * radius);
-        outDir = Vec3(-sinf(angle), 0, cosf(angle));
-    }
-    else if (progress < 2.0f * singleStraightFrac + singleCurveFrac)
-    {
-        // Top straight (going -X direction)
-        float t = (progress - singleStraightFrac - singleCurveFrac) / singleStraightFrac;
-        outPos = Vec3(halfStraight - t * straightLength, 0, radius);
-        outDir = Vec3(-1, 0, 0);
-    }
-    else
-    {
-        // Left semicircle
-        float t = (progress - 2.0f * singleStraightFrac - singleCurveFrac) / singleCurveFrac;
-        float angle = PI * 0.5f + t * PI;  // +90 to +270 degrees
-        outPos = Vec3(-halfStraight + cosf(angle) * radius, 0, sinf(angle) * radius);
-        outDir = Vec3(-sinf(angle), 0, cosf(angle));
-    }
-}
-
 static bool CreateGeometry(D3D12Renderer* renderer)
 {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
-
-    // Ground plane
-    const float planeSize = 1000.0f;
-    const float halfPlane = planeSize * 0.5f;
-
-    uint32_t planeBase = (uint32_t)vertices.size();
-    vertices.push_back({{ -halfPlane, 0, -halfPlane }, { 0, 1, 0 }, { 0, 0 }});
-    vertices.push_back({{  halfPlane, 0, -halfPlane }, { 0, 1, 0 }, { 1, 0 }});
-    vertices.push_back({{  halfPlane, 0,  halfPlane }, { 0, 1, 0 }, { 1, 1 }});
-    vertices.push_back({{ -halfPlane, 0,  halfPlane }, { 0, 1, 0 }, { 0, 1 }});
-
-    indices.push_back(planeBase + 0);
-    indices.push_back(planeBase + 1);
-    indices.push_back(planeBase + 2);
-    indices.push_back(planeBase + 0);
-    indices.push_back(planeBase + 2);
-    indices.push_back(planeBase + 3);
-
-    // Car-sized boxes: 4m long, 2m wide, 1.5m tall
-    const float carLength = 4.0f;
-    const float carWidth = 2.0f;
-    const float carHeight = 1.5f;
-
-    // Track parameters
-    const float straightLength = renderer->trackStraightLength;
-    const float radius = renderer->trackRadius;
-    const float laneWidth = renderer->trackLaneWidth;
-    const float PI = 3.14159265f;
-
-    // Calculate total track length
-    renderer->trackLength = straightLength * 2.0f + 2.0f * PI * radius;
-
-    // 60 cars in 2 lanes
-    const int numCars = 60;
-    const int carsPerLane = numCars / 2;
-    renderer->numCars = numCars;
-
-    // Record where car vertices start (after ground plane)
-    renderer->carVertexStartIndex = (uint32_t)vertices.size();
-
-    // Headlight parameters
-    const float headlightHeight = 0.6f;
-    const float headlightSpacing = 0.7f;
-    const float headlightRange = 30.0f;
-    const float headlightInnerAngle = 0.15f;
-    const float headlightOuterAngle = 0.35f;
-    const Vec3 headlightColor(1.5f, 1.4f, 1.2f);
-
-    renderer->numConeLights = 0;
-
-    // Initialize AABB for track bounds
-    renderer->carAABB.min = Vec3(-straightLength * 0.5f - radius - 20.0f, 0, -radius - 20.0f);
-    renderer->carAABB.max = Vec3(straightLength * 0.5f + radius + 20.0f, carHeight, radius + 20.0f);
-
-    // Spacing between cars along track (as fraction of track length)
-    float carSpacing = 1.0f / (float)carsPerLane;
-
-    for (int i = 0; i < numCars; i++)
-    {
-        int lane = i % 2;  // 0 = inner lane, 1 = outer lane
-        int posInLane = i / 2;
-
-        // Initial progress along track (evenly spaced within each lane)
-        float progress = (float)posInLane * carSpacing;
-        renderer->carTrackProgress[i] = progress;
-
-        // Lane offset (negative = inner, positive = outer)
-        renderer->carLane[i] = (lane == 0) ? -laneWidth * 0.5f : laneWidth * 0.5f;
-
-        // Get position and direction on track centerline
-        Vec3 trackPos, trackDir;
-        GetTrackPositionAndDirection(progress, straightLength, radius, trackPos, trackDir);
-
-        // Offset by lane
-        Vec3 trackRight(trackDir.z, 0, -trackDir.x);  // Perpendicular to direction
-        Vec3 carPos = trackPos + trackRight * renderer->carLane[i];
-        carPos.y = carHeight * 0.5f;
-
-        // Add car box aligned to track direction
-        AddOrientedBox(vertices, indices, carPos, trackDir, carWidth, carHeight, carLength);
-
-        // Add two headlights for this car
-        float frontOffset = carLength * 0.5f;
-        Vec3 frontPos = carPos + trackDir * frontOffset;
-        frontPos.y = headlightHeight;
-
-        // Left headlight
-        if (renderer->numConeLights < MAX_CONE_LIGHTS)
-        {
-            Vec3 leftOffset = trackRight * (-headlightSpacing);
-            ConeLight& light = renderer->coneLights[renderer->numConeLights++];
-            light.position = frontPos + leftOffset;
-            light.direction = trackDir;
-            light.color = headlightColor;
-            light.range = headlightRange;
-            light.innerAngle = headlightInnerAngle;
-            light.outerAngle = headlightOuterAngle;
-        }
-
-        // Right headlight
-        if (renderer->numConeLights < MAX_CONE_LIGHTS)
-        {
-            Vec3 rightOffset = trackRight * headlightSpacing;
-            ConeLight& light = renderer->coneLights[renderer->numConeLights++];
-            light.position = frontPos + rightOffset;
-            light.direction = trackDir;
-            light.color = headlightColor;
-            light.range = headlightRange;
-            light.innerAngle = headlightInnerAngle;
-            light.outerAngle = headlightOuterAngle;
-        }
-    }
-
-    // Calculate top-down orthographic view-projection matrix from AABB
-    float padding = 20.0f;
-    float halfWidth = (renderer->carAABB.max.x - renderer->carAABB.min.x) * 0.5f + padding;
-    float halfDepth = (renderer->carAABB.max.z - renderer->carAABB.min.z) * 0.5f + padding;
-
-    // Use the larger dimension for both axes to maintain 1:1 world space aspect ratio
-    float halfSize = (halfWidth > halfDepth) ? halfWidth : halfDepth;
-
-    // Create top-down view matrix (looking down from above)
-    float viewHeight = renderer->carAABB.max.y + 50.0f;
-    Vec3 eyePos(
-        (renderer->carAABB.min.x + renderer->carAABB.max.x) * 0.5f,
-        viewHeight,
-        (renderer->carAABB.min.z + renderer->carAABB.max.z) * 0.5f
-    );
-    Vec3 targetPos(eyePos.x, 0, eyePos.z);
-    Vec3 upDir(0, 0, -1);  // Z- is "up" when looking down
-
-    Mat4 topDownView = Mat4::lookAt(eyePos, targetPos, upDir);
-
-    // Orthographic projection bounds are in view space after lookAt transform
-    // View X = world X, View Y = world -Z, View Z = world -Y (depth)
-    // Use same size for both axes for 1:1 aspect ratio
-    float nearZ = 0.1f;
-    float farZ = viewHeight + 10.0f;  // Far enough to capture ground
-
-    Mat4 topDownProj = Mat4::orthographic(-halfSize, halfSize, -halfSize, halfSize, nearZ, farZ);
-    renderer->topDownViewProj = topDownProj * topDownView;
-
-    // Store horizon mapping world bounds (matches the top-down view)
-    renderer->horizonWorldMin = Vec3(eyePos.x - halfSize, 0, eyePos.z - halfSize);
-    renderer->horizonWorldSize = halfSize * 2.0f;
+    Scene_BuildInstancedGeometry(renderer, vertices, indices);
 
     renderer->indexCount = (uint32_t)indices.size();
-    renderer->carVertexCount = (uint32_t)vertices.size() - renderer->carVertexStartIndex;
+    renderer->carInstanceCount = renderer->numCars + SCENE_FIRST_CAR_INSTANCE;
 
     UINT vertexBufferSize = (UINT)(vertices.size() * sizeof(Vertex));
     UINT indexBufferSize = (UINT)(indices.size() * sizeof(uint32_t));
@@ -1641,12 +1917,11 @@ static bool CreateGeometry(D3D12Renderer* renderer)
         return false;
     }
 
-    // Keep vertex buffer mapped for dynamic car updates
+    // The mesh never changes; cars move through their instances
     void* mappedData;
     renderer->vertexBuffer->Map(0, nullptr, &mappedData);
     memcpy(mappedData, vertices.data(), vertexBufferSize);
-    // Store pointer to car vertices for updates (don't unmap)
-    renderer->carVerticesMapped = reinterpret_cast<Vertex*>(mappedData) + renderer->carVertexStartIndex;
+    renderer->vertexBuffer->Unmap(0, nullptr);
 
     renderer->vertexBufferView.BufferLocation = renderer->vertexBuffer->GetGPUVirtualAddress();
     renderer->vertexBufferView.SizeInBytes = vertexBufferSize;
@@ -1674,57 +1949,79 @@ static bool CreateGeometry(D3D12Renderer* renderer)
     return true;
 }
 
-static bool CreateDebugGeometry(D3D12Renderer* renderer)
+// Built-in overlays through the DebugDraw stream, generated in parallel
+static void DrawDebugOverlays(D3D12Renderer* renderer)
 {
-    std::vector<DebugVertex> debugVerts;
-    const int coneSegments = 16;
-    const Vec3 coneColor(1.0f, 1.0f, 0.0f);  // Yellow for cone wireframe
+    DebugDraw* dd = &renderer->debugDraw;
 
-    for (uint32_t i = 0; i < renderer->numConeLights; ++i)
+    if (renderer->showCasterBounds)
     {
-        const ConeLight& light = renderer->coneLights[i];
-        Vec3 pos = light.position;
-        Vec3 dir = light.direction;
-        float range = renderer->headlightRange;  // Use slider value
-        float outerAngle = light.outerAngle;
-
-        // Calculate basis vectors perpendicular to direction
-        Vec3 up = (fabsf(dir.y) < 0.99f) ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
-        Vec3 right = cross(dir, up).normalized();
-        up = cross(right, dir).normalized();
-
-        // Cone end radius at range distance
-        float endRadius = range * tanf(outerAngle);
-
-        // Draw lines from apex to cone circle
-        for (int j = 0; j < coneSegments; ++j)
+        ParallelFor(renderer->numCars, [&](uint32_t c)
         {
-            float angle = (float)j / (float)coneSegments * 6.28318f;
-            float nextAngle = (float)(j + 1) / (float)coneSegments * 6.28318f;
-
-            Vec3 offset1 = right * (cosf(angle) * endRadius) + up * (sinf(angle) * endRadius);
-            Vec3 offset2 = right * (cosf(nextAngle) * endRadius) + up * (sinf(nextAngle) * endRadius);
+            Vec3 center, extents;
+            ShadowCulling_GetCarBounds(renderer, c, center, extents);
+            DebugDraw_Box(dd, center, extents, Vec3(1.0f, 0.8f, 0.2f));
+        });
+    }
 
-            Vec3 endPoint1 = pos + dir * range + offset1;
-            Vec3 endPoint2 = pos + dir * range + offset2;
+    if (renderer->showShadowFrusta)
+    {
+        // Labels face the camera, sized by distance so they stay readable
+        const Camera& camera = renderer->camera;
+        Vec3 forward = camera.getForward();
+        Vec3 right = cross(forward, camera.getUp()).normalized();
+        Vec3 up = cross(right, forward);
 
-            // Line from apex to edge
-            debugVerts.push_back({{pos.x, pos.y, pos.z}, {coneColor.x, coneColor.y, coneColor.z}});
-            debugVerts.push_back({{endPoint1.x, endPoint1.y, endPoint1.z}, {coneColor.x, coneColor.y, coneColor.z}});
+        const ShadowAtlas& atlas = renderer->shadowAtlas;
+        ParallelFor((uint32_t)atlas.tiles.size(), [&](uint32_t i)
+        {
+            if (atlas.tiles[i].size == 0)
+                return;
+            DebugDraw_Frustum(dd, renderer->coneLightViewProj[i], Vec3(0.2f, 0.9f, 1.0f));
 
-            // Line around the circle edge
-            debugVerts.push_back({{endPoint1.x, endPoint1.y, endPoint1.z}, {coneColor.x, coneColor.y, coneColor.z}});
-            debugVerts.push_back({{endPoint2.x, endPoint2.y, endPoint2.z}, {coneColor.x, coneColor.y, coneColor.z}});
-        }
+            char label[32];
+            snprintf(label, sizeof(label), "L%u %u", i, atlas.tiles[i].size);
+            Vec3 position = Simulation_GetLightPosition(renderer, i);
+            float height = 0.02f * (position - camera.position).length();
+            DebugDraw_Text(dd, position + up * height, right, up, height, label, Vec3(1.0f, 1.0f, 1.0f));
+        });
+    }
 
-        // Direction line (center axis)
-        Vec3 endCenter = pos + dir * range;
-        debugVerts.push_back({{pos.x, pos.y, pos.z}, {1.0f, 0.0f, 0.0f}});  // Red for center
-        debugVerts.push_back({{endCenter.x, endCenter.y, endCenter.z}, {1.0f, 0.0f, 0.0f}});
+    // Only built in grid mode; green for one light up to red at overlapMaxCount
+    const LightGrid& grid = renderer->lightGrid;
+    if (renderer->showLightGridCells && renderer->lightCullingMode == LIGHT_CULLING_GRID && grid.size > 0)
+    {
+        float cellSize = grid.worldSize / (float)grid.size;
+        ParallelFor(grid.size, [&](uint32_t z)
+        {
+            for (uint32_t x = 0; x < grid.size; ++x)
+            {
+                uint32_t count = grid.ranges[z * grid.size + x].count;
+                if (count == 0)
+                    continue;
+                float t = std::min((float)(count - 1) / std::max(renderer->overlapMaxCount - 1.0f, 1.0f), 1.0f);
+                float x0 = grid.minX + (float)x * cellSize, z0 = grid.minZ + (float)z * cellSize;
+                DebugDraw_RectXZ(dd, x0, z0, x0 + cellSize, z0 + cellSize, 0.05f, Vec3(t, 1.0f - t, 0.0f));
+            }
+        });
     }
+}
 
-    if (debugVerts.empty())
-        return true;
+// Ground plane as the identity instance, then one box instance per car
+// (vertex buffers and index buffer already bound)
+static void DrawScene(D3D12Renderer* renderer)
+{
+    renderer->commandList->DrawIndexedInstanced(SCENE_GROUND_INDEX_COUNT, 1, 0, 0, 0);
+    if (renderer->numCars > 0)
+        renderer->commandList->DrawIndexedInstanced(INDICES_PER_BOX, renderer->numCars, SCENE_GROUND_INDEX_COUNT, 0, SCENE_FIRST_CAR_INSTANCE);
+}
+
+// Unit cone mesh, drawn once per light with DebugConeInstance transforms
+// uploaded each frame, so the mesh itself never changes
+static bool CreateDebugConeMesh(D3D12Renderer* renderer)
+{
+    std::vector<DebugVertex> debugVerts;
+    Scene_BuildDebugConeMesh(debugVerts);
 
     renderer->debugVertexCount = (uint32_t)debugVerts.size();
     UINT bufferSize = (UINT)(debugVerts.size() * sizeof(DebugVertex));
@@ -1761,78 +2058,99 @@ static bool CreateDebugGeometry(D3D12Renderer* renderer)
     return true;
 }
 
-static bool CreateConstantBuffers(D3D12Renderer* renderer)
+// Creates this frame's upload buffer with the capacity the ring asks for. The
+// GPU is done with the frame that last used it (MoveToNextFrame waited).
+static bool CreateUploadBuffer(D3D12Renderer* renderer, uint32_t frame)
 {
     D3D12_HEAP_PROPERTIES heapProps = {};
     heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
 
-    // Align to 256 bytes
-    const UINT cbSize = (sizeof(CameraConstants) + 255) & ~255;
-
     D3D12_RESOURCE_DESC bufferDesc = {};
     bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    bufferDesc.Width = cbSize;
+    bufferDesc.Width = renderer->uploadRing.frames[frame].capacity;
     bufferDesc.Height = 1;
     bufferDesc.DepthOrArraySize = 1;
     bufferDesc.MipLevels = 1;
     bufferDesc.SampleDesc.Count = 1;
     bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 
-    for (UINT i = 0; i < FRAME_COUNT; ++i)
+    ComPtr<ID3D12Resource> newBuffer;
+    if (FAILED(renderer->device->CreateCommittedResource(
+        &heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+        IID_PPV_ARGS(&newBuffer))))
     {
-        // Main camera constant buffer
-        if (FAILED(renderer->device->CreateCommittedResource(
-            &heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-            IID_PPV_ARGS(&renderer->constantBuffer[i]))))
-        {
-            return false;
-        }
-        renderer->constantBuffer[i]->Map(0, nullptr, (void**)&renderer->constantBufferMapped[i]);
-
-        // Shadow/top-down camera constant buffer
-        if (FAILED(renderer->device->CreateCommittedResource(
-            &heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-            IID_PPV_ARGS(&renderer->shadowConstantBuffer[i]))))
-        {
-            return false;
-        }
-        renderer->shadowConstantBuffer[i]->Map(0, nullptr, (void**)&renderer->shadowConstantBufferMapped[i]);
+        return false;
     }
 
-    // Create cone lights buffer
-    const UINT lightsBufferSize = MAX_CONE_LIGHTS * sizeof(ConeLightGPU);
-    bufferDesc.Width = lightsBufferSize;
+    if (renderer->uploadBuffers[frame])
+        renderer->uploadBuffers[frame]->Unmap(0, nullptr);
+    renderer->uploadBuffers[frame] = newBuffer;
+    renderer->uploadBuffers[frame]->Map(0, nullptr, (void**)&renderer->uploadMapped[frame]);
+    return true;
+}
 
-    for (UINT i = 0; i < FRAME_COUNT; ++i)
+// size bytes of this frame's upload buffer: CPU pointer and GPU address
+struct UploadAllocation
+{
+    void* cpu = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS gpu = 0;
+};
+
+static UploadAllocation AllocateUpload(D3D12Renderer* renderer, uint64_t size)
+{
+    UploadAllocation allocation;
+    uint32_t frame = renderer->frameIndex;
+    uint64_t offset = UploadRing_Allocate(&renderer->uploadRing, size);
+    if (offset == UPLOAD_RING_INVALID_OFFSET)
     {
-        if (FAILED(renderer->device->CreateCommittedResource(
-            &heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-            IID_PPV_ARGS(&renderer->coneLightsBuffer[i]))))
-        {
-            return false;
-        }
+        OutputDebugStringA("Upload ring allocation exceeds the frame's reservation\n");
+        return allocation;
+    }
+    allocation.cpu = renderer->uploadMapped[frame] + offset;
+    allocation.gpu = renderer->uploadBuffers[frame]->GetGPUVirtualAddress() + offset;
+    return allocation;
+}
 
-        renderer->coneLightsBuffer[i]->Map(0, nullptr, (void**)&renderer->coneLightsMapped[i]);
+// Everything sized by the car / light count. Runs from D3D12_Init and again
+// whenever carCount / lightCount change (config load, command line).
+static bool CreateSceneResources(D3D12Renderer* renderer)
+{
+    // Initializes the simulation if needed, so the counts below are current
+    if (!CreateGeometry(renderer))
+    {
+        OutputDebugStringA("Failed to create geometry\n");
+        return false;
     }
 
-    // Create per-light view-projection matrix buffer
-    const UINT matricesBufferSize = MAX_CONE_LIGHTS * sizeof(Mat4);
-    bufferDesc.Width = matricesBufferSize;
+    // The simulation always creates at least one light
+    renderer->lightCapacity = renderer->numConeLights;
+    renderer->horizonSliceCount = std::min(renderer->numConeLights, SCENE_MAX_HORIZON_SLICES);
+    renderer->coneLightViewProj.resize(renderer->numConeLights);
+    renderer->coneLightRecords.resize(renderer->numConeLights);
 
-    for (UINT i = 0; i < FRAME_COUNT; ++i)
+    // New horizon maps and possibly new bounds: every light traces in full
+    renderer->horizonSliceKeys.assign(renderer->horizonSliceCount, HorizonSliceKey());
+    renderer->horizonOccluders = HorizonOccluders();
+
+    // New atlas: every tile is drawn again
+    ShadowCulling_Invalidate(&renderer->shadowCasters);
+
+    char msg[256];
+    snprintf(msg, sizeof(msg), "Scene: %u cars in %u lanes, %u lights (%u horizon slices)\n",
+             renderer->numCars, renderer->numLanes, renderer->numConeLights, renderer->horizonSliceCount);
+    OutputDebugStringA(msg);
+
+    if (!CreateConeShadowMaps(renderer))
     {
-        if (FAILED(renderer->device->CreateCommittedResource(
-            &heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-            IID_PPV_ARGS(&renderer->coneLightMatricesBuffer[i]))))
-        {
-            return false;
-        }
+        OutputDebugStringA("Failed to create cone shadow maps\n");
+        return false;
+    }
 
-        renderer->coneLightMatricesBuffer[i]->Map(0, nullptr, (void**)&renderer->coneLightMatricesMapped[i]);
+    if (!CreateHorizonMaps(renderer))
+    {
+        OutputDebugStringA("Failed to create horizon maps\n");
+        return false;
     }
 
     return true;
@@ -2004,14 +2322,7 @@ bool D3D12_Init(D3D12Renderer* renderer, HWND hwnd, uint32_t width, uint32_t hei
         return false;
     }
 
-    // Create cone light shadow maps (256x256 x 128)
-    if (!CreateConeShadowMaps(renderer))
-    {
-        OutputDebugStringA("Failed to create cone shadow maps\n");
-        return false;
-    }
-
-    // Create horizon mapping resources
+    // Create horizon mapping resources (height map and compute pipeline)
     if (!CreateHorizonMappingResources(renderer))
     {
         OutputDebugStringA("Failed to create horizon mapping resources\n");
@@ -2032,26 +2343,18 @@ bool D3D12_Init(D3D12Renderer* renderer, HWND hwnd, uint32_t width, uint32_t hei
         return false;
     }
 
-    // Create geometry
-    if (!CreateGeometry(renderer))
-    {
-        OutputDebugStringA("Failed to create geometry\n");
-        return false;
-    }
+    // Upload buffers are created by the first frame that uses them
+    UploadRing_Init(&renderer->uploadRing, FRAME_COUNT);
 
-    // Create debug geometry (after main geometry creates cone lights)
-    if (!CreateDebugGeometry(renderer))
+    if (!CreateDebugConeMesh(renderer))
     {
-        OutputDebugStringA("Failed to create debug geometry\n");
+        OutputDebugStringA("Failed to create debug cone mesh\n");
         return false;
     }
 
-    // Create constant buffers
-    if (!CreateConstantBuffers(renderer))
-    {
-        OutputDebugStringA("Failed to create constant buffers\n");
+    // Geometry, shadow map arrays and light buffers for the current car / light count
+    if (!CreateSceneResources(renderer))
         return false;
-    }
 
     // Create ImGui SRV descriptor heap
     D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
@@ -2100,14 +2403,8 @@ void D3D12_Shutdown(D3D12Renderer* renderer)
 
     for (UINT i = 0; i < FRAME_COUNT; ++i)
     {
-        if (renderer->constantBuffer[i])
-            renderer->constantBuffer[i]->Unmap(0, nullptr);
-        if (renderer->shadowConstantBuffer[i])
-            renderer->shadowConstantBuffer[i]->Unmap(0, nullptr);
-        if (renderer->coneLightsBuffer[i])
-            renderer->coneLightsBuffer[i]->Unmap(0, nullptr);
-        if (renderer->coneLightMatricesBuffer[i])
-            renderer->coneLightMatricesBuffer[i]->Unmap(0, nullptr);
+        if (renderer->uploadBuffers[i])
+            renderer->uploadBuffers[i]->Unmap(0, nullptr);
     }
 
     if (renderer->fenceEvent)
@@ -2130,236 +2427,127 @@ void D3D12_WaitForGpu(D3D12Renderer* renderer)
     renderer->fenceValues[renderer->frameIndex]++;
 }
 
-// Update a single oriented box's vertices in place
-static void UpdateOrientedBoxVertices(Vertex* verts, const Vec3& center, const Vec3& forward,
-                                       float sx, float sy, float sz)
-{
-    // Build orientation basis
-    Vec3 fwd = forward.normalized();
-    Vec3 up(0, 1, 0);
-    Vec3 right = cross(up, fwd).normalized();  // Changed order for correct handedness
-
-    // Box half-sizes: X=width, Y=height, Z=length (forward)
-    float hx = sx * 0.5f;
-    float hy = sy * 0.5f;
-    float hz = sz * 0.5f;
-
-    // Helper to transform local position to world
-    auto toWorld = [&](float lx, float ly, float lz) -> Vec3 {
-        return center + right * lx + up * ly + fwd * lz;
-    };
-
-    // Helper to transform local normal to world
-    auto normalToWorld = [&](float nx, float ny, float nz) -> Vec3 {
-        return (right * nx + up * ny + fwd * nz).normalized();
-    };
-
-    int v = 0;
-
-    // Front face (forward +Z local = +fwd world)
-    Vec3 nFront = normalToWorld(0, 0, 1);
-    Vec3 p0 = toWorld(-hx, -hy, hz); verts[v++] = {{p0.x, p0.y, p0.z}, {nFront.x, nFront.y, nFront.z}, {0,0}};
-    Vec3 p1 = toWorld( hx, -hy, hz); verts[v++] = {{p1.x, p1.y, p1.z}, {nFront.x, nFront.y, nFront.z}, {1,0}};
-    Vec3 p2 = toWorld( hx,  hy, hz); verts[v++] = {{p2.x, p2.y, p2.z}, {nFront.x, nFront.y, nFront.z}, {1,1}};
-    Vec3 p3 = toWorld(-hx,  hy, hz); verts[v++] = {{p3.x, p3.y, p3.z}, {nFront.x, nFront.y, nFront.z}, {0,1}};
-
-    // Back face (-Z local = -fwd world)
-    Vec3 nBack = normalToWorld(0, 0, -1);
-    Vec3 p4 = toWorld( hx, -hy, -hz); verts[v++] = {{p4.x, p4.y, p4.z}, {nBack.x, nBack.y, nBack.z}, {0,0}};
-    Vec3 p5 = toWorld(-hx, -hy, -hz); verts[v++] = {{p5.x, p5.y, p5.z}, {nBack.x, nBack.y, nBack.z}, {1,0}};
-    Vec3 p6 = toWorld(-hx,  hy, -hz); verts[v++] = {{p6.x, p6.y, p6.z}, {nBack.x, nBack.y, nBack.z}, {1,1}};
-    Vec3 p7 = toWorld( hx,  hy, -hz); verts[v++] = {{p7.x, p7.y, p7.z}, {nBack.x, nBack.y, nBack.z}, {0,1}};
-
-    // Right face (+X local = +right world)
-    Vec3 nRight = normalToWorld(1, 0, 0);
-    Vec3 p8  = toWorld(hx, -hy,  hz); verts[v++] = {{p8.x,  p8.y,  p8.z},  {nRight.x, nRight.y, nRight.z}, {0,0}};
-    Vec3 p9  = toWorld(hx, -hy, -hz); verts[v++] = {{p9.x,  p9.y,  p9.z},  {nRight.x, nRight.y, nRight.z}, {1,0}};
-    Vec3 p10 = toWorld(hx,  hy, -hz); verts[v++] = {{p10.x, p10.y, p10.z}, {nRight.x, nRight.y, nRight.z}, {1,1}};
-    Vec3 p11 = toWorld(hx,  hy,  hz); verts[v++] = {{p11.x, p11.y, p11.z}, {nRight.x, nRight.y, nRight.z}, {0,1}};
-
-    // Left face (-X local = -right world)
-    Vec3 nLeft = normalToWorld(-1, 0, 0);
-    Vec3 p12 = toWorld(-hx, -hy, -hz); verts[v++] = {{p12.x, p12.y, p12.z}, {nLeft.x, nLeft.y, nLeft.z}, {0,0}};
-    Vec3 p13 = toWorld(-hx, -hy,  hz); verts[v++] = {{p13.x, p13.y, p13.z}, {nLeft.x, nLeft.y, nLeft.z}, {1,0}};
-    Vec3 p14 = toWorld(-hx,  hy,  hz); verts[v++] = {{p14.x, p14.y, p14.z}, {nLeft.x, nLeft.y, nLeft.z}, {1,1}};
-    Vec3 p15 = toWorld(-hx,  hy, -hz); verts[v++] = {{p15.x, p15.y, p15.z}, {nLeft.x, nLeft.y, nLeft.z}, {0,1}};
-
-    // Top face (+Y local = +up world)
-    Vec3 nTop = normalToWorld(0, 1, 0);
-    Vec3 p16 = toWorld(-hx, hy,  hz); verts[v++] = {{p16.x, p16.y, p16.z}, {nTop.x, nTop.y, nTop.z}, {0,0}};
-    Vec3 p17 = toWorld( hx, hy,  hz); verts[v++] = {{p17.x, p17.y, p17.z}, {nTop.x, nTop.y, nTop.z}, {1,0}};
-    Vec3 p18 = toWorld( hx, hy, -hz); verts[v++] = {{p18.x, p18.y, p18.z}, {nTop.x, nTop.y, nTop.z}, {1,1}};
-    Vec3 p19 = toWorld(-hx, hy, -hz); verts[v++] = {{p19.x, p19.y, p19.z}, {nTop.x, nTop.y, nTop.z}, {0,1}};
-
-    // Bottom face (-Y local = -up world)
-    Vec3 nBottom = normalToWorld(0, -1, 0);
-    Vec3 p20 = toWorld(-hx, -hy, -hz); verts[v++] = {{p20.x, p20.y, p20.z}, {nBottom.x, nBottom.y, nBottom.z}, {0,0}};
-    Vec3 p21 = toWorld( hx, -hy, -hz); verts[v++] = {{p21.x, p21.y, p21.z}, {nBottom.x, nBottom.y, nBottom.z}, {1,0}};
-    Vec3 p22 = toWorld( hx, -hy,  hz); verts[v++] = {{p22.x, p22.y, p22.z}, {nBottom.x, nBottom.y, nBottom.z}, {1,1}};
-    Vec3 p23 = toWorld(-hx, -hy,  hz); verts[v++] = {{p23.x, p23.y, p23.z}, {nBottom.x, nBottom.y, nBottom.z}, {0,1}};
-}
-
-// Number of vertices per oriented box (6 faces * 4 vertices)
-static constexpr int VERTS_PER_BOX = 24;
-
 void D3D12_Update(D3D12Renderer* renderer, float deltaTime)
 {
-    // Car dimensions
-    const float carLength = 4.0f;
-    const float carWidth = 2.0f;
-    const float carHeight = 1.5f;
-    const float headlightHeight = 0.6f;
-    const float headlightSpacing = 0.7f;
-
-    // Track parameters
-    float straightLength = renderer->trackStraightLength;
-    float radius = renderer->trackRadius;
-    float trackLength = renderer->trackLength;
-
-    // Calculate spacing parameters
-    // At spacing=1: cars evenly spread (maxSpacing)
-    // At spacing=0: cars close together (minGap = 0.5m between cars)
-    const float minGap = 0.5f;
-    const int carsPerLane = (int)renderer->numCars / 2;
-    float maxSpacingMeters = trackLength / (float)carsPerLane;  // Max distance between cars in each lane
-    float minSpacingMeters = carLength + minGap;  // Minimum: car length + 0.5m gap
-    float currentSpacingMeters = minSpacingMeters + (maxSpacingMeters - minSpacingMeters) * renderer->carSpacing;
-    float spacingFraction = currentSpacingMeters / trackLength;  // As fraction of track
-
-    // Move all cars forward
-    float progressDelta = (renderer->carSpeed * deltaTime) / trackLength;
-
-    for (uint32_t i = 0; i < renderer->numCars; i++)
-    {
-        // Update base progress (car 0 in each lane)
-        renderer->carTrackProgress[i] += progressDelta;
-        if (renderer->carTrackProgress[i] >= 1.0f)
-            renderer->carTrackProgress[i] -= 1.0f;
-
-        // Calculate actual position with spacing applied
-        int lane = i % 2;
-        int posInLane = i / 2;
-        float baseProgress = renderer->carTrackProgress[lane];  // Use lane leader's progress
-        float progress = baseProgress + posInLane * spacingFraction;
-        if (progress >= 1.0f) progress -= 1.0f;
-
-        float laneOffset = renderer->carLane[i];
-
-        // Get position and direction on track
-        Vec3 trackPos, trackDir;
-        GetTrackPositionAndDirection(progress, straightLength, radius, trackPos, trackDir);
-
-        // Calculate car position with lane offset
-        Vec3 trackRight(trackDir.z, 0, -trackDir.x);
-        Vec3 carPos = trackPos + trackRight * laneOffset;
-        carPos.y = carHeight * 0.5f;
-
-        // Update car box vertices
-        Vertex* carVerts = renderer->carVerticesMapped + (i * VERTS_PER_BOX);
-        UpdateOrientedBoxVertices(carVerts, carPos, trackDir, carWidth, carHeight, carLength);
-
-        // Update headlight positions and directions (2 lights per car)
-        uint32_t lightIndex = i * 2;
-        if (lightIndex + 1 < renderer->numConeLights)
-        {
-            float frontOffset = carLength * 0.5f;
-            Vec3 frontPos = carPos + trackDir * frontOffset;
-            frontPos.y = headlightHeight;
-
-            // Left headlight
-            Vec3 leftOffset = trackRight * (-headlightSpacing);
-            renderer->coneLights[lightIndex].position = frontPos + leftOffset;
-            renderer->coneLights[lightIndex].direction = trackDir;
-
-            // Right headlight
-            Vec3 rightOffset = trackRight * headlightSpacing;
-            renderer->coneLights[lightIndex + 1].position = frontPos + rightOffset;
-            renderer->coneLights[lightIndex + 1].direction = trackDir;
-        }
-    }
-
-    // Update debug visualization if enabled
-    if (renderer->showDebugLights)
+    // carCount / lightCount changed since the resources were built (config load,
+    // bookmark, paste): wait for the GPU and reallocate everything sized by them
+    if (Simulation_NeedsInit(renderer) ||
+        renderer->carInstanceCount != renderer->numCars + SCENE_FIRST_CAR_INSTANCE ||
+        renderer->lightCapacity != renderer->numConeLights)
     {
-        CreateDebugGeometry(renderer);
+        D3D12_WaitForGpu(renderer);
+        if (!CreateSceneResources(renderer))
+            OutputDebugStringA("Failed to resize scene resources\n");
     }
+
+    // Step the simulation; the car instances and debug cones are written in D3D12_Render
+    Simulation_Update(renderer, deltaTime);
 }
 
 void D3D12_Render(D3D12Renderer* renderer)
 {
     float aspect = (float)renderer->width / (float)renderer->height;
 
-    // Use activeLightCount for rendering (debug slider)
-    uint32_t lightCount = (uint32_t)renderer->activeLightCount;
-    if (lightCount > renderer->numConeLights) lightCount = renderer->numConeLights;
-
-    // Update main camera constant buffer
-    CameraConstants* cb = renderer->constantBufferMapped[renderer->frameIndex];
-    cb->viewProjection = renderer->camera.getViewProjectionMatrix(aspect);
-    cb->cameraPos = renderer->camera.position;
-    cb->numConeLights = (float)lightCount;
-    cb->ambientIntensity = renderer->ambientIntensity;
-    cb->coneLightIntensity = renderer->coneLightIntensity;
-    cb->shadowBias = renderer->shadowBias;
-    cb->falloffExponent = renderer->headlightFalloff;
-    cb->debugLightOverlap = renderer->showLightOverlap ? 1.0f : 0.0f;
-    cb->overlapMaxCount = renderer->overlapMaxCount;
-    cb->disableShadows = renderer->disableShadows ? 1.0f : 0.0f;
-    cb->useHorizonMapping = renderer->useHorizonMapping ? 1.0f : 0.0f;
-    cb->showGrid = renderer->showGrid ? 1.0f : 0.0f;
-    cb->horizonWorldMinX = renderer->horizonWorldMin.x;
-    cb->horizonWorldMinZ = renderer->horizonWorldMin.z;
-    cb->horizonWorldSize = renderer->horizonWorldSize;
-
-    // Update shadow constant buffer with top-down view
-    CameraConstants* shadowCb = renderer->shadowConstantBufferMapped[renderer->frameIndex];
-    shadowCb->viewProjection = renderer->topDownViewProj;
-    shadowCb->cameraPos = renderer->camera.position;
-    shadowCb->numConeLights = (float)lightCount;
-    shadowCb->ambientIntensity = renderer->ambientIntensity;
-    shadowCb->coneLightIntensity = renderer->coneLightIntensity;
-    shadowCb->shadowBias = renderer->shadowBias;
-    shadowCb->falloffExponent = renderer->headlightFalloff;
-    shadowCb->debugLightOverlap = 0.0f;  // Never in debug mode for shadow pass
-
-    // Update cone lights buffer (use slider-controlled range)
-    float currentRange = renderer->headlightRange;
-    ConeLightGPU* lightsGPU = renderer->coneLightsMapped[renderer->frameIndex];
-    for (uint32_t i = 0; i < renderer->numConeLights; ++i)
-    {
-        const ConeLight& light = renderer->coneLights[i];
-        lightsGPU[i].position[0] = light.position.x;
-        lightsGPU[i].position[1] = light.position.y;
-        lightsGPU[i].position[2] = light.position.z;
-        lightsGPU[i].position[3] = currentRange;  // Use slider value
-        lightsGPU[i].direction[0] = light.direction.x;
-        lightsGPU[i].direction[1] = light.direction.y;
-        lightsGPU[i].direction[2] = light.direction.z;
-        lightsGPU[i].direction[3] = cosf(light.outerAngle);
-        lightsGPU[i].color[0] = light.color.x;
-        lightsGPU[i].color[1] = light.color.y;
-        lightsGPU[i].color[2] = light.color.z;
-        lightsGPU[i].color[3] = cosf(light.innerAngle);
-    }
-
-    // Calculate and update per-light view-projection matrices
-    Mat4* lightMatrices = renderer->coneLightMatricesMapped[renderer->frameIndex];
-    for (uint32_t i = 0; i < renderer->numConeLights; ++i)
-    {
-        const ConeLight& light = renderer->coneLights[i];
-
-        // View matrix: look from light position along light direction
-        Vec3 target = light.position + light.direction * currentRange;
-        Vec3 up = (fabsf(light.direction.y) < 0.99f) ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
-        Mat4 view = Mat4::lookAt(light.position, target, up);
-
-        // Perspective projection using outer cone angle
-        float fov = light.outerAngle * 2.0f;  // Full cone angle
-        Mat4 proj = Mat4::perspective(fov, 1.0f, 0.1f, currentRange);
-
-        renderer->coneLightViewProj[i] = proj * view;
-        lightMatrices[i] = renderer->coneLightViewProj[i];
+    uint32_t lightCount = Scene_GetActiveLightCount(renderer);
+
+    // Per-froxel or per-cell light lists for the main pass
+    const std::vector<LightClusterRange>* lightRanges = &renderer->lightClusters.ranges;
+    const std::vector<uint32_t>* lightIndices = &renderer->lightClusters.lightIndices;
+    if (renderer->lightCullingMode == LIGHT_CULLING_GRID)
+    {
+        LightGrid_Build(renderer, &renderer->lightGrid);
+        lightRanges = &renderer->lightGrid.ranges;
+        lightIndices = &renderer->lightGrid.lightIndices;
+    }
+    else if (renderer->lightCullingMode == LIGHT_CULLING_CLUSTERED)
+    {
+        LightClusters_Build(renderer, renderer->width, renderer->height, &renderer->lightClusters);
+    }
+
+    // Cone lights with this frame's atlas tiles, packed before sizing the upload
+    // (the class table's size depends on the lights)
+    Scene_FillConeLights(renderer, renderer->coneLightRecords.data(), nullptr);
+    ShadowAtlas_Build(renderer, renderer->width, renderer->height, &renderer->shadowAtlas);
+    ShadowAtlas_FillLights(&renderer->shadowAtlas, renderer->coneLightRecords.data(), renderer->numConeLights);
+    if (!LightPack_Encode(renderer->coneLightRecords.data(), renderer->numConeLights, &renderer->lightPack))
+        OutputDebugStringA("Too many light classes, extra lights share the last one\n");
+
+    // Everything this frame uploads, sub-allocated from the frame's upload buffer
+    const uint64_t cbSize = sizeof(CameraConstants);
+    const uint64_t lightsSize = renderer->lightPack.lights.size() * sizeof(PackedConeLight);
+    const uint64_t lightClassesSize = renderer->lightPack.classes.size() * sizeof(LightClassGPU);
+    const uint64_t matricesSize = (uint64_t)renderer->numConeLights * sizeof(Mat4);
+    const uint64_t instancesSize = (uint64_t)renderer->carInstanceCount * sizeof(CarInstance);
+    const uint64_t rangesSize = lightRanges->size() * sizeof(LightClusterRange);
+    const uint64_t indicesSize = lightIndices->size() * sizeof(uint32_t);
+    const uint64_t debugConesSize = renderer->showDebugLights ? (uint64_t)renderer->numConeLights * sizeof(DebugConeInstance) : 0;
+    // Overlay stream sized by what the last frame drew, plus its identity instance
+    const uint32_t debugDrawCapacity = DebugDraw_GetNextCapacity(&renderer->debugDraw);
+    const uint64_t debugDrawSize = (uint64_t)debugDrawCapacity * sizeof(DebugVertex);
+    const uint64_t debugDrawInstanceSize = (debugDrawCapacity > 0) ? sizeof(DebugConeInstance) : 0;
+    uint64_t uploadSize = 0;
+    for (uint64_t size : { cbSize, lightsSize, lightClassesSize, matricesSize, instancesSize, rangesSize, indicesSize, debugConesSize,
+                           debugDrawSize, debugDrawInstanceSize })
+        uploadSize += UploadRing_GetAllocationSize(size);
+
+    if (UploadRing_BeginFrame(&renderer->uploadRing, renderer->frameIndex, uploadSize) &&
+        !CreateUploadBuffer(renderer, renderer->frameIndex))
+    {
+        OutputDebugStringA("Failed to create upload buffer\n");
+        return;
     }
+    UploadAllocation cbUpload = AllocateUpload(renderer, cbSize);
+    UploadAllocation lightsUpload = AllocateUpload(renderer, lightsSize);
+    UploadAllocation lightClassesUpload = AllocateUpload(renderer, lightClassesSize);
+    UploadAllocation matricesUpload = AllocateUpload(renderer, matricesSize);
+    UploadAllocation instancesUpload = AllocateUpload(renderer, instancesSize);
+    UploadAllocation rangesUpload = AllocateUpload(renderer, rangesSize);
+    UploadAllocation indicesUpload = AllocateUpload(renderer, indicesSize);
+    UploadAllocation debugConesUpload = AllocateUpload(renderer, debugConesSize);
+    UploadAllocation debugDrawUpload = AllocateUpload(renderer, debugDrawSize);
+    UploadAllocation debugDrawInstanceUpload = AllocateUpload(renderer, debugDrawInstanceSize);
+
+    // Main camera constants
+    CameraConstants* cb = (CameraConstants*)cbUpload.cpu;
+    Scene_FillCameraConstants(renderer, aspect, cb);
+    if (renderer->lightCullingMode == LIGHT_CULLING_GRID)
+        LightGrid_FillConstants(&renderer->lightGrid, cb);
+    else if (renderer->lightCullingMode == LIGHT_CULLING_CLUSTERED)
+        LightClusters_FillConstants(&renderer->lightClusters, cb);
+
+    // Car poses of this frame
+    Scene_WriteCarInstances(renderer, (CarInstance*)instancesUpload.cpu);
+    D3D12_VERTEX_BUFFER_VIEW instanceBufferView = {};
+    instanceBufferView.BufferLocation = instancesUpload.gpu;
+    instanceBufferView.SizeInBytes = (UINT)instancesSize;
+    instanceBufferView.StrideInBytes = sizeof(CarInstance);
+    D3D12_VERTEX_BUFFER_VIEW sceneVertexBuffers[] = { renderer->vertexBufferView, instanceBufferView };
+
+    // Packed cone lights, and per-light view-projection matrices built straight
+    // into the upload buffer (the CPU copy feeds culling and the shadow pass)
+    if (lightsSize > 0)
+        memcpy(lightsUpload.cpu, renderer->lightPack.lights.data(), lightsSize);
+    if (lightClassesSize > 0)
+        memcpy(lightClassesUpload.cpu, renderer->lightPack.classes.data(), lightClassesSize);
+    Scene_FillLightMatrices(renderer, (Mat4*)matricesUpload.cpu, renderer->coneLightViewProj.data());
+    ShadowCulling_Build(renderer, renderer->coneLightViewProj.data(), &renderer->shadowAtlas, &renderer->shadowCasters);
+
+    // Light lists (allocated in every mode, so the root SRVs stay valid without culling)
+    if (rangesSize > 0)
+        memcpy(rangesUpload.cpu, lightRanges->data(), rangesSize);
+    if (indicesSize > 0)
+        memcpy(indicesUpload.cpu, lightIndices->data(), indicesSize);
+
+    // Debug cone transforms, one instance of the unit cone per light
+    if (debugConesSize > 0)
+        Scene_WriteDebugConeInstances(renderer, (DebugConeInstance*)debugConesUpload.cpu);
+
+    // Overlay lines go straight into the upload buffer; drawn with the debug
+    // shader's instance transform set to identity
+    DebugDraw_Begin(&renderer->debugDraw, (DebugVertex*)debugDrawUpload.cpu, debugDrawCapacity);
+    DrawDebugOverlays(renderer);
+    if (debugDrawInstanceSize > 0)
+        *(DebugConeInstance*)debugDrawInstanceUpload.cpu = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
 
     // Reset command allocator and command list
     renderer->commandAllocators[renderer->frameIndex]->Reset();
@@ -2368,121 +2556,147 @@ void D3D12_Render(D3D12Renderer* renderer)
     // Set root signature
     renderer->commandList->SetGraphicsRootSignature(renderer->rootSignature.Get());
 
+    // Region of the height map the cars changed since the last trace. The
+    // height map and the horizon maps persist between frames: the top-down
+    // pass only runs when it changed, and lights that did not move only
+    // re-trace texels whose ray crosses that region, or nothing at all.
+    HorizonMapParams mapParams = Horizon_GetMapParams(renderer);
+    HorizonTexelRect dirty;
+    bool heightMapChanged = false;
+    if (renderer->useHorizonMapping)
+    {
+        dirty = Horizon_UpdateOccluders(&renderer->horizonOccluders, renderer, mapParams);
+        heightMapChanged = dirty.x1 > dirty.x0 && dirty.y1 > dirty.y0;
+    }
+
     // ========== Shadow Pass (top-down depth-only) ==========
-    // Set top-down view-projection as root constants
-    renderer->commandList->SetGraphicsRoot32BitConstants(4, 16, renderer->topDownViewProj.m, 0);
+    if (heightMapChanged)
+    {
+        // Set top-down view-projection as root constants
+        renderer->commandList->SetGraphicsRoot32BitConstants(4, 16, renderer->topDownViewProj.m, 0);
 
-    // Get shadow DSV handle (second slot in DSV heap)
-    UINT dsvDescriptorSize = renderer->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
-    D3D12_CPU_DESCRIPTOR_HANDLE shadowDsvHandle = renderer->dsvHeap->GetCPUDescriptorHandleForHeapStart();
-    shadowDsvHandle.ptr += dsvDescriptorSize;
+        // Get shadow DSV handle (second slot in DSV heap)
+        UINT dsvDescriptorSize = renderer->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+        D3D12_CPU_DESCRIPTOR_HANDLE shadowDsvHandle = renderer->dsvHeap->GetCPUDescriptorHandleForHeapStart();
+        shadowDsvHandle.ptr += dsvDescriptorSize;
 
-    // Clear shadow depth buffer
-    renderer->commandList->ClearDepthStencilView(shadowDsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+        // Clear shadow depth buffer
+        renderer->commandList->ClearDepthStencilView(shadowDsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
-    // Set render target (depth only, no color target)
-    renderer->commandList->OMSetRenderTargets(0, nullptr, FALSE, &shadowDsvHandle);
+        // Set render target (depth only, no color target)
+        renderer->commandList->OMSetRenderTargets(0, nullptr, FALSE, &shadowDsvHandle);
 
-    // Set viewport and scissor for shadow map
-    D3D12_VIEWPORT shadowViewport = {};
-    shadowViewport.Width = (float)D3D12Renderer::SHADOW_MAP_SIZE;
-    shadowViewport.Height = (float)D3D12Renderer::SHADOW_MAP_SIZE;
-    shadowViewport.MaxDepth = 1.0f;
-    renderer->commandList->RSSetViewports(1, &shadowViewport);
+        // Set viewport and scissor for shadow map
+        D3D12_VIEWPORT shadowViewport = {};
+        shadowViewport.Width = (float)D3D12Renderer::SHADOW_MAP_SIZE;
+        shadowViewport.Height = (float)D3D12Renderer::SHADOW_MAP_SIZE;
+        shadowViewport.MaxDepth = 1.0f;
+        renderer->commandList->RSSetViewports(1, &shadowViewport);
 
-    D3D12_RECT shadowScissorRect = { 0, 0, (LONG)D3D12Renderer::SHADOW_MAP_SIZE, (LONG)D3D12Renderer::SHADOW_MAP_SIZE };
-    renderer->commandList->RSSetScissorRects(1, &shadowScissorRect);
+        D3D12_RECT shadowScissorRect = { 0, 0, (LONG)D3D12Renderer::SHADOW_MAP_SIZE, (LONG)D3D12Renderer::SHADOW_MAP_SIZE };
+        renderer->commandList->RSSetScissorRects(1, &shadowScissorRect);
 
-    // Draw scene to shadow map
-    renderer->commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    renderer->commandList->IASetVertexBuffers(0, 1, &renderer->vertexBufferView);
-    renderer->commandList->IASetIndexBuffer(&renderer->indexBufferView);
-    renderer->commandList->DrawIndexedInstanced(renderer->indexCount, 1, 0, 0, 0);
+        // Draw scene to shadow map
+        renderer->commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        renderer->commandList->IASetVertexBuffers(0, 2, sceneVertexBuffers);
+        renderer->commandList->IASetIndexBuffer(&renderer->indexBufferView);
+        DrawScene(renderer);
+    }
 
     // ========== Cone Light Shadow Maps Pass ==========
-    // Render shadow map for each active cone light
-    UINT coneDsvDescriptorSize = renderer->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
-
-    D3D12_VIEWPORT coneShadowViewport = {};
-    coneShadowViewport.Width = (float)D3D12Renderer::CONE_SHADOW_MAP_SIZE;
-    coneShadowViewport.Height = (float)D3D12Renderer::CONE_SHADOW_MAP_SIZE;
-    coneShadowViewport.MaxDepth = 1.0f;
+    // Render each active cone light into its atlas tile. The atlas persists
+    // between frames; tiles whose inputs did not change are left as they are.
+    D3D12_CPU_DESCRIPTOR_HANDLE coneDsvHandle = renderer->coneShadowDsvHeap->GetCPUDescriptorHandleForHeapStart();
+    renderer->commandList->OMSetRenderTargets(0, nullptr, FALSE, &coneDsvHandle);
 
-    D3D12_RECT coneShadowScissor = { 0, 0, (LONG)D3D12Renderer::CONE_SHADOW_MAP_SIZE, (LONG)D3D12Renderer::CONE_SHADOW_MAP_SIZE };
+    renderer->commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    renderer->commandList->IASetVertexBuffers(0, 2, sceneVertexBuffers);
+    renderer->commandList->IASetIndexBuffer(&renderer->indexBufferView);
 
+    const ShadowCasterLists& casters = renderer->shadowCasters;
     for (uint32_t i = 0; i < lightCount; ++i)
     {
-        // Get DSV for this array slice
-        D3D12_CPU_DESCRIPTOR_HANDLE coneDsvHandle = renderer->coneShadowDsvHeap->GetCPUDescriptorHandleForHeapStart();
-        coneDsvHandle.ptr += i * coneDsvDescriptorSize;
+        const ShadowAtlasTile& tile = renderer->shadowAtlas.tiles[i];
+        if (tile.size == 0 || !casters.redraw[i])
+            continue;
 
-        // Clear this slice
-        renderer->commandList->ClearDepthStencilView(coneDsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+        // Viewport and scissor select the tile
+        D3D12_VIEWPORT coneShadowViewport = {};
+        coneShadowViewport.TopLeftX = (float)tile.x;
+        coneShadowViewport.TopLeftY = (float)tile.y;
+        coneShadowViewport.Width = (float)tile.size;
+        coneShadowViewport.Height = (float)tile.size;
+        coneShadowViewport.MaxDepth = 1.0f;
 
-        // Set render target (depth only)
-        renderer->commandList->OMSetRenderTargets(0, nullptr, FALSE, &coneDsvHandle);
+        D3D12_RECT coneShadowScissor = { (LONG)tile.x, (LONG)tile.y, (LONG)(tile.x + tile.size), (LONG)(tile.y + tile.size) };
+        renderer->commandList->ClearDepthStencilView(coneDsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 1, &coneShadowScissor);
+
+        // Tiles without visible cars stay cleared
+        const ShadowCasterRange& range = casters.ranges[i];
+        if (range.count == 0)
+            continue;
 
-        // Set viewport and scissor
         renderer->commandList->RSSetViewports(1, &coneShadowViewport);
         renderer->commandList->RSSetScissorRects(1, &coneShadowScissor);
 
         // Set view-projection matrix as root constants (16 floats at root parameter 4)
         renderer->commandList->SetGraphicsRoot32BitConstants(4, 16, renderer->coneLightViewProj[i].m, 0);
 
-        // Draw scene (skip ground plane - first 6 indices - only render cars as shadow casters)
-        renderer->commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        renderer->commandList->IASetVertexBuffers(0, 1, &renderer->vertexBufferView);
-        renderer->commandList->IASetIndexBuffer(&renderer->indexBufferView);
-        // Skip first 6 indices (ground plane), render only cars
-        uint32_t carIndexCount = renderer->indexCount - 6;
-        renderer->commandList->DrawIndexedInstanced(carIndexCount, 1, 6, 0, 0);
+        // Draw the cars inside the light's frustum (the ground plane casts no shadow)
+        for (uint32_t r = range.offset; r < range.offset + range.count; ++r)
+        {
+            const ShadowCasterRun& run = casters.runs[r];
+            renderer->commandList->DrawIndexedInstanced(INDICES_PER_BOX, run.carCount,
+                SCENE_GROUND_INDEX_COUNT, 0, SCENE_FIRST_CAR_INSTANCE + run.firstCar);
+        }
     }
 
     // ========== Horizon Mapping Compute Pass ==========
     if (renderer->useHorizonMapping)
     {
-        // Transition shadow depth buffer to copy source
-        D3D12_RESOURCE_BARRIER copyBarriers[2] = {};
-        copyBarriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        copyBarriers[0].Transition.pResource = renderer->shadowDepthBuffer.Get();
-        copyBarriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_DEPTH_WRITE;
-        copyBarriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
-        copyBarriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-
-        copyBarriers[1].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        copyBarriers[1].Transition.pResource = renderer->horizonHeightMap.Get();
-        copyBarriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
-        copyBarriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
-        copyBarriers[1].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-
-        renderer->commandList->ResourceBarrier(2, copyBarriers);
-
-        // Copy shadow depth buffer to height map texture
-        D3D12_TEXTURE_COPY_LOCATION srcLoc = {};
-        srcLoc.pResource = renderer->shadowDepthBuffer.Get();
-        srcLoc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-        srcLoc.SubresourceIndex = 0;
-
-        D3D12_TEXTURE_COPY_LOCATION dstLoc = {};
-        dstLoc.pResource = renderer->horizonHeightMap.Get();
-        dstLoc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-        dstLoc.SubresourceIndex = 0;
-
-        renderer->commandList->CopyTextureRegion(&dstLoc, 0, 0, 0, &srcLoc, nullptr);
-
-        // Transition height map to SRV and shadow depth back to depth write
-        copyBarriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
-        copyBarriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_DEPTH_WRITE;
-        copyBarriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-        copyBarriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
-
-        renderer->commandList->ResourceBarrier(2, copyBarriers);
+        // Copy the new top-down depth to the height map
+        if (heightMapChanged)
+        {
+            // Transition shadow depth buffer to copy source
+            D3D12_RESOURCE_BARRIER copyBarriers[2] = {};
+            copyBarriers[0].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            copyBarriers[0].Transition.pResource = renderer->shadowDepthBuffer.Get();
+            copyBarriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+            copyBarriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+            copyBarriers[0].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+            copyBarriers[1].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            copyBarriers[1].Transition.pResource = renderer->horizonHeightMap.Get();
+            copyBarriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+            copyBarriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+            copyBarriers[1].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+            renderer->commandList->ResourceBarrier(2, copyBarriers);
+
+            // Copy shadow depth buffer to height map texture
+            D3D12_TEXTURE_COPY_LOCATION srcLoc = {};
+            srcLoc.pResource = renderer->shadowDepthBuffer.Get();
+            srcLoc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+            srcLoc.SubresourceIndex = 0;
+
+            D3D12_TEXTURE_COPY_LOCATION dstLoc = {};
+            dstLoc.pResource = renderer->horizonHeightMap.Get();
+            dstLoc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+            dstLoc.SubresourceIndex = 0;
+
+            renderer->commandList->CopyTextureRegion(&dstLoc, 0, 0, 0, &srcLoc, nullptr);
+
+            // Transition height map to SRV and shadow depth back to depth write
+            copyBarriers[0].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
+            copyBarriers[0].Transition.StateAfter = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+            copyBarriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+            copyBarriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+
+            renderer->commandList->ResourceBarrier(2, copyBarriers);
+        }
 
-        // Set compute pipeline
+        // Set compute root signature and descriptor heaps
         renderer->commandList->SetComputeRootSignature(renderer->horizonComputeRootSig.Get());
-        renderer->commandList->SetPipelineState(renderer->horizonComputePSO.Get());
-
-        // Set descriptor heaps
         ID3D12DescriptorHeap* horizonHeaps[] = { renderer->horizonSrvUavHeap.Get() };
         renderer->commandList->SetDescriptorHeaps(1, horizonHeaps);
 
@@ -2490,15 +2704,115 @@ void D3D12_Render(D3D12Renderer* renderer)
         D3D12_GPU_DESCRIPTOR_HANDLE srvHandle = renderer->horizonSrvUavHeap->GetGPUDescriptorHandleForHeapStart();
         renderer->commandList->SetComputeRootDescriptorTable(1, srvHandle);
 
-        // Set horizon maps UAV (descriptor 1)
         UINT descriptorSize = renderer->device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+        // Rebuild the depth pyramid when the height map changed (always true on
+        // the first frame). Each mip is read by the next once it is written.
+        if (heightMapChanged)
+        {
+            D3D12_RESOURCE_BARRIER pyramidBarrier = {};
+            pyramidBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            pyramidBarrier.Transition.pResource = renderer->horizonDepthPyramid.Get();
+            pyramidBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+            pyramidBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+            pyramidBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            renderer->commandList->ResourceBarrier(1, &pyramidBarrier);
+
+            renderer->commandList->SetPipelineState(renderer->horizonPyramidPSO.Get());
+            for (UINT mip = 0; mip < HORIZON_PYRAMID_MIPS; ++mip)
+            {
+                uint32_t pyramidParams[2] = { (D3D12Renderer::HORIZON_MAP_SIZE / 2) >> mip, (mip == 0) ? 1u : 0u };
+                renderer->commandList->SetComputeRoot32BitConstants(0, 2, pyramidParams, 0);
+
+                // Previous mip; mip 0 reads the height map and leaves t1 unused
+                D3D12_GPU_DESCRIPTOR_HANDLE sourceHandle = srvHandle;
+                sourceHandle.ptr += (mip == 0 ? HORIZON_PYRAMID_SRV_DESCRIPTOR : HORIZON_PYRAMID_MIP_SRV_DESCRIPTOR + mip - 1) * descriptorSize;
+                renderer->commandList->SetComputeRootDescriptorTable(3, sourceHandle);
+
+                D3D12_GPU_DESCRIPTOR_HANDLE destHandle = srvHandle;
+                destHandle.ptr += (HORIZON_PYRAMID_MIP_UAV_DESCRIPTOR + mip) * descriptorSize;
+                renderer->commandList->SetComputeRootDescriptorTable(2, destHandle);
+
+                uint32_t groups = (pyramidParams[0] + 7) / 8;
+                renderer->commandList->Dispatch(groups, groups, 1);
+
+                pyramidBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+                pyramidBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+                pyramidBarrier.Transition.Subresource = mip;
+                renderer->commandList->ResourceBarrier(1, &pyramidBarrier);
+            }
+        }
+
+        // Angular mode: one light-independent map replaces the per-light
+        // slices, traced again only when the occluders or the range change
+        if (renderer->useAngularHorizon)
+        {
+            if (heightMapChanged || !renderer->horizonAngularValid || renderer->horizonAngularRange != renderer->headlightRange)
+            {
+                D3D12_RESOURCE_BARRIER angularBarrier = {};
+                angularBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+                angularBarrier.Transition.pResource = renderer->horizonAngularMap.Get();
+                angularBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+                angularBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+                angularBarrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+                renderer->commandList->ResourceBarrier(1, &angularBarrier);
+
+                struct AngularParams {
+                    float worldSize;
+                    uint32_t mapSize;
+                    float nearPlaneY;
+                    float farPlaneY;
+                    float range;
+                    uint32_t angularSize;
+                    uint32_t angleCount;
+                };
+                AngularParams angularParams = {};
+                angularParams.worldSize = renderer->horizonWorldSize;
+                angularParams.mapSize = D3D12Renderer::HORIZON_MAP_SIZE;
+                angularParams.nearPlaneY = mapParams.nearPlaneY;
+                angularParams.farPlaneY = mapParams.farPlaneY;
+                angularParams.range = renderer->headlightRange;
+                angularParams.angularSize = HORIZON_ANGULAR_MAP_SIZE;
+                angularParams.angleCount = HORIZON_ANGLE_COUNT;
+
+                renderer->commandList->SetPipelineState(renderer->horizonAngularPSO.Get());
+                renderer->commandList->SetComputeRoot32BitConstants(0, 7, &angularParams, 0);
+
+                D3D12_GPU_DESCRIPTOR_HANDLE angularHandle = srvHandle;
+                angularHandle.ptr += HORIZON_ANGULAR_UAV_DESCRIPTOR * descriptorSize;
+                renderer->commandList->SetComputeRootDescriptorTable(2, angularHandle);
+
+                D3D12_GPU_DESCRIPTOR_HANDLE pyramidHandle = srvHandle;
+                pyramidHandle.ptr += HORIZON_PYRAMID_SRV_DESCRIPTOR * descriptorSize;
+                renderer->commandList->SetComputeRootDescriptorTable(3, pyramidHandle);
+
+                uint32_t groups = (HORIZON_ANGULAR_MAP_SIZE + 7) / 8;
+                renderer->commandList->Dispatch(groups, groups, HORIZON_ANGLE_COUNT);
+
+                angularBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+                angularBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+                renderer->commandList->ResourceBarrier(1, &angularBarrier);
+
+                renderer->horizonAngularValid = true;
+                renderer->horizonAngularRange = renderer->headlightRange;
+            }
+        }
+        else
+        {
+            renderer->horizonAngularValid = false;
+        }
+
+        renderer->commandList->SetPipelineState(renderer->horizonComputePSO.Get());
+
+        // Set horizon maps UAV (descriptor 1)
         D3D12_GPU_DESCRIPTOR_HANDLE uavHandle = srvHandle;
         uavHandle.ptr += descriptorSize;
         renderer->commandList->SetComputeRootDescriptorTable(2, uavHandle);
 
-        // Dispatch compute for each light
-        UINT dispatchX = (D3D12Renderer::HORIZON_MAP_SIZE + 15) / 16;
-        UINT dispatchY = (D3D12Renderer::HORIZON_MAP_SIZE + 15) / 16;
+        // Set depth pyramid SRV (all mips)
+        D3D12_GPU_DESCRIPTOR_HANDLE pyramidHandle = srvHandle;
+        pyramidHandle.ptr += HORIZON_PYRAMID_SRV_DESCRIPTOR * descriptorSize;
+        renderer->commandList->SetComputeRootDescriptorTable(3, pyramidHandle);
 
         struct HorizonParams {
             float lightPosX, lightPosY, lightPosZ;
@@ -2508,38 +2822,54 @@ void D3D12_Render(D3D12Renderer* renderer)
             uint32_t mapSize;
             float nearPlaneY;    // World Y at depth=0
             float farPlaneY;     // World Y at depth=1
-            float padding;
+            uint32_t partialTrace;
+            uint32_t texelOffsetX, texelOffsetY;
+            uint32_t texelCountX, texelCountY;
+            float dirtyMinX, dirtyMinY, dirtyMaxX, dirtyMaxY;
         };
 
-        // Calculate world Y values at depth buffer extremes
-        // Top-down camera is at viewHeight looking down with near=0.1, far=viewHeight+10
-        float viewHeight = renderer->carAABB.max.y + 50.0f;
-        float nearZ = 0.1f;
-        float farZ = viewHeight + 10.0f;
-        float nearPlaneY = viewHeight - nearZ;   // World Y at depth=0 (near plane)
-        float farPlaneY = viewHeight - farZ;     // World Y at depth=1 (far plane) = -10
-
-        for (uint32_t i = 0; i < lightCount; ++i)
+        // The angular map covers every light, the slices go stale
+        uint32_t horizonCount = renderer->useAngularHorizon ? 0 : std::min(lightCount, renderer->horizonSliceCount);
+        for (uint32_t i = 0; i < horizonCount; ++i)
         {
-            const ConeLight& light = renderer->coneLights[i];
+            Vec3 lightPos = Simulation_GetLightPosition(renderer, i);
+            HorizonSliceKey key = Horizon_GetSliceKey(mapParams, lightPos.x, lightPos.z, renderer->headlightRange);
+            HorizonSliceUpdate update = Horizon_PlanSliceUpdate(renderer->horizonSliceKeys[i], key, heightMapChanged);
+            renderer->horizonSliceKeys[i] = key;
+            if (update == HORIZON_UPDATE_NONE || key.width == 0 || key.height == 0)
+                continue;
 
             HorizonParams params = {};
-            params.lightPosX = light.position.x;
-            params.lightPosY = light.position.y;
-            params.lightPosZ = light.position.z;
+            params.lightPosX = lightPos.x;
+            params.lightPosY = lightPos.y;
+            params.lightPosZ = lightPos.z;
             params.worldSize = renderer->horizonWorldSize;
             params.worldMinX = renderer->horizonWorldMin.x;
             params.worldMinY = renderer->horizonWorldMin.y;
             params.worldMinZ = renderer->horizonWorldMin.z;
             params.lightIndex = i;
             params.mapSize = D3D12Renderer::HORIZON_MAP_SIZE;
-            params.nearPlaneY = nearPlaneY;
-            params.farPlaneY = farPlaneY;
-
-            renderer->commandList->SetComputeRoot32BitConstants(0, 12, &params, 0);
-            renderer->commandList->Dispatch(dispatchX, dispatchY, 1);
+            params.nearPlaneY = mapParams.nearPlaneY;
+            params.farPlaneY = mapParams.farPlaneY;
+            params.partialTrace = (update == HORIZON_UPDATE_PARTIAL) ? 1 : 0;
+            params.texelOffsetX = (uint32_t)key.x0;
+            params.texelOffsetY = (uint32_t)key.y0;
+            params.texelCountX = (uint32_t)key.width;
+            params.texelCountY = (uint32_t)key.height;
+            // Grown a little to cover rounding in the traced sample positions
+            params.dirtyMinX = (float)dirty.x0 - 0.01f;
+            params.dirtyMinY = (float)dirty.y0 - 0.01f;
+            params.dirtyMaxX = (float)dirty.x1 + 0.01f;
+            params.dirtyMaxY = (float)dirty.y1 + 0.01f;
+
+            renderer->commandList->SetComputeRoot32BitConstants(0, 20, &params, 0);
+            renderer->commandList->Dispatch((key.width + 15) / 16, (key.height + 15) / 16, 1);
         }
 
+        // Changes to lights that are not traced this frame are not tracked
+        for (uint32_t i = horizonCount; i < renderer->horizonSliceCount; ++i)
+            renderer->horizonSliceKeys[i].valid = false;
+
         // Transition horizon maps from UAV to SRV for pixel shader
         D3D12_RESOURCE_BARRIER horizonBarrier = {};
         horizonBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -2567,9 +2897,9 @@ void D3D12_Render(D3D12Renderer* renderer)
     renderer->commandList->SetDescriptorHeaps(1, shadowHeaps);
 
     // Use main constant buffer with main camera view-projection
-    renderer->commandList->SetGraphicsRootConstantBufferView(0, renderer->constantBuffer[renderer->frameIndex]->GetGPUVirtualAddress());
-    renderer->commandList->SetGraphicsRootShaderResourceView(1, renderer->coneLightsBuffer[renderer->frameIndex]->GetGPUVirtualAddress());
-    renderer->commandList->SetGraphicsRootShaderResourceView(2, renderer->coneLightMatricesBuffer[renderer->frameIndex]->GetGPUVirtualAddress());
+    renderer->commandList->SetGraphicsRootConstantBufferView(0, cbUpload.gpu);
+    renderer->commandList->SetGraphicsRootShaderResourceView(1, lightsUpload.gpu);
+    renderer->commandList->SetGraphicsRootShaderResourceView(2, matricesUpload.gpu);
     renderer->commandList->SetGraphicsRootDescriptorTable(3, renderer->coneShadowSrvHeap->GetGPUDescriptorHandleForHeapStart());
 
     // Bind horizon maps (descriptor 1 in the same heap)
@@ -2578,6 +2908,11 @@ void D3D12_Render(D3D12Renderer* renderer)
     horizonSrvHandle.ptr += srvDescriptorSize;
     renderer->commandList->SetGraphicsRootDescriptorTable(5, horizonSrvHandle);
 
+    // Light lists (clusters or grid cells)
+    renderer->commandList->SetGraphicsRootShaderResourceView(6, rangesUpload.gpu);
+    renderer->commandList->SetGraphicsRootShaderResourceView(7, indicesUpload.gpu);
+    renderer->commandList->SetGraphicsRootShaderResourceView(8, lightClassesUpload.gpu);
+
     // Transition render target
     D3D12_RESOURCE_BARRIER barrier = {};
     barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -2618,11 +2953,21 @@ void D3D12_Render(D3D12Renderer* renderer)
         renderer->commandList->SetPipelineState(renderer->fullscreenPipelineState.Get());
         renderer->commandList->SetGraphicsRootSignature(renderer->fullscreenRootSignature.Get());
 
-        // Set slice index as root constant
-        int sliceData[4] = { renderer->debugShadowMapIndex, 0, 0, 0 };
-        renderer->commandList->SetGraphicsRoot32BitConstants(0, 4, sliceData, 0);
+        // Atlas UV rect of the selected light's tile as root constants
+        float tileRect[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        int index = renderer->debugShadowMapIndex;
+        if (index >= 0 && (size_t)index < renderer->shadowAtlas.tiles.size() && renderer->shadowAtlas.tiles[index].size > 0)
+        {
+            const ShadowAtlasTile& tile = renderer->shadowAtlas.tiles[index];
+            const float invAtlasSize = 1.0f / (float)SHADOW_ATLAS_SIZE;
+            tileRect[0] = (float)tile.x * invAtlasSize;
+            tileRect[1] = (float)tile.y * invAtlasSize;
+            tileRect[2] = (float)tile.size * invAtlasSize;
+            tileRect[3] = (float)tile.size * invAtlasSize;
+        }
+        renderer->commandList->SetGraphicsRoot32BitConstants(0, 4, tileRect, 0);
 
-        // Use cone shadow maps (Texture2DArray)
+        // Use the shadow atlas
         ID3D12DescriptorHeap* heaps[] = { renderer->coneShadowSrvHeap.Get() };
         renderer->commandList->SetDescriptorHeaps(1, heaps);
         renderer->commandList->SetGraphicsRootDescriptorTable(1, renderer->coneShadowSrvHeap->GetGPUDescriptorHandleForHeapStart());
@@ -2634,17 +2979,39 @@ void D3D12_Render(D3D12Renderer* renderer)
     {
         // Draw scene
         renderer->commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        renderer->commandList->IASetVertexBuffers(0, 1, &renderer->vertexBufferView);
+        renderer->commandList->IASetVertexBuffers(0, 2, sceneVertexBuffers);
         renderer->commandList->IASetIndexBuffer(&renderer->indexBufferView);
-        renderer->commandList->DrawIndexedInstanced(renderer->indexCount, 1, 0, 0, 0);
+        DrawScene(renderer);
 
         // Draw debug cone wireframes if enabled
-        if (renderer->showDebugLights && renderer->debugVertexCount > 0)
+        if (debugConesSize > 0)
+        {
+            renderer->commandList->SetPipelineState(renderer->debugPipelineState.Get());
+            renderer->commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINELIST);
+            D3D12_VERTEX_BUFFER_VIEW debugConeView = {};
+            debugConeView.BufferLocation = debugConesUpload.gpu;
+            debugConeView.SizeInBytes = (UINT)debugConesSize;
+            debugConeView.StrideInBytes = sizeof(DebugConeInstance);
+            D3D12_VERTEX_BUFFER_VIEW debugVertexBuffers[] = { renderer->debugVertexBufferView, debugConeView };
+            renderer->commandList->IASetVertexBuffers(0, 2, debugVertexBuffers);
+            renderer->commandList->DrawInstanced(renderer->debugVertexCount, renderer->numConeLights, 0, 0);
+        }
+
+        // All overlay primitives of the frame in one draw
+        uint32_t debugDrawVertexCount = DebugDraw_GetVertexCount(&renderer->debugDraw);
+        if (debugDrawVertexCount > 0)
         {
             renderer->commandList->SetPipelineState(renderer->debugPipelineState.Get());
             renderer->commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINELIST);
-            renderer->commandList->IASetVertexBuffers(0, 1, &renderer->debugVertexBufferView);
-            renderer->commandList->DrawInstanced(renderer->debugVertexCount, 1, 0, 0);
+            D3D12_VERTEX_BUFFER_VIEW debugDrawViews[2] = {};
+            debugDrawViews[0].BufferLocation = debugDrawUpload.gpu;
+            debugDrawViews[0].SizeInBytes = (UINT)debugDrawSize;
+            debugDrawViews[0].StrideInBytes = sizeof(DebugVertex);
+            debugDrawViews[1].BufferLocation = debugDrawInstanceUpload.gpu;
+            debugDrawViews[1].SizeInBytes = (UINT)debugDrawInstanceSize;
+            debugDrawViews[1].StrideInBytes = sizeof(DebugConeInstance);
+            renderer->commandList->IASetVertexBuffers(0, 2, debugDrawViews);
+            renderer->commandList->DrawInstanced(debugDrawVertexCount, 1, 0, 0);
         }
     }
 
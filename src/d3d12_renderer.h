@@ -7,71 +7,24 @@
 #include <dxgi1_6.h>
 #include <wrl/client.h>
 #include <cstdint>
-
-#include "math_utils.h"
+#include <vector>
+
+#include "debug_draw.h"
+#include "horizon.h"
+#include "light_clusters.h"
+#include "light_grid.h"
+#include "light_pack.h"
+#include "scene.h"
+#include "shadow_atlas.h"
+#include "shadow_culling.h"
+#include "upload_ring.h"
 
 using Microsoft::WRL::ComPtr;
 
 static constexpr uint32_t FRAME_COUNT = 2;
-static constexpr uint32_t MAX_CONE_LIGHTS = 128;
-static constexpr uint32_t MAX_CARS = 60;
-
-struct ConeLight
-{
-    Vec3 position;
-    Vec3 direction;
-    Vec3 color;
-    float range;
-    float innerAngle;
-    float outerAngle;
-};
-
-struct ConeLightGPU
-{
-    float position[4];
-    float direction[4];
-    float color[4];
-};
-
-struct Vertex
-{
-    float position[3];
-    float normal[3];
-    float uv[2];
-};
-
-struct DebugVertex
-{
-    float position[3];
-    float color[3];
-};
 
-struct CameraConstants
-{
-    Mat4 viewProjection;
-    Vec3 cameraPos;
-    float numConeLights;
-    float ambientIntensity;
-    float coneLightIntensity;
-    float shadowBias;
-    float falloffExponent;
-    float debugLightOverlap;  // 1.0 = show light overlap visualization
-    float overlapMaxCount;    // Max count for heat map coloring
-    float disableShadows;     // 1.0 = skip shadow map sampling
-    float useHorizonMapping;  // 1.0 = use horizon mapping instead of shadow maps
-    float showGrid;           // 1.0 = show grid pattern on ground
-    float horizonWorldMinX;   // Horizon map world space bounds
-    float horizonWorldMinZ;
-    float horizonWorldSize;
-};
-
-struct AABB
-{
-    Vec3 min;
-    Vec3 max;
-};
-
-struct D3D12Renderer
+// Scene/settings state lives in SceneState so it can be shared with the headless path
+struct D3D12Renderer : SceneState
 {
     // Core D3D12 objects
     ComPtr<IDXGIFactory4>           factory;
@@ -94,25 +47,15 @@ struct D3D12Renderer
     D3D12_INDEX_BUFFER_VIEW         indexBufferView;
     uint32_t                        indexCount;
 
-    // Car vertex data (for dynamic updates)
-    Vertex*                         carVerticesMapped = nullptr;  // Points into mapped vertex buffer
-    uint32_t                        carVertexStartIndex = 0;      // First car vertex in buffer
-    uint32_t                        carVertexCount = 0;           // Total car vertices
+    // Car instances (identity for the ground + one per car), uploaded every frame
+    uint32_t                        carInstanceCount = 0;
 
-    // Constant buffer (main camera)
-    ComPtr<ID3D12Resource>          constantBuffer[FRAME_COUNT];
-    CameraConstants*                constantBufferMapped[FRAME_COUNT];
-
-    // Constant buffer (shadow/top-down camera)
-    ComPtr<ID3D12Resource>          shadowConstantBuffer[FRAME_COUNT];
-    CameraConstants*                shadowConstantBufferMapped[FRAME_COUNT];
-
-    // Cone lights buffer
-    ComPtr<ID3D12Resource>          coneLightsBuffer[FRAME_COUNT];
-    ConeLightGPU*                   coneLightsMapped[FRAME_COUNT];
-    ConeLight                       coneLights[MAX_CONE_LIGHTS];
-    uint32_t                        numConeLights = 0;
-    int                             activeLightCount = 0;  // For debug slider
+    // Per-frame dynamic data (camera constants, cone lights, light matrices,
+    // light lists, car instances, debug cones and lines) is sub-allocated from
+    // the frame's upload buffer, persistently mapped and grown on demand
+    UploadRing                      uploadRing;
+    ComPtr<ID3D12Resource>          uploadBuffers[FRAME_COUNT];
+    uint8_t*                        uploadMapped[FRAME_COUNT] = {};
 
     // Depth buffer
     ComPtr<ID3D12Resource>          depthBuffer;
@@ -134,78 +77,59 @@ struct D3D12Renderer
     uint32_t width = 0;
     uint32_t height = 0;
 
-    // Camera
-    Camera camera;
-
     // Debug visualization
-    bool showDebugLights = false;
-    bool showLightOverlap = false;  // Heat map of light cone overlaps
-    float overlapMaxCount = 10.0f;  // Max count for heat map (maps to red)
     ComPtr<ID3D12PipelineState>     debugPipelineState;
-    ComPtr<ID3D12Resource>          debugVertexBuffer;
+    ComPtr<ID3D12Resource>          debugVertexBuffer;         // Unit cone, instanced per light
     D3D12_VERTEX_BUFFER_VIEW        debugVertexBufferView;
     uint32_t                        debugVertexCount = 0;
-
-    // Lighting controls
-    float ambientIntensity = 0.3f;
-    float coneLightIntensity = 1.0f;
-    float shadowBias = 0.0f;
-    float headlightRange = 30.0f;  // Range in meters (20-300)
-    float headlightFalloff = 2.0f; // Distance falloff exponent (lower = less falloff)
-    bool disableShadows = false;   // Skip shadow map sampling
-    bool showGrid = true;          // Show grid pattern on ground
-
-    // Car animation
-    uint32_t numCars = 0;
-    float carTrackProgress[MAX_CARS];  // 0-1 progress along the oval track
-    float carLane[MAX_CARS];           // Lane offset (inner/outer)
-    float carSpeed = 20.0f;            // Speed in meters per second
-    float carSpacing = 1.0f;           // 0-1: 0=close (0.5m gap), 1=max spread
-
-    // Track parameters
-    float trackLength = 0.0f;          // Total track length in meters
-    float trackStraightLength = 150.0f;
-    float trackRadius = 50.0f;
-    float trackLaneWidth = 3.0f;
-
-    // Car AABB for top-down rendering
-    AABB carAABB;
-    Mat4 topDownViewProj;
+    DebugDraw                       debugDraw;                 // Overlay lines, streamed through the upload ring
 
     // Offscreen depth buffer for top-down view (1024x1024)
-    static constexpr uint32_t SHADOW_MAP_SIZE = 1024;
     ComPtr<ID3D12Resource>          shadowDepthBuffer;
     ComPtr<ID3D12PipelineState>     shadowPipelineState;
-    bool showShadowMapDebug = false;
-    int debugShadowMapIndex = 0;  // Which cone shadow map slice to visualize
 
     // Fullscreen quad for depth visualization
     ComPtr<ID3D12RootSignature>     fullscreenRootSignature;
     ComPtr<ID3D12PipelineState>     fullscreenPipelineState;
     ComPtr<ID3D12DescriptorHeap>    shadowSrvHeap;
 
-    // Cone light shadow maps (256x256 x MAX_CONE_LIGHTS)
-    static constexpr uint32_t CONE_SHADOW_MAP_SIZE = 256;
-    ComPtr<ID3D12Resource>          coneShadowMaps;            // Texture2DArray
-    ComPtr<ID3D12DescriptorHeap>    coneShadowDsvHeap;         // DSV heap for all slices
+    // Per-light resources are sized for lightCapacity lights and rebuilt when the
+    // scene size changes; horizon slices are capped (see SCENE_MAX_HORIZON_SLICES)
+    uint32_t                        lightCapacity = 0;
+    uint32_t                        horizonSliceCount = 0;
+
+    // Cone light shadow maps: one SHADOW_ATLAS_SIZE^2 atlas, tiles assigned per frame
+    ShadowAtlas                     shadowAtlas;
+    ShadowCasterLists               shadowCasters;             // Cars each tile draws
+    ComPtr<ID3D12Resource>          coneShadowMaps;            // Texture2D atlas
+    ComPtr<ID3D12DescriptorHeap>    coneShadowDsvHeap;         // DSV heap for the atlas
     ComPtr<ID3D12DescriptorHeap>    coneShadowSrvHeap;         // SRV heap for shader access
-    Mat4                            coneLightViewProj[MAX_CONE_LIGHTS];  // CPU-side matrices
+    std::vector<Mat4>               coneLightViewProj;         // CPU-side matrices
+
+    // Cone lights: full records (CPU), packed with their classes for the GPU
+    std::vector<ConeLightGPU>       coneLightRecords;
+    LightPack                       lightPack;
 
-    // Per-light view-projection matrices (uploaded to GPU)
-    ComPtr<ID3D12Resource>          coneLightMatricesBuffer[FRAME_COUNT];
-    Mat4*                           coneLightMatricesMapped[FRAME_COUNT];
+    // Light culling: froxel clusters or top-down grid cells, built on the CPU
+    // each frame and uploaded through the upload ring
+    LightClusterGrid                lightClusters;
+    LightGrid                       lightGrid;
 
     // Horizon Mapping shadow technique
-    bool useHorizonMapping = false;
-    static constexpr uint32_t HORIZON_MAP_SIZE = 1024;
     ComPtr<ID3D12Resource>          horizonHeightMap;          // R32_FLOAT top-down height map
     ComPtr<ID3D12Resource>          horizonMaps;               // Texture2DArray R32_FLOAT per-light horizon angles
     ComPtr<ID3D12DescriptorHeap>    horizonSrvUavHeap;         // SRV+UAV heap for compute
     ComPtr<ID3D12RootSignature>     horizonComputeRootSig;     // Root signature for horizon compute
     ComPtr<ID3D12PipelineState>     horizonComputePSO;         // Compute pipeline for horizon tracing
+    ComPtr<ID3D12Resource>          horizonDepthPyramid;       // R32G32_FLOAT (min, max) depth mips of the height map
+    ComPtr<ID3D12PipelineState>     horizonPyramidPSO;         // Compute pipeline building one pyramid mip
+    ComPtr<ID3D12Resource>          horizonAngularMap;         // Texture2DArray R32G32_FLOAT, one slice per azimuth
+    ComPtr<ID3D12PipelineState>     horizonAngularPSO;         // Compute pipeline tracing the angular map
+    bool                            horizonAngularValid = false;
+    float                           horizonAngularRange = 0.0f;    // Range the angular map was traced for
     ComPtr<ID3D12Resource>          horizonParamsBuffer;       // Per-light parameters for compute
-    float                           horizonWorldSize = 0.0f;   // World space size covered by horizon map
-    Vec3                            horizonWorldMin;           // World space min corner of horizon map
+    std::vector<HorizonSliceKey>    horizonSliceKeys;          // What each slice was last traced for
+    HorizonOccluders                horizonOccluders;          // Car poses of the last traced height map
 };
 
 bool D3D12_Init(D3D12Renderer* renderer, HWND hwnd, uint32_t width, uint32_t height);
@@ -0,0 +1,312 @@
+#include "debug_draw.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Segments of the stroke font, a 16-segment display: endpoints in glyph units
+// (x across the width, y up the height)
+static const float g_GlyphSegments[16][4] = {
+    { 0.0f, 1.0f, 0.5f, 1.0f },     // A1  top left
+    { 0.5f, 1.0f, 1.0f, 1.0f },     // A2  top right
+    { 1.0f, 1.0f, 1.0f, 0.5f },     // B   right upper
+    { 1.0f, 0.5f, 1.0f, 0.0f },     // C   right lower
+    { 0.0f, 0.0f, 0.5f, 0.0f },     // D1  bottom left
+    { 0.5f, 0.0f, 1.0f, 0.0f },     // D2  bottom right
+    { 0.0f, 0.0f, 0.0f, 0.5f },     // E   left lower
+    { 0.0f, 0.5f, 0.0f, 1.0f },     // F   left upper
+    { 0.0f, 0.5f, 0.5f, 0.5f },     // G1  middle left
+    { 0.5f, 0.5f, 1.0f, 0.5f },     // G2  middle right
+    { 0.0f, 1.0f, 0.5f, 0.5f },     // H   diagonal top left
+    { 0.5f, 1.0f, 0.5f, 0.5f },     // I   center upper
+    { 1.0f, 1.0f, 0.5f, 0.5f },     // J   diagonal top right
+    { 0.0f, 0.0f, 0.5f, 0.5f },     // K   diagonal bottom left
+    { 0.5f, 0.5f, 0.5f, 0.0f },     // L   center lower
+    { 1.0f, 0.0f, 0.5f, 0.5f },     // M   diagonal bottom right
+};
+
+enum : uint16_t
+{
+    SEG_A1 = 1 << 0, SEG_A2 = 1 << 1, SEG_B = 1 << 2, SEG_C = 1 << 3,
+    SEG_D1 = 1 << 4, SEG_D2 = 1 << 5, SEG_E = 1 << 6, SEG_F = 1 << 7,
+    SEG_G1 = 1 << 8, SEG_G2 = 1 << 9, SEG_H = 1 << 10, SEG_I = 1 << 11,
+    SEG_J = 1 << 12, SEG_K = 1 << 13, SEG_L = 1 << 14, SEG_M = 1 << 15,
+    SEG_A = SEG_A1 | SEG_A2, SEG_D = SEG_D1 | SEG_D2, SEG_G = SEG_G1 | SEG_G2,
+};
+
+// Glyph width and advance relative to the height
+static constexpr float GLYPH_WIDTH = 0.6f;
+static constexpr float GLYPH_ADVANCE = 0.8f;
+
+static uint16_t GetGlyphSegments(char c)
+{
+    switch (c)
+    {
+    case '0': return SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_J | SEG_K;
+    case '1': return SEG_B | SEG_C | SEG_J;
+    case '2': return SEG_A | SEG_B | SEG_G | SEG_E | SEG_D;
+    case '3': return SEG_A | SEG_B | SEG_C | SEG_D | SEG_G2;
+    case '4': return SEG_F | SEG_G | SEG_B | SEG_C;
+    case '5': return SEG_A | SEG_F | SEG_G | SEG_C | SEG_D;
+    case '6': return SEG_A | SEG_F | SEG_E | SEG_D | SEG_C | SEG_G;
+    case '7': return SEG_A | SEG_B | SEG_C;
+    case '8': return SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_G;
+    case '9': return SEG_A | SEG_B | SEG_C | SEG_D | SEG_F | SEG_G;
+    case 'A': return SEG_A | SEG_B | SEG_C | SEG_E | SEG_F | SEG_G;
+    case 'B': return SEG_A | SEG_B | SEG_C | SEG_D | SEG_I | SEG_L | SEG_G2;
+    case 'C': return SEG_A | SEG_F | SEG_E | SEG_D;
+    case 'D': return SEG_A | SEG_B | SEG_C | SEG_D | SEG_I | SEG_L;
+    case 'E': return SEG_A | SEG_F | SEG_E | SEG_D | SEG_G1;
+    case 'F': return SEG_A | SEG_F | SEG_E | SEG_G1;
+    case 'G': return SEG_A | SEG_F | SEG_E | SEG_D | SEG_C | SEG_G2;
+    case 'H': return SEG_F | SEG_E | SEG_B | SEG_C | SEG_G;
+    case 'I': return SEG_A | SEG_I | SEG_L | SEG_D;
+    case 'J': return SEG_B | SEG_C | SEG_D | SEG_E;
+    case 'K': return SEG_F | SEG_E | SEG_G1 | SEG_J | SEG_M;
+    case 'L': return SEG_F | SEG_E | SEG_D;
+    case 'M': return SEG_F | SEG_E | SEG_H | SEG_J | SEG_B | SEG_C;
+    case 'N': return SEG_F | SEG_E | SEG_H | SEG_M | SEG_B | SEG_C;
+    case 'O': return SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F;
+    case 'P': return SEG_A | SEG_B | SEG_F | SEG_E | SEG_G;
+    case 'Q': return SEG_A | SEG_B | SEG_C | SEG_D | SEG_E | SEG_F | SEG_M;
+    case 'R': return SEG_A | SEG_B | SEG_F | SEG_E | SEG_G | SEG_M;
+    case 'S': return SEG_A | SEG_F | SEG_G | SEG_C | SEG_D;
+    case 'T': return SEG_A | SEG_I | SEG_L;
+    case 'U': return SEG_F | SEG_E | SEG_D | SEG_C | SEG_B;
+    case 'V': return SEG_F | SEG_E | SEG_K | SEG_J;
+    case 'W': return SEG_F | SEG_E | SEG_K | SEG_M | SEG_C | SEG_B;
+    case 'X': return SEG_H | SEG_J | SEG_K | SEG_M;
+    case 'Y': return SEG_H | SEG_J | SEG_L;
+    case 'Z': return SEG_A | SEG_J | SEG_K | SEG_D;
+    case '-': return SEG_G;
+    case '+': return SEG_G | SEG_I | SEG_L;
+    case '=': return SEG_G | SEG_D;
+    case '.': return SEG_D1;
+    case '/': return SEG_J | SEG_K;
+    case '_': return SEG_D;
+    default: return 0;
+    }
+}
+
+static uint16_t GetCharSegments(char c)
+{
+    if (c >= 'a' && c <= 'z')
+        c = (char)(c - 'a' + 'A');
+    return GetGlyphSegments(c);
+}
+
+static uint32_t CountBits(uint32_t v)
+{
+    uint32_t count = 0;
+    for (; v; v &= v - 1)
+        ++count;
+    return count;
+}
+
+// Reserves count vertices (even) for one primitive; nullptr if they do not fit.
+// A primitive straddling the end fills the part that fits with zero-length
+// lines, so vertices[0, min(used, capacity)) is always valid.
+static DebugVertex* Reserve(DebugDraw* dd, uint32_t count)
+{
+    uint32_t capacity = dd->capacity;
+    uint32_t start = dd->used.fetch_add(count, std::memory_order_relaxed);
+    if (start <= capacity && count <= capacity - start)
+        return dd->vertices + start;
+    if (start < capacity)
+        memset(dd->vertices + start, 0, (capacity - start) * sizeof(DebugVertex));
+    return nullptr;
+}
+
+static void PutLine(DebugVertex*& out, const Vec3& a, const Vec3& b, const Vec3& color)
+{
+    *out++ = { { a.x, a.y, a.z }, { color.x, color.y, color.z } };
+    *out++ = { { b.x, b.y, b.z }, { color.x, color.y, color.z } };
+}
+
+// Lines between the 8 corners of a box, corner index bit 0 / 1 / 2 = x / y / z
+static void PutBoxEdges(DebugVertex*& out, const Vec3 corners[8], const Vec3& color)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        for (int axis = 1; axis < 8; axis <<= 1)
+        {
+            if (!(i & axis))
+                PutLine(out, corners[i], corners[i | axis], color);
+        }
+    }
+}
+
+uint32_t DebugDraw_GetNextCapacity(const DebugDraw* dd)
+{
+    uint32_t required = dd->used.load(std::memory_order_relaxed);
+    if (required == 0)
+        return 0;
+
+    uint32_t capacity = std::max(dd->capacity, DEBUG_DRAW_MIN_VERTICES);
+    while (capacity < required && capacity < DEBUG_DRAW_MAX_VERTICES)
+        capacity *= 2;
+    return std::min(capacity, DEBUG_DRAW_MAX_VERTICES);
+}
+
+void DebugDraw_Begin(DebugDraw* dd, DebugVertex* vertices, uint32_t capacity)
+{
+    dd->vertices = vertices;
+    dd->capacity = vertices ? capacity : 0;
+    dd->used.store(0, std::memory_order_relaxed);
+}
+
+uint32_t DebugDraw_GetVertexCount(const DebugDraw* dd)
+{
+    return std::min(dd->used.load(std::memory_order_relaxed), dd->capacity);
+}
+
+uint32_t DebugDraw_GetDroppedVertexCount(const DebugDraw* dd)
+{
+    uint32_t used = dd->used.load(std::memory_order_relaxed);
+    return (used > dd->capacity) ? used - dd->capacity : 0;
+}
+
+void DebugDraw_Line(DebugDraw* dd, const Vec3& a, const Vec3& b, const Vec3& color)
+{
+    DebugVertex* out = Reserve(dd, DEBUG_DRAW_LINE_VERTICES);
+    if (out)
+        PutLine(out, a, b, color);
+}
+
+void DebugDraw_Box(DebugDraw* dd, const Vec3& center, const Vec3& extents, const Vec3& color)
+{
+    DebugVertex* out = Reserve(dd, DEBUG_DRAW_BOX_VERTICES);
+    if (!out)
+        return;
+
+    Vec3 corners[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        corners[i] = Vec3(center.x + ((i & 1) ? extents.x : -extents.x),
+                          center.y + ((i & 2) ? extents.y : -extents.y),
+                          center.z + ((i & 4) ? extents.z : -extents.z));
+    }
+    PutBoxEdges(out, corners, color);
+}
+
+void DebugDraw_Frustum(DebugDraw* dd, const Mat4& viewProj, const Vec3& color)
+{
+    DebugVertex* out = Reserve(dd, DEBUG_DRAW_FRUSTUM_VERTICES);
+    if (!out)
+        return;
+
+    // Planes (n, d) as in ShadowCulling_GetFrustum: -x, +x, -y, +y, near, far
+    const float* m = viewProj.m;
+    Vec3 n[6];
+    float d[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        int row = p / 2;                        // x, y, z
+        float sign = (p & 1) ? -1.0f : 1.0f;
+        float w[4] = { m[3], m[7], m[11], m[15] };
+        float r[4] = { m[row], m[4 + row], m[8 + row], m[12 + row] };
+        float plane[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            if (p == 4)
+                plane[k] = r[k];                // z >= 0
+            else
+                plane[k] = w[k] + sign * r[k];
+        }
+        n[p] = Vec3(plane[0], plane[1], plane[2]);
+        d[p] = plane[3];
+    }
+
+    // Each corner is where one x, one y and one z plane meet
+    Vec3 corners[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        int a = (i & 1) ? 1 : 0, b = (i & 2) ? 3 : 2, c = (i & 4) ? 5 : 4;
+        Vec3 bc = cross(n[b], n[c]), ca = cross(n[c], n[a]), ab = cross(n[a], n[b]);
+        float det = dot(n[a], bc);
+        float scale = (fabsf(det) > 1e-12f) ? -1.0f / det : 0.0f;
+        corners[i] = (bc * d[a] + ca * d[b] + ab * d[c]) * scale;
+    }
+    PutBoxEdges(out, corners, color);
+}
+
+void DebugDraw_Sphere(DebugDraw* dd, const Vec3& center, float radius, const Vec3& color)
+{
+    DebugVertex* out = Reserve(dd, DEBUG_DRAW_SPHERE_VERTICES);
+    if (!out)
+        return;
+
+    // Unit circle, shared by the three planes
+    static const struct CircleTable
+    {
+        float c[DEBUG_DRAW_SPHERE_SEGMENTS + 1];
+        float s[DEBUG_DRAW_SPHERE_SEGMENTS + 1];
+        CircleTable()
+        {
+            for (uint32_t j = 0; j <= DEBUG_DRAW_SPHERE_SEGMENTS; ++j)
+            {
+                float angle = (float)j / (float)DEBUG_DRAW_SPHERE_SEGMENTS * 6.28318f;
+                c[j] = cosf(angle);
+                s[j] = sinf(angle);
+            }
+        }
+    } circle;
+
+    for (uint32_t j = 0; j < DEBUG_DRAW_SPHERE_SEGMENTS; ++j)
+    {
+        float c0 = circle.c[j] * radius, s0 = circle.s[j] * radius;
+        float c1 = circle.c[j + 1] * radius, s1 = circle.s[j + 1] * radius;
+        PutLine(out, center + Vec3(c0, s0, 0.0f), center + Vec3(c1, s1, 0.0f), color);
+        PutLine(out, center + Vec3(c0, 0.0f, s0), center + Vec3(c1, 0.0f, s1), color);
+        PutLine(out, center + Vec3(0.0f, c0, s0), center + Vec3(0.0f, c1, s1), color);
+    }
+}
+
+void DebugDraw_RectXZ(DebugDraw* dd, float minX, float minZ, float maxX, float maxZ, float y, const Vec3& color)
+{
+    DebugVertex* out = Reserve(dd, DEBUG_DRAW_RECT_VERTICES);
+    if (!out)
+        return;
+
+    Vec3 p00(minX, y, minZ), p10(maxX, y, minZ), p11(maxX, y, maxZ), p01(minX, y, maxZ);
+    PutLine(out, p00, p10, color);
+    PutLine(out, p10, p11, color);
+    PutLine(out, p11, p01, color);
+    PutLine(out, p01, p00, color);
+}
+
+uint32_t DebugDraw_GetTextVertexCount(const char* text)
+{
+    uint32_t count = 0;
+    for (const char* c = text; *c; ++c)
+        count += CountBits(GetCharSegments(*c)) * 2;
+    return count;
+}
+
+void DebugDraw_Text(DebugDraw* dd, const Vec3& origin, const Vec3& right, const Vec3& up, float height,
+                    const char* text, const Vec3& color)
+{
+    // One reservation for the whole label
+    uint32_t count = DebugDraw_GetTextVertexCount(text);
+    if (count == 0)
+        return;
+    DebugVertex* out = Reserve(dd, count);
+    if (!out)
+        return;
+
+    Vec3 glyphX = right * (height * GLYPH_WIDTH);
+    Vec3 glyphY = up * height;
+    Vec3 pen = origin;
+    for (const char* c = text; *c; ++c)
+    {
+        uint16_t segments = GetCharSegments(*c);
+        for (int s = 0; s < 16; ++s)
+        {
+            if (!(segments & (1 << s)))
+                continue;
+            const float* seg = g_GlyphSegments[s];
+            PutLine(out, pen + glyphX * seg[0] + glyphY * seg[1], pen + glyphX * seg[2] + glyphY * seg[3], color);
+        }
+        pen += right * (height * GLYPH_ADVANCE);
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// Immediate-mode debug drawing: lines, boxes, frustums, spheres, grid cells and
+// world-space labels, accumulated as one line list per frame and drawn with a
+// single draw call. Primitive generation is plain CPU code, shared with the
+// headless checks.
+//
+// Any thread may draw between DebugDraw_Begin and reading the stream: each
+// primitive reserves its vertices with one atomic add and writes them without
+// locks. The stream is storage the caller provides per frame (the renderer
+// passes mapped upload memory, so drawing writes straight to the GPU buffer).
+// Its capacity is fixed during a frame; primitives that do not fit are dropped
+// and counted, and DebugDraw_GetNextCapacity asks for enough room for the next
+// frame, so an overflow lasts one frame.
+
+#include <atomic>
+#include <cstdint>
+
+#include "scene.h"
+
+// Stream size bounds in vertices (two per line)
+static constexpr uint32_t DEBUG_DRAW_MIN_VERTICES = 16 * 1024;
+static constexpr uint32_t DEBUG_DRAW_MAX_VERTICES = 4 * 1024 * 1024;
+
+// Segments per circle of DebugDraw_Sphere
+static constexpr uint32_t DEBUG_DRAW_SPHERE_SEGMENTS = 16;
+
+// Vertices each fixed-size primitive adds
+static constexpr uint32_t DEBUG_DRAW_LINE_VERTICES = 2;
+static constexpr uint32_t DEBUG_DRAW_BOX_VERTICES = 24;
+static constexpr uint32_t DEBUG_DRAW_FRUSTUM_VERTICES = 24;
+static constexpr uint32_t DEBUG_DRAW_SPHERE_VERTICES = 3 * DEBUG_DRAW_SPHERE_SEGMENTS * 2;
+static constexpr uint32_t DEBUG_DRAW_RECT_VERTICES = 8;
+
+struct DebugDraw
+{
+    DebugVertex* vertices = nullptr;        // This frame's stream
+    uint32_t capacity = 0;
+    std::atomic<uint32_t> used{ 0 };        // Vertices reserved this frame, may exceed the capacity
+};
+
+// Stream capacity for the next frame: what this frame asked for, in powers of
+// two between DEBUG_DRAW_MIN_VERTICES and DEBUG_DRAW_MAX_VERTICES (never less
+// than this frame's), or 0 if nothing was drawn
+uint32_t DebugDraw_GetNextCapacity(const DebugDraw* dd);
+
+// Starts a new frame writing to vertices[0, capacity), forgetting the previous
+// primitives. Not thread-safe.
+void DebugDraw_Begin(DebugDraw* dd, DebugVertex* vertices, uint32_t capacity);
+
+// Vertices of this frame that fit the stream (vertices[0, count))
+uint32_t DebugDraw_GetVertexCount(const DebugDraw* dd);
+
+// Vertices of this frame that did not fit
+uint32_t DebugDraw_GetDroppedVertexCount(const DebugDraw* dd);
+
+void DebugDraw_Line(DebugDraw* dd, const Vec3& a, const Vec3& b, const Vec3& color);
+
+// Axis-aligned box from center and half extents
+void DebugDraw_Box(DebugDraw* dd, const Vec3& center, const Vec3& extents, const Vec3& color);
+
+// Frustum of a view-projection matrix (D3D clip space, 0 <= z <= w)
+void DebugDraw_Frustum(DebugDraw* dd, const Mat4& viewProj, const Vec3& color);
+
+// Three axis-aligned great circles
+void DebugDraw_Sphere(DebugDraw* dd, const Vec3& center, float radius, const Vec3& color);
+
+// XZ rectangle at height y (grid cells, tiles on the ground)
+void DebugDraw_RectXZ(DebugDraw* dd, float minX, float minZ, float maxX, float maxZ, float y, const Vec3& color);
+
+// Label in the plane spanned by right / up (unit vectors, e.g. the camera's
+// for a billboard), starting at origin with characters height tall. Stroke
+// font covering A-Z, 0-9 and - + = . / _ (lowercase prints as uppercase).
+void DebugDraw_Text(DebugDraw* dd, const Vec3& origin, const Vec3& right, const Vec3& up, float height,
+                    const char* text, const Vec3& color);
+
+// Vertices DebugDraw_Text adds for text
+uint32_t DebugDraw_GetTextVertexCount(const char* text);
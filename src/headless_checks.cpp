@@ -0,0 +1,1832 @@
+#include "headless_checks.h"
+#include "debug_draw.h"
+#include "horizon.h"
+#include "light_clusters.h"
+#include "light_grid.h"
+#include "light_pack.h"
+#include "math_batch.h"
+#include "parallel.h"
+#include "ply_mesh.h"
+#include "pbrt_export.h"
+#include "scene.h"
+#include "scene_io.h"
+#include "shadow_atlas.h"
+#include "shadow_culling.h"
+#include "simd.h"
+#include "simulation.h"
+#include "software_renderer.h"
+#include "upload_ring.h"
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Soak mode validates the simulation after every chunk of steps
+static constexpr uint64_t SOAK_CHUNK_STEPS = 1000;
+
+// Lights traced as full maps per thread count in -bench-horizon
+static constexpr uint32_t BENCH_FULL_MAP_LIGHTS = 4;
+
+// Test configs usually freeze the cars; checks over moving traffic run them at
+// the default speed then
+static float GetTrafficSpeed()
+{
+    return (g_Scene.carSpeed > 0.0f) ? g_Scene.carSpeed : SimulationState().carSpeed;
+}
+
+// Warms the scene up like -test, then calls fn(frame) for frameCount frames of
+// moving traffic, one simulation step apart. fn returns false to stop (a
+// failed check); returns false then.
+template <typename Fn>
+static bool RunTrafficFrames(int frameCount, Fn&& fn)
+{
+    Simulation_AdvanceSteps(&g_Scene, TEST_FRAME_WAIT);
+    g_Scene.carSpeed = GetTrafficSpeed();
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        if (frame > 0)
+            Simulation_AdvanceSteps(&g_Scene, 1);
+        if (!fn(frame))
+            return false;
+    }
+    return true;
+}
+
+// Cars must stay on the track and lights must stay attached to their car
+static bool ValidateSimulation(const SimulationState* sim, const AABB& bounds)
+{
+    for (uint32_t i = 0; i < sim->numCars; i++)
+    {
+        float progress = sim->carTrackProgress[i];
+        if (!(progress >= 0.0f && progress < 1.0f))
+        {
+            printf("ERROR: car %u progress %f out of [0, 1)\n", i, progress);
+            return false;
+        }
+    }
+
+    // Vectorized poses must agree with the scalar track reference
+    for (uint32_t i = 0; i < sim->numCars; i++)
+    {
+        Vec3 trackPos, trackDir;
+        Simulation_GetTrackPositionAndDirection(sim->carProgress[i], sim->trackStraightLength, sim->trackRadius,
+                                                trackPos, trackDir);
+        Vec3 right(trackDir.z, 0, -trackDir.x);
+        Vec3 expected = trackPos + right * sim->carLane[i];
+
+        Vec3 carPos, carDir, carRight;
+        Simulation_GetCarPose(sim, i, carPos, carDir, carRight);
+        if (fabsf(carPos.x - expected.x) > 1e-2f || fabsf(carPos.z - expected.z) > 1e-2f ||
+            fabsf(carDir.x - trackDir.x) > 1e-3f || fabsf(carDir.z - trackDir.z) > 1e-3f)
+        {
+            printf("ERROR: car %u pose (%f, %f) differs from reference (%f, %f)\n",
+                   i, carPos.x, carPos.z, expected.x, expected.z);
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < sim->numConeLights; i++)
+    {
+        Vec3 p = Simulation_GetLightPosition(sim, i);
+        Vec3 d = Simulation_GetLightDirection(sim, i);
+        if (!(p.x >= bounds.min.x && p.x <= bounds.max.x && p.z >= bounds.min.z && p.z <= bounds.max.z) ||
+            !(fabsf(d.length() - 1.0f) < 1e-3f))
+        {
+            printf("ERROR: light %u left the track (%f, %f, %f)\n", i, p.x, p.y, p.z);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int Headless_RunSoak(uint64_t numSteps)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t done = 0;
+    while (done < numSteps)
+    {
+        uint64_t chunk = (numSteps - done < SOAK_CHUNK_STEPS) ? numSteps - done : SOAK_CHUNK_STEPS;
+        Simulation_AdvanceSteps(&g_Scene, chunk);
+        done += chunk;
+
+        if (!ValidateSimulation(&g_Scene, g_Scene.carAABB))
+        {
+            printf("Soak FAILED after %llu steps\n", (unsigned long long)g_Scene.stepCount);
+            return 1;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Soak OK: %llu steps (%.1f simulated minutes) in %.3f s, %.0f steps/s\n",
+           (unsigned long long)numSteps, (double)numSteps * SIMULATION_STEP / 60.0,
+           seconds, seconds > 0.0 ? (double)numSteps / seconds : 0.0);
+    return 0;
+}
+
+// Culling check samples surface points on this spacing (meters)
+static constexpr float CULLING_CHECK_SPACING = 0.25f;
+
+// Same reach test as CalculateConeLightContribution, without shading
+static bool LightReachesPoint(const ConeLightGPU& light, const Vec3& p)
+{
+    Vec3 toLight = Vec3(light.position[0], light.position[1], light.position[2]) - p;
+    float dist = toLight.length();
+    if (dist > light.position[3] || dist <= 0.0f)
+        return false;
+    float cosAngle = -dot(toLight * (1.0f / dist), Vec3(light.direction[0], light.direction[1], light.direction[2]));
+    return cosAngle >= light.direction[3];
+}
+
+// Light lists of one culling mode, as the main pass looks them up
+struct CullingLists
+{
+    int mode;
+    const char* name;
+    LightClusterGrid clusters;
+    LightGrid grid;
+};
+
+// Every light that reaches a visible point must be in the list the main pass
+// uses for that point's pixel. Returns the number of missing lights.
+static uint32_t CheckPointLights(const CameraConstants& cb, const CullingLists& lists,
+                                 const std::vector<ConeLightGPU>& lights, uint32_t lightCount, const Vec3& p)
+{
+    const float* m = cb.viewProjection.m;
+    float clip[4];
+    for (int r = 0; r < 4; ++r)
+        clip[r] = m[r] * p.x + m[4 + r] * p.y + m[8 + r] * p.z + m[12 + r];
+    if (clip[3] <= 0.0f || clip[2] < 0.0f || clip[2] > clip[3])
+        return 0;
+
+    float pixelX = (clip[0] / clip[3] * 0.5f + 0.5f) * (float)OUTPUT_WIDTH;
+    float pixelY = (0.5f - clip[1] / clip[3] * 0.5f) * (float)OUTPUT_HEIGHT;
+    if (pixelX < 0.0f || pixelY < 0.0f || pixelX >= (float)OUTPUT_WIDTH || pixelY >= (float)OUTPUT_HEIGHT)
+        return 0;
+
+    const std::vector<LightClusterRange>* ranges;
+    const std::vector<uint32_t>* indices;
+    uint32_t listIndex;
+    if (lists.mode == LIGHT_CULLING_CLUSTERED)
+    {
+        float viewDepth = dot(p - cb.cameraPos, cb.cameraForward);
+        ranges = &lists.clusters.ranges;
+        indices = &lists.clusters.lightIndices;
+        listIndex = LightClusters_GetClusterIndex(&lists.clusters, pixelX, pixelY, viewDepth);
+    }
+    else
+    {
+        ranges = &lists.grid.ranges;
+        indices = &lists.grid.lightIndices;
+        listIndex = LightGrid_GetCellIndex(&lists.grid, p.x, p.z);
+    }
+
+    const LightClusterRange& range = (*ranges)[listIndex];
+    const uint32_t* first = indices->data() + range.offset;
+    const uint32_t* last = first + range.count;
+
+    uint32_t missing = 0;
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        if (LightReachesPoint(lights[i], p) && !std::binary_search(first, last, i))
+            missing++;
+    }
+    return missing;
+}
+
+static double RenderTimed(uint8_t* pixels)
+{
+    auto start = std::chrono::steady_clock::now();
+    Software_Render(&g_Scene, g_Vertices, g_Indices, OUTPUT_WIDTH, OUTPUT_HEIGHT, pixels);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int Headless_RunCullingCheck()
+{
+    Simulation_AdvanceSteps(&g_Scene, TEST_FRAME_WAIT);
+    Scene_WriteCarVertices(&g_Scene, g_Vertices.data() + SCENE_GROUND_VERTEX_COUNT);
+
+    CameraConstants cb = {};
+    Scene_FillCameraConstants(&g_Scene, (float)OUTPUT_WIDTH / (float)OUTPUT_HEIGHT, &cb);
+    uint32_t lightCount = Scene_GetActiveLightCount(&g_Scene);
+    std::vector<ConeLightGPU> lights(g_Scene.numConeLights);
+    std::vector<Mat4> lightMatrices(g_Scene.numConeLights);
+    Scene_FillConeLights(&g_Scene, lights.data(), lightMatrices.data());
+
+    // Brute-force reference image
+    int savedMode = g_Scene.lightCullingMode;
+    std::vector<uint8_t> reference((size_t)OUTPUT_WIDTH * OUTPUT_HEIGHT * 4);
+    std::vector<uint8_t> culled(reference.size());
+    g_Scene.lightCullingMode = LIGHT_CULLING_NONE;
+    double bruteMs = RenderTimed(reference.data());
+    printf("Brute force: %u lights, rendered in %.1f ms\n", lightCount, bruteMs);
+
+    CullingLists modes[2];
+    modes[0].mode = LIGHT_CULLING_CLUSTERED;
+    modes[0].name = "Clustered";
+    modes[1].mode = LIGHT_CULLING_GRID;
+    modes[1].name = "Grid";
+
+    for (CullingLists& lists : modes)
+    {
+        auto buildStart = std::chrono::steady_clock::now();
+        const std::vector<LightClusterRange>* ranges;
+        size_t indexCount;
+        if (lists.mode == LIGHT_CULLING_CLUSTERED)
+        {
+            LightClusters_Build(&g_Scene, OUTPUT_WIDTH, OUTPUT_HEIGHT, &lists.clusters);
+            ranges = &lists.clusters.ranges;
+            indexCount = lists.clusters.lightIndices.size();
+        }
+        else
+        {
+            LightGrid_Build(&g_Scene, &lists.grid);
+            ranges = &lists.grid.ranges;
+            indexCount = lists.grid.lightIndices.size();
+        }
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+        uint32_t usedLists = 0, maxLights = 0;
+        for (const LightClusterRange& range : *ranges)
+        {
+            usedLists += (range.count > 0) ? 1 : 0;
+            maxLights = std::max(maxLights, range.count);
+        }
+
+        // Ground points around the track, then a lattice through every car box
+        float margin = g_Scene.headlightRange;
+        int pointsX = (int)((g_Scene.carAABB.max.x - g_Scene.carAABB.min.x + 2.0f * margin) / CULLING_CHECK_SPACING) + 1;
+        int pointsZ = (int)((g_Scene.carAABB.max.z - g_Scene.carAABB.min.z + 2.0f * margin) / CULLING_CHECK_SPACING) + 1;
+        std::atomic<uint32_t> missing(0);
+        ParallelFor((uint32_t)pointsZ, [&](uint32_t z)
+        {
+            for (int x = 0; x < pointsX; ++x)
+            {
+                Vec3 p(g_Scene.carAABB.min.x - margin + (float)x * CULLING_CHECK_SPACING, 0.0f,
+                       g_Scene.carAABB.min.z - margin + (float)z * CULLING_CHECK_SPACING);
+                missing += CheckPointLights(cb, lists, lights, lightCount, p);
+            }
+        });
+        ParallelFor(g_Scene.numCars, [&](uint32_t car)
+        {
+            Vec3 carPos, carDir, carRight;
+            Simulation_GetCarPose(&g_Scene, car, carPos, carDir, carRight);
+            for (int i = 0; i <= 4; ++i)
+                for (int j = 0; j <= 4; ++j)
+                    for (int k = 0; k <= 4; ++k)
+                    {
+                        Vec3 p = carPos + carRight * (CAR_WIDTH * ((float)i / 4.0f - 0.5f)) +
+                                 Vec3(0.0f, CAR_HEIGHT * ((float)j / 4.0f - 0.5f), 0.0f) +
+                                 carDir * (CAR_LENGTH * ((float)k / 4.0f - 0.5f));
+                        missing += CheckPointLights(cb, lists, lights, lightCount, p);
+                    }
+        });
+
+        // Culled shading must match the brute-force loop exactly: skipped lights
+        // contribute exactly zero and the lists keep the summation order
+        g_Scene.lightCullingMode = lists.mode;
+        double culledMs = RenderTimed(culled.data());
+        size_t differing = 0;
+        for (size_t i = 0; i < reference.size(); ++i)
+            differing += (reference[i] != culled[i]) ? 1 : 0;
+
+        printf("%s: %zu lists, %u non-empty, %zu indices (max %u per list), built in %.2f ms, rendered in %.1f ms\n",
+               lists.name, ranges->size(), usedLists, indexCount, maxLights, buildMs, culledMs);
+        if (missing > 0)
+        {
+            printf("ERROR: %s: %u light/point pairs missing from their list\n", lists.name, missing.load());
+            return 1;
+        }
+        if (differing > 0)
+        {
+            printf("ERROR: %s: %zu bytes differ from brute force\n", lists.name, differing);
+            return 1;
+        }
+    }
+    g_Scene.lightCullingMode = savedMode;
+
+    printf("Culling check OK\n");
+    return 0;
+}
+
+// Incremental horizon update vs. a full trace of the same height map, bit for bit
+static bool CompareHorizon(const HorizonCache& incremental, const HorizonCache& full)
+{
+    if (incremental.slices.size() != full.slices.size())
+    {
+        printf("ERROR: %zu horizon slices, expected %zu\n", incremental.slices.size(), full.slices.size());
+        return false;
+    }
+    for (size_t i = 0; i < full.slices.size(); ++i)
+    {
+        const HorizonSlice& a = incremental.slices[i];
+        const HorizonSlice& b = full.slices[i];
+        if (a.x0 != b.x0 || a.y0 != b.y0 || a.width != b.width || a.height != b.height ||
+            memcmp(a.data.data(), b.data.data(), b.data.size() * sizeof(float)) != 0)
+        {
+            printf("ERROR: horizon slice %zu differs from the full trace\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int Headless_RunHorizonCheck()
+{
+    Simulation_AdvanceSteps(&g_Scene, TEST_FRAME_WAIT);
+    uint32_t shadowedCount = Scene_GetShadowedLightCount(&g_Scene);
+    uint32_t nudgedCar = g_Scene.numCars - 1;
+
+    float carSpeed = GetTrafficSpeed();
+
+    // Moving traffic, then only one car moving under static lights (its
+    // headlights are left in place), then a static frame
+    static constexpr int MOVING_FRAMES = 2;
+    static constexpr int NUDGE_FRAMES = 3;
+    static constexpr int FRAME_COUNT = MOVING_FRAMES + NUDGE_FRAMES + 2;
+
+    HorizonCache cache;
+    HorizonOccluders occluders;
+    std::vector<float> heightMap, prevHeightMap;
+    double incrementalMs = 0.0, fullMs = 0.0;
+    for (int frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        const char* phase = "static";
+        if (frame == 0)
+        {
+            phase = "first";
+        }
+        else if (frame <= MOVING_FRAMES)
+        {
+            phase = "moving";
+            float savedSpeed = g_Scene.carSpeed;
+            g_Scene.carSpeed = carSpeed;
+            Simulation_AdvanceSteps(&g_Scene, 1);
+            g_Scene.carSpeed = savedSpeed;
+        }
+        else if (frame <= MOVING_FRAMES + NUDGE_FRAMES)
+        {
+            phase = "one car";
+            g_Scene.carPosX[nudgedCar] += g_Scene.carDirX[nudgedCar] * 0.5f;
+            g_Scene.carPosZ[nudgedCar] += g_Scene.carDirZ[nudgedCar] * 0.5f;
+        }
+        Scene_WriteCarVertices(&g_Scene, g_Vertices.data() + SCENE_GROUND_VERTEX_COUNT);
+        Software_RenderHeightMap(&g_Scene, g_Vertices, g_Indices, heightMap);
+
+        // The GPU path's changed region (from the car poses) must cover every changed texel
+        HorizonMapParams params = Horizon_GetMapParams(&g_Scene);
+        HorizonTexelRect rect = Horizon_UpdateOccluders(&occluders, &g_Scene, params);
+        for (int y = 0; y < params.mapSize && !prevHeightMap.empty(); ++y)
+        {
+            for (int x = 0; x < params.mapSize; ++x)
+            {
+                size_t t = (size_t)y * params.mapSize + x;
+                if (heightMap[t] != prevHeightMap[t] && (x < rect.x0 || x >= rect.x1 || y < rect.y0 || y >= rect.y1))
+                {
+                    printf("ERROR: height map texel (%d, %d) changed outside the car rect\n", x, y);
+                    return 1;
+                }
+            }
+        }
+        prevHeightMap = heightMap;
+
+        auto start = std::chrono::steady_clock::now();
+        Horizon_Update(&cache, &g_Scene, heightMap.data(), shadowedCount);
+        double updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        HorizonCache full;
+        start = std::chrono::steady_clock::now();
+        Horizon_Update(&full, &g_Scene, heightMap.data(), shadowedCount);
+        double traceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        printf("Frame %d (%s): %u full, %u partial, %u skipped lights, %u dirty tiles, "
+               "%llu / %llu texels traced, %.2f ms (full trace %.2f ms)\n",
+               frame, phase, cache.fullLights, cache.partialLights, cache.skippedLights, cache.dirtyTiles,
+               (unsigned long long)cache.tracedTexels, (unsigned long long)full.tracedTexels, updateMs, traceMs);
+        if (!CompareHorizon(cache, full))
+            return 1;
+        if (frame > 0)
+        {
+            incrementalMs += updateMs;
+            fullMs += traceMs;
+        }
+    }
+
+    printf("Horizon check OK (%u lights, incremental %.2f ms vs. full %.2f ms over %d frames)\n",
+           shadowedCount, incrementalMs, fullMs, FRAME_COUNT - 1);
+    return 0;
+}
+
+// Smallest share of the atlas in use once a tile was lowered (the space left
+// is less than three 512 tiles)
+static constexpr double ATLAS_CHECK_MIN_OCCUPANCY = 0.95;
+
+// Tiles inside the atlas, aligned, within the size range and not overlapping;
+// every visible light has a tile unless a more important one took the space,
+// a less important light never has a larger tile than a lowered one, and
+// lowering leaves little of the atlas unused
+static bool ValidateAtlas(const ShadowAtlas& atlas, uint32_t lightCount)
+{
+    if (atlas.tiles.size() != lightCount)
+    {
+        printf("ERROR: %zu atlas tiles for %u lights\n", atlas.tiles.size(), lightCount);
+        return false;
+    }
+
+    const uint32_t cellsPerSide = SHADOW_ATLAS_SIZE / SHADOW_ATLAS_MIN_TILE;
+    std::vector<uint8_t> used((size_t)cellsPerSide * cellsPerSide, 0);
+    uint32_t tileCount = 0, droppedCount = 0, maxTileSize = 0;
+    uint64_t usedTexels = 0;
+    float minKept = 1e30f, maxDropped = 0.0f;
+    std::vector<uint32_t> requests(lightCount);
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        const ShadowAtlasTile& tile = atlas.tiles[i];
+        uint32_t requested;
+        float importance = ShadowAtlas_GetImportance(&g_Scene, i, OUTPUT_WIDTH, OUTPUT_HEIGHT, &requested);
+        requests[i] = requested;
+        if (importance != atlas.importance[i])
+        {
+            printf("ERROR: light %u importance %f, expected %f\n", i, atlas.importance[i], importance);
+            return false;
+        }
+        if (tile.size == 0)
+        {
+            if (requested > 0)
+            {
+                droppedCount++;
+                maxDropped = std::max(maxDropped, importance);
+            }
+            continue;
+        }
+        if (requested == 0)
+        {
+            printf("ERROR: light %u is not visible but has a tile\n", i);
+            return false;
+        }
+
+        bool powerOfTwo = (tile.size & (tile.size - 1)) == 0;
+        if (!powerOfTwo || tile.size < SHADOW_ATLAS_MIN_TILE || tile.size > requested ||
+            tile.x % tile.size != 0 || tile.y % tile.size != 0 ||
+            tile.x + tile.size > SHADOW_ATLAS_SIZE || tile.y + tile.size > SHADOW_ATLAS_SIZE)
+        {
+            printf("ERROR: light %u has a bad tile (%u, %u) size %u (requested %u)\n",
+                   i, tile.x, tile.y, tile.size, requested);
+            return false;
+        }
+        for (uint32_t y = tile.y / SHADOW_ATLAS_MIN_TILE; y < (tile.y + tile.size) / SHADOW_ATLAS_MIN_TILE; ++y)
+        {
+            for (uint32_t x = tile.x / SHADOW_ATLAS_MIN_TILE; x < (tile.x + tile.size) / SHADOW_ATLAS_MIN_TILE; ++x)
+            {
+                if (used[(size_t)y * cellsPerSide + x]++)
+                {
+                    printf("ERROR: light %u tile overlaps another at (%u, %u)\n", i, x * SHADOW_ATLAS_MIN_TILE, y * SHADOW_ATLAS_MIN_TILE);
+                    return false;
+                }
+            }
+        }
+        tileCount++;
+        usedTexels += (uint64_t)tile.size * tile.size;
+        maxTileSize = std::max(maxTileSize, tile.size);
+        minKept = std::min(minKept, importance);
+    }
+
+    if (tileCount != atlas.tileCount || droppedCount != atlas.droppedCount || usedTexels != atlas.usedTexels ||
+        maxTileSize != atlas.maxTileSize)
+    {
+        printf("ERROR: atlas stats %u tiles / %u dropped / %llu texels / max tile %u, counted %u / %u / %llu / %u\n",
+               atlas.tileCount, atlas.droppedCount, (unsigned long long)atlas.usedTexels, atlas.maxTileSize,
+               tileCount, droppedCount, (unsigned long long)usedTexels, maxTileSize);
+        return false;
+    }
+    if (droppedCount > 0 && maxDropped > minKept)
+    {
+        printf("ERROR: dropped a light of importance %f but kept one of %f\n", maxDropped, minKept);
+        return false;
+    }
+
+    // Walking from the most important light, no tile is larger than the
+    // smallest lowered tile before it
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < lightCount; ++i)
+        if (atlas.tiles[i].size > 0)
+            order.push_back(i);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+    {
+        if (atlas.importance[a] != atlas.importance[b])
+            return atlas.importance[a] > atlas.importance[b];
+        return a < b;
+    });
+    uint32_t lowered = UINT32_MAX;
+    for (uint32_t i : order)
+    {
+        const ShadowAtlasTile& tile = atlas.tiles[i];
+        if (tile.size > lowered)
+        {
+            printf("ERROR: light %u (importance %f) has a %u tile, a more important light was lowered to %u\n",
+                   i, atlas.importance[i], tile.size, lowered);
+            return false;
+        }
+        if (tile.size < requests[i])
+            lowered = tile.size;
+    }
+
+    double occupancy = (double)usedTexels / ((double)SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE);
+    if ((lowered != UINT32_MAX || droppedCount > 0) && occupancy < ATLAS_CHECK_MIN_OCCUPANCY)
+    {
+        printf("ERROR: tiles were lowered but only %.1f%% of the atlas is used\n", 100.0 * occupancy);
+        return false;
+    }
+    return true;
+}
+
+int Headless_RunAtlasCheck()
+{
+    static constexpr int FRAME_COUNT = 60;
+    ShadowAtlas atlas;
+    double buildMs = 0.0;
+    bool completed = RunTrafficFrames(FRAME_COUNT, [&](int frame)
+    {
+        auto start = std::chrono::steady_clock::now();
+        ShadowAtlas_Build(&g_Scene, OUTPUT_WIDTH, OUTPUT_HEIGHT, &atlas);
+        buildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (!ValidateAtlas(atlas, Scene_GetActiveLightCount(&g_Scene)))
+        {
+            printf("Atlas check FAILED at frame %d\n", frame);
+            return false;
+        }
+        if (frame % 10 == 0)
+        {
+            printf("Frame %d: %u tiles, %u dropped, max tile %u, %.1f%% of the atlas used\n",
+                   frame, atlas.tileCount, atlas.droppedCount, atlas.maxTileSize,
+                   100.0 * (double)atlas.usedTexels / ((double)SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE));
+        }
+        return true;
+    });
+    if (!completed)
+        return 1;
+
+    printf("Atlas check OK (%u lights, %.3f ms per build)\n", Scene_GetActiveLightCount(&g_Scene), buildMs / FRAME_COUNT);
+    return 0;
+}
+
+// Position / normal tolerance between the instanced and expanded car boxes
+static constexpr float INSTANCE_CHECK_EPSILON = 1e-4f;
+
+int Headless_RunInstanceCheck()
+{
+    std::vector<Vertex> meshVertices;
+    std::vector<uint32_t> meshIndices;
+    Scene_BuildInstancedGeometry(&g_Scene, meshVertices, meshIndices);
+    if (meshVertices.size() != SCENE_GROUND_VERTEX_COUNT + VERTS_PER_BOX ||
+        meshIndices.size() != SCENE_GROUND_INDEX_COUNT + INDICES_PER_BOX)
+    {
+        printf("Instance check FAILED: unexpected mesh size (%zu vertices, %zu indices)\n",
+               meshVertices.size(), meshIndices.size());
+        return 1;
+    }
+
+    const uint32_t carCount = g_Scene.numCars;
+    std::vector<CarInstance> instances(carCount + SCENE_FIRST_CAR_INSTANCE);
+    static constexpr int FRAME_COUNT = 60;
+    float maxError = 0.0f;
+    bool completed = RunTrafficFrames(FRAME_COUNT, [&](int frame)
+    {
+        Scene_WriteCarVertices(&g_Scene, g_Vertices.data() + SCENE_GROUND_VERTEX_COUNT);
+        Scene_WriteCarInstances(&g_Scene, instances.data());
+
+        // Instance 0 draws the ground unchanged; the box indices match the expanded ones
+        for (uint32_t i = 0; i < SCENE_GROUND_INDEX_COUNT + INDICES_PER_BOX; ++i)
+        {
+            if (meshIndices[i] != g_Indices[i])
+            {
+                printf("Instance check FAILED: index %u differs\n", i);
+                return false;
+            }
+        }
+
+        for (uint32_t c = 0; c <= carCount; ++c)
+        {
+            // Slot 0 is the ground, then one box per car
+            const Vertex* local = meshVertices.data() + (c == 0 ? 0 : SCENE_GROUND_VERTEX_COUNT);
+            const Vertex* expanded = g_Vertices.data() + (c == 0 ? 0 : SCENE_GROUND_VERTEX_COUNT + (size_t)(c - 1) * VERTS_PER_BOX);
+            uint32_t vertexCount = (c == 0) ? SCENE_GROUND_VERTEX_COUNT : VERTS_PER_BOX;
+            const CarInstance& instance = instances[c == 0 ? 0 : SCENE_FIRST_CAR_INSTANCE + c - 1];
+            for (uint32_t v = 0; v < vertexCount; ++v)
+            {
+                Vertex world;
+                Scene_TransformInstanceVertex(instance, local[v], world);
+                float error = 0.0f;
+                for (int k = 0; k < 3; ++k)
+                {
+                    error = std::max(error, fabsf(world.position[k] - expanded[v].position[k]));
+                    error = std::max(error, fabsf(world.normal[k] - expanded[v].normal[k]));
+                }
+                maxError = std::max(maxError, error);
+                if (error > INSTANCE_CHECK_EPSILON ||
+                    world.uv[0] != expanded[v].uv[0] || world.uv[1] != expanded[v].uv[1])
+                {
+                    printf("Instance check FAILED at frame %d: %s vertex %u differs by %g\n",
+                           frame, c == 0 ? "ground" : "car", v, error);
+                    return false;
+                }
+            }
+        }
+        return true;
+    });
+    if (!completed)
+        return 1;
+
+    // Per-frame upload: every car box vs one instance per car plus the identity
+    size_t expandedBytes = (size_t)carCount * VERTS_PER_BOX * sizeof(Vertex);
+    size_t instancedBytes = instances.size() * sizeof(CarInstance);
+    printf("Upload per frame: %zu bytes expanded, %zu bytes instanced (%u cars)\n", expandedBytes, instancedBytes, carCount);
+    printf("Instance check OK (max error %g)\n", maxError);
+    return 0;
+}
+
+// Random lights -check-light-pack encodes besides the scene's, within the
+// range LIGHT_PACK_MAX_OFFSET_ERROR holds for
+static constexpr uint32_t LIGHT_PACK_CHECK_RANDOM_LIGHTS = 100000;
+static constexpr float LIGHT_PACK_CHECK_EXTENT = 4096.0f;
+
+// Largest decode errors of one batch
+struct LightPackErrors
+{
+    float offset = 0.0f;        // x / z, world units
+    float height = 0.0f;        // y, relative
+    float direction = 0.0f;     // Radians
+};
+
+// Decodes pack and compares it with the lights it was encoded from
+static bool CheckLightPack(const LightPack& pack, const ConeLightGPU* lights, uint32_t count, LightPackErrors& errors)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const ConeLightGPU& light = lights[i];
+        ConeLightGPU decoded;
+        LightPack_Decode(pack.lights[i], pack.classes.data(), &decoded);
+
+        float offsetError = std::max(fabsf(decoded.position[0] - light.position[0]),
+                                     fabsf(decoded.position[2] - light.position[2]));
+        float heightError = fabsf(decoded.position[1] - light.position[1]) / std::max(fabsf(light.position[1]), 1e-4f);
+        Vec3 a(light.direction[0], light.direction[1], light.direction[2]);
+        Vec3 b(decoded.direction[0], decoded.direction[1], decoded.direction[2]);
+        float directionError = atan2f(cross(a, b).length(), dot(a, b));
+        errors.offset = std::max(errors.offset, offsetError);
+        errors.height = std::max(errors.height, heightError);
+        errors.direction = std::max(errors.direction, directionError);
+
+        bool exact = decoded.position[3] == light.position[3] && decoded.direction[3] == light.direction[3] &&
+                     memcmp(decoded.color, light.color, sizeof(light.color)) == 0 &&
+                     memcmp(decoded.shadowTile, light.shadowTile, sizeof(light.shadowTile)) == 0;
+        if (offsetError > LIGHT_PACK_MAX_OFFSET_ERROR || heightError > 1.0f / 2048.0f ||
+            directionError > LIGHT_PACK_MAX_DIRECTION_ERROR || !exact)
+        {
+            printf("Light pack check FAILED: light %u at (%g, %g, %g) decodes with offset error %g, height error %g, "
+                   "direction error %g%s\n", i, light.position[0], light.position[1], light.position[2],
+                   offsetError, heightError, directionError, exact ? "" : ", shared parameters or tile differ");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Config text with one error of each kind (lines 4, 6, 7, 8 and 9) between
+// lines that must still apply
+static const char* g_BadConfig =
+    "version=1\n"
+    "# comment\n"
+    "\n"
+    "carSpeed=abc\n"
+    "ambientIntensity=0.5\n"
+    "noEquals\n"
+    "carSpeed=1.5x\n"
+    "unknownKey=3\r\n"
+    "carCount=-5\n"
+    "carCount=4000000000\n"
+    "lightCullingMode=3\n"
+    "  shadowBias = 0.25 \r\n";
+
+static constexpr int CONFIG_BENCH_RUNS = 10000;
+
+int Headless_RunConfigCheck()
+{
+    // Round trip of the loaded config
+    std::string text = SerializeState(g_Scene);
+    std::unique_ptr<SceneState> scene = std::make_unique<SceneState>();
+    std::string errors;
+    if (!DeserializeState(*scene, text, &errors) || SerializeState(*scene) != text)
+    {
+        printf("%sConfig check FAILED: round trip differs\n", errors.c_str());
+        return 1;
+    }
+
+    // Bad lines are reported with their numbers and skipped, good ones apply
+    scene = std::make_unique<SceneState>();
+    errors.clear();
+    bool ok = DeserializeState(*scene, g_BadConfig, &errors);
+    const char* expected =
+        "line 4: bad value (carSpeed=abc)\n"
+        "line 6: expected key=value (noEquals)\n"
+        "line 7: bad value (carSpeed=1.5x)\n"
+        "line 8: unknown key (unknownKey=3)\n"
+        "line 9: bad value (carCount=-5)\n"
+        "line 10: bad value (carCount=4000000000)\n"
+        "line 11: bad value (lightCullingMode=3)\n";
+    if (ok || errors != expected || scene->ambientIntensity != 0.5f || scene->shadowBias != 0.25f ||
+        scene->carSpeed != SceneState().carSpeed || scene->carCount != SceneState().carCount ||
+        scene->lightCullingMode != SceneState().lightCullingMode)
+    {
+        printf("%sConfig check FAILED: bad lines not reported as expected\n", errors.c_str());
+        return 1;
+    }
+
+    errors.clear();
+    if (LoadStateFromFile(*scene, "missing/none.cfg", &errors) || errors != "missing/none.cfg: cannot open\n")
+    {
+        printf("%sConfig check FAILED: missing file not reported\n", errors.c_str());
+        return 1;
+    }
+
+    // Parse rate (the simulation is initialized by the first run only)
+    auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < CONFIG_BENCH_RUNS; ++run)
+        DeserializeState(*scene, text);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%d loads of %zu bytes in %.1f ms (%.2f us each, %u cars)\n", CONFIG_BENCH_RUNS, text.size(), ms,
+           ms * 1000.0 / CONFIG_BENCH_RUNS, scene->numCars);
+
+    printf("Config check OK\n");
+    return 0;
+}
+
+int Headless_RunLightPackCheck()
+{
+    // Every half converts back to itself (NaNs stay NaN)
+    for (uint32_t h = 0; h < 0x10000; ++h)
+    {
+        float value = LightPack_HalfToFloat((uint16_t)h);
+        uint16_t back = LightPack_FloatToHalf(value);
+        bool nan = ((h >> 10) & 0x1f) == 0x1f && (h & 0x3ff) != 0;
+        if (nan ? (((back >> 10) & 0x1f) != 0x1f || (back & 0x3ff) == 0) : back != h)
+        {
+            printf("Light pack check FAILED: half 0x%04x converts back to 0x%04x\n", h, back);
+            return 1;
+        }
+    }
+
+    // Scene lights over moving traffic, with this frame's atlas tiles
+    static constexpr int FRAME_COUNT = 60;
+    const uint32_t lightCount = g_Scene.numConeLights;
+    std::vector<ConeLightGPU> lights(lightCount);
+    ShadowAtlas atlas;
+    LightPack pack;
+    LightPackErrors sceneErrors;
+    double encodeMs = 0.0;
+    bool completed = RunTrafficFrames(FRAME_COUNT, [&](int frame)
+    {
+        Scene_FillConeLights(&g_Scene, lights.data(), nullptr);
+        ShadowAtlas_Build(&g_Scene, OUTPUT_WIDTH, OUTPUT_HEIGHT, &atlas);
+        ShadowAtlas_FillLights(&atlas, lights.data(), lightCount);
+
+        auto start = std::chrono::steady_clock::now();
+        bool fits = LightPack_Encode(lights.data(), lightCount, &pack);
+        encodeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!fits || !CheckLightPack(pack, lights.data(), lightCount, sceneErrors))
+        {
+            printf("Light pack check FAILED at frame %d\n", frame);
+            return false;
+        }
+        return true;
+    });
+    if (!completed)
+        return 1;
+
+    const size_t sceneClasses = pack.classes.size();
+
+    // Random positions, directions (both hemispheres and the fold), tiles and a few classes
+    uint32_t random = 12345;
+    auto next = [&random](float lo, float hi)
+    {
+        random = random * 1664525u + 1013904223u;
+        return lo + (hi - lo) * (float)(random >> 8) / 16777216.0f;
+    };
+    std::vector<ConeLightGPU> randomLights(LIGHT_PACK_CHECK_RANDOM_LIGHTS);
+    for (uint32_t i = 0; i < LIGHT_PACK_CHECK_RANDOM_LIGHTS; ++i)
+    {
+        ConeLightGPU& light = randomLights[i];
+        Vec3 dir(next(-1.0f, 1.0f), next(-1.0f, 1.0f), next(-1.0f, 1.0f));
+        if (i % 4 == 0)
+            dir.y = 0.0f;
+        dir = dir.normalized();
+        float lightClass = (float)(i % 7);
+        float tileSize = (i % 3 == 0) ? 0.0f : (float)(SHADOW_ATLAS_MIN_TILE << (i % 5));
+        float position[4] = { next(-LIGHT_PACK_CHECK_EXTENT, LIGHT_PACK_CHECK_EXTENT), next(0.01f, 100.0f),
+                              next(-LIGHT_PACK_CHECK_EXTENT, LIGHT_PACK_CHECK_EXTENT), 10.0f + lightClass };
+        float direction[4] = { dir.x, dir.y, dir.z, cosf(0.3f + 0.01f * lightClass) };
+        float color[4] = { 1.0f + lightClass, 0.5f, 0.25f, cosf(0.1f) };
+        float tile[4] = { tileSize > 0.0f ? (float)((i * 64) % SHADOW_ATLAS_SIZE) : 0.0f,
+                          tileSize > 0.0f ? (float)((i * 128) % SHADOW_ATLAS_SIZE) : 0.0f, tileSize, 0.0f };
+        memcpy(light.position, position, sizeof(position));
+        memcpy(light.direction, direction, sizeof(direction));
+        memcpy(light.color, color, sizeof(color));
+        memcpy(light.shadowTile, tile, sizeof(tile));
+    }
+    LightPackErrors randomErrors;
+    if (!LightPack_Encode(randomLights.data(), LIGHT_PACK_CHECK_RANDOM_LIGHTS, &pack) ||
+        !CheckLightPack(pack, randomLights.data(), LIGHT_PACK_CHECK_RANDOM_LIGHTS, randomErrors))
+    {
+        printf("Light pack check FAILED on random lights\n");
+        return 1;
+    }
+    if (pack.classes.size() != 7)
+    {
+        printf("Light pack check FAILED: %zu classes for 7 distinct ones\n", pack.classes.size());
+        return 1;
+    }
+
+    // Shading reads: light record and matrix per light, before and after
+    size_t classBytes = sceneClasses * sizeof(LightClassGPU);
+    printf("Light records: %zu bytes per light unpacked, %zu packed + %zu bytes of classes (%zu) for %u lights; "
+           "matrices %zu bytes per light\n", sizeof(ConeLightGPU), sizeof(PackedConeLight), classBytes, sceneClasses,
+           lightCount, sizeof(Mat4));
+    printf("Max errors: scene offset %g, height %g, direction %g rad; random offset %g, height %g, direction %g rad\n",
+           sceneErrors.offset, sceneErrors.height, sceneErrors.direction,
+           randomErrors.offset, randomErrors.height, randomErrors.direction);
+    printf("Light pack check OK (%.3f ms per encode)\n", encodeMs / FRAME_COUNT);
+    return 0;
+}
+
+// Frames the upload ring check runs per frames-in-flight count
+static constexpr uint32_t UPLOAD_RING_CHECK_FRAMES = 2000;
+
+// One frame of the upload ring check: what it allocated and the marker it wrote
+struct UploadCheckFrame
+{
+    uint64_t number = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> allocations;     // (offset, size)
+};
+
+// Runs the renderer's protocol on CPU-side buffers: frame n fills slot n %
+// frameCount after the GPU finished frame n - frameCount, which last used that
+// slot. Each frame stamps its allocations; the simulated GPU reads them when
+// the frame retires, after every later frame in flight wrote its own data.
+static bool CheckUploadRing(uint32_t frameCount)
+{
+    UploadRing ring;
+    UploadRing_Init(&ring, frameCount);
+    std::vector<std::vector<uint8_t>> buffers(frameCount);
+    std::vector<UploadCheckFrame> inFlight(frameCount);
+    uint32_t random = 12345;
+    auto next = [&random]() { random = random * 1664525u + 1013904223u; return random >> 8; };
+
+    for (uint64_t n = 0; n < UPLOAD_RING_CHECK_FRAMES; ++n)
+    {
+        uint32_t slot = (uint32_t)(n % frameCount);
+
+        // Retire the frame that used this slot last
+        UploadCheckFrame& previous = inFlight[slot];
+        for (const std::pair<uint64_t, uint64_t>& allocation : previous.allocations)
+        {
+            for (uint64_t b = 0; b < allocation.second; ++b)
+            {
+                if (buffers[slot][allocation.first + b] != (uint8_t)previous.number)
+                {
+                    printf("Upload ring check FAILED: frame %llu data overwritten before the GPU read it\n",
+                           (unsigned long long)previous.number);
+                    return false;
+                }
+            }
+        }
+
+        // Sizes like a frame of the renderer: a few small blocks and light lists
+        // that sometimes jump (culling mode or light count change)
+        std::vector<uint64_t> sizes;
+        uint32_t count = 1 + next() % 8;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t kind = next() % 16;
+            uint64_t size = (kind == 0) ? next() % (1u << 20) : (kind < 4) ? 0 : next() % 4096;
+            sizes.push_back(size);
+        }
+
+        uint64_t required = 0;
+        for (uint64_t size : sizes)
+            required += UploadRing_GetAllocationSize(size);
+        if (UploadRing_BeginFrame(&ring, slot, required))
+            buffers[slot].assign(ring.frames[slot].capacity, 0);
+
+        UploadCheckFrame& frame = inFlight[slot];
+        frame.number = n;
+        frame.allocations.clear();
+        uint64_t end = 0;
+        for (uint64_t size : sizes)
+        {
+            uint64_t offset = UploadRing_Allocate(&ring, size);
+            if (offset == UPLOAD_RING_INVALID_OFFSET || offset % UPLOAD_RING_ALIGNMENT != 0 || offset < end ||
+                offset + size > ring.frames[slot].capacity)
+            {
+                printf("Upload ring check FAILED: frame %llu got a bad offset for %llu bytes\n",
+                       (unsigned long long)n, (unsigned long long)size);
+                return false;
+            }
+            end = offset + UploadRing_GetAllocationSize(size);
+            memset(buffers[slot].data() + offset, (uint8_t)n, size);
+            frame.allocations.push_back({ offset, size });
+        }
+
+        // Nothing beyond the reservation
+        if (UploadRing_Allocate(&ring, 1) != UPLOAD_RING_INVALID_OFFSET)
+        {
+            printf("Upload ring check FAILED: frame %llu allocated past its reservation\n", (unsigned long long)n);
+            return false;
+        }
+    }
+
+    uint64_t capacity = 0;
+    for (const UploadRingFrame& frame : ring.frames)
+        capacity += frame.capacity;
+    printf("%u frames in flight: %u buffers created over %u frames, %.1f KB peak frame, %.1f KB total\n",
+           frameCount, ring.growCount, UPLOAD_RING_CHECK_FRAMES, ring.peakUsed / 1024.0, capacity / 1024.0);
+    return true;
+}
+
+int Headless_RunUploadRingCheck()
+{
+    for (uint32_t frameCount = 1; frameCount <= 3; ++frameCount)
+    {
+        if (!CheckUploadRing(frameCount))
+            return 1;
+    }
+    printf("Upload ring check OK\n");
+    return 0;
+}
+
+// Primitives per -check-debug-draw frame, cycling through every kind, and the
+// threads drawing them (fixed, so the stream is contended on any machine)
+static constexpr uint32_t DEBUG_DRAW_CHECK_PRIMITIVES = 50000;
+static constexpr uint32_t DEBUG_DRAW_CHECK_THREADS = 8;
+
+// Primitive i of the check frame, built from the scene's cars and lights
+static void DrawCheckPrimitive(DebugDraw* dd, uint32_t i, const std::vector<Mat4>& lightViewProj)
+{
+    uint32_t car = i % g_Scene.numCars;
+    uint32_t light = i % (uint32_t)lightViewProj.size();
+    Vec3 center, extents;
+    ShadowCulling_GetCarBounds(&g_Scene, car, center, extents);
+    Vec3 color((float)(i % 7) / 6.0f, (float)(i % 5) / 4.0f, (float)(i % 3) / 2.0f);
+
+    switch (i % 6)
+    {
+    case 0: DebugDraw_Line(dd, center, center + Vec3(0.0f, 2.0f, 0.0f), color); break;
+    case 1: DebugDraw_Box(dd, center, extents, color); break;
+    case 2: DebugDraw_Frustum(dd, lightViewProj[light], color); break;
+    case 3: DebugDraw_Sphere(dd, Simulation_GetLightPosition(&g_Scene, light), 1.0f + (float)(i % 4), color); break;
+    case 4: DebugDraw_RectXZ(dd, center.x - extents.x, center.z - extents.z, center.x + extents.x, center.z + extents.z, 0.05f, color); break;
+    default:
+    {
+        char label[32];
+        snprintf(label, sizeof(label), "C%u", car);
+        DebugDraw_Text(dd, center, Vec3(1.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f), 0.5f, label, color);
+        break;
+    }
+    }
+}
+
+// One frame of the check into storage (grown to the capacity and filled with
+// 0xff, which no written vertex matches); milliseconds
+static double DrawCheckFrame(DebugDraw* dd, std::vector<DebugVertex>& storage, uint32_t capacity, bool parallel,
+                             const std::vector<Mat4>& lightViewProj)
+{
+    storage.resize(capacity);
+    memset(storage.data(), 0xff, storage.size() * sizeof(DebugVertex));
+    DebugDraw_Begin(dd, storage.data(), capacity);
+
+    // Threads take interleaved primitives
+    uint32_t threadCount = parallel ? DEBUG_DRAW_CHECK_THREADS : 1;
+    auto worker = [&](uint32_t first)
+    {
+        for (uint32_t i = first; i < DEBUG_DRAW_CHECK_PRIMITIVES; i += threadCount)
+            DrawCheckPrimitive(dd, i, lightViewProj);
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < threadCount; ++t)
+        threads.emplace_back(worker, t);
+    worker(0);
+    for (std::thread& thread : threads)
+        thread.join();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A line of the stream, compared bytewise (vertex order within a primitive is
+// fixed, primitive order depends on the threads)
+struct DebugLine
+{
+    DebugVertex v[2];
+    bool operator<(const DebugLine& other) const { return memcmp(this, &other, sizeof(DebugLine)) < 0; }
+    bool operator==(const DebugLine& other) const { return memcmp(this, &other, sizeof(DebugLine)) == 0; }
+};
+
+static std::vector<DebugLine> GetSortedLines(const DebugDraw* dd)
+{
+    uint32_t count = DebugDraw_GetVertexCount(dd);
+    std::vector<DebugLine> lines(count / 2);
+    memcpy(lines.data(), dd->vertices, lines.size() * sizeof(DebugLine));
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+int Headless_RunDebugDrawCheck()
+{
+    Simulation_AdvanceSteps(&g_Scene, TEST_FRAME_WAIT);
+    if (g_Scene.numCars == 0 || g_Scene.numConeLights == 0)
+    {
+        printf("Debug draw check needs cars and lights\n");
+        return 1;
+    }
+    std::vector<ConeLightGPU> lights(g_Scene.numConeLights);
+    std::vector<Mat4> lightViewProj(g_Scene.numConeLights);
+    Scene_FillConeLights(&g_Scene, lights.data(), lightViewProj.data());
+
+    // First frame has no storage: everything is dropped, and the next frame is sized to fit
+    DebugDraw dd;
+    std::vector<DebugVertex> storage;
+    DrawCheckFrame(&dd, storage, DebugDraw_GetNextCapacity(&dd), false, lightViewProj);
+    uint32_t expected = DebugDraw_GetDroppedVertexCount(&dd);
+    uint32_t capacity = DebugDraw_GetNextCapacity(&dd);
+    if (DebugDraw_GetVertexCount(&dd) != 0 || expected == 0 || capacity < expected || (capacity & (capacity - 1)) != 0)
+    {
+        printf("Debug draw check FAILED: empty stream kept %u vertices, dropped %u, next capacity %u\n",
+               DebugDraw_GetVertexCount(&dd), expected, capacity);
+        return 1;
+    }
+
+    // Single-threaded reference
+    double serialMs = DrawCheckFrame(&dd, storage, capacity, false, lightViewProj);
+    if (DebugDraw_GetVertexCount(&dd) != expected || DebugDraw_GetDroppedVertexCount(&dd) != 0)
+    {
+        printf("Debug draw check FAILED: single-threaded frame has %u vertices, expected %u\n",
+               DebugDraw_GetVertexCount(&dd), expected);
+        return 1;
+    }
+    std::vector<DebugLine> reference = GetSortedLines(&dd);
+    DebugLine unwritten;
+    memset(&unwritten, 0xff, sizeof(unwritten));
+    for (const DebugLine& line : reference)
+    {
+        if (memcmp(&line.v[0], &unwritten.v[0], sizeof(DebugVertex)) == 0 ||
+            memcmp(&line.v[1], &unwritten.v[1], sizeof(DebugVertex)) == 0)
+        {
+            printf("Debug draw check FAILED: a primitive reserved more vertices than it wrote\n");
+            return 1;
+        }
+    }
+
+    // All threads: the same lines in some order
+    double parallelMs = DrawCheckFrame(&dd, storage, capacity, true, lightViewProj);
+    if (DebugDraw_GetVertexCount(&dd) != expected || DebugDraw_GetDroppedVertexCount(&dd) != 0 ||
+        GetSortedLines(&dd) != reference)
+    {
+        printf("Debug draw check FAILED: %u threads produced different lines than one\n", DEBUG_DRAW_CHECK_THREADS);
+        return 1;
+    }
+
+    // Overflow: the stream is full, holds only whole lines of the reference or
+    // zero-length padding, and the next frame grows back to fit
+    uint32_t smallCapacity = expected / 3;
+    DrawCheckFrame(&dd, storage, smallCapacity, true, lightViewProj);
+    if (DebugDraw_GetVertexCount(&dd) != smallCapacity || DebugDraw_GetDroppedVertexCount(&dd) != expected - smallCapacity ||
+        DebugDraw_GetNextCapacity(&dd) < expected)
+    {
+        printf("Debug draw check FAILED: overflow kept %u vertices, dropped %u, next capacity %u\n",
+               DebugDraw_GetVertexCount(&dd), DebugDraw_GetDroppedVertexCount(&dd), DebugDraw_GetNextCapacity(&dd));
+        return 1;
+    }
+    DebugLine padding = {};
+    for (const DebugLine& line : GetSortedLines(&dd))
+    {
+        if (!(line == padding) && !std::binary_search(reference.begin(), reference.end(), line))
+        {
+            printf("Debug draw check FAILED: overflowed stream holds a partial primitive\n");
+            return 1;
+        }
+    }
+
+    printf("%u primitives, %u vertices (%.1f KB): %.2f ms on 1 thread, %.2f ms on %u threads\n",
+           DEBUG_DRAW_CHECK_PRIMITIVES, expected, expected * sizeof(DebugVertex) / 1024.0, serialMs, parallelMs,
+           DEBUG_DRAW_CHECK_THREADS);
+    printf("Debug draw check OK\n");
+    return 0;
+}
+
+// Elements per -bench-math kernel call, and how often each kernel runs
+static constexpr uint32_t MATH_BENCH_COUNT = 4096;
+static constexpr uint32_t MATH_BENCH_REPEATS = 200;
+
+// Milliseconds per call of fn, over MATH_BENCH_REPEATS calls
+template <typename Fn>
+static double TimeMathKernel(Fn&& fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < MATH_BENCH_REPEATS; ++r)
+        fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / MATH_BENCH_REPEATS;
+}
+
+// The batch and SIMD kernels are bit-identical to their scalar references
+// unless the compiler fuses a * b + c into FMA (GCC / Clang without
+// -ffp-contract=off), which moves both sides by a few roundings, differently.
+// Every bench comparing the two accepts this much.
+static constexpr float FMA_CONTRACTION_TOLERANCE = 1e-5f;
+
+// Largest |a - b| over count values, relative to the largest magnitude in b's
+// group of groupSize values (at least 1, so values that cancel to near zero
+// are measured against their inputs' scale)
+static float GetMaxRelativeDifference(const float* a, const float* b, size_t count, size_t groupSize)
+{
+    float maxDifference = 0.0f;
+    for (size_t first = 0; first < count; first += groupSize)
+    {
+        float scale = 1.0f;
+        for (size_t i = first; i < first + groupSize; ++i)
+            scale = std::max(scale, fabsf(b[i]));
+        for (size_t i = first; i < first + groupSize; ++i)
+            maxDifference = std::max(maxDifference, fabsf(a[i] - b[i]) / scale);
+    }
+    return maxDifference;
+}
+
+static void PrintMathResult(const char* name, double scalarMs, double batchMs)
+{
+    printf("%-20s scalar %.3f ms, batch %.3f ms (%.2fx), %.1f M/s\n", name, scalarMs, batchMs, scalarMs / batchMs,
+           MATH_BENCH_COUNT / (batchMs * 1000.0));
+}
+
+int Headless_RunMathBench()
+{
+    // Light-like inputs: eyes around the track, targets ahead, cone angles and ranges
+    uint32_t random = 12345;
+    auto next = [&random](float lo, float hi)
+    {
+        random = random * 1664525u + 1013904223u;
+        return lo + (hi - lo) * (float)(random >> 8) / 16777216.0f;
+    };
+    const uint32_t n = MATH_BENCH_COUNT;
+    std::vector<float> eyeX(n), eyeY(n), eyeZ(n), targetX(n), targetY(n), targetZ(n), upX(n), upY(n), upZ(n);
+    std::vector<float> fovY(n), aspect(n), nearZ(n), farZ(n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        eyeX[i] = next(-500.0f, 500.0f);
+        eyeY[i] = next(0.5f, 1.0f);
+        eyeZ[i] = next(-200.0f, 200.0f);
+        targetX[i] = eyeX[i] + next(-30.0f, 30.0f);
+        targetY[i] = eyeY[i] - next(0.0f, 3.0f);
+        targetZ[i] = eyeZ[i] + next(-30.0f, 30.0f);
+        bool vertical = (i % 64) == 0;      // Exercises the other up vector
+        if (vertical)
+        {
+            targetX[i] = eyeX[i];
+            targetZ[i] = eyeZ[i];
+        }
+        upX[i] = vertical ? 1.0f : 0.0f;
+        upY[i] = vertical ? 0.0f : 1.0f;
+        upZ[i] = 0.0f;
+        fovY[i] = next(0.3f, 1.5f);
+        aspect[i] = 1.0f;
+        nearZ[i] = 0.1f;
+        farZ[i] = next(20.0f, 300.0f);
+    }
+    LookAtPerspectiveInputs in = { eyeX.data(), eyeY.data(), eyeZ.data(), targetX.data(), targetY.data(), targetZ.data(),
+                                   upX.data(), upY.data(), upZ.data(), fovY.data(), aspect.data(), nearZ.data(), farZ.data() };
+
+    // Light matrices
+    std::vector<Mat4> scalarMats(n), batchMats(n);
+    double scalarMs = TimeMathKernel([&]()
+    {
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            Mat4 view = Mat4::lookAt(Vec3(eyeX[i], eyeY[i], eyeZ[i]), Vec3(targetX[i], targetY[i], targetZ[i]),
+                                     Vec3(upX[i], upY[i], upZ[i]));
+            scalarMats[i] = Mat4::perspective(fovY[i], aspect[i], nearZ[i], farZ[i]) * view;
+        }
+    });
+    double batchMs = TimeMathKernel([&]() { MathBatch_LookAtPerspective(in, n, batchMats.data()); });
+    bool identical = memcmp(scalarMats.data(), batchMats.data(), n * sizeof(Mat4)) == 0;
+    float maxDifference = GetMaxRelativeDifference(batchMats[0].m, scalarMats[0].m, 16 * (size_t)n, 16);
+    if (maxDifference > FMA_CONTRACTION_TOLERANCE)
+    {
+        printf("Math bench FAILED: batch look-at / perspective differs from Mat4 by %g\n", maxDifference);
+        return 1;
+    }
+    PrintMathResult("Look-at/perspective", scalarMs, batchMs);
+
+    // Matrix products (light matrices times a fixed model matrix)
+    std::vector<Mat4> models(n, Mat4::lookAt(Vec3(1.0f, 2.0f, 3.0f), Vec3(4.0f, 0.0f, -2.0f), Vec3(0.0f, 1.0f, 0.0f)));
+    std::vector<Mat4> scalarProducts(n), batchProducts(n);
+    scalarMs = TimeMathKernel([&]()
+    {
+        for (uint32_t i = 0; i < n; ++i)
+            scalarProducts[i] = scalarMats[i] * models[i];
+    });
+    batchMs = TimeMathKernel([&]() { MathBatch_MultiplyMatrices(scalarMats.data(), models.data(), n, batchProducts.data()); });
+    identical = identical && memcmp(scalarProducts.data(), batchProducts.data(), n * sizeof(Mat4)) == 0;
+    float difference = GetMaxRelativeDifference(batchProducts[0].m, scalarProducts[0].m, 16 * (size_t)n, 16);
+    maxDifference = std::max(maxDifference, difference);
+    if (difference > FMA_CONTRACTION_TOLERANCE)
+    {
+        printf("Math bench FAILED: batch matrix products differ from Mat4 by %g\n", difference);
+        return 1;
+    }
+    PrintMathResult("Matrix multiply", scalarMs, batchMs);
+
+    // Points through one matrix (the eyes through the first light's matrix)
+    const Mat4& m = scalarMats[0];
+    std::vector<float> scalarOut(4 * (size_t)n), batchOut(4 * (size_t)n);
+    scalarMs = TimeMathKernel([&]()
+    {
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            for (int r = 0; r < 4; ++r)
+                scalarOut[r * (size_t)n + i] = m.m[r] * eyeX[i] + m.m[4 + r] * eyeY[i] + m.m[8 + r] * eyeZ[i] + m.m[12 + r];
+        }
+    });
+    batchMs = TimeMathKernel([&]()
+    {
+        MathBatch_TransformPoints(m, eyeX.data(), eyeY.data(), eyeZ.data(), n, batchOut.data(), batchOut.data() + n,
+                                  batchOut.data() + 2 * (size_t)n, batchOut.data() + 3 * (size_t)n);
+    });
+    identical = identical && memcmp(scalarOut.data(), batchOut.data(), scalarOut.size() * sizeof(float)) == 0;
+    difference = GetMaxRelativeDifference(batchOut.data(), scalarOut.data(), scalarOut.size(), 1);
+    maxDifference = std::max(maxDifference, difference);
+    if (difference > FMA_CONTRACTION_TOLERANCE)
+    {
+        printf("Math bench FAILED: batch point transform differs from the scalar one by %g\n", difference);
+        return 1;
+    }
+    PrintMathResult("Point transform", scalarMs, batchMs);
+
+    if (identical)
+        printf("Math bench OK (%u elements, %u lanes, bit-identical to Mat4)\n", n, FloatXN::WIDTH);
+    else
+        printf("Math bench OK (%u elements, %u lanes, within %g of Mat4: a * b + c was fused into FMA, "
+               "-ffp-contract=off gives bit-identical results)\n", n, FloatXN::WIDTH, maxDifference);
+    return 0;
+}
+
+// Light matrix the way Scene_FillConeLights built it one light at a time
+static Mat4 GetReferenceLightMatrix(const SceneState* scene, uint32_t lightIndex)
+{
+    Vec3 lightPos = Simulation_GetLightPosition(scene, lightIndex);
+    Vec3 lightDir = Simulation_GetLightDirection(scene, lightIndex);
+    Vec3 target = lightPos + lightDir * scene->headlightRange;
+    Vec3 up = (fabsf(lightDir.y) < 0.99f) ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+    Mat4 view = Mat4::lookAt(lightPos, target, up);
+    Mat4 proj = Mat4::perspective(scene->coneLights[lightIndex].outerAngle * 2.0f, 1.0f, 0.1f, scene->headlightRange);
+    return proj * view;
+}
+
+int Headless_RunLightMatrixBench()
+{
+    static constexpr int FRAME_COUNT = 60;
+    const uint32_t lightCount = g_Scene.numConeLights;
+    std::vector<Mat4> reference(lightCount), mapped(lightCount), copy(lightCount);
+    double scalarMs = 0.0, batchMs = 0.0;
+    bool identical = true;
+    float maxDifference = 0.0f;
+    bool completed = RunTrafficFrames(FRAME_COUNT, [&](int frame)
+    {
+        // Scalar build into the CPU array, then the copy to the upload buffer
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < lightCount; ++i)
+            copy[i] = GetReferenceLightMatrix(&g_Scene, i);
+        memcpy(reference.data(), copy.data(), lightCount * sizeof(Mat4));
+        scalarMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        Scene_FillLightMatrices(&g_Scene, mapped.data(), copy.data());
+        batchMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Same values (zeros may differ in sign: skipped terms), or close
+        // when the compiler fused a * b + c into FMA
+        for (uint32_t i = 0; i < lightCount; ++i)
+        {
+            for (int e = 0; e < 16; ++e)
+                identical = identical && mapped[i].m[e] == reference[i].m[e] && copy[i].m[e] == reference[i].m[e];
+            float difference = std::max(GetMaxRelativeDifference(mapped[i].m, reference[i].m, 16, 16),
+                                        GetMaxRelativeDifference(copy[i].m, reference[i].m, 16, 16));
+            maxDifference = std::max(maxDifference, difference);
+            if (difference > FMA_CONTRACTION_TOLERANCE)
+            {
+                printf("Light matrix bench FAILED at frame %d: light %u differs from the per-light build by %g\n",
+                       frame, i, difference);
+                return false;
+            }
+        }
+        return true;
+    });
+    if (!completed)
+        return 1;
+
+    printf("%u lights: scalar + copy %.3f ms, batched %.3f ms per frame (%.2fx, %u lanes)\n", lightCount,
+           scalarMs / FRAME_COUNT, batchMs / FRAME_COUNT, scalarMs / batchMs, FloatXN::WIDTH);
+    if (identical)
+        printf("Light matrix bench OK (matches the per-light build)\n");
+    else
+        printf("Light matrix bench OK (within %g of the per-light build: a * b + c was fused into FMA, "
+               "-ffp-contract=off gives equal results)\n", maxDifference);
+    return 0;
+}
+
+// Size of a file in bytes, 0 if it cannot be opened
+uint64_t Headless_GetFileSize(const char* path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return file.is_open() ? (uint64_t)file.tellg() : 0;
+}
+
+// Random mesh size of -check-ply's round trip
+static constexpr uint32_t PLY_CHECK_VERTICES = 10000;
+static constexpr uint32_t PLY_CHECK_TRIANGLES = 20000;
+
+// Sidecar path ExportToPBRT uses for pbrtPath
+std::string Headless_GetSidecarPath(const std::string& pbrtPath, const char* suffix)
+{
+    return pbrtPath.substr(0, pbrtPath.rfind('.')) + suffix;
+}
+
+int Headless_RunPlyCheck(const std::string& configFile)
+{
+    std::string base = configFile.substr(0, configFile.rfind('.'));
+
+    // Round trip of arbitrary bits (signed zeros, denormals, infinities)
+    uint32_t random = 12345;
+    auto next = [&random]() { random = random * 1664525u + 1013904223u; return random; };
+    PlyMesh mesh;
+    for (uint32_t i = 0; i < PLY_CHECK_VERTICES * 3; ++i)
+    {
+        uint32_t bits = next();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        mesh.positions.push_back(std::isnan(value) ? -0.0f : value);
+    }
+    for (uint32_t i = 0; i < PLY_CHECK_TRIANGLES * 3; ++i)
+        mesh.indices.push_back((next() >> 8) % PLY_CHECK_VERTICES);
+
+    std::string path = base + "_check.ply";
+    PlyMesh readBack;
+    if (!PlyMesh_Write(path.c_str(), mesh) || !PlyMesh_Read(path.c_str(), &readBack) ||
+        readBack.positions.size() != mesh.positions.size() || readBack.indices != mesh.indices ||
+        memcmp(readBack.positions.data(), mesh.positions.data(), mesh.positions.size() * sizeof(float)) != 0)
+    {
+        printf("PLY check FAILED: random mesh does not round-trip\n");
+        return 1;
+    }
+
+    // A truncated file is rejected
+    uint64_t size = Headless_GetFileSize(path.c_str());
+    std::vector<char> bytes(size);
+    std::ifstream(path, std::ios::binary).read(bytes.data(), (std::streamsize)size);
+    std::ofstream(path, std::ios::binary).write(bytes.data(), (std::streamsize)size - 1);
+    if (PlyMesh_Read(path.c_str(), &readBack))
+    {
+        printf("PLY check FAILED: truncated file accepted\n");
+        return 1;
+    }
+    std::remove(path.c_str());
+
+    // Exported car boxes: every PLY corner is a corner of the expanded box of
+    // the same car (X negated into PBRT space)
+    Simulation_AdvanceSteps(&g_Scene, TEST_FRAME_WAIT);
+    Scene_WriteCarVertices(&g_Scene, g_Vertices.data() + SCENE_GROUND_VERTEX_COUNT);
+    for (int instanced = 0; instanced < 2; ++instanced)
+    {
+        PbrtExportOptions options;
+        options.instanceCars = (instanced == 1);
+        options.plyGeometry = true;
+        std::string pbrtPath = base + "_check.pbrt";
+        std::string groundPath = Headless_GetSidecarPath(pbrtPath, "_ground.ply");
+        std::string carsPath = Headless_GetSidecarPath(pbrtPath, "_cars.ply");
+        PlyMesh ground, cars;
+        if (!ExportToPBRT(g_Scene, pbrtPath.c_str(), options) || !PlyMesh_Read(groundPath.c_str(), &ground) ||
+            !PlyMesh_Read(carsPath.c_str(), &cars))
+        {
+            printf("PLY check FAILED: export or sidecar read failed\n");
+            return 1;
+        }
+        std::remove(pbrtPath.c_str());
+        std::remove(groundPath.c_str());
+        std::remove(carsPath.c_str());
+
+        uint32_t boxCount = instanced ? 1 : g_Scene.numCars;
+        if (ground.indices.size() != 6 || cars.positions.size() != (size_t)boxCount * 8 * 3 ||
+            cars.indices.size() != (size_t)boxCount * 36)
+        {
+            printf("PLY check FAILED: unexpected sidecar sizes\n");
+            return 1;
+        }
+        if (instanced)
+            continue;
+
+        float maxError = 0.0f;
+        for (uint32_t c = 0; c < g_Scene.numCars; ++c)
+        {
+            const Vertex* box = g_Vertices.data() + SCENE_GROUND_VERTEX_COUNT + (size_t)c * VERTS_PER_BOX;
+            for (uint32_t k = 0; k < 8; ++k)
+            {
+                const float* p = &cars.positions[((size_t)c * 8 + k) * 3];
+                float best = FLT_MAX;
+                for (uint32_t v = 0; v < VERTS_PER_BOX; ++v)
+                {
+                    float error = std::max({ fabsf(p[0] + box[v].position[0]), fabsf(p[1] - box[v].position[1]),
+                                             fabsf(p[2] - box[v].position[2]) });
+                    best = std::min(best, error);
+                }
+                maxError = std::max(maxError, best);
+            }
+        }
+        if (maxError > INSTANCE_CHECK_EPSILON * 100.0f)
+        {
+            printf("PLY check FAILED: car corners off by %g\n", maxError);
+            return 1;
+        }
+        printf("%u pre-transformed cars, max corner error %g\n", g_Scene.numCars, maxError);
+    }
+
+    printf("PLY check OK\n");
+    return 0;
+}
+
+// Exports per -bench-export mode; the fastest run counts
+static constexpr int EXPORT_BENCH_RUNS = 5;
+
+int Headless_RunExportBench(const std::string& configFile)
+{
+    Simulation_AdvanceSteps(&g_Scene, TEST_FRAME_WAIT);
+
+    std::string base = configFile.substr(0, configFile.rfind('.'));
+    const char* modeNames[4] = { "inline", "instanced", "ply", "ply-inst" };
+    for (int mode = 0; mode < 4; ++mode)
+    {
+        PbrtExportOptions options;
+        options.instanceCars = (mode & 1) != 0;
+        options.plyGeometry = (mode & 2) != 0;
+        std::string path = base + "_bench_" + modeNames[mode] + ".pbrt";
+
+        double bestMs = 0.0;
+        for (int run = 0; run < EXPORT_BENCH_RUNS; ++run)
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (!ExportToPBRT(g_Scene, path.c_str(), options))
+            {
+                printf("ERROR: Failed to export %s\n", path.c_str());
+                return 1;
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            bestMs = (run == 0) ? ms : std::min(bestMs, ms);
+        }
+
+        // Scene file plus sidecars
+        uint64_t bytes = Headless_GetFileSize(path.c_str());
+        std::remove(path.c_str());
+        for (const char* suffix : { "_ground.ply", "_cars.ply" })
+        {
+            std::string sidecar = Headless_GetSidecarPath(path, suffix);
+            bytes += Headless_GetFileSize(sidecar.c_str());
+            std::remove(sidecar.c_str());
+        }
+        printf("%-9s %8.2f ms, %10llu bytes (%u cars, %u lights)\n", modeNames[mode], bestMs, (unsigned long long)bytes,
+               g_Scene.numCars, Scene_GetActiveLightCount(&g_Scene));
+    }
+    return 0;
+}
+
+int Headless_RunCullingBench()
+{
+    static constexpr int FRAME_COUNT = 60;
+    std::vector<ConeLightGPU> lights(g_Scene.numConeLights);
+    std::vector<Mat4> lightMatrices(g_Scene.numConeLights);
+    ShadowAtlas atlas;
+    ShadowCasterLists casters;
+    uint64_t tested = 0, visible = 0, draws = 0, redrawn = 0;
+    double cullMs = 0.0;
+    bool completed = RunTrafficFrames(FRAME_COUNT, [&](int frame)
+    {
+        Scene_FillConeLights(&g_Scene, lights.data(), lightMatrices.data());
+        ShadowAtlas_Build(&g_Scene, OUTPUT_WIDTH, OUTPUT_HEIGHT, &atlas);
+
+        auto start = std::chrono::steady_clock::now();
+        ShadowCulling_Build(&g_Scene, lightMatrices.data(), &atlas, &casters);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Every culled car must be outside the light's frustum: its box
+        // vertices are all clipped by one plane (the same test per vertex)
+        if (frame == 0)
+        {
+            Scene_WriteCarVertices(&g_Scene, g_Vertices.data() + SCENE_GROUND_VERTEX_COUNT);
+            for (uint32_t i = 0; i < (uint32_t)atlas.tiles.size(); ++i)
+            {
+                if (atlas.tiles[i].size == 0)
+                    continue;
+                ShadowFrustum frustum;
+                ShadowCulling_GetFrustum(lightMatrices[i], &frustum);
+                std::vector<uint8_t> listed(g_Scene.numCars, 0);
+                const ShadowCasterRange& range = casters.ranges[i];
+                for (uint32_t r = range.offset; r < range.offset + range.count; ++r)
+                    for (uint32_t c = 0; c < casters.runs[r].carCount; ++c)
+                        listed[casters.runs[r].firstCar + c] = 1;
+                for (uint32_t c = 0; c < g_Scene.numCars; ++c)
+                {
+                    const Vertex* box = g_Vertices.data() + SCENE_GROUND_VERTEX_COUNT + (size_t)c * VERTS_PER_BOX;
+                    bool anyInside = false;
+                    for (uint32_t v = 0; v < VERTS_PER_BOX && !anyInside; ++v)
+                    {
+                        Vec3 p(box[v].position[0], box[v].position[1], box[v].position[2]);
+                        anyInside = ShadowCulling_IsBoxVisible(frustum, p, Vec3(0.0f, 0.0f, 0.0f));
+                    }
+                    if (anyInside && !listed[c])
+                    {
+                        printf("ERROR: light %u culled car %u, which has a vertex inside its frustum\n", i, c);
+                        return false;
+                    }
+                }
+            }
+        }
+
+        cullMs += ms;
+        tested += casters.testedCasters;
+        visible += casters.visibleCasters;
+        draws += casters.runs.size();
+        redrawn += casters.redrawnTiles;
+        if (frame % 10 == 0)
+        {
+            printf("Frame %d: %u lights with a tile (%u redrawn), %llu / %llu casters drawn (%.1f%% culled), %zu draws, %.3f ms\n",
+                   frame, atlas.tileCount, casters.redrawnTiles, (unsigned long long)casters.visibleCasters,
+                   (unsigned long long)casters.testedCasters,
+                   100.0 * (1.0 - (double)casters.visibleCasters / (double)std::max<uint64_t>(casters.testedCasters, 1)),
+                   casters.runs.size(), ms);
+        }
+        return true;
+    });
+    if (!completed)
+        return 1;
+
+    // Same state again: every tile is reused
+    static constexpr int STATIC_FRAMES = 3;
+    uint32_t staticRedrawn = 0;
+    for (int frame = 0; frame < STATIC_FRAMES; ++frame)
+    {
+        Scene_FillConeLights(&g_Scene, lights.data(), lightMatrices.data());
+        ShadowAtlas_Build(&g_Scene, OUTPUT_WIDTH, OUTPUT_HEIGHT, &atlas);
+        ShadowCulling_Build(&g_Scene, lightMatrices.data(), &atlas, &casters);
+        staticRedrawn += casters.redrawnTiles;
+    }
+
+    printf("Per frame: %.1f / %.1f casters drawn (%.1f%% culled), %.1f draws, %llu vs. %llu triangles, %.1f tiles redrawn, "
+           "%.3f ms culling (%u threads)\n",
+           (double)visible / FRAME_COUNT, (double)tested / FRAME_COUNT,
+           100.0 * (1.0 - (double)visible / (double)std::max<uint64_t>(tested, 1)), (double)draws / FRAME_COUNT,
+           (unsigned long long)(visible * (INDICES_PER_BOX / 3) / FRAME_COUNT),
+           (unsigned long long)(tested * (INDICES_PER_BOX / 3) / FRAME_COUNT), (double)redrawn / FRAME_COUNT,
+           cullMs / FRAME_COUNT, Parallel_GetThreadCount());
+    printf("Static frames: %u tiles redrawn in %d frames\n", staticRedrawn, STATIC_FRAMES);
+    if (staticRedrawn > 0)
+    {
+        printf("ERROR: static frames redrew shadow tiles\n");
+        return 1;
+    }
+    return 0;
+}
+
+// One tracer over the slice of every shadowed light; returns the time in ms
+template <typename TraceFn>
+static double TraceSlices(const std::vector<HorizonSliceKey>& keys, std::vector<std::vector<float>>& slices,
+                          uint64_t& stepCount, TraceFn trace)
+{
+    std::vector<std::pair<uint32_t, int>> rows;
+    slices.resize(keys.size());
+    for (uint32_t i = 0; i < (uint32_t)keys.size(); ++i)
+    {
+        slices[i].resize((size_t)keys[i].width * keys[i].height);
+        for (int row = 0; row < keys[i].height; ++row)
+            rows.push_back(std::make_pair(i, row));
+    }
+
+    std::atomic<uint64_t> steps(0);
+    auto start = std::chrono::steady_clock::now();
+    ParallelFor((uint32_t)rows.size(), [&](uint32_t r)
+    {
+        const HorizonSliceKey& key = keys[rows[r].first];
+        float* dst = slices[rows[r].first].data() + (size_t)rows[r].second * key.width;
+        uint64_t rowSteps = 0;
+        for (int x = 0; x < key.width; ++x)
+        {
+            uint32_t texelSteps;
+            dst[x] = trace(key, key.x0 + x, key.y0 + rows[r].second, &texelSteps);
+            rowSteps += texelSteps;
+        }
+        steps += rowSteps;
+    });
+    stepCount = steps.load();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int Headless_RunHorizonBench()
+{
+    Simulation_AdvanceSteps(&g_Scene, TEST_FRAME_WAIT);
+    Scene_WriteCarVertices(&g_Scene, g_Vertices.data() + SCENE_GROUND_VERTEX_COUNT);
+
+    std::vector<float> heightMap;
+    Software_RenderHeightMap(&g_Scene, g_Vertices, g_Indices, heightMap);
+    HorizonMapParams params = Horizon_GetMapParams(&g_Scene);
+
+    auto start = std::chrono::steady_clock::now();
+    HorizonDepthPyramid pyramid;
+    Horizon_BuildPyramid(heightMap.data(), params.mapSize, &pyramid);
+    double pyramidMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t shadowedCount = Scene_GetShadowedLightCount(&g_Scene);
+    std::vector<HorizonSliceKey> keys(shadowedCount);
+    uint64_t texelCount = 0;
+    for (uint32_t i = 0; i < shadowedCount; ++i)
+    {
+        Vec3 lightPos = Simulation_GetLightPosition(&g_Scene, i);
+        keys[i] = Horizon_GetSliceKey(params, lightPos.x, lightPos.z, g_Scene.headlightRange);
+        texelCount += (uint64_t)keys[i].width * keys[i].height;
+    }
+
+    std::vector<std::vector<float>> linear, hierarchical;
+    uint64_t linearSteps, hierarchicalSteps;
+    double linearMs = TraceSlices(keys, linear, linearSteps,
+        [&](const HorizonSliceKey& key, int tx, int ty, uint32_t* steps)
+        {
+            return Horizon_TraceTexel(heightMap.data(), params, key.lightX, key.lightZ, tx, ty, steps);
+        });
+    double hierarchicalMs = TraceSlices(keys, hierarchical, hierarchicalSteps,
+        [&](const HorizonSliceKey& key, int tx, int ty, uint32_t* steps)
+        {
+            return Horizon_TraceTexelHierarchical(pyramid, params, key.lightX, key.lightZ, tx, ty, steps);
+        });
+
+    printf("%u lights, %llu texels, %d pyramid levels built in %.2f ms\n",
+           shadowedCount, (unsigned long long)texelCount, pyramid.levelCount, pyramidMs);
+    printf("Linear:       %.1f ms, %llu steps (%.1f per texel)\n",
+           linearMs, (unsigned long long)linearSteps, (double)linearSteps / (double)std::max<uint64_t>(texelCount, 1));
+    printf("Hierarchical: %.1f ms, %llu steps (%.1f per texel, %.1f%% of linear)\n",
+           hierarchicalMs, (unsigned long long)hierarchicalSteps,
+           (double)hierarchicalSteps / (double)std::max<uint64_t>(texelCount, 1),
+           100.0 * (double)hierarchicalSteps / (double)std::max<uint64_t>(linearSteps, 1));
+
+    for (uint32_t i = 0; i < shadowedCount; ++i)
+    {
+        for (size_t t = 0; t < linear[i].size(); ++t)
+        {
+            if (memcmp(&linear[i][t], &hierarchical[i][t], sizeof(float)) != 0)
+            {
+                int tx = keys[i].x0 + (int)(t % keys[i].width);
+                int ty = keys[i].y0 + (int)(t / keys[i].width);
+                printf("ERROR: light %u texel (%d, %d): hierarchical %.9g, linear %.9g\n",
+                       i, tx, ty, hierarchical[i][t], linear[i][t]);
+                return 1;
+            }
+        }
+    }
+
+    printf("Hierarchical trace matches the linear march\n");
+
+    // Same slices with the SIMD march, one row per work item
+    std::vector<std::vector<float>> simd(shadowedCount);
+    std::vector<std::pair<uint32_t, int>> rows;
+    for (uint32_t i = 0; i < shadowedCount; ++i)
+    {
+        simd[i].resize((size_t)keys[i].width * keys[i].height);
+        for (int row = 0; row < keys[i].height; ++row)
+            rows.push_back(std::make_pair(i, row));
+    }
+    start = std::chrono::steady_clock::now();
+    ParallelFor((uint32_t)rows.size(), [&](uint32_t r)
+    {
+        const HorizonSliceKey& key = keys[rows[r].first];
+        Horizon_TraceRow(heightMap.data(), params, key.lightX, key.lightZ, key.x0, key.y0 + rows[r].second,
+                         key.width, simd[rows[r].first].data() + (size_t)rows[r].second * key.width);
+    });
+    double simdMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Bit-identical unless a * b + c was fused into FMA, like the math benches
+    bool identical = true;
+    float maxDifference = 0.0f;
+    for (uint32_t i = 0; i < shadowedCount; ++i)
+    {
+        if (memcmp(linear[i].data(), simd[i].data(), linear[i].size() * sizeof(float)) == 0)
+            continue;
+        identical = false;
+        float difference = GetMaxRelativeDifference(simd[i].data(), linear[i].data(), linear[i].size(), 1);
+        maxDifference = std::max(maxDifference, difference);
+        if (!(difference <= FMA_CONTRACTION_TOLERANCE))
+        {
+            printf("ERROR: light %u: SIMD march differs from the linear march by %g\n", i, difference);
+            return 1;
+        }
+    }
+    if (identical)
+        printf("SIMD linear:  %.1f ms, %u lanes, matches the linear march\n", simdMs, FloatXN::WIDTH);
+    else
+        printf("SIMD linear:  %.1f ms, %u lanes, within %g of the linear march (a * b + c was fused into FMA)\n",
+               simdMs, FloatXN::WIDTH, maxDifference);
+
+    // Full maps (the offline / no-GPU case) for up to BENCH_FULL_MAP_LIGHTS
+    // lights at doubling thread counts
+    uint32_t fullMapLights = std::min(shadowedCount, BENCH_FULL_MAP_LIGHTS);
+    uint32_t maxThreads = Parallel_GetThreadCount();
+    std::vector<float> fullMap((size_t)params.mapSize * params.mapSize);
+    double singleThreadRate = 0.0;
+    for (uint32_t threads = 1; fullMapLights > 0; threads = std::min(threads * 2, maxThreads))
+    {
+        Parallel_SetThreadLimit(threads);
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < fullMapLights; ++i)
+            Horizon_TraceMap(heightMap.data(), params, keys[i].lightX, keys[i].lightZ, fullMap.data());
+        double mapMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() /
+                       (double)fullMapLights;
+
+        // Mtexels per second per light
+        double rate = (double)fullMap.size() / (mapMs * 1000.0);
+        if (threads == 1)
+            singleThreadRate = rate;
+        printf("Full map:     %u threads, %.1f ms per light, %.2f Mtexels/s per light (%.2fx)\n",
+               threads, mapMs, rate, rate / singleThreadRate);
+        if (threads == maxThreads)
+            break;
+    }
+    Parallel_SetThreadLimit(0);
+
+    // Angular map: build cost, memory, and how often it agrees with the exact
+    // per-light result on whether a light clears the horizon (nearest
+    // direction, at the angular texel centers)
+    start = std::chrono::steady_clock::now();
+    HorizonAngularMap angular;
+    Horizon_BuildAngular(pyramid, params, g_Scene.headlightRange, &angular);
+    double angularMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const int texelsPerAngular = params.mapSize / HORIZON_ANGULAR_MAP_SIZE;
+    const float metersPerTexel = params.worldSize / (float)params.mapSize;
+    uint64_t compared = 0, agreed = 0;
+    for (uint32_t i = 0; i < shadowedCount; ++i)
+    {
+        Vec3 lightPos = Simulation_GetLightPosition(&g_Scene, i);
+        Vec3 lightDir = Simulation_GetLightDirection(&g_Scene, i);
+        float cosOuter = cosf(g_Scene.coneLights[i].outerAngle);
+        for (int ay = 0; ay < HORIZON_ANGULAR_MAP_SIZE; ++ay)
+        {
+            int ty = ay * texelsPerAngular + texelsPerAngular / 2;
+            if (ty < keys[i].y0 || ty >= keys[i].y0 + keys[i].height)
+                continue;
+            for (int ax = 0; ax < HORIZON_ANGULAR_MAP_SIZE; ++ax)
+            {
+                int tx = ax * texelsPerAngular + texelsPerAngular / 2;
+                if (tx < keys[i].x0 || tx >= keys[i].x0 + keys[i].width)
+                    continue;
+
+                float dx = lightPos.x - (params.worldMinX + (float)tx * metersPerTexel);
+                float dz = lightPos.z - (params.worldMinZ + (float)ty * metersPerTexel);
+                float dist = sqrtf(dx * dx + dz * dz);
+                if (dist > g_Scene.headlightRange || dist < 0.001f)
+                    continue;
+                // Only pairs the light actually reaches (inside the cone)
+                Vec3 toTexel = Vec3(-dx, -lightPos.y, -dz);
+                float cosAngle = dot(toTexel, lightDir) / toTexel.length();
+                if (cosAngle < cosOuter)
+                    continue;
+                float azimuth = atan2f(dz, dx) * (float)HORIZON_ANGLE_COUNT / 6.28318530718f;
+                int direction = ((int)floorf(azimuth + 0.5f) + HORIZON_ANGLE_COUNT) % HORIZON_ANGLE_COUNT;
+
+                float exact = linear[i][(size_t)(ty - keys[i].y0) * keys[i].width + (tx - keys[i].x0)];
+                float approx = Horizon_GetAngularRequiredHeight(angular, ax, ay, direction, dist);
+                compared++;
+                agreed += ((lightPos.y > exact) == (lightPos.y > approx)) ? 1 : 0;
+            }
+        }
+    }
+
+    printf("Angular:      %.1f ms, %d x %d x %d directions, %.1f MB (per-light slices: %.1f MB)\n",
+           angularMs, HORIZON_ANGULAR_MAP_SIZE, HORIZON_ANGULAR_MAP_SIZE, HORIZON_ANGLE_COUNT,
+           (double)angular.data.size() * sizeof(float) / (1024.0 * 1024.0),
+           (double)shadowedCount * params.mapSize * params.mapSize * sizeof(float) / (1024.0 * 1024.0));
+    printf("Angular agrees with the per-light trace on %.2f%% of %llu lit texel / light pairs\n",
+           100.0 * (double)agreed / (double)std::max<uint64_t>(compared, 1), (unsigned long long)compared);
+    return 0;
+}
+
@@ -0,0 +1,43 @@
+#pragma once
+
+// Self-checks and benchmarks of the headless build (-check-*, -bench-*,
+// -soak). headless_main.cpp loads the config into g_Scene and builds the
+// expanded geometry, then runs one of these; each prints "... OK" or
+// "... FAILED" and returns the process exit code.
+
+#include "scene.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Same output size and warm-up as the windowed -test mode
+static constexpr uint32_t OUTPUT_WIDTH = 1280;
+static constexpr uint32_t OUTPUT_HEIGHT = 720;
+static constexpr int TEST_FRAME_WAIT = 30;
+
+// Loaded scene and its expanded geometry (ground plane, then one box per car)
+inline SceneState g_Scene;
+inline std::vector<Vertex> g_Vertices;
+inline std::vector<uint32_t> g_Indices;
+
+// Size of a file in bytes, 0 if it cannot be opened
+uint64_t Headless_GetFileSize(const char* path);
+
+// Path next to an exported .pbrt: "foo.pbrt" + "_cars.ply" -> "foo_cars.ply"
+std::string Headless_GetSidecarPath(const std::string& pbrtPath, const char* suffix);
+
+int Headless_RunSoak(uint64_t steps);
+int Headless_RunCullingCheck();
+int Headless_RunHorizonCheck();
+int Headless_RunAtlasCheck();
+int Headless_RunInstanceCheck();
+int Headless_RunLightPackCheck();
+int Headless_RunConfigCheck();
+int Headless_RunPlyCheck(const std::string& configFile);
+int Headless_RunUploadRingCheck();
+int Headless_RunDebugDrawCheck();
+int Headless_RunMathBench();
+int Headless_RunLightMatrixBench();
+int Headless_RunExportBench(const std::string& configFile);
+int Headless_RunCullingBench();
+int Headless_RunHorizonBench();
@@ -0,0 +1,575 @@
+// Headless entry point: renders a .cfg with the CPU software renderer, no
+// window or GPU required. Used by test_runner.py on non-Windows machines.
+//
+// Build (Linux / macOS):
+//   g++ -std=c++17 -O2 -ffp-contract=off -pthread -o bin/cl3d_headless src/headless_main.cpp src/headless_checks.cpp src/scene.cpp src/scene_io.cpp src/simulation.cpp src/software_renderer.cpp src/light_clusters.cpp src/light_grid.cpp src/horizon.cpp src/shadow_atlas.cpp src/shadow_culling.cpp src/upload_ring.cpp src/debug_draw.cpp src/math_batch.cpp src/light_pack.cpp src/parallel.cpp src/pbrt_export.cpp src/ply_mesh.cpp
+// Add -mavx2 -mfma (AVX2) or -mavx512f (AVX-512) for the wider SIMD kernels.
+// -ffp-contract=off keeps a * b + c from being fused into FMA, so the SIMD
+// kernels match their scalar references bit for bit (simd.h); without it the
+// checks and benches accept and report FMA-sized differences.
+//
+// Usage:
+//   cl3d_headless -test test/foo.cfg       writes foo_test_out.tga to the current directory
+//   cl3d_headless -generate-ref foo.cfg|dir|list.txt [-generate-ref ...] [-sweep 0,1.5,3]
+//                                          exports PBRT references of many configs in parallel (no D3D12): a
+//                                          .cfg, every .cfg of a directory, or one config per line of a list;
+//                                          with -sweep, once per config and simulated time (foo_t1.5.pbrt)
+//   cl3d_headless -soak 1000000 [foo.cfg]  steps the simulation and checks invariants
+//   cl3d_headless -check-culling foo.cfg   checks the light culling modes against brute force
+//   cl3d_headless -check-horizon foo.cfg   checks incremental horizon updates against a full trace
+//   cl3d_headless -check-atlas foo.cfg     checks the shadow atlas packing over moving traffic
+//   cl3d_headless -check-instances foo.cfg checks instanced cars against the expanded boxes, reports upload sizes
+//   cl3d_headless -check-light-pack foo.cfg checks the packed light format's error bounds, reports sizes
+//   cl3d_headless -check-ply foo.cfg       checks PLY round trips and the exported PLY car boxes
+//   cl3d_headless -check-config foo.cfg    checks the config round trip and error reports, times loading
+//   cl3d_headless -check-upload-ring       checks the per-frame upload allocator with frames in flight
+//   cl3d_headless -check-debug-draw foo.cfg checks the debug draw stream from many threads and on overflow
+//   cl3d_headless -bench-culling foo.cfg   times per-light shadow caster culling, reports culled / total casters
+//                                          and the tiles redrawn in moving and static frames
+//   cl3d_headless -bench-horizon foo.cfg   times the horizon tracers (linear, hierarchical, SIMD, full maps
+//                                          per thread count) and the angular map
+//   cl3d_headless -bench-math              times the batch matrix / point kernels against the scalar Mat4 code
+//   cl3d_headless -bench-light-matrices foo.cfg
+//                                          times the batched light matrix build against the per-light one
+//   cl3d_headless -bench-export foo.cfg    times the PBRT export with inline and instanced car boxes, reports
+//                                          file sizes
+//   cl3d_headless -export-anim foo.cfg -frames N [-frame-step 0.033] [-camera-key frame,x,y,z,yaw,pitch ...]
+//                                          writes foo_anim_0000.pbrt... sharing foo_anim_shared.pbrt, the
+//                                          simulation advanced by the frame step, the camera between the keys
+//   -cars N / -lights N                    override the scene size (carCount / lightCount)
+
+#include "headless_checks.h"
+#include "parallel.h"
+#include "pbrt_export.h"
+#include "scene.h"
+#include "scene_io.h"
+#include "simulation.h"
+#include "software_renderer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+static void PrintUsage()
+{
+    printf("Usage: cl3d_headless -test <config.cfg>\n");
+    printf("       cl3d_headless -generate-ref <config.cfg|dir|list.txt> [...] [-sweep <seconds,...>]\n");
+    printf("       cl3d_headless -soak <steps> [config.cfg]\n");
+    printf("       cl3d_headless -check-culling <config.cfg>\n");
+    printf("       cl3d_headless -check-horizon <config.cfg>\n");
+    printf("       cl3d_headless -check-atlas <config.cfg>\n");
+    printf("       cl3d_headless -check-instances <config.cfg>\n");
+    printf("       cl3d_headless -check-light-pack <config.cfg>\n");
+    printf("       cl3d_headless -check-ply <config.cfg>\n");
+    printf("       cl3d_headless -check-config <config.cfg>\n");
+    printf("       cl3d_headless -check-upload-ring\n");
+    printf("       cl3d_headless -check-debug-draw <config.cfg>\n");
+    printf("       cl3d_headless -bench-culling <config.cfg>\n");
+    printf("       cl3d_headless -bench-horizon <config.cfg>\n");
+    printf("       cl3d_headless -bench-math\n");
+    printf("       cl3d_headless -bench-light-matrices <config.cfg>\n");
+    printf("       cl3d_headless -bench-export <config.cfg>\n");
+    printf("       cl3d_headless -export-anim <config.cfg> -frames <count> [-frame-step <seconds>]\n");
+    printf("                     [-camera-key <frame,x,y,z,yaw,pitch> ...]\n");
+    printf("Options: -cars <count> -lights <count>\n");
+}
+
+// One -generate-ref export: a config at one point of its time sweep
+struct ReferenceJob
+{
+    std::string configFile;
+    std::string outputFile;
+    float time = -1.0f;         // Seconds simulated after loading, < 0 = none
+    bool ok = false;
+    std::string errors;         // Config errors, printed after the parallel run
+};
+
+// Adds the configs path names: a .cfg, every .cfg of a directory, or a list
+// file with one config per line (relative to the list)
+static bool CollectConfigs(const std::string& path, std::vector<std::string>& configs)
+{
+    namespace fs = std::filesystem;
+    std::error_code error;
+    if (fs::is_directory(path, error))
+    {
+        std::vector<std::string> found;
+        for (const fs::directory_entry& entry : fs::directory_iterator(path, error))
+        {
+            if (entry.is_regular_file(error) && entry.path().extension() == ".cfg")
+                found.push_back(entry.path().string());
+        }
+        std::sort(found.begin(), found.end());
+        configs.insert(configs.end(), found.begin(), found.end());
+        return !error;
+    }
+    if (fs::path(path).extension() == ".cfg")
+    {
+        configs.push_back(path);
+        return true;
+    }
+
+    std::ifstream list(path);
+    if (!list.is_open())
+        return false;
+    fs::path listDir = fs::path(path).parent_path();
+    std::string line;
+    while (std::getline(list, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+        fs::path config(line);
+        configs.push_back(config.is_absolute() ? line : (listDir / config).string());
+    }
+    return true;
+}
+
+// config.cfg -> config.pbrt (same as cl3d -generate-ref), config_t<time>.pbrt in a sweep
+static std::string GetReferenceOutputPath(const std::string& configFile, float time)
+{
+    std::string result = configFile.substr(0, configFile.rfind('.'));
+    if (time >= 0.0f)
+    {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "_t%g", time);
+        result += suffix;
+    }
+    return result + ".pbrt";
+}
+
+// Loads job's config into a fresh scene (no geometry, no renderer) and exports it
+static bool ExportReference(ReferenceJob& job, uint32_t carCount, uint32_t lightCount)
+{
+    std::unique_ptr<SceneState> scene = std::make_unique<SceneState>();
+    if (carCount > 0) scene->carCount = carCount;
+    if (lightCount > 0) scene->lightCount = lightCount;
+    if (!LoadStateFromFile(*scene, job.configFile.c_str(), &job.errors))
+        return false;
+
+    // Command line wins over carCount / lightCount from the config
+    if (carCount > 0) scene->carCount = carCount;
+    if (lightCount > 0) scene->lightCount = lightCount;
+    if (Simulation_NeedsInit(scene.get()))
+        Simulation_Init(scene.get());
+    if (job.time > 0.0f)
+        Simulation_AdvanceSteps(scene.get(), (uint64_t)llroundf(job.time / SIMULATION_STEP));
+
+    return ExportToPBRT(*scene, job.outputFile.c_str());
+}
+
+static int RunGenerateReferences(const std::vector<std::string>& paths, const std::vector<float>& sweep,
+                                 uint32_t carCount, uint32_t lightCount)
+{
+    std::vector<std::string> configs;
+    for (const std::string& path : paths)
+    {
+        if (!CollectConfigs(path, configs))
+        {
+            printf("ERROR: Failed to read %s\n", path.c_str());
+            return 1;
+        }
+    }
+
+    // Every config at every sweep time, or once as loaded
+    std::vector<ReferenceJob> jobs;
+    for (const std::string& config : configs)
+    {
+        for (size_t t = 0; t < std::max<size_t>(sweep.size(), 1); ++t)
+        {
+            ReferenceJob job;
+            job.configFile = config;
+            job.time = sweep.empty() ? -1.0f : sweep[t];
+            job.outputFile = GetReferenceOutputPath(config, job.time);
+            jobs.push_back(job);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ParallelFor((uint32_t)jobs.size(), [&](uint32_t i) { jobs[i].ok = ExportReference(jobs[i], carCount, lightCount); });
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t failed = 0;
+    for (const ReferenceJob& job : jobs)
+    {
+        if (job.ok)
+        {
+            printf("Exported PBRT scene to: %s\n", job.outputFile.c_str());
+        }
+        else
+        {
+            printf("%sERROR: Failed to export %s\n", job.errors.c_str(), job.configFile.c_str());
+            failed++;
+        }
+    }
+    printf("Exported %zu scenes from %zu configs in %.1f ms on %u threads\n", jobs.size() - failed, configs.size(), ms,
+           std::min(Parallel_GetThreadCount(), (uint32_t)std::max<size_t>(jobs.size(), 1)));
+    return (failed > 0 || jobs.empty()) ? 1 : 0;
+}
+
+static int RunTest(const std::string& testConfigFile)
+{
+    // Run the same number of simulation steps the windowed test waits for
+    Simulation_AdvanceSteps(&g_Scene, TEST_FRAME_WAIT);
+    Scene_WriteCarVertices(&g_Scene, g_Vertices.data() + SCENE_GROUND_VERTEX_COUNT);
+
+    std::vector<uint8_t> pixels((size_t)OUTPUT_WIDTH * OUTPUT_HEIGHT * 4);
+    Software_Render(&g_Scene, g_Vertices, g_Indices, OUTPUT_WIDTH, OUTPUT_HEIGHT, pixels.data());
+
+    std::string outputFile = GenerateTestOutputFilename(testConfigFile);
+    if (!WriteTGA(outputFile.c_str(), OUTPUT_WIDTH, OUTPUT_HEIGHT, pixels.data()))
+    {
+        printf("ERROR: Failed to write %s\n", outputFile.c_str());
+        return 1;
+    }
+
+    printf("Wrote %s\n", outputFile.c_str());
+    return 0;
+}
+
+// Frames of the loaded scene around one shared include, compared with the
+// size of a full scene file
+static int RunAnimationExport(const std::string& configFile, const PbrtAnimationOptions& animation)
+{
+    std::string path = configFile.substr(0, configFile.rfind('.')) + "_anim.pbrt";
+
+    auto start = std::chrono::steady_clock::now();
+    if (!ExportAnimationToPBRT(&g_Scene, path.c_str(), animation))
+    {
+        printf("ERROR: Failed to export %s\n", path.c_str());
+        return 1;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t sharedBytes = Headless_GetFileSize(Headless_GetSidecarPath(path, "_shared.pbrt").c_str());
+    for (const char* suffix : { "_ground.ply", "_cars.ply" })
+        sharedBytes += Headless_GetFileSize(Headless_GetSidecarPath(path, suffix).c_str());
+    uint64_t frameBytes = 0;
+    for (uint32_t frame = 0; frame < animation.frameCount; ++frame)
+    {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "_%04u.pbrt", frame);
+        frameBytes += Headless_GetFileSize(Headless_GetSidecarPath(path, suffix).c_str());
+    }
+
+    // Same options as the frames, written as one file
+    PbrtExportOptions fullOptions = animation.exportOptions;
+    fullOptions.instanceCars = true;
+    std::string fullPath = Headless_GetSidecarPath(path, "_full.pbrt");
+    if (!ExportToPBRT(g_Scene, fullPath.c_str(), fullOptions))
+    {
+        printf("ERROR: Failed to export %s\n", fullPath.c_str());
+        return 1;
+    }
+    uint64_t fullBytes = Headless_GetFileSize(fullPath.c_str());
+    std::remove(fullPath.c_str());
+    for (const char* suffix : { "_ground.ply", "_cars.ply" })
+        std::remove(Headless_GetSidecarPath(fullPath, suffix).c_str());
+
+    uint32_t frames = std::max(animation.frameCount, 1u);
+    printf("Exported %u frames to %s in %.1f ms (%.2f ms per frame, %u cars, %u lights)\n", animation.frameCount,
+           path.c_str(), ms, ms / frames, g_Scene.numCars, Scene_GetActiveLightCount(&g_Scene));
+    printf("shared %llu bytes, %llu bytes per frame (full scene file %llu bytes)\n", (unsigned long long)sharedBytes,
+           (unsigned long long)(frameBytes / frames), (unsigned long long)fullBytes);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::string testConfigFile;
+    std::vector<std::string> referencePaths;
+    std::vector<float> sweepTimes;
+    uint64_t soakSteps = 0;
+    bool checkCulling = false;
+    bool checkHorizon = false;
+    bool checkAtlas = false;
+    bool checkInstances = false;
+    bool checkLightPack = false;
+    std::string checkPlyConfig;
+    bool checkConfig = false;
+    bool checkUploadRing = false;
+    bool checkDebugDraw = false;
+    bool benchCulling = false;
+    bool benchHorizon = false;
+    bool benchMath = false;
+    bool benchLightMatrices = false;
+    std::string benchExportConfig;
+    std::string exportAnimConfig;
+    PbrtAnimationOptions animation;
+    std::vector<std::string> configFiles;
+    uint32_t carCount = 0;
+    uint32_t lightCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+
+        // Check for -test flag
+        if (strcmp(arg, "-test") == 0 && i + 1 < argc)
+        {
+            testConfigFile = argv[i + 1];
+            configFiles.push_back(testConfigFile);
+            i++;  // Skip next argument
+        }
+        // Check for -generate-ref flag (repeatable)
+        else if (strcmp(arg, "-generate-ref") == 0 && i + 1 < argc)
+        {
+            referencePaths.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Simulation times for -generate-ref, comma separated
+        else if (strcmp(arg, "-sweep") == 0 && i + 1 < argc)
+        {
+            for (const char* p = argv[i + 1]; *p; )
+            {
+                char* end;
+                sweepTimes.push_back(strtof(p, &end));
+                p = (*end == ',') ? end + 1 : end + strlen(end);
+            }
+            i++;  // Skip next argument
+        }
+        // Check for -soak flag
+        else if (strcmp(arg, "-soak") == 0 && i + 1 < argc)
+        {
+            soakSteps = strtoull(argv[i + 1], nullptr, 10);
+            i++;  // Skip next argument
+        }
+        // Check for -check-culling flag
+        else if (strcmp(arg, "-check-culling") == 0 && i + 1 < argc)
+        {
+            checkCulling = true;
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -check-horizon flag
+        else if (strcmp(arg, "-check-horizon") == 0 && i + 1 < argc)
+        {
+            checkHorizon = true;
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -check-atlas flag
+        else if (strcmp(arg, "-check-atlas") == 0 && i + 1 < argc)
+        {
+            checkAtlas = true;
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -check-instances flag
+        else if (strcmp(arg, "-check-instances") == 0 && i + 1 < argc)
+        {
+            checkInstances = true;
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -check-light-pack flag
+        else if (strcmp(arg, "-check-light-pack") == 0 && i + 1 < argc)
+        {
+            checkLightPack = true;
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -check-ply flag
+        else if (strcmp(arg, "-check-ply") == 0 && i + 1 < argc)
+        {
+            checkPlyConfig = argv[i + 1];
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -check-upload-ring flag (no config)
+        else if (strcmp(arg, "-check-upload-ring") == 0)
+        {
+            checkUploadRing = true;
+        }
+        else if (strcmp(arg, "-check-config") == 0 && i + 1 < argc)
+        {
+            checkConfig = true;
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -check-debug-draw flag
+        else if (strcmp(arg, "-check-debug-draw") == 0 && i + 1 < argc)
+        {
+            checkDebugDraw = true;
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -bench-culling flag
+        else if (strcmp(arg, "-bench-culling") == 0 && i + 1 < argc)
+        {
+            benchCulling = true;
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -bench-horizon flag
+        else if (strcmp(arg, "-bench-horizon") == 0 && i + 1 < argc)
+        {
+            benchHorizon = true;
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -bench-math flag (no config)
+        else if (strcmp(arg, "-bench-math") == 0)
+        {
+            benchMath = true;
+        }
+        // Check for -bench-light-matrices flag
+        else if (strcmp(arg, "-bench-light-matrices") == 0 && i + 1 < argc)
+        {
+            benchLightMatrices = true;
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Check for -bench-export flag
+        else if (strcmp(arg, "-bench-export") == 0 && i + 1 < argc)
+        {
+            benchExportConfig = argv[i + 1];
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        else if (strcmp(arg, "-export-anim") == 0 && i + 1 < argc)
+        {
+            exportAnimConfig = argv[i + 1];
+            configFiles.push_back(argv[i + 1]);
+            i++;  // Skip next argument
+        }
+        // Animation settings for -export-anim
+        else if (strcmp(arg, "-frames") == 0 && i + 1 < argc)
+        {
+            animation.frameCount = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+            i++;  // Skip next argument
+        }
+        else if (strcmp(arg, "-frame-step") == 0 && i + 1 < argc)
+        {
+            animation.frameStep = strtof(argv[i + 1], nullptr);
+            i++;  // Skip next argument
+        }
+        else if (strcmp(arg, "-camera-key") == 0 && i + 1 < argc)
+        {
+            PbrtCameraKey key;
+            if (sscanf(argv[i + 1], "%u,%f,%f,%f,%f,%f", &key.frame, &key.position.x, &key.position.y, &key.position.z,
+                       &key.yaw, &key.pitch) != 6)
+            {
+                printf("ERROR: Bad camera key %s (frame,x,y,z,yaw,pitch)\n", argv[i + 1]);
+                return 1;
+            }
+            animation.cameraKeys.push_back(key);
+            i++;  // Skip next argument
+        }
+        // Scene size overrides (applied after the configs)
+        else if (strcmp(arg, "-cars") == 0 && i + 1 < argc)
+        {
+            carCount = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+            i++;  // Skip next argument
+        }
+        else if (strcmp(arg, "-lights") == 0 && i + 1 < argc)
+        {
+            lightCount = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+            i++;  // Skip next argument
+        }
+        // Check if it's a .cfg file (loaded on top of the defaults)
+        else
+        {
+            size_t argLen = strlen(arg);
+            if (argLen > 4 && strcmp(arg + argLen - 4, ".cfg") == 0)
+                configFiles.push_back(arg);
+        }
+    }
+
+    if (testConfigFile.empty() && referencePaths.empty() && soakSteps == 0 && !checkCulling && !checkHorizon && !checkAtlas && !checkInstances &&
+        !checkLightPack && checkPlyConfig.empty() && !checkConfig && !checkUploadRing && !checkDebugDraw && !benchCulling && !benchHorizon && !benchMath &&
+        !benchLightMatrices && benchExportConfig.empty() && exportAnimConfig.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // Needs no scene (reference export loads one per config)
+    if (!referencePaths.empty())
+        return RunGenerateReferences(referencePaths, sweepTimes, carCount, lightCount);
+    if (checkUploadRing)
+        return Headless_RunUploadRingCheck();
+    if (benchMath)
+        return Headless_RunMathBench();
+
+    // Size from the command line first so the configs' simulation time applies to it
+    if (carCount > 0) g_Scene.carCount = carCount;
+    if (lightCount > 0) g_Scene.lightCount = lightCount;
+
+    // Geometry first (initializes the cars), then settings, same order as D3D12_Init + command line
+    Scene_BuildGeometry(&g_Scene, g_Vertices, g_Indices);
+
+    for (const std::string& configFile : configFiles)
+    {
+        std::string errors;
+        if (!LoadStateFromFile(g_Scene, configFile.c_str(), &errors))
+        {
+            printf("%sERROR: Failed to load %s\n", errors.c_str(), configFile.c_str());
+            return 1;
+        }
+    }
+
+    // Command line wins over carCount / lightCount from the configs
+    if (carCount > 0) g_Scene.carCount = carCount;
+    if (lightCount > 0) g_Scene.lightCount = lightCount;
+    if (Simulation_NeedsInit(&g_Scene))
+        Simulation_Init(&g_Scene);
+
+    // A config may have changed the car count: rebuild the boxes (keeps the simulation)
+    if (g_Vertices.size() != SCENE_GROUND_VERTEX_COUNT + (size_t)g_Scene.numCars * VERTS_PER_BOX)
+        Scene_BuildGeometry(&g_Scene, g_Vertices, g_Indices);
+
+    if (soakSteps > 0)
+        return Headless_RunSoak(soakSteps);
+
+    if (checkCulling)
+        return Headless_RunCullingCheck();
+
+    if (checkHorizon)
+        return Headless_RunHorizonCheck();
+
+    if (checkAtlas)
+        return Headless_RunAtlasCheck();
+
+    if (checkInstances)
+        return Headless_RunInstanceCheck();
+
+    if (checkLightPack)
+        return Headless_RunLightPackCheck();
+
+    if (!checkPlyConfig.empty())
+        return Headless_RunPlyCheck(checkPlyConfig);
+
+    if (checkConfig)
+        return Headless_RunConfigCheck();
+
+    if (checkDebugDraw)
+        return Headless_RunDebugDrawCheck();
+
+    if (benchCulling)
+        return Headless_RunCullingBench();
+
+    if (benchHorizon)
+        return Headless_RunHorizonBench();
+
+    if (benchLightMatrices)
+        return Headless_RunLightMatrixBench();
+
+    if (!benchExportConfig.empty())
+        return Headless_RunExportBench(benchExportConfig);
+
+    if (!exportAnimConfig.empty())
+    {
+        std::stable_sort(animation.cameraKeys.begin(), animation.cameraKeys.end(),
+                         [](const PbrtCameraKey& a, const PbrtCameraKey& b) { return a.frame < b.frame; });
+        return RunAnimationExport(exportAnimConfig, animation);
+    }
+
+    return RunTest(testConfigFile);
+}
@@ -0,0 +1,924 @@
+#include "horizon.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Changed tiles are grown by this many texels before the ray test, covering
+// rounding in the traced sample positions
+static constexpr float HORIZON_DIRTY_MARGIN = 0.01f;
+
+// A rect of one slice to trace, in slice-relative texels [x0, x1) x [y0, y1)
+struct HorizonWork
+{
+    uint32_t light;
+    int x0, y0, x1, y1;
+};
+
+// Axis-aligned box in texel space
+struct TexelBox
+{
+    float x0, y0, x1, y1;
+};
+
+static bool SameParams(const HorizonMapParams& a, const HorizonMapParams& b)
+{
+    return a.mapSize == b.mapSize && a.worldMinX == b.worldMinX && a.worldMinZ == b.worldMinZ &&
+           a.worldSize == b.worldSize && a.nearPlaneY == b.nearPlaneY && a.farPlaneY == b.farPlaneY;
+}
+
+// Tiles of the height map whose depth values differ from the previous map
+static void FindDirtyTiles(const float* oldMap, const float* newMap, int mapSize, std::vector<TexelBox>& tiles)
+{
+    const int tilesPerSide = (mapSize + HORIZON_DIRTY_TILE_SIZE - 1) / HORIZON_DIRTY_TILE_SIZE;
+
+    std::vector<uint8_t> dirty((size_t)tilesPerSide * tilesPerSide, 0);
+    ParallelFor((uint32_t)tilesPerSide, [&](uint32_t tileY)
+    {
+        int y0 = (int)tileY * HORIZON_DIRTY_TILE_SIZE;
+        int y1 = std::min(y0 + HORIZON_DIRTY_TILE_SIZE, mapSize);
+        for (int tileX = 0; tileX < tilesPerSide; ++tileX)
+        {
+            int x0 = tileX * HORIZON_DIRTY_TILE_SIZE;
+            size_t rowBytes = (size_t)(std::min(x0 + HORIZON_DIRTY_TILE_SIZE, mapSize) - x0) * sizeof(float);
+            for (int y = y0; y < y1; ++y)
+            {
+                size_t offset = (size_t)y * mapSize + x0;
+                if (memcmp(oldMap + offset, newMap + offset, rowBytes) != 0)
+                {
+                    dirty[tileY * tilesPerSide + tileX] = 1;
+                    break;
+                }
+            }
+        }
+    });
+
+    tiles.clear();
+    for (int tileY = 0; tileY < tilesPerSide; ++tileY)
+    {
+        for (int tileX = 0; tileX < tilesPerSide; ++tileX)
+        {
+            if (!dirty[tileY * tilesPerSide + tileX])
+                continue;
+            TexelBox box;
+            box.x0 = (float)(tileX * HORIZON_DIRTY_TILE_SIZE) - HORIZON_DIRTY_MARGIN;
+            box.y0 = (float)(tileY * HORIZON_DIRTY_TILE_SIZE) - HORIZON_DIRTY_MARGIN;
+            box.x1 = (float)std::min((tileX + 1) * HORIZON_DIRTY_TILE_SIZE, mapSize) + HORIZON_DIRTY_MARGIN;
+            box.y1 = (float)std::min((tileY + 1) * HORIZON_DIRTY_TILE_SIZE, mapSize) + HORIZON_DIRTY_MARGIN;
+            tiles.push_back(box);
+        }
+    }
+}
+
+// Whether any ray from a texel center in [x0, x1) x [y0, y1) to the light can
+// sample inside the box. The rays sweep the convex hull of the texel centers
+// and the light; separating axis test of that hull against the box, using the
+// normals of every point pair (a superset of the hull's edges).
+static bool RaysCrossBox(int x0, int y0, int x1, int y1, float lightX, float lightY, const TexelBox& box)
+{
+    const float px[5] = { (float)x0 + 0.5f, (float)x1 - 0.5f, (float)x0 + 0.5f, (float)x1 - 0.5f, lightX };
+    const float py[5] = { (float)y0 + 0.5f, (float)y0 + 0.5f, (float)y1 - 0.5f, (float)y1 - 0.5f, lightY };
+
+    float minX = px[0], maxX = px[0], minY = py[0], maxY = py[0];
+    for (int i = 1; i < 5; ++i)
+    {
+        minX = std::min(minX, px[i]); maxX = std::max(maxX, px[i]);
+        minY = std::min(minY, py[i]); maxY = std::max(maxY, py[i]);
+    }
+    if (maxX < box.x0 || minX > box.x1 || maxY < box.y0 || minY > box.y1)
+        return false;
+
+    const float bx[4] = { box.x0, box.x1, box.x0, box.x1 };
+    const float by[4] = { box.y0, box.y0, box.y1, box.y1 };
+    for (int i = 0; i < 5; ++i)
+    {
+        for (int j = i + 1; j < 5; ++j)
+        {
+            float nx = py[i] - py[j];
+            float ny = px[j] - px[i];
+
+            float hullMin = INFINITY, hullMax = -INFINITY;
+            for (int k = 0; k < 5; ++k)
+            {
+                float d = px[k] * nx + py[k] * ny;
+                hullMin = std::min(hullMin, d); hullMax = std::max(hullMax, d);
+            }
+            float boxMin = INFINITY, boxMax = -INFINITY;
+            for (int k = 0; k < 4; ++k)
+            {
+                float d = bx[k] * nx + by[k] * ny;
+                boxMin = std::min(boxMin, d); boxMax = std::max(boxMax, d);
+            }
+            if (hullMax < boxMin || hullMin > boxMax)
+                return false;
+        }
+    }
+    return true;
+}
+
+HorizonMapParams Horizon_GetMapParams(const SceneState* scene)
+{
+    HorizonMapParams params;
+    params.mapSize = (int)SceneState::HORIZON_MAP_SIZE;
+    params.worldMinX = scene->horizonWorldMin.x;
+    params.worldMinZ = scene->horizonWorldMin.z;
+    params.worldSize = scene->horizonWorldSize;
+    params.nearPlaneY = scene->topDownNearPlaneY;
+    params.farPlaneY = scene->topDownFarPlaneY;
+    return params;
+}
+
+float Horizon_TraceTexel(const float* heightMap, const HorizonMapParams& params, float lightX, float lightZ,
+                         int tx, int ty, uint32_t* stepCount)
+{
+    const int mapSize = params.mapSize;
+    const float worldMinX = params.worldMinX;
+    const float worldMinZ = params.worldMinZ;
+    const float worldSize = params.worldSize;
+
+    float uvX = ((float)tx + 0.5f) / (float)mapSize;
+    float uvY = ((float)ty + 0.5f) / (float)mapSize;
+    float worldX = worldMinX + uvX * worldSize;
+    float worldZ = worldMinZ + uvY * worldSize;
+
+    float toLightX = lightX - worldX;
+    float toLightZ = lightZ - worldZ;
+    float distToLightXZ = sqrtf(toLightX * toLightX + toLightZ * toLightZ);
+    if (stepCount)
+        *stepCount = 0;
+    if (distToLightXZ < 0.001f)
+        return HORIZON_NO_OCCLUSION;
+
+    float dirX = toLightX / distToLightXZ;
+    float dirZ = toLightZ / distToLightXZ;
+
+    float maxRequiredHeight = HORIZON_NO_OCCLUSION;
+    float currentX = (float)tx + 0.5f;
+    float currentY = (float)ty + 0.5f;
+
+    int step = 1;
+    for (; step < mapSize; ++step)
+    {
+        float sampleX = currentX + dirX * (float)step;
+        float sampleY = currentY + dirZ * (float)step;
+
+        if (sampleX < 0.0f || sampleX >= (float)mapSize || sampleY < 0.0f || sampleY >= (float)mapSize)
+            break;
+
+        float sampleWorldX = worldMinX + sampleX / (float)mapSize * worldSize;
+        float sampleWorldZ = worldMinZ + sampleY / (float)mapSize * worldSize;
+        float dx = sampleWorldX - worldX;
+        float dz = sampleWorldZ - worldZ;
+        float sampleDistXZ = sqrtf(dx * dx + dz * dz);
+
+        if (sampleDistXZ > distToLightXZ)
+            break;
+
+        float depthSample = heightMap[(int)sampleY * mapSize + (int)sampleX];
+        float sampleHeight = params.nearPlaneY + depthSample * (params.farPlaneY - params.nearPlaneY);
+
+        if (sampleDistXZ > 0.001f)
+        {
+            float requiredHeight = sampleHeight * distToLightXZ / sampleDistXZ;
+            maxRequiredHeight = std::max(maxRequiredHeight, requiredHeight);
+        }
+    }
+
+    if (stepCount)
+        *stepCount = (uint32_t)(step - 1);
+    return maxRequiredHeight;
+}
+
+// Horizon_TraceTexel for F::WIDTH consecutive texels of a row. Every lane
+// performs the scalar operations in the same order, and a lane stops at the
+// step where the scalar march breaks, so the results match bit for bit.
+template <typename F>
+static void TraceTexels(const float* heightMap, const HorizonMapParams& params, float lightX, float lightZ,
+                        int tx, int ty, float* out)
+{
+    const int mapSize = params.mapSize;
+    constexpr uint32_t WIDTH = F::WIDTH;
+
+    // Per-lane setup, same as Horizon_TraceTexel. Texels at the light get a
+    // zero direction and start out stopped.
+    float laneCurrentX[WIDTH], laneWorldX[WIDTH], laneDirX[WIDTH], laneDirZ[WIDTH], laneDist[WIDTH];
+    float uvY = ((float)ty + 0.5f) / (float)mapSize;
+    float worldZ = params.worldMinZ + uvY * params.worldSize;
+    for (uint32_t i = 0; i < WIDTH; ++i)
+    {
+        float uvX = ((float)(tx + (int)i) + 0.5f) / (float)mapSize;
+        laneCurrentX[i] = (float)(tx + (int)i) + 0.5f;
+        laneWorldX[i] = params.worldMinX + uvX * params.worldSize;
+
+        float toLightX = lightX - laneWorldX[i];
+        float toLightZ = lightZ - worldZ;
+        laneDist[i] = sqrtf(toLightX * toLightX + toLightZ * toLightZ);
+        laneDirX[i] = (laneDist[i] < 0.001f) ? 0.0f : toLightX / laneDist[i];
+        laneDirZ[i] = (laneDist[i] < 0.001f) ? 0.0f : toLightZ / laneDist[i];
+    }
+
+    const F zero = F::Set(0.0f);
+    const F size = F::Set((float)mapSize);
+    const F worldMinX = F::Set(params.worldMinX);
+    const F worldMinZ = F::Set(params.worldMinZ);
+    const F worldSize = F::Set(params.worldSize);
+    const F nearPlaneY = F::Set(params.nearPlaneY);
+    const F heightScale = F::Set(params.farPlaneY - params.nearPlaneY);
+    const F minDist = F::Set(0.001f);
+
+    const F currentX = F::Load(laneCurrentX);
+    const F currentY = F::Set((float)ty + 0.5f);
+    const F texelWorldX = F::Load(laneWorldX);
+    const F texelWorldZ = F::Set(worldZ);
+    const F dirX = F::Load(laneDirX);
+    const F dirZ = F::Load(laneDirZ);
+    const F distToLight = F::Load(laneDist);
+
+    F maxRequiredHeight = F::Set(HORIZON_NO_OCCLUSION);
+    auto active = distToLight >= minDist;
+    for (int step = 1; step < mapSize && Any(active); ++step)
+    {
+        F stepF = F::Set((float)step);
+        F sampleX = currentX + dirX * stepF;
+        F sampleY = currentY + dirZ * stepF;
+
+        F sampleWorldX = worldMinX + sampleX / size * worldSize;
+        F sampleWorldZ = worldMinZ + sampleY / size * worldSize;
+        F dx = sampleWorldX - texelWorldX;
+        F dz = sampleWorldZ - texelWorldZ;
+        F sampleDist = Sqrt(dx * dx + dz * dz);
+
+        active = active & (sampleX >= zero) & (sampleX < size) & (sampleY >= zero) & (sampleY < size) &
+                 (sampleDist <= distToLight);
+        if (!Any(active))
+            break;
+
+        // No gather below AVX2: fetch per lane, stopped lanes read texel 0
+        float laneX[WIDTH], laneY[WIDTH], laneDepth[WIDTH];
+        Select(active, sampleX, zero).Store(laneX);
+        Select(active, sampleY, zero).Store(laneY);
+        for (uint32_t i = 0; i < WIDTH; ++i)
+            laneDepth[i] = heightMap[(int)laneY[i] * mapSize + (int)laneX[i]];
+
+        F sampleHeight = nearPlaneY + F::Load(laneDepth) * heightScale;
+        F requiredHeight = sampleHeight * distToLight / sampleDist;
+
+        // std::max keeps the first argument unless the second is larger
+        auto raises = active & (sampleDist > minDist) & (maxRequiredHeight < requiredHeight);
+        maxRequiredHeight = Select(raises, requiredHeight, maxRequiredHeight);
+    }
+
+    maxRequiredHeight.Store(out);
+}
+
+void Horizon_TraceRow(const float* heightMap, const HorizonMapParams& params, float lightX, float lightZ,
+                      int tx, int ty, int count, float* out)
+{
+    int i = 0;
+    for (; i + (int)FloatXN::WIDTH <= count; i += (int)FloatXN::WIDTH)
+        TraceTexels<FloatXN>(heightMap, params, lightX, lightZ, tx + i, ty, out + i);
+    for (; i < count; ++i)
+        TraceTexels<FloatX1>(heightMap, params, lightX, lightZ, tx + i, ty, out + i);
+}
+
+void Horizon_TraceMap(const float* heightMap, const HorizonMapParams& params, float lightX, float lightZ, float* out)
+{
+    const int mapSize = params.mapSize;
+    const int tilesPerSide = (mapSize + HORIZON_TRACE_TILE_SIZE - 1) / HORIZON_TRACE_TILE_SIZE;
+
+    // Square tiles rather than rows: neighboring rays read the same texels
+    ParallelFor((uint32_t)(tilesPerSide * tilesPerSide), [&](uint32_t tile)
+    {
+        int x0 = (int)(tile % (uint32_t)tilesPerSide) * HORIZON_TRACE_TILE_SIZE;
+        int y0 = (int)(tile / (uint32_t)tilesPerSide) * HORIZON_TRACE_TILE_SIZE;
+        int x1 = std::min(x0 + HORIZON_TRACE_TILE_SIZE, mapSize);
+        int y1 = std::min(y0 + HORIZON_TRACE_TILE_SIZE, mapSize);
+        for (int y = y0; y < y1; ++y)
+            Horizon_TraceRow(heightMap, params, lightX, lightZ, x0, y, x1 - x0, out + (size_t)y * mapSize + x0);
+    });
+}
+
+// Per-texel state of the march in Horizon_TraceTexel. Every position and
+// distance is computed with exactly the same operations, so a given step lands
+// on the same sample in both tracers.
+struct HorizonRay
+{
+    const HorizonMapParams* params;
+    float worldX, worldZ;
+    float currentX, currentY;
+    float dirX, dirZ;
+    float invDirX, invDirZ;     // Only for estimates
+    float distToLight;
+    float texelToUV;            // 1 / mapSize if that division is exact, else 0
+};
+
+static void GetSamplePosition(const HorizonRay& ray, int step, float& sampleX, float& sampleY)
+{
+    sampleX = ray.currentX + ray.dirX * (float)step;
+    sampleY = ray.currentY + ray.dirZ * (float)step;
+}
+
+static float GetSampleDistance(const HorizonRay& ray, float sampleX, float sampleY)
+{
+    const HorizonMapParams& p = *ray.params;
+    float sampleUVX, sampleUVY;
+    if (ray.texelToUV != 0.0f)
+    {
+        sampleUVX = sampleX * ray.texelToUV;
+        sampleUVY = sampleY * ray.texelToUV;
+    }
+    else
+    {
+        sampleUVX = sampleX / (float)p.mapSize;
+        sampleUVY = sampleY / (float)p.mapSize;
+    }
+    float sampleWorldX = p.worldMinX + sampleUVX * p.worldSize;
+    float sampleWorldZ = p.worldMinZ + sampleUVY * p.worldSize;
+    float dx = sampleWorldX - ray.worldX;
+    float dz = sampleWorldZ - ray.worldZ;
+    return sqrtf(dx * dx + dz * dz);
+}
+
+// Whether the linear march still samples at this step (it stops at the first
+// step that leaves the map or passes the light)
+static bool IsStepInRange(const HorizonRay& ray, int step)
+{
+    const int mapSize = ray.params->mapSize;
+    if (step >= mapSize)
+        return false;
+    float sampleX, sampleY;
+    GetSamplePosition(ray, step, sampleX, sampleY);
+    if (sampleX < 0.0f || sampleX >= (float)mapSize || sampleY < 0.0f || sampleY >= (float)mapSize)
+        return false;
+    return GetSampleDistance(ray, sampleX, sampleY) <= ray.distToLight;
+}
+
+// Ray parameter where the line leaves the box [x0, x1) x [y0, y1)
+static float GetExitParameter(const HorizonRay& ray, float x0, float y0, float x1, float y1)
+{
+    float t = INFINITY;
+    if (ray.dirX > 0.0f) t = std::min(t, (x1 - ray.currentX) * ray.invDirX);
+    if (ray.dirX < 0.0f) t = std::min(t, (x0 - ray.currentX) * ray.invDirX);
+    if (ray.dirZ > 0.0f) t = std::min(t, (y1 - ray.currentY) * ray.invDirZ);
+    if (ray.dirZ < 0.0f) t = std::min(t, (y0 - ray.currentY) * ray.invDirZ);
+    return t;
+}
+
+// Sample positions and distances never decrease along the ray (every operation
+// is monotonic), so the steps the linear march takes are 1..lastStep and the
+// steps landing in one cell are a contiguous range. Both ends are estimated
+// from the exact line and then fixed up against the actual sample positions.
+static int FindLastStep(const HorizonRay& ray)
+{
+    const HorizonMapParams& p = *ray.params;
+    float texelsPerMeter = (float)p.mapSize / p.worldSize;
+    float t = std::min(ray.distToLight * texelsPerMeter,
+                       GetExitParameter(ray, 0.0f, 0.0f, (float)p.mapSize, (float)p.mapSize));
+    int step = (int)std::min(std::max(t, 0.0f), (float)(p.mapSize - 1));
+
+    while (IsStepInRange(ray, step + 1))
+        step++;
+    while (step >= 1 && !IsStepInRange(ray, step))
+        step--;
+    return step;
+}
+
+static bool IsStepInCell(const HorizonRay& ray, int step, int level, int cellX, int cellY)
+{
+    float sampleX, sampleY;
+    GetSamplePosition(ray, step, sampleX, sampleY);
+    return ((int)sampleX >> level) == cellX && ((int)sampleY >> level) == cellY;
+}
+
+// Last step (<= lastStep) whose sample is still in the cell that contains 'step'
+static int FindCellExitStep(const HorizonRay& ray, int step, int lastStep, int level, int cellX, int cellY)
+{
+    float cellSize = (float)(1 << level);
+    float t = GetExitParameter(ray, (float)cellX * cellSize, (float)cellY * cellSize,
+                               (float)(cellX + 1) * cellSize, (float)(cellY + 1) * cellSize);
+    int exitStep = (int)std::min(std::max(t, (float)step), (float)lastStep);
+
+    while (exitStep < lastStep && IsStepInCell(ray, exitStep + 1, level, cellX, cellY))
+        exitStep++;
+    while (exitStep > step && !IsStepInCell(ray, exitStep, level, cellX, cellY))
+        exitStep--;
+    return exitStep;
+}
+
+float Horizon_TraceTexelHierarchical(const HorizonDepthPyramid& pyramid, const HorizonMapParams& params,
+                                     float lightX, float lightZ, int tx, int ty, uint32_t* stepCount)
+{
+    const int mapSize = params.mapSize;
+
+    // Same setup as Horizon_TraceTexel
+    HorizonRay ray;
+    ray.params = &params;
+    float uvX = ((float)tx + 0.5f) / (float)mapSize;
+    float uvY = ((float)ty + 0.5f) / (float)mapSize;
+    ray.worldX = params.worldMinX + uvX * params.worldSize;
+    ray.worldZ = params.worldMinZ + uvY * params.worldSize;
+
+    float toLightX = lightX - ray.worldX;
+    float toLightZ = lightZ - ray.worldZ;
+    ray.distToLight = sqrtf(toLightX * toLightX + toLightZ * toLightZ);
+    if (stepCount)
+        *stepCount = 0;
+    if (ray.distToLight < 0.001f)
+        return HORIZON_NO_OCCLUSION;
+
+    ray.dirX = toLightX / ray.distToLight;
+    ray.dirZ = toLightZ / ray.distToLight;
+    ray.currentX = (float)tx + 0.5f;
+    ray.currentY = (float)ty + 0.5f;
+    ray.invDirX = 1.0f / ray.dirX;
+    ray.invDirZ = 1.0f / ray.dirZ;
+    // Dividing by a power of two is exact, so is multiplying by its inverse
+    ray.texelToUV = ((mapSize & (mapSize - 1)) == 0) ? 1.0f / (float)mapSize : 0.0f;
+
+    const float dist = ray.distToLight;
+    const float heightScale = params.farPlaneY - params.nearPlaneY;
+    const int lastStep = FindLastStep(ray);
+
+    float maxRequiredHeight = HORIZON_NO_OCCLUSION;
+    uint32_t steps = 0;
+    int level = 0;
+    int step = 1;
+    while (step <= lastStep)
+    {
+        float sampleX, sampleY;
+        GetSamplePosition(ray, step, sampleX, sampleY);
+        const int texelX = (int)sampleX;
+        const int texelY = (int)sampleY;
+        const float firstDist = GetSampleDistance(ray, sampleX, sampleY);
+
+        // Coarsest cell around this step that can be handled as a whole;
+        // refines down to the texel, where only a sample within 0.001 of the
+        // start (which never counts) is left over
+        int exitStep = step;
+        float lastDist = firstDist;
+        for (;;)
+        {
+            steps++;
+            int cellX = texelX >> level;
+            int cellY = texelY >> level;
+            const float* cell = (level == 0) ? nullptr
+                : &pyramid.levels[level - 1][2 * ((size_t)cellY * (size_t)(mapSize >> level) + cellX)];
+            float minDepth = cell ? cell[0] : pyramid.heightMap[texelY * mapSize + texelX];
+            float maxDepth = cell ? cell[1] : minDepth;
+            float maxHeight = params.nearPlaneY + minDepth * heightScale;
+            float minHeight = params.nearPlaneY + maxDepth * heightScale;
+
+            // Samples in this cell: steps [step, exitStep]. Their distances lie in
+            // [firstDist, lastDist] and their heights in [minHeight, maxHeight],
+            // which bounds height * dist / sampleDist from above.
+            bool flat = (minHeight == maxHeight) && firstDist > 0.001f;
+            bool belowMax = maxHeight >= 0.0f && firstDist > 0.001f &&
+                            maxHeight * dist / firstDist <= maxRequiredHeight;
+            bool refine = maxHeight >= 0.0f && !flat && !belowMax;
+            if (!refine)
+            {
+                exitStep = FindCellExitStep(ray, step, lastStep, level, cellX, cellY);
+                float lastSampleX, lastSampleY;
+                GetSamplePosition(ray, exitStep, lastSampleX, lastSampleY);
+                lastDist = GetSampleDistance(ray, lastSampleX, lastSampleY);
+
+                if (belowMax || lastDist <= 0.001f)
+                {
+                    // Nothing in the cell can raise the maximum
+                }
+                else if (flat)
+                {
+                    // One height: the required height is monotonic along the
+                    // steps, so the first or the last sample holds the maximum
+                    maxRequiredHeight = std::max(maxRequiredHeight, maxHeight * dist / firstDist);
+                    maxRequiredHeight = std::max(maxRequiredHeight, maxHeight * dist / lastDist);
+                }
+                else
+                {
+                    // All heights below zero
+                    refine = maxHeight * dist / lastDist > maxRequiredHeight;
+                }
+            }
+
+            if (!refine)
+            {
+                step = exitStep + 1;
+                if (level + 1 < pyramid.levelCount)
+                    level++;
+                break;
+            }
+            if (level == 0)
+            {
+                step++;
+                break;
+            }
+            level--;
+        }
+    }
+
+    if (stepCount)
+        *stepCount = steps;
+    return maxRequiredHeight;
+}
+
+void Horizon_BuildPyramid(const float* heightMap, int mapSize, HorizonDepthPyramid* pyramid)
+{
+    int levelCount = 1;
+    while ((mapSize >> levelCount) > 0 && ((mapSize >> levelCount) << levelCount) == mapSize)
+        levelCount++;
+
+    pyramid->mapSize = mapSize;
+    pyramid->levelCount = levelCount;
+    pyramid->heightMap = heightMap;
+    pyramid->levels.resize(levelCount - 1);
+
+    for (int level = 1; level < levelCount; ++level)
+    {
+        const int size = mapSize >> level;
+        const int srcSize = size * 2;
+        const float* src = (level == 1) ? heightMap : pyramid->levels[level - 2].data();
+        std::vector<float>& dst = pyramid->levels[level - 1];
+        dst.resize((size_t)size * size * 2);
+
+        ParallelFor((uint32_t)size, [&](uint32_t y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                float minDepth = INFINITY, maxDepth = -INFINITY;
+                for (int j = 0; j < 2; ++j)
+                {
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        size_t srcIndex = (size_t)(2 * y + j) * srcSize + 2 * x + i;
+                        if (level == 1)
+                        {
+                            minDepth = std::min(minDepth, src[srcIndex]);
+                            maxDepth = std::max(maxDepth, src[srcIndex]);
+                        }
+                        else
+                        {
+                            minDepth = std::min(minDepth, src[2 * srcIndex]);
+                            maxDepth = std::max(maxDepth, src[2 * srcIndex + 1]);
+                        }
+                    }
+                }
+                dst[2 * ((size_t)y * size + x)] = minDepth;
+                dst[2 * ((size_t)y * size + x) + 1] = maxDepth;
+            }
+        });
+    }
+}
+
+float Horizon_TraceAngular(const HorizonDepthPyramid& pyramid, const HorizonMapParams& params, float range,
+                           int x, int y, int direction, float* occluderDist)
+{
+    const int mapSize = params.mapSize;
+    const float texelsPerAngular = (float)mapSize / (float)HORIZON_ANGULAR_MAP_SIZE;
+    const float metersPerTexel = params.worldSize / (float)mapSize;
+    const float heightScale = params.farPlaneY - params.nearPlaneY;
+
+    float angle = (float)direction * (6.28318530718f / (float)HORIZON_ANGLE_COUNT);
+    HorizonRay ray = {};
+    ray.params = &params;
+    ray.dirX = cosf(angle);
+    ray.dirZ = sinf(angle);
+    ray.invDirX = 1.0f / ray.dirX;
+    ray.invDirZ = 1.0f / ray.dirZ;
+    ray.currentX = ((float)x + 0.5f) * texelsPerAngular;
+    ray.currentY = ((float)y + 0.5f) * texelsPerAngular;
+
+    // Walk the cells along the line, starting one texel out so the receiver's
+    // own texel does not count. A cell whose max height cannot beat the
+    // tangent at its entry distance is stepped over; texels are sampled at
+    // their entry point, the nearest (steepest) one.
+    const float maxT = range / metersPerTexel;
+    float maxTangent = 0.0f;
+    float maxDist = HORIZON_NO_OCCLUDER;
+    int level = 0;
+    float t = 1.0f;
+    while (t <= maxT)
+    {
+        float sampleX = ray.currentX + ray.dirX * t;
+        float sampleY = ray.currentY + ray.dirZ * t;
+        if (sampleX < 0.0f || sampleX >= (float)mapSize || sampleY < 0.0f || sampleY >= (float)mapSize)
+            break;
+        const int texelX = (int)sampleX;
+        const int texelY = (int)sampleY;
+        const float sampleDist = t * metersPerTexel;
+
+        for (;;)
+        {
+            int cellX = texelX >> level;
+            int cellY = texelY >> level;
+            float minDepth = (level == 0) ? pyramid.heightMap[texelY * mapSize + texelX]
+                : pyramid.levels[level - 1][2 * ((size_t)cellY * (size_t)(mapSize >> level) + cellX)];
+            float maxHeight = params.nearPlaneY + minDepth * heightScale;
+            bool raises = maxHeight > maxTangent * sampleDist;
+            if (raises && level > 0)
+            {
+                level--;
+                continue;
+            }
+            if (raises)
+            {
+                maxTangent = maxHeight / sampleDist;
+                maxDist = sampleDist;
+            }
+
+            // Continue just past the cell; the nudge guarantees progress
+            float cellSize = (float)(1 << level);
+            float exitT = GetExitParameter(ray, (float)cellX * cellSize, (float)cellY * cellSize,
+                                           (float)(cellX + 1) * cellSize, (float)(cellY + 1) * cellSize);
+            t = std::max(exitT, t) + 0.001f;
+            if (level + 1 < pyramid.levelCount)
+                level++;
+            break;
+        }
+    }
+
+    *occluderDist = maxDist;
+    return maxTangent;
+}
+
+void Horizon_BuildAngular(const HorizonDepthPyramid& pyramid, const HorizonMapParams& params, float range,
+                          HorizonAngularMap* map)
+{
+    const int size = HORIZON_ANGULAR_MAP_SIZE;
+    map->valid = true;
+    map->params = params;
+    map->range = range;
+    map->data.resize((size_t)HORIZON_ANGLE_COUNT * size * size * 2);
+
+    // One row of one direction per work item
+    ParallelFor((uint32_t)(HORIZON_ANGLE_COUNT * size), [&](uint32_t row)
+    {
+        int direction = (int)row / size;
+        int y = (int)row % size;
+        float* dst = map->data.data() + (size_t)row * size * 2;
+        for (int x = 0; x < size; ++x)
+            dst[2 * x] = Horizon_TraceAngular(pyramid, params, range, x, y, direction, &dst[2 * x + 1]);
+    });
+}
+
+float Horizon_GetAngularRequiredHeight(const HorizonAngularMap& map, int x, int y, int direction, float distToLight)
+{
+    const int size = HORIZON_ANGULAR_MAP_SIZE;
+    const float* texel = &map.data[(((size_t)direction * size + y) * size + x) * 2];
+    // Without an occluder before the light the ray still passes over the
+    // ground, which the per-light trace counts as well
+    return (texel[1] <= distToLight) ? texel[0] * distToLight : 0.0f;
+}
+
+HorizonSliceKey Horizon_GetSliceKey(const HorizonMapParams& params, float lightX, float lightZ, float range)
+{
+    const int mapSize = params.mapSize;
+    const float texelsPerMeter = (float)mapSize / params.worldSize;
+
+    float centerX = (lightX - params.worldMinX) * texelsPerMeter;
+    float centerY = (lightZ - params.worldMinZ) * texelsPerMeter;
+    float radius = range * texelsPerMeter + 2.0f;
+
+    int x0 = std::max(0, (int)floorf(centerX - radius));
+    int y0 = std::max(0, (int)floorf(centerY - radius));
+    int x1 = std::min(mapSize - 1, (int)ceilf(centerX + radius));
+    int y1 = std::min(mapSize - 1, (int)ceilf(centerY + radius));
+
+    HorizonSliceKey key;
+    key.valid = true;
+    key.lightX = lightX;
+    key.lightZ = lightZ;
+    key.x0 = x0;
+    key.y0 = y0;
+    key.width = std::max(0, x1 - x0 + 1);
+    key.height = std::max(0, y1 - y0 + 1);
+    return key;
+}
+
+HorizonSliceUpdate Horizon_PlanSliceUpdate(const HorizonSliceKey& traced, const HorizonSliceKey& wanted,
+                                           bool heightMapChanged)
+{
+    if (!traced.valid || traced.lightX != wanted.lightX || traced.lightZ != wanted.lightZ ||
+        traced.x0 != wanted.x0 || traced.y0 != wanted.y0 ||
+        traced.width != wanted.width || traced.height != wanted.height)
+        return HORIZON_UPDATE_FULL;
+    return heightMapChanged ? HORIZON_UPDATE_PARTIAL : HORIZON_UPDATE_NONE;
+}
+
+void Horizon_Update(HorizonCache* cache, const SceneState* scene, const float* heightMap, uint32_t lightCount)
+{
+    HorizonMapParams params = Horizon_GetMapParams(scene);
+    const int mapSize = params.mapSize;
+    const size_t texelCount = (size_t)mapSize * mapSize;
+
+    if (!SameParams(params, cache->params) || cache->heightMap.size() != texelCount)
+    {
+        Horizon_Invalidate(cache);
+        cache->params = params;
+        cache->heightMap.assign(heightMap, heightMap + texelCount);
+    }
+
+    std::vector<TexelBox> dirtyTiles;
+    FindDirtyTiles(cache->heightMap.data(), heightMap, mapSize, dirtyTiles);
+
+    // Trace against the cache's copy so the pyramid can point at it
+    if (!dirtyTiles.empty())
+        memcpy(cache->heightMap.data(), heightMap, texelCount * sizeof(float));
+    if (!dirtyTiles.empty() || cache->pyramid.heightMap != cache->heightMap.data())
+        Horizon_BuildPyramid(cache->heightMap.data(), mapSize, &cache->pyramid);
+
+    cache->fullLights = 0;
+    cache->partialLights = 0;
+    cache->skippedLights = 0;
+    cache->dirtyTiles = (uint32_t)dirtyTiles.size();
+    cache->tracedTexels = 0;
+
+    if (scene->useAngularHorizon)
+    {
+        // Slices are not kept up to date meanwhile
+        cache->slices.clear();
+        HorizonAngularMap& angular = cache->angular;
+        if (!angular.valid || !dirtyTiles.empty() || angular.range != scene->headlightRange)
+        {
+            Horizon_BuildAngular(cache->pyramid, params, scene->headlightRange, &angular);
+            cache->tracedTexels = (uint64_t)HORIZON_ANGLE_COUNT * HORIZON_ANGULAR_MAP_SIZE * HORIZON_ANGULAR_MAP_SIZE;
+        }
+        return;
+    }
+    cache->angular.valid = false;
+
+    // Lights beyond the count are dropped; changes made while a light is not
+    // traced are not tracked
+    cache->slices.resize(lightCount);
+
+    const float texelsPerMeter = (float)mapSize / params.worldSize;
+
+    std::vector<HorizonWork> work;
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        HorizonSlice& slice = cache->slices[i];
+        Vec3 lightPos = Simulation_GetLightPosition(scene, i);
+        HorizonSliceKey key = Horizon_GetSliceKey(params, lightPos.x, lightPos.z, scene->headlightRange);
+
+        HorizonSliceUpdate update = Horizon_PlanSliceUpdate(slice, key, !dirtyTiles.empty());
+        if (update == HORIZON_UPDATE_FULL)
+        {
+            // One row per work item so a single wide light still spreads across threads
+            static_cast<HorizonSliceKey&>(slice) = key;
+            slice.data.resize((size_t)slice.width * slice.height);
+            for (int row = 0; row < slice.height; ++row)
+                work.push_back({ i, 0, row, slice.width, row + 1 });
+            cache->tracedTexels += (uint64_t)slice.width * slice.height;
+            cache->fullLights++;
+        }
+        else if (update == HORIZON_UPDATE_PARTIAL)
+        {
+            float lightTexelX = (lightPos.x - params.worldMinX) * texelsPerMeter;
+            float lightTexelY = (lightPos.z - params.worldMinZ) * texelsPerMeter;
+
+            size_t firstWork = work.size();
+            for (int by = 0; by < slice.height; by += HORIZON_DIRTY_TILE_SIZE)
+            {
+                for (int bx = 0; bx < slice.width; bx += HORIZON_DIRTY_TILE_SIZE)
+                {
+                    int x1 = std::min(bx + HORIZON_DIRTY_TILE_SIZE, slice.width);
+                    int y1 = std::min(by + HORIZON_DIRTY_TILE_SIZE, slice.height);
+                    for (const TexelBox& tile : dirtyTiles)
+                    {
+                        if (RaysCrossBox(slice.x0 + bx, slice.y0 + by, slice.x0 + x1, slice.y0 + y1,
+                                         lightTexelX, lightTexelY, tile))
+                        {
+                            work.push_back({ i, bx, by, x1, y1 });
+                            cache->tracedTexels += (uint64_t)(x1 - bx) * (y1 - by);
+                            break;
+                        }
+                    }
+                }
+            }
+            if (work.size() > firstWork)
+                cache->partialLights++;
+            else
+                cache->skippedLights++;
+        }
+        else
+        {
+            cache->skippedLights++;
+        }
+    }
+
+    // The SIMD march beats the hierarchical trace on the CPU (-bench-horizon)
+    ParallelFor((uint32_t)work.size(), [&](uint32_t w)
+    {
+        const HorizonWork& item = work[w];
+        HorizonSlice& slice = cache->slices[item.light];
+        for (int y = item.y0; y < item.y1; ++y)
+        {
+            float* dst = slice.data.data() + (size_t)y * slice.width;
+            Horizon_TraceRow(cache->heightMap.data(), params, slice.lightX, slice.lightZ,
+                             slice.x0 + item.x0, slice.y0 + y, item.x1 - item.x0, dst + item.x0);
+        }
+    });
+}
+
+// Texel bounds of a car's bounding circle, grown by a texel
+static void AddCarFootprint(HorizonTexelRect& rect, bool& empty, float x, float z, const HorizonMapParams& params)
+{
+    const float texelsPerMeter = (float)params.mapSize / params.worldSize;
+    const float radius = 0.5f * sqrtf(CAR_LENGTH * CAR_LENGTH + CAR_WIDTH * CAR_WIDTH) * texelsPerMeter + 1.0f;
+
+    float cx = (x - params.worldMinX) * texelsPerMeter;
+    float cy = (z - params.worldMinZ) * texelsPerMeter;
+    int x0 = std::max(0, (int)floorf(cx - radius));
+    int y0 = std::max(0, (int)floorf(cy - radius));
+    int x1 = std::min(params.mapSize, (int)ceilf(cx + radius) + 1);
+    int y1 = std::min(params.mapSize, (int)ceilf(cy + radius) + 1);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    if (empty)
+    {
+        rect = { x0, y0, x1, y1 };
+        empty = false;
+        return;
+    }
+    rect.x0 = std::min(rect.x0, x0);
+    rect.y0 = std::min(rect.y0, y0);
+    rect.x1 = std::max(rect.x1, x1);
+    rect.y1 = std::max(rect.y1, y1);
+}
+
+HorizonTexelRect Horizon_UpdateOccluders(HorizonOccluders* occluders, const SimulationState* sim,
+                                         const HorizonMapParams& params)
+{
+    HorizonTexelRect rect;
+    if (occluders->posX.size() != sim->numCars)
+    {
+        // Different car set: everything may have changed
+        rect = { 0, 0, params.mapSize, params.mapSize };
+        occluders->posX.assign(sim->carPosX.begin(), sim->carPosX.begin() + sim->numCars);
+        occluders->posZ.assign(sim->carPosZ.begin(), sim->carPosZ.begin() + sim->numCars);
+        occluders->dirX.assign(sim->carDirX.begin(), sim->carDirX.begin() + sim->numCars);
+        occluders->dirZ.assign(sim->carDirZ.begin(), sim->carDirZ.begin() + sim->numCars);
+        return rect;
+    }
+
+    bool empty = true;
+    for (uint32_t i = 0; i < sim->numCars; ++i)
+    {
+        if (occluders->posX[i] == sim->carPosX[i] && occluders->posZ[i] == sim->carPosZ[i] &&
+            occluders->dirX[i] == sim->carDirX[i] && occluders->dirZ[i] == sim->carDirZ[i])
+            continue;
+
+        AddCarFootprint(rect, empty, occluders->posX[i], occluders->posZ[i], params);
+        AddCarFootprint(rect, empty, sim->carPosX[i], sim->carPosZ[i], params);
+        occluders->posX[i] = sim->carPosX[i];
+        occluders->posZ[i] = sim->carPosZ[i];
+        occluders->dirX[i] = sim->carDirX[i];
+        occluders->dirZ[i] = sim->carDirZ[i];
+    }
+    return rect;
+}
+
+void Horizon_Invalidate(HorizonCache* cache)
+{
+    for (HorizonSlice& slice : cache->slices)
+        slice.valid = false;
+    cache->angular.valid = false;
+    cache->heightMap.clear();
+    cache->pyramid = HorizonDepthPyramid();
+}
+
+static float FetchHorizon(const HorizonSlice& slice, int mapSize, int x, int y)
+{
+    x = std::min(std::max(x, 0), mapSize - 1);
+    y = std::min(std::max(y, 0), mapSize - 1);
+
+    x -= slice.x0;
+    y -= slice.y0;
+    if (x < 0 || y < 0 || x >= slice.width || y >= slice.height)
+        return HORIZON_NO_OCCLUSION;
+    return slice.data[(size_t)y * slice.width + x];
+}
+
+static float Lerp(float a, float b, float t)
+{
+    return a + (b - a) * t;
+}
+
+float Horizon_Sample(const HorizonSlice& slice, int mapSize, float u, float v)
+{
+    const float size = (float)mapSize;
+    float fx = u * size - 0.5f;
+    float fy = v * size - 0.5f;
+    int ix = (int)floorf(fx);
+    int iy = (int)floorf(fy);
+    float tx = fx - (float)ix;
+    float ty = fy - (float)iy;
+
+    float h00 = FetchHorizon(slice, mapSize, ix, iy);
+    float h10 = FetchHorizon(slice, mapSize, ix + 1, iy);
+    float h01 = FetchHorizon(slice, mapSize, ix, iy + 1);
+    float h11 = FetchHorizon(slice, mapSize, ix + 1, iy + 1);
+    return Lerp(Lerp(h00, h10, tx), Lerp(h01, h11, tx), ty);
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+// CPU horizon mapping: per-light maps of the light height needed to clear the
+// top-down height map, traced the same way as CSMain in
+// g_HorizonComputeShaderSource. Used by the software renderer and the headless
+// checks; Horizon_TraceMap builds a full map without a GPU. Slices are traced
+// with the SIMD march (Horizon_TraceRow).
+//
+// HorizonCache keeps the traced data between frames and only re-traces what
+// can have changed: every texel of a light that moved, or, for a static
+// light, the texels whose ray towards the light crosses a changed part of the
+// height map. Lights with nothing to do are skipped. The result is identical
+// to a full trace (see -check-horizon in headless_main.cpp).
+//
+// With useAngularHorizon the cache instead holds one light-independent
+// angular map (HorizonAngularMap), rebuilt when the height map changes.
+
+#include <cstdint>
+#include <vector>
+
+#include "scene.h"
+
+// Stored where nothing occludes the light (any light height is visible)
+static constexpr float HORIZON_NO_OCCLUSION = -1000.0f;
+
+// Granularity of height map change tracking and partial re-traces, in texels
+static constexpr int HORIZON_DIRTY_TILE_SIZE = 16;
+
+// Tiles Horizon_TraceMap hands to the worker threads, in texels per side
+static constexpr int HORIZON_TRACE_TILE_SIZE = 64;
+
+// Angular horizon map: texels per side (over the height map bounds) and
+// azimuth directions. Must match the constants in the D3D12 shaders.
+static constexpr int HORIZON_ANGULAR_MAP_SIZE = 256;
+static constexpr int HORIZON_ANGLE_COUNT = 32;
+
+// Occluder distance stored for directions where nothing rises above the ground
+static constexpr float HORIZON_NO_OCCLUDER = 1.0e30f;
+
+// Placement of the top-down height map, same values as the HorizonParams root constants
+struct HorizonMapParams
+{
+    int mapSize = 0;
+    float worldMinX = 0.0f;
+    float worldMinZ = 0.0f;
+    float worldSize = 0.0f;
+    float nearPlaneY = 0.0f;    // World Y at depth 0
+    float farPlaneY = 0.0f;     // World Y at depth 1
+};
+
+// What a light's horizon data was traced for: light position and the texel
+// rect within its range
+struct HorizonSliceKey
+{
+    bool valid = false;
+    float lightX = 0.0f, lightZ = 0.0f;
+    int x0 = 0, y0 = 0;
+    int width = 0, height = 0;
+};
+
+// Horizon data for one light. Only texels within the light's range are traced,
+// everything outside reads as unoccluded.
+struct HorizonSlice : HorizonSliceKey
+{
+    std::vector<float> data;
+};
+
+enum HorizonSliceUpdate
+{
+    HORIZON_UPDATE_NONE = 0,    // Still valid
+    HORIZON_UPDATE_PARTIAL,     // Light unchanged, re-trace texels behind changed occluders
+    HORIZON_UPDATE_FULL,        // Light moved or data invalid, re-trace the whole rect
+};
+
+// Min / max depth of every 2^L x 2^L cell of the height map for levels
+// L = 1 .. levelCount - 1 (level 0 is the height map itself). Height falls with
+// depth, so the min depth of a cell is its max height.
+struct HorizonDepthPyramid
+{
+    int mapSize = 0;
+    int levelCount = 0;
+    const float* heightMap = nullptr;           // Level 0, not owned
+    std::vector<std::vector<float>> levels;     // Level L at [L - 1]: (min, max) x (mapSize >> L)^2
+};
+
+// Texel rect [x0, x1) x [y0, y1) of the height map
+struct HorizonTexelRect
+{
+    int x0 = 0, y0 = 0;
+    int x1 = 0, y1 = 0;
+};
+
+// Car poses the last height map was rendered with. The GPU path keeps the
+// height map on the GPU, so it derives the changed region from the cars.
+struct HorizonOccluders
+{
+    std::vector<float> posX, posZ;
+    std::vector<float> dirX, dirZ;
+};
+
+// Per texel and azimuth direction: the steepest occluder within range, as
+// the max of height / distance ("tangent") and the distance where it first
+// occurs. Memory and cost do not depend on the light count.
+//
+// A light at distance d in that direction needs to be higher than
+// tangent * d if that occluder lies before the light; otherwise only above
+// the ground. This is exact for a single occluder per direction and
+// misses a lower occluder in front of the light when a steeper one lies behind
+// it, which is rare here since all cars have the same height (the nearest one
+// is the steepest). Between directions the shadow is interpolated.
+struct HorizonAngularMap
+{
+    bool valid = false;
+    HorizonMapParams params;        // Height map the data was traced against
+    float range = 0.0f;             // Occluders are searched up to this distance
+    std::vector<float> data;        // (tangent, distance) at ((direction * size + y) * size + x) * 2
+};
+
+struct HorizonCache
+{
+    HorizonMapParams params;
+    std::vector<float> heightMap;       // Depth values the slices were traced against
+    HorizonDepthPyramid pyramid;        // Of heightMap
+    std::vector<HorizonSlice> slices;   // One per shadowed light
+    HorizonAngularMap angular;          // Instead of slices with useAngularHorizon
+
+    // Stats of the last update
+    uint32_t fullLights = 0;
+    uint32_t partialLights = 0;
+    uint32_t skippedLights = 0;
+    uint32_t dirtyTiles = 0;
+    uint64_t tracedTexels = 0;
+};
+
+HorizonMapParams Horizon_GetMapParams(const SceneState* scene);
+
+// Required light height at texel (tx, ty) for a light at (lightX, lightZ), or
+// HORIZON_NO_OCCLUSION. heightMap holds mapSize^2 top-down depth values.
+// Linear march, one texel per step; stepCount (optional) receives the samples taken.
+float Horizon_TraceTexel(const float* heightMap, const HorizonMapParams& params, float lightX, float lightZ,
+                         int tx, int ty, uint32_t* stepCount = nullptr);
+
+// Horizon_TraceTexel for texels [tx, tx + count) of row ty into out[0 .. count),
+// bit for bit unless a * b + c is fused into FMA (simd.h). Marches SIMD-width
+// groups of texels in lockstep.
+void Horizon_TraceRow(const float* heightMap, const HorizonMapParams& params, float lightX, float lightZ,
+                      int tx, int ty, int count, float* out);
+
+// Full mapSize^2 map of required light heights for one light, same layout and
+// values as a horizonMaps slice traced by CSMain. Tiles are spread across the
+// ParallelFor threads, each row goes through Horizon_TraceRow.
+void Horizon_TraceMap(const float* heightMap, const HorizonMapParams& params, float lightX, float lightZ, float* out);
+
+// Same result as Horizon_TraceTexel, bit for bit, but skips pyramid cells that
+// cannot raise the required height found so far. stepCount (optional) receives
+// the number of cells / samples visited.
+float Horizon_TraceTexelHierarchical(const HorizonDepthPyramid& pyramid, const HorizonMapParams& params,
+                                     float lightX, float lightZ, int tx, int ty, uint32_t* stepCount = nullptr);
+
+// Builds the pyramid of a mapSize^2 height map; heightMap must outlive it
+void Horizon_BuildPyramid(const float* heightMap, int mapSize, HorizonDepthPyramid* pyramid);
+
+// Steepest occluder seen from angular texel (x, y) in azimuth 'direction',
+// within 'range' meters: returns the tangent and writes its distance (or
+// HORIZON_NO_OCCLUDER). Same walk as CSAngular in the D3D12 renderer.
+float Horizon_TraceAngular(const HorizonDepthPyramid& pyramid, const HorizonMapParams& params, float range,
+                           int x, int y, int direction, float* occluderDist);
+
+// Traces every texel and direction of the angular map
+void Horizon_BuildAngular(const HorizonDepthPyramid& pyramid, const HorizonMapParams& params, float range,
+                          HorizonAngularMap* map);
+
+// Required light height from angular texel (x, y) for a light distToLight
+// meters away in azimuth 'direction' (0, the ground, if nothing occludes)
+float Horizon_GetAngularRequiredHeight(const HorizonAngularMap& map, int x, int y, int direction, float distToLight);
+
+// Key for a light: the texels within range (plus a filter margin). Lights are
+// attenuated to zero beyond their range, so the rest of the map is never sampled.
+HorizonSliceKey Horizon_GetSliceKey(const HorizonMapParams& params, float lightX, float lightZ, float range);
+
+// How data traced for 'traced' has to be updated to match 'wanted'
+HorizonSliceUpdate Horizon_PlanSliceUpdate(const HorizonSliceKey& traced, const HorizonSliceKey& wanted,
+                                           bool heightMapChanged);
+
+// Brings the cache up to date for the scene's first lightCount lights (or the
+// angular map, see useAngularHorizon) against a new height map. Parameter
+// changes invalidate everything.
+void Horizon_Update(HorizonCache* cache, const SceneState* scene, const float* heightMap, uint32_t lightCount);
+
+// Stores the current car poses and returns the rect covering the old and new
+// footprint of every car that moved since the last call (empty if none did)
+HorizonTexelRect Horizon_UpdateOccluders(HorizonOccluders* occluders, const SimulationState* sim,
+                                         const HorizonMapParams& params);
+
+// Drops all traced data; the next update traces every light in full
+void Horizon_Invalidate(HorizonCache* cache);
+
+// Bilinear sample with clamp addressing at normalized map coordinates (u, v)
+float Horizon_Sample(const HorizonSlice& slice, int mapSize, float u, float v);
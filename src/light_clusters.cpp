@@ -0,0 +1,210 @@
+#include "light_clusters.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Froxels are grown by this much before the sphere test so a pixel whose depth
+// or position rounds into a neighboring cluster still finds its lights
+static constexpr float CLUSTER_DEPTH_MARGIN = 0.01f;  // Fraction of the slice depth
+static constexpr float CLUSTER_PIXEL_MARGIN = 1.0f;
+
+// Light bounding sphere in view space (x right, y up, z = depth along the view)
+struct ViewSphere
+{
+    float x, y, z;
+    float radius;
+    uint32_t lightIndex;
+    uint32_t slice0, slice1;
+};
+
+static uint32_t GetSlice(const LightClusterGrid* grid, float viewDepth)
+{
+    float s = logf(std::max(viewDepth, grid->nearZ) / grid->nearZ) * grid->depthScale;
+    return std::min((uint32_t)s, grid->slices - 1);
+}
+
+// Squared distance from a point to an interval, 0 inside
+static float DistanceSq(float v, float lo, float hi)
+{
+    float d = (v < lo) ? lo - v : (v > hi) ? v - hi : 0.0f;
+    return d * d;
+}
+
+void LightClusters_GetConeBounds(const Vec3& apex, const Vec3& dir, float range, float cosOuter,
+                                 Vec3& outCenter, float& outRadius)
+{
+    // Narrow cones: smallest sphere through the apex and the rim of the cap.
+    // Wide cones: the cap's far side dominates, center on the apex.
+    if (cosOuter >= 0.70710678f)
+    {
+        outRadius = range / (2.0f * cosOuter);
+        outCenter = apex + dir * outRadius;
+    }
+    else
+    {
+        outRadius = range;
+        outCenter = apex;
+    }
+}
+
+void LightClusters_Build(const SceneState* scene, uint32_t width, uint32_t height, LightClusterGrid* grid)
+{
+    const Camera& camera = scene->camera;
+
+    grid->tilesX = (width + LIGHT_CLUSTER_TILE_SIZE - 1) / LIGHT_CLUSTER_TILE_SIZE;
+    grid->tilesY = (height + LIGHT_CLUSTER_TILE_SIZE - 1) / LIGHT_CLUSTER_TILE_SIZE;
+    grid->slices = LIGHT_CLUSTER_DEPTH_SLICES;
+    grid->nearZ = camera.nearZ;
+    grid->depthScale = (float)grid->slices / logf(camera.farZ / camera.nearZ);
+
+    const uint32_t tileCount = grid->tilesX * grid->tilesY;
+
+    // Slice boundaries in view depth
+    std::vector<float> sliceDepth(grid->slices + 1);
+    for (uint32_t s = 0; s <= grid->slices; ++s)
+        sliceDepth[s] = grid->nearZ * expf((float)s / grid->depthScale);
+
+    // View basis, same as Mat4::lookAt
+    Vec3 forward = camera.getForward();
+    Vec3 right = cross(forward, camera.getUp()).normalized();
+    Vec3 up = cross(right, forward);
+
+    // View-space x / depth at the right screen edge (NDC x = 1), same for y
+    float tanHalfFov = tanf(camera.fov * 0.5f);
+    float scaleX = tanHalfFov * (float)width / (float)height;
+    float scaleY = tanHalfFov;
+
+    // Bounding spheres of the lights in front of the camera
+    uint32_t lightCount = Scene_GetActiveLightCount(scene);
+    float range = scene->headlightRange;
+    std::vector<ViewSphere> spheres;
+    spheres.reserve(lightCount);
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        Vec3 center;
+        float radius;
+        LightClusters_GetConeBounds(Simulation_GetLightPosition(scene, i), Simulation_GetLightDirection(scene, i),
+                                    range, cosf(scene->coneLights[i].outerAngle), center, radius);
+
+        Vec3 rel = center - camera.position;
+        ViewSphere sphere;
+        sphere.x = dot(rel, right);
+        sphere.y = dot(rel, up);
+        sphere.z = dot(rel, forward);
+        sphere.radius = radius;
+        sphere.lightIndex = i;
+        if (sphere.z + radius < grid->nearZ || sphere.z - radius > camera.farZ)
+            continue;
+
+        // One extra slice on each side, the froxel test below rejects them exactly
+        uint32_t s0 = GetSlice(grid, sphere.z - radius);
+        uint32_t s1 = GetSlice(grid, sphere.z + radius);
+        sphere.slice0 = (s0 > 0) ? s0 - 1 : 0;
+        sphere.slice1 = std::min(s1 + 1, grid->slices - 1);
+        spheres.push_back(sphere);
+    }
+
+    // Each slice bins independently; lights are visited in index order so every
+    // list comes out ascending (same summation order as the brute-force loop)
+    grid->sliceLists.resize(grid->slices);
+    ParallelFor(grid->slices, [&](uint32_t s)
+    {
+        std::vector<std::vector<uint32_t>>& lists = grid->sliceLists[s];
+        lists.resize(tileCount);
+        for (std::vector<uint32_t>& list : lists)
+            list.clear();
+
+        float z0 = sliceDepth[s] * (1.0f - CLUSTER_DEPTH_MARGIN);
+        float z1 = sliceDepth[s + 1] * (1.0f + CLUSTER_DEPTH_MARGIN);
+
+        for (const ViewSphere& sphere : spheres)
+        {
+            if (s < sphere.slice0 || s > sphere.slice1)
+                continue;
+
+            // Depth range of the sphere's box inside this slice
+            float zMin = std::max(z0, sphere.z - sphere.radius);
+            float zMax = std::min(z1, sphere.z + sphere.radius);
+            if (zMin > zMax)
+                continue;
+
+            // Screen rect of that box (x / z is monotonic in z for a fixed x)
+            float xLo = sphere.x - sphere.radius, xHi = sphere.x + sphere.radius;
+            float yLo = sphere.y - sphere.radius, yHi = sphere.y + sphere.radius;
+            float ndcX0 = std::min(xLo / zMin, xLo / zMax) / scaleX;
+            float ndcX1 = std::max(xHi / zMin, xHi / zMax) / scaleX;
+            float ndcY0 = std::min(yLo / zMin, yLo / zMax) / scaleY;
+            float ndcY1 = std::max(yHi / zMin, yHi / zMax) / scaleY;
+
+            float px0 = (ndcX0 * 0.5f + 0.5f) * (float)width - CLUSTER_PIXEL_MARGIN;
+            float px1 = (ndcX1 * 0.5f + 0.5f) * (float)width + CLUSTER_PIXEL_MARGIN;
+            float py0 = (0.5f - ndcY1 * 0.5f) * (float)height - CLUSTER_PIXEL_MARGIN;
+            float py1 = (0.5f - ndcY0 * 0.5f) * (float)height + CLUSTER_PIXEL_MARGIN;
+            if (px1 < 0.0f || py1 < 0.0f || px0 >= (float)width || py0 >= (float)height)
+                continue;
+
+            int tx0 = std::max((int)(px0 / LIGHT_CLUSTER_TILE_SIZE), 0);
+            int ty0 = std::max((int)(py0 / LIGHT_CLUSTER_TILE_SIZE), 0);
+            int tx1 = std::min((int)(px1 / LIGHT_CLUSTER_TILE_SIZE), (int)grid->tilesX - 1);
+            int ty1 = std::min((int)(py1 / LIGHT_CLUSTER_TILE_SIZE), (int)grid->tilesY - 1);
+
+            for (int ty = ty0; ty <= ty1; ++ty)
+            {
+                // Tile edges in NDC (y flipped), grown by the pixel margin
+                float tileY0 = (float)(ty * LIGHT_CLUSTER_TILE_SIZE) - CLUSTER_PIXEL_MARGIN;
+                float tileY1 = (float)((ty + 1) * LIGHT_CLUSTER_TILE_SIZE) + CLUSTER_PIXEL_MARGIN;
+                float ny0 = (1.0f - 2.0f * tileY1 / (float)height) * scaleY;
+                float ny1 = (1.0f - 2.0f * tileY0 / (float)height) * scaleY;
+                float boxY0 = std::min(ny0 * z0, ny0 * z1), boxY1 = std::max(ny1 * z0, ny1 * z1);
+                float dy = DistanceSq(sphere.y, boxY0, boxY1) + DistanceSq(sphere.z, z0, z1);
+
+                for (int tx = tx0; tx <= tx1; ++tx)
+                {
+                    float tileX0 = (float)(tx * LIGHT_CLUSTER_TILE_SIZE) - CLUSTER_PIXEL_MARGIN;
+                    float tileX1 = (float)((tx + 1) * LIGHT_CLUSTER_TILE_SIZE) + CLUSTER_PIXEL_MARGIN;
+                    float nx0 = (2.0f * tileX0 / (float)width - 1.0f) * scaleX;
+                    float nx1 = (2.0f * tileX1 / (float)width - 1.0f) * scaleX;
+                    float boxX0 = std::min(nx0 * z0, nx0 * z1), boxX1 = std::max(nx1 * z0, nx1 * z1);
+
+                    // Sphere vs. the froxel's view-space AABB
+                    if (dy + DistanceSq(sphere.x, boxX0, boxX1) <= sphere.radius * sphere.radius)
+                        lists[ty * grid->tilesX + tx].push_back(sphere.lightIndex);
+                }
+            }
+        }
+    });
+
+    // Flatten into ranges + one index list
+    grid->ranges.resize((size_t)tileCount * grid->slices);
+    grid->lightIndices.clear();
+    for (uint32_t s = 0; s < grid->slices; ++s)
+    {
+        for (uint32_t t = 0; t < tileCount; ++t)
+        {
+            const std::vector<uint32_t>& list = grid->sliceLists[s][t];
+            LightClusterRange& clusterRange = grid->ranges[(size_t)s * tileCount + t];
+            clusterRange.offset = (uint32_t)grid->lightIndices.size();
+            clusterRange.count = (uint32_t)list.size();
+            grid->lightIndices.insert(grid->lightIndices.end(), list.begin(), list.end());
+        }
+    }
+}
+
+uint32_t LightClusters_GetClusterIndex(const LightClusterGrid* grid, float pixelX, float pixelY, float viewDepth)
+{
+    uint32_t tx = std::min((uint32_t)std::max(pixelX / LIGHT_CLUSTER_TILE_SIZE, 0.0f), grid->tilesX - 1);
+    uint32_t ty = std::min((uint32_t)std::max(pixelY / LIGHT_CLUSTER_TILE_SIZE, 0.0f), grid->tilesY - 1);
+    uint32_t slice = GetSlice(grid, viewDepth);
+    return (slice * grid->tilesY + ty) * grid->tilesX + tx;
+}
+
+void LightClusters_FillConstants(const LightClusterGrid* grid, CameraConstants* cb)
+{
+    cb->clusterTileSize = (float)LIGHT_CLUSTER_TILE_SIZE;
+    cb->clusterCountX = (float)grid->tilesX;
+    cb->clusterCountY = (float)grid->tilesY;
+    cb->clusterCountZ = (float)grid->slices;
+    cb->clusterNearZ = grid->nearZ;
+    cb->clusterDepthScale = grid->depthScale;
+}
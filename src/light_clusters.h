@@ -0,0 +1,51 @@
+#pragma once
+
+// Clustered light culling: the view frustum is split into screen-space tiles x
+// exponential depth slices (froxels) and every active cone light is binned into
+// the clusters its bounding sphere touches. Built on the CPU every frame and
+// shared by both renderers; the D3D12 renderer uploads ranges + indices.
+
+#include <cstdint>
+#include <vector>
+
+#include "scene.h"
+
+// Cluster tile size in pixels and number of depth slices between camera near and far
+static constexpr uint32_t LIGHT_CLUSTER_TILE_SIZE = 32;
+static constexpr uint32_t LIGHT_CLUSTER_DEPTH_SLICES = 32;
+
+// Lights of one cluster: lightIndices[offset, offset + count), ascending
+struct LightClusterRange
+{
+    uint32_t offset;
+    uint32_t count;
+};
+
+struct LightClusterGrid
+{
+    uint32_t tilesX = 0;
+    uint32_t tilesY = 0;
+    uint32_t slices = 0;
+    float nearZ = 0.0f;        // slice = log(viewDepth / nearZ) * depthScale
+    float depthScale = 0.0f;
+
+    std::vector<LightClusterRange> ranges;  // (slice * tilesY + tileY) * tilesX + tileX
+    std::vector<uint32_t> lightIndices;
+
+    // Per-slice scratch lists reused between builds
+    std::vector<std::vector<std::vector<uint32_t>>> sliceLists;
+};
+
+// Bounding sphere of a cone light (apex, direction, range, cos of the outer angle)
+void LightClusters_GetConeBounds(const Vec3& apex, const Vec3& dir, float range, float cosOuter,
+                                 Vec3& outCenter, float& outRadius);
+
+// Bins the scene's active lights for a width x height view of the scene camera
+void LightClusters_Build(const SceneState* scene, uint32_t width, uint32_t height, LightClusterGrid* grid);
+
+// Cluster containing a pixel (window coordinates, pixel centers at +0.5) at a
+// given view depth. Mirrors GetClusterIndex in the pixel shader.
+uint32_t LightClusters_GetClusterIndex(const LightClusterGrid* grid, float pixelX, float pixelY, float viewDepth);
+
+// Writes the grid dimensions to the cluster fields of the camera constants
+void LightClusters_FillConstants(const LightClusterGrid* grid, CameraConstants* cb);
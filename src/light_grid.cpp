@@ -0,0 +1,118 @@
+#include "light_grid.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Footprints are grown by this fraction of a cell so positions that round into
+// a neighboring cell still find their lights
+static constexpr float LIGHT_GRID_MARGIN = 0.01f;
+
+// Light footprint: XZ circle of the bounding sphere
+struct Footprint
+{
+    float x, z;
+    float radius;
+    uint32_t lightIndex;
+};
+
+static int GetCell(float coord, float minCoord, const LightGrid* grid)
+{
+    int cell = (int)floorf((coord - minCoord) / grid->worldSize * (float)grid->size);
+    return std::min(std::max(cell, 0), (int)grid->size - 1);
+}
+
+// Cell bounds along one axis; edge cells are open towards the outside
+static void GetCellBounds(int cell, float minCoord, const LightGrid* grid, float& lo, float& hi)
+{
+    float cellSize = grid->worldSize / (float)grid->size;
+    lo = (cell == 0) ? -INFINITY : minCoord + (float)cell * cellSize;
+    hi = (cell == (int)grid->size - 1) ? INFINITY : minCoord + (float)(cell + 1) * cellSize;
+}
+
+// Squared distance from a point to an interval, 0 inside
+static float DistanceSq(float v, float lo, float hi)
+{
+    float d = (v < lo) ? lo - v : (v > hi) ? v - hi : 0.0f;
+    return d * d;
+}
+
+void LightGrid_Build(const SceneState* scene, LightGrid* grid)
+{
+    grid->size = LIGHT_GRID_SIZE;
+    grid->minX = scene->horizonWorldMin.x;
+    grid->minZ = scene->horizonWorldMin.z;
+    grid->worldSize = scene->horizonWorldSize;
+
+    const uint32_t size = grid->size;
+    float margin = grid->worldSize / (float)size * LIGHT_GRID_MARGIN;
+
+    uint32_t lightCount = Scene_GetActiveLightCount(scene);
+    std::vector<Footprint> footprints(lightCount);
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        Vec3 center;
+        float radius;
+        LightClusters_GetConeBounds(Simulation_GetLightPosition(scene, i), Simulation_GetLightDirection(scene, i),
+                                    scene->headlightRange, cosf(scene->coneLights[i].outerAngle), center, radius);
+        footprints[i] = { center.x, center.z, radius + margin, i };
+    }
+
+    // One row of cells per task; lights in index order keep every list ascending
+    grid->rowLists.resize(size);
+    ParallelFor(size, [&](uint32_t z)
+    {
+        std::vector<std::vector<uint32_t>>& lists = grid->rowLists[z];
+        lists.resize(size);
+        for (std::vector<uint32_t>& list : lists)
+            list.clear();
+
+        float z0, z1;
+        GetCellBounds((int)z, grid->minZ, grid, z0, z1);
+
+        for (const Footprint& light : footprints)
+        {
+            float dz = DistanceSq(light.z, z0, z1);
+            float radiusSq = light.radius * light.radius;
+            if (dz > radiusSq)
+                continue;
+
+            int x0 = GetCell(light.x - light.radius, grid->minX, grid);
+            int x1 = GetCell(light.x + light.radius, grid->minX, grid);
+            for (int x = x0; x <= x1; ++x)
+            {
+                float cellX0, cellX1;
+                GetCellBounds(x, grid->minX, grid, cellX0, cellX1);
+                if (dz + DistanceSq(light.x, cellX0, cellX1) <= radiusSq)
+                    lists[x].push_back(light.lightIndex);
+            }
+        }
+    });
+
+    // Flatten into ranges + one index list
+    grid->ranges.resize((size_t)size * size);
+    grid->lightIndices.clear();
+    for (uint32_t z = 0; z < size; ++z)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            const std::vector<uint32_t>& list = grid->rowLists[z][x];
+            LightClusterRange& cellRange = grid->ranges[(size_t)z * size + x];
+            cellRange.offset = (uint32_t)grid->lightIndices.size();
+            cellRange.count = (uint32_t)list.size();
+            grid->lightIndices.insert(grid->lightIndices.end(), list.begin(), list.end());
+        }
+    }
+}
+
+uint32_t LightGrid_GetCellIndex(const LightGrid* grid, float worldX, float worldZ)
+{
+    int x = GetCell(worldX, grid->minX, grid);
+    int z = GetCell(worldZ, grid->minZ, grid);
+    return (uint32_t)z * grid->size + (uint32_t)x;
+}
+
+void LightGrid_FillConstants(const LightGrid* grid, CameraConstants* cb)
+{
+    cb->lightGridSize = (float)grid->size;
+}
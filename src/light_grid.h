@@ -0,0 +1,40 @@
+#pragma once
+
+// Top-down light grid: a world-space XZ grid over the horizon map bounds where
+// each cell lists the cone lights whose footprint overlaps it. Cheaper than the
+// froxel clusters for this scene since nearly all lit pixels are on the ground
+// plane. Built on the CPU every frame, shared by both renderers.
+
+#include <cstdint>
+#include <vector>
+
+#include "light_clusters.h"
+#include "scene.h"
+
+// Cells per side of the grid (over horizonWorldSize)
+static constexpr uint32_t LIGHT_GRID_SIZE = 128;
+
+struct LightGrid
+{
+    uint32_t size = 0;
+    float minX = 0.0f;
+    float minZ = 0.0f;
+    float worldSize = 0.0f;
+
+    // Lights of cell (x, z) at ranges[z * size + x], ascending. Points outside
+    // the bounds use the nearest edge cell, so edge cells extend to infinity.
+    std::vector<LightClusterRange> ranges;
+    std::vector<uint32_t> lightIndices;
+
+    // Per-row scratch lists reused between builds
+    std::vector<std::vector<std::vector<uint32_t>>> rowLists;
+};
+
+// Bins the scene's active lights by the XZ footprint of their bounding spheres
+void LightGrid_Build(const SceneState* scene, LightGrid* grid);
+
+// Cell containing a world position. Mirrors GetLightGridCell in the pixel shader.
+uint32_t LightGrid_GetCellIndex(const LightGrid* grid, float worldX, float worldZ);
+
+// Writes the grid size to the camera constants (bounds are the horizon bounds)
+void LightGrid_FillConstants(const LightGrid* grid, CameraConstants* cb);
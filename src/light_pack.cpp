@@ -0,0 +1,234 @@
+#include "light_pack.h"
+#include "shadow_atlas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Tile x / y must fit 12 bits, sizes are powers of two
+static_assert(SHADOW_ATLAS_SIZE <= 4096, "Shadow tile positions are packed in 12 bits");
+
+static uint32_t FloatBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float SignNotZero(float v)
+{
+    return (v >= 0.0f) ? 1.0f : -1.0f;
+}
+
+static uint32_t PackSnorm16(float v)
+{
+    return (uint32_t)(int32_t)lrintf(std::clamp(v, -1.0f, 1.0f) * 32767.0f) & 0xffffu;
+}
+
+static float UnpackSnorm16(uint32_t bits)
+{
+    return std::max((float)(int16_t)(uint16_t)bits / 32767.0f, -1.0f);
+}
+
+// One axis of the position as cell index and offset (cell | offset << 16)
+static void PackCoordinate(float v, uint32_t* cell, uint32_t* offset)
+{
+    float cellIndex = std::clamp(floorf(v / LIGHT_PACK_CELL_SIZE), -32768.0f, 32767.0f);
+    float fraction = std::clamp((v - cellIndex * LIGHT_PACK_CELL_SIZE) / LIGHT_PACK_CELL_SIZE, 0.0f, 1.0f);
+    *cell = (uint32_t)(int32_t)cellIndex & 0xffffu;
+    *offset = (uint32_t)lrintf(fraction * 65535.0f);
+}
+
+static float UnpackCoordinate(uint32_t cell, uint32_t offset)
+{
+    return ((float)(int16_t)(uint16_t)cell + (float)offset * (1.0f / 65535.0f)) * LIGHT_PACK_CELL_SIZE;
+}
+
+// Octahedral map with +Y / -Y as the two hemispheres (headlights point
+// horizontally, along the fold)
+static uint32_t PackDirection(const float* d)
+{
+    float l1 = fabsf(d[0]) + fabsf(d[1]) + fabsf(d[2]);
+    if (l1 <= 0.0f)
+        return 0;
+    float u = d[0] / l1;
+    float v = d[2] / l1;
+    if (d[1] < 0.0f)
+    {
+        float foldedU = (1.0f - fabsf(v)) * SignNotZero(u);
+        float foldedV = (1.0f - fabsf(u)) * SignNotZero(v);
+        u = foldedU;
+        v = foldedV;
+    }
+    return PackSnorm16(u) | (PackSnorm16(v) << 16);
+}
+
+static void UnpackDirection(uint32_t packed, float* d)
+{
+    float u = UnpackSnorm16(packed & 0xffffu);
+    float v = UnpackSnorm16(packed >> 16);
+    float x = u;
+    float y = 1.0f - fabsf(u) - fabsf(v);
+    float z = v;
+    if (y < 0.0f)
+    {
+        x = (1.0f - fabsf(v)) * SignNotZero(u);
+        z = (1.0f - fabsf(u)) * SignNotZero(v);
+    }
+    float length = sqrtf(x * x + y * y + z * z);
+    d[0] = x / length;
+    d[1] = y / length;
+    d[2] = z / length;
+}
+
+static uint32_t PackShadowTile(const float* tile)
+{
+    uint32_t size = (uint32_t)tile[2];
+    if (size == 0)
+        return 0;
+    uint32_t sizeCode = 1;
+    while ((1u << (sizeCode - 1)) < size)
+        sizeCode++;
+    return (uint32_t)tile[0] | ((uint32_t)tile[1] << 12) | (sizeCode << 24);
+}
+
+uint16_t LightPack_FloatToHalf(float value)
+{
+    uint32_t bits = FloatBits(value);
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t magnitude = bits & 0x7fffffffu;
+
+    // Infinity / NaN, and everything that rounds past the largest half
+    if (magnitude >= 0x7f800000u)
+        return (uint16_t)(sign | ((magnitude > 0x7f800000u) ? 0x7e00u : 0x7c00u));
+    if (magnitude >= 0x477ff000u)
+        return (uint16_t)(sign | 0x7c00u);
+
+    // Subnormal half (below 2^-14), zero below 2^-25
+    if (magnitude < 0x38800000u)
+    {
+        if (magnitude < 0x33000000u)
+            return (uint16_t)sign;
+        uint32_t mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+        uint32_t shift = 126 - (magnitude >> 23);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+
+    // Normal: rebias the exponent, round the mantissa (a carry moves into the exponent)
+    uint32_t half = (magnitude - 0x38000000u) >> 13;
+    uint32_t rest = magnitude & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1)))
+        half++;
+    return (uint16_t)(sign | half);
+}
+
+float LightPack_HalfToFloat(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        float value = (float)mantissa * (1.0f / 16777216.0f);
+        return sign ? -value : value;
+    }
+    if (exponent == 31)
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool LightPack_Encode(const ConeLightGPU* lights, uint32_t count, LightPack* pack)
+{
+    pack->lights.resize(count);
+    pack->classes.clear();
+    pack->classIndices.clear();
+
+    bool fits = true;
+    std::array<uint32_t, 6> lastKey = {};
+    uint32_t lastClass = ~0u;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const ConeLightGPU& light = lights[i];
+        PackedConeLight& packed = pack->lights[i];
+
+        // Neighbouring lights are usually of the same class; look up the rest
+        std::array<uint32_t, 6> key = {
+            FloatBits(light.position[3]), FloatBits(light.direction[3]), FloatBits(light.color[3]),
+            FloatBits(light.color[0]), FloatBits(light.color[1]), FloatBits(light.color[2]),
+        };
+        if (lastClass == ~0u || key != lastKey)
+        {
+            auto it = pack->classIndices.find(key);
+            if (it != pack->classIndices.end())
+            {
+                lastClass = it->second;
+            }
+            else if (pack->classes.size() < LIGHT_PACK_MAX_CLASSES)
+            {
+                LightClassGPU lightClass = {
+                    { light.position[3], light.direction[3], light.color[3], 0.0f },
+                    { light.color[0], light.color[1], light.color[2], 0.0f },
+                };
+                lastClass = (uint32_t)pack->classes.size();
+                pack->classes.push_back(lightClass);
+                pack->classIndices.emplace(key, lastClass);
+            }
+            else
+            {
+                fits = false;
+                lastClass = LIGHT_PACK_MAX_CLASSES - 1;
+            }
+            lastKey = key;
+        }
+
+        uint32_t cellX, cellZ, offsetX, offsetZ;
+        PackCoordinate(light.position[0], &cellX, &offsetX);
+        PackCoordinate(light.position[2], &cellZ, &offsetZ);
+        packed.cell = cellX | (cellZ << 16);
+        packed.offset = offsetX | (offsetZ << 16);
+        packed.direction = PackDirection(light.direction);
+        packed.heightAndClass = LightPack_FloatToHalf(light.position[1]) | (lastClass << 16);
+        packed.shadowTile = PackShadowTile(light.shadowTile);
+    }
+    return fits;
+}
+
+void LightPack_Decode(const PackedConeLight& packed, const LightClassGPU* classes, ConeLightGPU* out)
+{
+    const LightClassGPU& lightClass = classes[packed.heightAndClass >> 16];
+
+    out->position[0] = UnpackCoordinate(packed.cell & 0xffffu, packed.offset & 0xffffu);
+    out->position[1] = LightPack_HalfToFloat((uint16_t)(packed.heightAndClass & 0xffffu));
+    out->position[2] = UnpackCoordinate(packed.cell >> 16, packed.offset >> 16);
+    out->position[3] = lightClass.rangeAndCos[0];
+    UnpackDirection(packed.direction, out->direction);
+    out->direction[3] = lightClass.rangeAndCos[1];
+    out->color[0] = lightClass.color[0];
+    out->color[1] = lightClass.color[1];
+    out->color[2] = lightClass.color[2];
+    out->color[3] = lightClass.rangeAndCos[2];
+
+    uint32_t sizeCode = packed.shadowTile >> 24;
+    out->shadowTile[0] = (float)(packed.shadowTile & 0xfffu);
+    out->shadowTile[1] = (float)((packed.shadowTile >> 12) & 0xfffu);
+    out->shadowTile[2] = sizeCode ? (float)(1u << (sizeCode - 1)) : 0.0f;
+    out->shadowTile[3] = 0.0f;
+}
+
+void LightPack_DecodeAll(const LightPack* pack, ConeLightGPU* out)
+{
+    for (size_t i = 0; i < pack->lights.size(); ++i)
+        LightPack_Decode(pack->lights[i], pack->classes.data(), &out[i]);
+}
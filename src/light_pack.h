@@ -0,0 +1,75 @@
+#pragma once
+
+// Compact cone light records for shading: 20 bytes per light instead of the 64
+// of ConeLightGPU. Range, cone angles and color are shared by light class (one
+// table entry per distinct combination, usually a single one for all
+// headlights); each light keeps its quantized position, direction, class and
+// shadow tile. Encoded on the CPU every frame and decoded by the pixel shader;
+// the software renderer shades from LightPack_Decode, so both renderers see
+// the same quantized lights.
+//
+// Quantization (bounds checked by -check-light-pack):
+// - x, z: int16 index of a LIGHT_PACK_CELL_SIZE cell plus a unorm16 offset in
+//   it, so the error stays below LIGHT_PACK_MAX_OFFSET_ERROR within a few km
+// - y: half float, relative error <= 2^-11
+// - direction: octahedral, snorm16 per axis, angle error <= LIGHT_PACK_MAX_DIRECTION_ERROR
+// - shadow tile, class parameters: exact
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "scene.h"
+
+// World units per position cell
+static constexpr float LIGHT_PACK_CELL_SIZE = 16.0f;
+
+// Largest position error per axis (x, z) within 4096 units of the origin
+static constexpr float LIGHT_PACK_MAX_OFFSET_ERROR = 0.0005f;
+
+// Largest angle between a direction and its decoded version, in radians
+static constexpr float LIGHT_PACK_MAX_DIRECTION_ERROR = 1e-4f;
+
+// Class indices are 16 bits
+static constexpr uint32_t LIGHT_PACK_MAX_CLASSES = 65536;
+
+struct PackedConeLight
+{
+    uint32_t cell;              // Cell x (int16) | cell z (int16) << 16
+    uint32_t offset;            // Offset in the cell x (unorm16) | z (unorm16) << 16
+    uint32_t direction;         // Octahedral u (snorm16) | v (snorm16) << 16
+    uint32_t heightAndClass;    // y (half) | class index << 16
+    uint32_t shadowTile;        // Atlas x (12 bits) | y (12 bits) << 12 | log2(size) + 1 << 24, 0 = no shadow map
+};
+
+// Parameters shared by the lights of one class
+struct LightClassGPU
+{
+    float rangeAndCos[4];       // range, cos(outer angle), cos(inner angle), 0
+    float color[4];
+};
+
+struct LightPack
+{
+    std::vector<PackedConeLight> lights;
+    std::vector<LightClassGPU> classes;
+
+    // Class lookup by parameter bits, rebuilt by every encode
+    std::map<std::array<uint32_t, 6>, uint32_t> classIndices;
+};
+
+// Packs lights[0, count) into pack->lights, collecting their classes in
+// pack->classes. False if there are more than LIGHT_PACK_MAX_CLASSES classes
+// (the extra lights use the last one).
+bool LightPack_Encode(const ConeLightGPU* lights, uint32_t count, LightPack* pack);
+
+// Unpacks one light like the pixel shader does
+void LightPack_Decode(const PackedConeLight& packed, const LightClassGPU* classes, ConeLightGPU* out);
+
+// Unpacks every light of the last encode into out[0, pack->lights.size())
+void LightPack_DecodeAll(const LightPack* pack, ConeLightGPU* out);
+
+// Half float conversion (round to nearest even, overflow to infinity)
+uint16_t LightPack_FloatToHalf(float value);
+float LightPack_HalfToFloat(uint16_t half);
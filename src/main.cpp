@@ -1,4 +1,6 @@
 #include "d3d12_renderer.h"
+#include "scene_io.h"
+#include "pbrt_export.h"
 #include "imgui.h"
 #include "imgui_impl_win32.h"
 #include "imgui_impl_dx12.h"
@@ -43,387 +45,6 @@ static constexpr int TEST_FRAME_WAIT = 30;
 static bool g_GenerateRefMode = false;
 static std::string g_GenerateRefConfigFile;
 
-// Serialize all settings to a string
-static std::string SerializeState(const D3D12Renderer& renderer)
-{
-    std::ostringstream ss;
-    ss << std::setprecision(8);
-
-    // Version for future compatibility
-    ss << "version=1\n";
-
-    // Camera position and orientation
-    ss << "camera.position.x=" << renderer.camera.position.x << "\n";
-    ss << "camera.position.y=" << renderer.camera.position.y << "\n";
-    ss << "camera.position.z=" << renderer.camera.position.z << "\n";
-    ss << "camera.yaw=" << renderer.camera.yaw << "\n";
-    ss << "camera.pitch=" << renderer.camera.pitch << "\n";
-
-    // Lighting settings
-    ss << "ambientIntensity=" << renderer.ambientIntensity << "\n";
-    ss << "coneLightIntensity=" << renderer.coneLightIntensity << "\n";
-    ss << "headlightRange=" << renderer.headlightRange << "\n";
-    ss << "headlightFalloff=" << renderer.headlightFalloff << "\n";
-    ss << "shadowBias=" << renderer.shadowBias << "\n";
-    ss << "disableShadows=" << (renderer.disableShadows ? 1 : 0) << "\n";
-    ss << "useHorizonMapping=" << (renderer.useHorizonMapping ? 1 : 0) << "\n";
-    ss << "showGrid=" << (renderer.showGrid ? 1 : 0) << "\n";
-
-    // Animation settings
-    ss << "carSpeed=" << renderer.carSpeed << "\n";
-    ss << "carSpacing=" << renderer.carSpacing << "\n";
-
-    // Debug settings
-    ss << "showDebugLights=" << (renderer.showDebugLights ? 1 : 0) << "\n";
-    ss << "showLightOverlap=" << (renderer.showLightOverlap ? 1 : 0) << "\n";
-    ss << "overlapMaxCount=" << renderer.overlapMaxCount << "\n";
-    ss << "activeLightCount=" << renderer.activeLightCount << "\n";
-    ss << "showShadowMapDebug=" << (renderer.showShadowMapDebug ? 1 : 0) << "\n";
-    ss << "debugShadowMapIndex=" << renderer.debugShadowMapIndex << "\n";
-
-    // Simulation time (first car's track progress as reference)
-    ss << "simulationTime=" << renderer.carTrackProgress[0] << "\n";
-
-    return ss.str();
-}
-
-// Deserialize settings from a string
-static bool DeserializeState(D3D12Renderer& renderer, const std::string& data)
-{
-    std::istringstream ss(data);
-    std::string line;
-
-    float simulationTime = -1.0f;
-    float oldSimTime = renderer.carTrackProgress[0];
-
-    while (std::getline(ss, line))
-    {
-        if (line.empty() || line[0] == '#')
-            continue;
-
-        size_t eqPos = line.find('=');
-        if (eqPos == std::string::npos)
-            continue;
-
-        std::string key = line.substr(0, eqPos);
-        std::string value = line.substr(eqPos + 1);
-
-        // Camera
-        if (key == "camera.position.x") renderer.camera.position.x = std::stof(value);
-        else if (key == "camera.position.y") renderer.camera.position.y = std::stof(value);
-        else if (key == "camera.position.z") renderer.camera.position.z = std::stof(value);
-        else if (key == "camera.yaw") renderer.camera.yaw = std::stof(value);
-        else if (key == "camera.pitch") renderer.camera.pitch = std::stof(value);
-
-        // Lighting
-        else if (key == "ambientIntensity") renderer.ambientIntensity = std::stof(value);
-        else if (key == "coneLightIntensity") renderer.coneLightIntensity = std::stof(value);
-        else if (key == "headlightRange") renderer.headlightRange = std::stof(value);
-        else if (key == "headlightFalloff") renderer.headlightFalloff = std::stof(value);
-        else if (key == "shadowBias") renderer.shadowBias = std::stof(value);
-        else if (key == "disableShadows") renderer.disableShadows = (std::stoi(value) != 0);
-        else if (key == "useHorizonMapping") renderer.useHorizonMapping = (std::stoi(value) != 0);
-        else if (key == "showGrid") renderer.showGrid = (std::stoi(value) != 0);
-
-        // Animation
-        else if (key == "carSpeed") renderer.carSpeed = std::stof(value);
-        else if (key == "carSpacing") renderer.carSpacing = std::stof(value);
-
-        // Debug
-        else if (key == "showDebugLights") renderer.showDebugLights = (std::stoi(value) != 0);
-        else if (key == "showLightOverlap") renderer.showLightOverlap = (std::stoi(value) != 0);
-        else if (key == "overlapMaxCount") renderer.overlapMaxCount = std::stof(value);
-        else if (key == "activeLightCount") renderer.activeLightCount = std::stoi(value);
-        else if (key == "showShadowMapDebug") renderer.showShadowMapDebug = (std::stoi(value) != 0);
-        else if (key == "debugShadowMapIndex") renderer.debugShadowMapIndex = std::stoi(value);
-
-        // Simulation time
-        else if (key == "simulationTime") simulationTime = std::stof(value);
-    }
-
-    // Apply simulation time delta to all cars
-    if (simulationTime >= 0.0f)
-    {
-        float delta = simulationTime - oldSimTime;
-        for (uint32_t i = 0; i < renderer.numCars; i++)
-        {
-            renderer.carTrackProgress[i] += delta;
-            // Wrap to [0, 1)
-            while (renderer.carTrackProgress[i] >= 1.0f)
-                renderer.carTrackProgress[i] -= 1.0f;
-            while (renderer.carTrackProgress[i] < 0.0f)
-                renderer.carTrackProgress[i] += 1.0f;
-        }
-    }
-
-    return true;
-}
-
-// Save state to a file
-static bool SaveStateToFile(const D3D12Renderer& renderer, const char* filename)
-{
-    std::ofstream file(filename);
-    if (!file.is_open())
-        return false;
-    file << SerializeState(renderer);
-    return true;
-}
-
-// Load state from a file
-static bool LoadStateFromFile(D3D12Renderer& renderer, const char* filename)
-{
-    std::ifstream file(filename);
-    if (!file.is_open())
-        return false;
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return DeserializeState(renderer, buffer.str());
-}
-
-// Helper function to get position and direction on the oval track
-// Must match the implementation in d3d12_renderer.cpp exactly!
-static void GetTrackPositionAndDirection(float progress, float straightLength, float radius,
-                                          Vec3& outPos, Vec3& outDir)
-{
-    const float PI = 3.14159265f;
-
-    // Track layout (counterclockwise):
-    // - Bottom straight: progress 0 to ~0.25 (going +X)
-    // - Right semicircle: progress ~0.25 to ~0.5 (turning around)
-    // - Top straight: progress ~0.5 to ~0.75 (going -X)
-    // - Left semicircle: progress ~0.75 to 1.0 (turning around)
-
-    float totalStraight = straightLength * 2.0f;
-    float totalCurve = 2.0f * PI * radius;
-    float totalLength = totalStraight + totalCurve;
-
-    float straightFraction = totalStraight / totalLength;
-    float curveFraction = totalCurve / totalLength;
-    float singleStraightFrac = straightFraction * 0.5f;
-    float singleCurveFrac = curveFraction * 0.5f;
-
-    float halfStraight = straightLength * 0.5f;
-
-    if (progress < singleStraightFrac)
-    {
-        // Bottom straight (going +X direction)
-        float t = progress / singleStraightFrac;
-        outPos = Vec3(-halfStraight + t * straightLength, 0, -radius);
-        outDir = Vec3(1, 0, 0);
-    }
-    else if (progress < singleStraightFrac + singleCurveFrac)
-    {
-        // Right semicircle
-        float t = (progress - singleStraightFrac) / singleCurveFrac;
-        float angle = -PI * 0.5f + t * PI;  // -90 to +90 degrees
-        outPos = Vec3(halfStraight + cosf(angle) * radius, 0, sinf(angle) * radius);
-        outDir = Vec3(-sinf(angle), 0, cosf(angle));
-    }
-    else if (progress < 2.0f * singleStraightFrac + singleCurveFrac)
-    {
-        // Top straight (going -X direction)
-        float t = (progress - singleStraightFrac - singleCurveFrac) / singleStraightFrac;
-        outPos = Vec3(halfStraight - t * straightLength, 0, radius);
-        outDir = Vec3(-1, 0, 0);
-    }
-    else
-    {
-        // Left semicircle
-        float t = (progress - 2.0f * singleStraightFrac - singleCurveFrac) / singleCurveFrac;
-        float angle = PI * 0.5f + t * PI;  // +90 to +270 degrees
-        outPos = Vec3(-halfStraight + cosf(angle) * radius, 0, sinf(angle) * radius);
-        outDir = Vec3(-sinf(angle), 0, cosf(angle));
-    }
-}
-
-// Export scene to PBRT format for reference raytracer
-static bool ExportToPBRT(const D3D12Renderer& renderer, const char* outputPath)
-{
-    std::ofstream file(outputPath);
-    if (!file.is_open())
-        return false;
-
-    file << std::setprecision(6);
-    file << "# PBRT scene exported from cl3d\n";
-    file << "# Render with: pbrt scene.pbrt\n\n";
-
-    // Film settings (match our window size)
-    file << "Film \"rgb\"\n";
-    file << "    \"integer xresolution\" [ 1280 ]\n";
-    file << "    \"integer yresolution\" [ 720 ]\n";
-    file << "    \"string filename\" \"render.exr\"\n\n";
-
-    // Sampler for quality - higher samples = less noise
-    file << "Sampler \"halton\" \"integer pixelsamples\" [ 512 ]\n\n";
-
-    // Integrator - direct lighting only (maxdepth 1 = no bounces)
-    file << "Integrator \"volpath\" \"integer maxdepth\" [ 1 ]\n\n";
-
-    // Camera - negate X to convert from D3D12 left-handed to PBRT right-handed
-    const Camera& cam = renderer.camera;
-    Vec3 forward = cam.getForward();
-    Vec3 lookAt = cam.position + forward;
-
-    file << "LookAt " << -cam.position.x << " " << cam.position.y << " " << cam.position.z << "  # eye\n";
-    file << "       " << -lookAt.x << " " << lookAt.y << " " << lookAt.z << "  # look at\n";
-    file << "       0 1 0  # up\n\n";
-
-    file << "Camera \"perspective\"\n";
-    file << "    \"float fov\" [ 60 ]\n\n";
-
-    // Begin world
-    file << "WorldBegin\n\n";
-
-    // Ambient light - scale down to avoid bright background (PBRT illuminates everything)
-    // cl3d ground ambient = 0.3 * 0.3 = 0.09, but we want darker background
-    float ambient = renderer.ambientIntensity * 0.2f;  // Scale down significantly
-    file << "# Ambient light (scaled from " << renderer.ambientIntensity << ")\n";
-    file << "LightSource \"infinite\" \"rgb L\" [ " << ambient << " " << ambient << " " << ambient << " ]\n\n";
-
-    // Ground plane - lower reflectance for darker ambient areas
-    file << "# Ground plane\n";
-    file << "AttributeBegin\n";
-    float groundReflectance = 0.15f;  // Keep dark in unlit areas
-    file << "    Material \"diffuse\" \"rgb reflectance\" [ " << groundReflectance << " " << groundReflectance << " " << groundReflectance << " ]\n";
-    file << "    Shape \"trianglemesh\"\n";
-    file << "        \"point3 P\" [ -500 0 -500  500 0 -500  500 0 500  -500 0 500 ]\n";
-    file << "        \"integer indices\" [ 0 1 2  0 2 3 ]\n";
-    file << "AttributeEnd\n\n";
-
-    // Car boxes - must match D3D12_Update calculation exactly
-    file << "# Cars (boxes on oval track)\n";
-    const float PI = 3.14159265f;
-    const float carLength = 4.0f;
-    const float carWidth = 2.0f;
-    const float carHeight = 1.5f;
-    const float straightLength = renderer.trackStraightLength;
-    const float radius = renderer.trackRadius;
-    const float trackLength = straightLength * 2.0f + 2.0f * PI * radius;
-
-    // Calculate spacing (must match D3D12_Update)
-    const int carsPerLane = renderer.numCars / 2;
-    const float minGap = 0.5f;
-    float maxSpacingMeters = trackLength / (float)carsPerLane;
-    float minSpacingMeters = carLength + minGap;
-    float currentSpacingMeters = minSpacingMeters + (maxSpacingMeters - minSpacingMeters) * renderer.carSpacing;
-    float spacingFraction = currentSpacingMeters / trackLength;
-
-    // Headlight parameters (must match D3D12_Update)
-    const float headlightHeight = 0.6f;
-    const float headlightSpacing = 0.4f;
-    const float headlightInnerAngle = 15.0f * PI / 180.0f;
-    const float headlightOuterAngle = 20.0f * PI / 180.0f;
-
-    // Store car data for light calculation
-    struct CarData { Vec3 pos; Vec3 dir; Vec3 right; };
-    std::vector<CarData> carData(renderer.numCars);
-
-    for (uint32_t i = 0; i < renderer.numCars; i++)
-    {
-        // Calculate actual progress with lane-based spacing (matches D3D12_Update)
-        int lane = i % 2;
-        int posInLane = i / 2;
-        float baseProgress = renderer.carTrackProgress[lane];  // Lane leader's progress
-        float progress = baseProgress + posInLane * spacingFraction;
-        if (progress >= 1.0f) progress -= 1.0f;
-
-        Vec3 trackPos, trackDir;
-        GetTrackPositionAndDirection(progress, straightLength, radius, trackPos, trackDir);
-
-        Vec3 trackRight(trackDir.z, 0, -trackDir.x);
-        Vec3 carPos = trackPos + trackRight * renderer.carLane[i];
-        carPos.y = carHeight * 0.5f;
-
-        // Store for light calculation
-        carData[i].pos = carPos;
-        carData[i].dir = trackDir;
-        carData[i].right = trackRight;
-
-        file << "AttributeBegin\n";
-        file << "    Material \"diffuse\" \"rgb reflectance\" [ 0.8 0.8 0.8 ]\n";  // Match cl3d car color
-
-        // Transform: translate then rotate to align with track direction
-        // Negate X for coordinate system conversion
-        float angle = atan2f(-trackDir.x, trackDir.z) * 180.0f / PI;
-        file << "    Translate " << -carPos.x << " " << carPos.y << " " << carPos.z << "\n";
-        file << "    Rotate " << angle << " 0 1 0\n";
-        file << "    Scale " << carWidth * 0.5f << " " << carHeight * 0.5f << " " << carLength * 0.5f << "\n";
-
-        // Unit cube centered at origin
-        file << "    Shape \"trianglemesh\"\n";
-        file << "        \"point3 P\" [\n";
-        file << "            -1 -1 -1  1 -1 -1  1 1 -1  -1 1 -1\n";
-        file << "            -1 -1  1  1 -1  1  1 1  1  -1 1  1\n";
-        file << "        ]\n";
-        file << "        \"integer indices\" [\n";
-        file << "            0 2 1  0 3 2  4 5 6  4 6 7\n";
-        file << "            0 1 5  0 5 4  2 3 7  2 7 6\n";
-        file << "            0 4 7  0 7 3  1 2 6  1 6 5\n";
-        file << "        ]\n";
-        file << "AttributeEnd\n\n";
-    }
-
-    // Headlights - calculate positions based on car positions (matches D3D12_Update)
-    file << "# Headlights (spotlights)\n";
-    int numLights = (renderer.activeLightCount > 0) ? renderer.activeLightCount : (int)renderer.numConeLights;
-    int lightsExported = 0;
-
-    for (uint32_t carIdx = 0; carIdx < renderer.numCars && lightsExported < numLights; carIdx++)
-    {
-        const CarData& car = carData[carIdx];
-
-        // Front of car
-        float frontOffset = carLength * 0.5f;
-        Vec3 frontPos = car.pos + car.dir * frontOffset;
-        frontPos.y = headlightHeight;
-
-        // Left headlight (negate X for coordinate system conversion)
-        if (lightsExported < numLights)
-        {
-            Vec3 leftOffset = car.right * (-headlightSpacing);
-            Vec3 lightPos = frontPos + leftOffset;
-            Vec3 lightTarget = lightPos + car.dir * 10.0f;
-            float coneAngle = headlightOuterAngle * 180.0f / PI;
-            float power = renderer.coneLightIntensity * renderer.headlightRange * renderer.headlightRange * 1.0f;
-
-            file << "AttributeBegin\n";
-            file << "    LightSource \"spot\"\n";
-            file << "        \"point3 from\" [ " << -lightPos.x << " " << lightPos.y << " " << lightPos.z << " ]\n";
-            file << "        \"point3 to\" [ " << -lightTarget.x << " " << lightTarget.y << " " << lightTarget.z << " ]\n";
-            file << "        \"float coneangle\" [ " << coneAngle << " ]\n";
-            file << "        \"float conedeltaangle\" [ 5 ]\n";
-            file << "        \"rgb I\" [ " << 1.5f * power << " " << 1.4f * power << " " << 1.2f * power << " ]\n";
-            file << "AttributeEnd\n\n";
-            lightsExported++;
-        }
-
-        // Right headlight (negate X for coordinate system conversion)
-        if (lightsExported < numLights)
-        {
-            Vec3 rightOffset = car.right * headlightSpacing;
-            Vec3 lightPos = frontPos + rightOffset;
-            Vec3 lightTarget = lightPos + car.dir * 10.0f;
-            float coneAngle = headlightOuterAngle * 180.0f / PI;
-            float power = renderer.coneLightIntensity * renderer.headlightRange * renderer.headlightRange * 1.0f;
-
-            file << "AttributeBegin\n";
-            file << "    LightSource \"spot\"\n";
-            file << "        \"point3 from\" [ " << -lightPos.x << " " << lightPos.y << " " << lightPos.z << " ]\n";
-            file << "        \"point3 to\" [ " << -lightTarget.x << " " << lightTarget.y << " " << lightTarget.z << " ]\n";
-            file << "        \"float coneangle\" [ " << coneAngle << " ]\n";
-            file << "        \"float conedeltaangle\" [ 5 ]\n";
-            file << "        \"rgb I\" [ " << 1.5f * power << " " << 1.4f * power << " " << 1.2f * power << " ]\n";
-            file << "AttributeEnd\n\n";
-            lightsExported++;
-        }
-    }
-
-    // pbrt-v4 no WorldEnd
-    file.close();
-
-    return true;
-}
-
 // Copy state to clipboard
 static bool CopyStateToClipboard(HWND hwnd, const D3D12Renderer& renderer)
 {
@@ -474,54 +95,19 @@ static bool PasteStateFromClipboard(HWND hwnd, D3D12Renderer& renderer)
     GlobalUnlock(hData);
     CloseClipboard();
 
-    return DeserializeState(renderer, state);
+    std::string errors;
+    bool ok = DeserializeState(renderer, state, &errors);
+    OutputDebugStringA(errors.c_str());
+    return ok;
 }
 
-// Write TGA file (uncompressed, 32-bit BGRA)
-static bool WriteTGA(const char* filename, uint32_t width, uint32_t height, const uint8_t* pixels)
+// Load a .cfg, bad lines are skipped and reported in the debug output
+static bool LoadConfig(D3D12Renderer& renderer, const char* filename)
 {
-    std::ofstream file(filename, std::ios::binary);
-    if (!file.is_open())
-        return false;
-
-    // TGA header
-    uint8_t header[18] = {};
-    header[2] = 2;  // Uncompressed true-color
-    header[12] = width & 0xFF;
-    header[13] = (width >> 8) & 0xFF;
-    header[14] = height & 0xFF;
-    header[15] = (height >> 8) & 0xFF;
-    header[16] = 32;  // 32 bits per pixel
-    header[17] = 0x20;  // Top-left origin
-
-    file.write((char*)header, sizeof(header));
-    file.write((char*)pixels, width * height * 4);
-
-    return true;
-}
-
-// Generate output filename from config filename
-// "config.cfg" -> "config_test_out.tga"
-static std::string GenerateTestOutputFilename(const std::string& configFile)
-{
-    std::string result = configFile;
-
-    // Remove .cfg extension if present
-    size_t dotPos = result.rfind(".cfg");
-    if (dotPos != std::string::npos && dotPos == result.length() - 4)
-    {
-        result = result.substr(0, dotPos);
-    }
-
-    // Also remove path, keep just the filename
-    size_t slashPos = result.rfind('/');
-    size_t backslashPos = result.rfind('\\');
-    size_t pathEnd = 0;
-    if (slashPos != std::string::npos) pathEnd = slashPos + 1;
-    if (backslashPos != std::string::npos && backslashPos >= pathEnd) pathEnd = backslashPos + 1;
-    if (pathEnd > 0) result = result.substr(pathEnd);
-
-    return result + "_test_out.tga";
+    std::string errors;
+    bool ok = LoadStateFromFile(renderer, filename, &errors);
+    OutputDebugStringA(errors.c_str());
+    return ok;
 }
 
 static float GetDeltaTime()
@@ -749,6 +335,9 @@ static void DrawImGui(float deltaTime)
     ImGui::SliderFloat("Shadow Bias", &g_Renderer.shadowBias, -0.5f, 0.5f);
     ImGui::Checkbox("Disable Shadows", &g_Renderer.disableShadows);
     ImGui::Checkbox("Use Horizon Mapping", &g_Renderer.useHorizonMapping);
+    ImGui::Checkbox("Angular Horizon (all lights)", &g_Renderer.useAngularHorizon);
+    const char* cullingModes[] = { "None", "Clustered", "Top-Down Grid" };
+    ImGui::Combo("Light Culling", &g_Renderer.lightCullingMode, cullingModes, IM_ARRAYSIZE(cullingModes));
     ImGui::Checkbox("Show Grid", &g_Renderer.showGrid);
 
     ImGui::Separator();
@@ -758,22 +347,39 @@ static void DrawImGui(float deltaTime)
 
     ImGui::Separator();
     ImGui::Checkbox("Show Headlight Debug", &g_Renderer.showDebugLights);
+    ImGui::Checkbox("Show Caster Bounds", &g_Renderer.showCasterBounds);
+    ImGui::Checkbox("Show Shadow Frusta", &g_Renderer.showShadowFrusta);
+    ImGui::Checkbox("Show Light Grid Cells", &g_Renderer.showLightGridCells);
     ImGui::Checkbox("Show Light Overlap", &g_Renderer.showLightOverlap);
     if (g_Renderer.showLightOverlap)
     {
         ImGui::SliderFloat("Overlap Max", &g_Renderer.overlapMaxCount, 1.0f, 120.0f);
         DrawHeatMapLegend(g_Renderer.overlapMaxCount);
     }
+    ImGui::Text("Cars: %u (%u lanes)", g_Renderer.numCars, g_Renderer.numLanes);
     ImGui::Text("Cone Lights: %u", g_Renderer.numConeLights);
     if (g_Renderer.activeLightCount == 0)
         g_Renderer.activeLightCount = (int)g_Renderer.numConeLights;
     ImGui::SliderInt("Active Lights", &g_Renderer.activeLightCount, 0, (int)g_Renderer.numConeLights);
+    const UploadRing& uploadRing = g_Renderer.uploadRing;
+    ImGui::Text("Upload: %.1f KB this frame, %.1f KB peak, %u buffers created",
+                uploadRing.frames.empty() ? 0.0 : uploadRing.frames[uploadRing.current].used / 1024.0,
+                uploadRing.peakUsed / 1024.0, uploadRing.growCount);
+    ImGui::Text("Debug Draw: %u vertices, %u dropped", DebugDraw_GetVertexCount(&g_Renderer.debugDraw),
+                DebugDraw_GetDroppedVertexCount(&g_Renderer.debugDraw));
 
     ImGui::Separator();
+    const ShadowAtlas& atlas = g_Renderer.shadowAtlas;
+    ImGui::Text("Shadow Atlas: %u tiles, %u dropped, max %u, %.0f%% used", atlas.tileCount, atlas.droppedCount,
+                atlas.maxTileSize, 100.0 * (double)atlas.usedTexels / ((double)SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE));
+    ImGui::Text("Shadow Casters: %llu / %llu drawn, %u tiles redrawn", (unsigned long long)g_Renderer.shadowCasters.visibleCasters,
+                (unsigned long long)g_Renderer.shadowCasters.testedCasters, g_Renderer.shadowCasters.redrawnTiles);
     ImGui::Checkbox("Show Cone Shadow Map", &g_Renderer.showShadowMapDebug);
     if (g_Renderer.showShadowMapDebug)
     {
-        ImGui::SliderInt("Shadow Map Index", &g_Renderer.debugShadowMapIndex, 0, (int)g_Renderer.numConeLights - 1);
+        ImGui::SliderInt("Shadow Map Light", &g_Renderer.debugShadowMapIndex, 0, (int)g_Renderer.numConeLights - 1);
+        if (g_Renderer.debugShadowMapIndex < (int)atlas.tiles.size())
+            ImGui::Text("Tile: %u x %u", atlas.tiles[g_Renderer.debugShadowMapIndex].size, atlas.tiles[g_Renderer.debugShadowMapIndex].size);
     }
 
     ImGui::End();
@@ -834,7 +440,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         {
             char filename[16];
             snprintf(filename, sizeof(filename), "%c.cfg", (char)wParam);
-            LoadStateFromFile(g_Renderer, filename);
+            LoadConfig(g_Renderer, filename);
         }
         return 0;
 
@@ -937,6 +543,8 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR, int nCmdShow)
     // Parse command line for .cfg file to load or -test mode
     int argc = 0;
     LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    uint32_t carCountOverride = 0;
+    uint32_t lightCountOverride = 0;
     if (argv)
     {
         for (int i = 1; i < argc; i++)
@@ -960,7 +568,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR, int nCmdShow)
                         WideCharToMultiByte(CP_UTF8, 0, argv[i + 1], -1, cfgFile, cfgLen, nullptr, nullptr);
                         g_TestConfigFile = cfgFile;
                         g_TestOutputFile = GenerateTestOutputFilename(g_TestConfigFile);
-                        LoadStateFromFile(g_Renderer, cfgFile);
+                        LoadConfig(g_Renderer, cfgFile);
                         delete[] cfgFile;
                     }
                     i++;  // Skip next argument
@@ -976,18 +584,31 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR, int nCmdShow)
                         char* cfgFile = new char[cfgLen];
                         WideCharToMultiByte(CP_UTF8, 0, argv[i + 1], -1, cfgFile, cfgLen, nullptr, nullptr);
                         g_GenerateRefConfigFile = cfgFile;
-                        LoadStateFromFile(g_Renderer, cfgFile);
+                        LoadConfig(g_Renderer, cfgFile);
                         delete[] cfgFile;
                     }
                     i++;  // Skip next argument
                 }
+                // Scene size overrides (-cars N / -lights N)
+                else if (strcmp(arg, "-cars") == 0 && i + 1 < argc)
+                {
+                    carCountOverride = (uint32_t)wcstoul(argv[i + 1], nullptr, 10);
+                    if (carCountOverride > 0) g_Renderer.carCount = carCountOverride;
+                    i++;  // Skip next argument
+                }
+                else if (strcmp(arg, "-lights") == 0 && i + 1 < argc)
+                {
+                    lightCountOverride = (uint32_t)wcstoul(argv[i + 1], nullptr, 10);
+                    if (lightCountOverride > 0) g_Renderer.lightCount = lightCountOverride;
+                    i++;  // Skip next argument
+                }
                 // Check if it's a .cfg file (for non-test loading)
                 else
                 {
                     size_t argLen = strlen(arg);
                     if (argLen > 4 && strcmp(arg + argLen - 4, ".cfg") == 0)
                     {
-                        LoadStateFromFile(g_Renderer, arg);
+                        LoadConfig(g_Renderer, arg);
                     }
                 }
                 delete[] arg;
@@ -996,6 +617,13 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, LPWSTR, int nCmdShow)
         LocalFree(argv);
     }
 
+    // Command line wins over carCount / lightCount from the configs. GPU resources
+    // follow in the next D3D12_Update.
+    if (carCountOverride > 0) g_Renderer.carCount = carCountOverride;
+    if (lightCountOverride > 0) g_Renderer.lightCount = lightCountOverride;
+    if (Simulation_NeedsInit(&g_Renderer))
+        Simulation_Init(&g_Renderer);
+
     // Handle -generate-ref mode: export and exit immediately
     if (g_GenerateRefMode)
     {
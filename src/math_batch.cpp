@@ -0,0 +1,132 @@
+#include "math_batch.h"
+#include "simd.h"
+
+// Lane type for the columns of one matrix
+#if defined(SIMD_HAS_SSE2)
+typedef FloatX4 ColumnLanes;
+#else
+typedef FloatX1 ColumnLanes;
+#endif
+
+template <typename F>
+static inline void TransformPoints(const Mat4& m, const float* x, const float* y, const float* z, uint32_t i,
+                                   float* outX, float* outY, float* outZ, float* outW)
+{
+    F px = F::Load(x + i), py = F::Load(y + i), pz = F::Load(z + i);
+    float* out[4] = { outX, outY, outZ, outW };
+    for (int r = 0; r < 4; ++r)
+    {
+        // Same order as Mat4::operator* with w = 1
+        F v = F::Set(m.m[r]) * px + F::Set(m.m[4 + r]) * py + F::Set(m.m[8 + r]) * pz + F::Set(m.m[12 + r]);
+        v.Store(out[r] + i);
+    }
+}
+
+// Normalizes (x, y, z) in place like Vec3::normalized (zero stays zero)
+template <typename F>
+static inline void Normalize(F& x, F& y, F& z)
+{
+    const F zero = F::Set(0.0f);
+    F length = Sqrt(x * x + y * y + z * z);
+    auto valid = length > zero;
+    x = Select(valid, x / length, zero);
+    y = Select(valid, y / length, zero);
+    z = Select(valid, z / length, zero);
+}
+
+// F::WIDTH matrices starting at index i, written out as Mat4
+template <typename F>
+static inline void LookAtPerspective(const LookAtPerspectiveInputs& in, uint32_t i, Mat4* outViewProj)
+{
+    // tanf has no lane version, one call per element
+    float tanHalfFov[F::WIDTH];
+    for (uint32_t k = 0; k < F::WIDTH; ++k)
+        tanHalfFov[k] = tanf(in.fovY[i + k] * 0.5f);
+
+    const F zero = F::Set(0.0f);
+    const F one = F::Set(1.0f);
+
+    // Mat4::lookAt
+    F ex = F::Load(in.eyeX + i), ey = F::Load(in.eyeY + i), ez = F::Load(in.eyeZ + i);
+    F fx = F::Load(in.targetX + i) - ex, fy = F::Load(in.targetY + i) - ey, fz = F::Load(in.targetZ + i) - ez;
+    Normalize(fx, fy, fz);
+    F upX = F::Load(in.upX + i), upY = F::Load(in.upY + i), upZ = F::Load(in.upZ + i);
+    F rx = fy * upZ - fz * upY, ry = fz * upX - fx * upZ, rz = fx * upY - fy * upX;
+    Normalize(rx, ry, rz);
+    F ux = ry * fz - rz * fy, uy = rz * fx - rx * fz, uz = rx * fy - ry * fx;
+
+    F view[16] = {
+        rx, ux, -fx, zero,
+        ry, uy, -fy, zero,
+        rz, uz, -fz, zero,
+        -(rx * ex + ry * ey + rz * ez), -(ux * ex + uy * ey + uz * ez), fx * ex + fy * ey + fz * ez, one,
+    };
+
+    // Mat4::perspective
+    F tanHalf = F::Load(tanHalfFov);
+    F nearZ = F::Load(in.nearZ + i), farZ = F::Load(in.farZ + i);
+    F proj[16] = {
+        one / (F::Load(in.aspect + i) * tanHalf), zero, zero, zero,
+        zero, one / tanHalf, zero, zero,
+        zero, zero, farZ / (nearZ - farZ), F::Set(-1.0f),
+        zero, zero, (nearZ * farZ) / (nearZ - farZ), zero,
+    };
+
+    // proj * view, every term like Mat4::operator* (zeros included, so the
+    // signs of zero results match too)
+    float lanes[16][F::WIDTH];
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            F v = proj[0 * 4 + r] * view[c * 4 + 0] + proj[1 * 4 + r] * view[c * 4 + 1] +
+                  proj[2 * 4 + r] * view[c * 4 + 2] + proj[3 * 4 + r] * view[c * 4 + 3];
+            v.Store(lanes[c * 4 + r]);
+        }
+    }
+    for (uint32_t k = 0; k < F::WIDTH; ++k)
+    {
+        for (int e = 0; e < 16; ++e)
+            outViewProj[i + k].m[e] = lanes[e][k];
+    }
+}
+
+void MathBatch_TransformPoints(const Mat4& m, const float* x, const float* y, const float* z, uint32_t count,
+                               float* outX, float* outY, float* outZ, float* outW)
+{
+    uint32_t i = 0;
+    for (; i + FloatXN::WIDTH <= count; i += FloatXN::WIDTH)
+        TransformPoints<FloatXN>(m, x, y, z, i, outX, outY, outZ, outW);
+    for (; i < count; i++)
+        TransformPoints<FloatX1>(m, x, y, z, i, outX, outY, outZ, outW);
+}
+
+void MathBatch_LookAtPerspective(const LookAtPerspectiveInputs& in, uint32_t count, Mat4* outViewProj)
+{
+    uint32_t i = 0;
+    for (; i + FloatXN::WIDTH <= count; i += FloatXN::WIDTH)
+        LookAtPerspective<FloatXN>(in, i, outViewProj);
+    for (; i < count; i++)
+        LookAtPerspective<FloatX1>(in, i, outViewProj);
+}
+
+void MathBatch_MultiplyMatrices(const Mat4* a, const Mat4* b, uint32_t count, Mat4* out)
+{
+    typedef ColumnLanes F;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        // Column c of the result is a's columns weighted by column c of b
+        Mat4 result;
+        for (int c = 0; c < 4; ++c)
+        {
+            const float* weights = &b[i].m[c * 4];
+            for (uint32_t r = 0; r < 4; r += F::WIDTH)
+            {
+                F v = F::Load(&a[i].m[0 * 4 + r]) * F::Set(weights[0]) + F::Load(&a[i].m[1 * 4 + r]) * F::Set(weights[1]) +
+                      F::Load(&a[i].m[2 * 4 + r]) * F::Set(weights[2]) + F::Load(&a[i].m[3 * 4 + r]) * F::Set(weights[3]);
+                v.Store(&result.m[c * 4 + r]);
+            }
+        }
+        out[i] = result;
+    }
+}
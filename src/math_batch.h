@@ -0,0 +1,45 @@
+#pragma once
+
+// Batch versions of the math_utils.h operations for arrays of points and
+// matrices (per-light view-projections, culling, export). Each kernel runs
+// SIMD-width groups of elements in lanes (simd.h) and gives bit-identical
+// results to the scalar Mat4 code it replaces, so callers can switch freely.
+// That holds as long as the compiler does not fuse a * b + c into FMA: MSVC
+// does not by default, GCC / Clang need -ffp-contract=off once FMA is enabled
+// (-mfma, -mavx512f). Fused builds differ in the last bits (-bench-math
+// reports by how much).
+//
+// Inputs are structure-of-arrays: one float array per component, indexed by
+// element. Matrices are stored as Mat4 (column-major), like everywhere else.
+
+#include <cstdint>
+
+#include "math_utils.h"
+
+// Parameters of MathBatch_LookAtPerspective, one entry per matrix
+struct LookAtPerspectiveInputs
+{
+    const float* eyeX;
+    const float* eyeY;
+    const float* eyeZ;
+    const float* targetX;
+    const float* targetY;
+    const float* targetZ;
+    const float* upX;
+    const float* upY;
+    const float* upZ;
+    const float* fovY;
+    const float* aspect;
+    const float* nearZ;
+    const float* farZ;
+};
+
+// out = m * (x, y, z, 1) for count points
+void MathBatch_TransformPoints(const Mat4& m, const float* x, const float* y, const float* z, uint32_t count,
+                               float* outX, float* outY, float* outZ, float* outW);
+
+// outViewProj[i] = Mat4::perspective(fovY, aspect, nearZ, farZ) * Mat4::lookAt(eye, target, up)
+void MathBatch_LookAtPerspective(const LookAtPerspectiveInputs& in, uint32_t count, Mat4* outViewProj);
+
+// out[i] = a[i] * b[i]; out may alias a or b
+void MathBatch_MultiplyMatrices(const Mat4* a, const Mat4* b, uint32_t count, Mat4* out);
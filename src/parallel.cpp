@@ -0,0 +1,122 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Set on the pool's workers and on a caller while it runs its job's items
+static thread_local bool t_InsideJob = false;
+
+struct ThreadPool
+{
+    std::mutex jobMutex;                // Held by the caller for a whole job
+    std::mutex mutex;                   // Guards the fields below
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::vector<std::thread> threads;
+    bool quit = false;
+
+    // Current job
+    uint64_t generation = 0;
+    void (*fn)(void*, uint32_t) = nullptr;
+    void* context = nullptr;
+    uint32_t count = 0;
+    uint32_t participants = 0;          // Workers [0, participants) take part
+    uint32_t active = 0;                // Participants still running
+    std::atomic<uint32_t> next{ 0 };
+
+    ThreadPool();
+    ~ThreadPool();
+};
+
+static void RunItems(ThreadPool& pool, void (*fn)(void*, uint32_t), void* context, uint32_t count)
+{
+    for (;;)
+    {
+        uint32_t i = pool.next.fetch_add(1, std::memory_order_relaxed);
+        if (i >= count)
+            break;
+        fn(context, i);
+    }
+}
+
+static void WorkerMain(ThreadPool* pool, uint32_t index)
+{
+    t_InsideJob = true;
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    for (;;)
+    {
+        pool->wake.wait(lock, [&]() { return pool->quit || pool->generation != seen; });
+        if (pool->quit)
+            return;
+        seen = pool->generation;
+        if (index >= pool->participants)
+            continue;
+
+        void (*fn)(void*, uint32_t) = pool->fn;
+        void* context = pool->context;
+        uint32_t count = pool->count;
+        lock.unlock();
+        RunItems(*pool, fn, context, count);
+        lock.lock();
+        if (--pool->active == 0)
+            pool->done.notify_one();
+    }
+}
+
+// One worker per hardware thread besides the caller
+ThreadPool::ThreadPool()
+{
+    uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    threads.reserve(hardwareThreads - 1);
+    for (uint32_t t = 0; t + 1 < hardwareThreads; ++t)
+        threads.emplace_back(WorkerMain, this, t);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void Parallel_Run(uint32_t count, void (*fn)(void* context, uint32_t i), void* context)
+{
+    if (count == 0)
+        return;
+
+    uint32_t numThreads = std::min(Parallel_GetThreadCount(), count);
+    if (numThreads <= 1 || t_InsideJob)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            fn(context, i);
+        return;
+    }
+
+    static ThreadPool pool;
+    std::lock_guard<std::mutex> job(pool.jobMutex);
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.fn = fn;
+        pool.context = context;
+        pool.count = count;
+        pool.participants = std::min(numThreads - 1, (uint32_t)pool.threads.size());
+        pool.active = pool.participants;
+        pool.next.store(0, std::memory_order_relaxed);
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+
+    t_InsideJob = true;
+    RunItems(pool, fn, context, count);
+    t_InsideJob = false;
+
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.done.wait(lock, [&]() { return pool.active == 0; });
+}
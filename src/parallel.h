@@ -0,0 +1,49 @@
+#pragma once
+
+// Minimal fork/join helper for the CPU-side passes (software rasterizer, light
+// culling, horizon maps etc.)
+//
+// The worker threads are started once, on the first ParallelFor, and then wait
+// for work, so a call costs a wake-up rather than creating and joining threads.
+// The renderer makes several calls per frame.
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+// Upper bound on the worker threads, 0 = no limit
+inline std::atomic<uint32_t> g_ParallelThreadLimit(0);
+
+// Caps the threads ParallelFor uses (benchmarks measuring scaling); 0 restores
+// one per hardware thread
+inline void Parallel_SetThreadLimit(uint32_t limit)
+{
+    g_ParallelThreadLimit.store(limit, std::memory_order_relaxed);
+}
+
+// Number of worker threads used by ParallelFor (at least 1)
+inline uint32_t Parallel_GetThreadCount()
+{
+    uint32_t count = std::thread::hardware_concurrency();
+    uint32_t limit = g_ParallelThreadLimit.load(std::memory_order_relaxed);
+    if (limit > 0 && (count == 0 || count > limit))
+        count = limit;
+    return count > 0 ? count : 1;
+}
+
+// Runs fn(context, i) for every i in [0, count) on the pool. One job runs at a
+// time: calls from other threads wait for it, and calls from inside a job (on
+// a worker or the calling thread) run serially on that thread.
+void Parallel_Run(uint32_t count, void (*fn)(void* context, uint32_t i), void* context);
+
+// Runs fn(i) for every i in [0, count). Items are handed out one at a time from
+// a shared counter so uneven work (tiles, lights) balances across threads.
+// The calling thread participates; returns when all items are done.
+template <typename Fn>
+void ParallelFor(uint32_t count, Fn&& fn)
+{
+    typedef std::remove_reference_t<Fn> Function;
+    Parallel_Run(count, [](void* context, uint32_t i) { (*(Function*)context)(i); }, (void*)std::addressof(fn));
+}
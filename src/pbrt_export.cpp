@@ -0,0 +1,440 @@
+#include "pbrt_export.h"
+#include "ply_mesh.h"
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// Bytes collected before each write to the file
+static constexpr size_t PBRT_WRITE_BLOCK_SIZE = 1 << 20;
+
+// Room for one formatted float (shortest round-trip form) and its separator
+static constexpr size_t PBRT_MAX_FLOAT_CHARS = 32;
+
+// Unit cube centered at the origin, scaled to the car size in instanced mode
+static const float g_BoxCorners[8][3] = {
+    { -1, -1, -1 }, { 1, -1, -1 }, { 1, 1, -1 }, { -1, 1, -1 },
+    { -1, -1,  1 }, { 1, -1,  1 }, { 1, 1,  1 }, { -1, 1,  1 },
+};
+static const uint32_t g_BoxTriangles[36] = {
+    0, 2, 1,  0, 3, 2,  4, 5, 6,  4, 6, 7,
+    0, 1, 5,  0, 5, 4,  2, 3, 7,  2, 7, 6,
+    0, 4, 7,  0, 7, 3,  1, 2, 6,  1, 6, 5,
+};
+static const char* g_BoxIndices =
+    "        \"integer indices\" [\n"
+    "            0 2 1  0 3 2  4 5 6  4 6 7\n"
+    "            0 1 5  0 5 4  2 3 7  2 7 6\n"
+    "            0 4 7  0 7 3  1 2 6  1 6 5\n"
+    "        ]\n";
+
+struct PbrtWriter
+{
+    std::ofstream file;
+    std::vector<char> block;
+    size_t used = 0;
+};
+
+static void Flush(PbrtWriter& w)
+{
+    w.file.write(w.block.data(), (std::streamsize)w.used);
+    w.used = 0;
+}
+
+static void Text(PbrtWriter& w, const char* text)
+{
+    size_t length = strlen(text);
+    if (w.used + length > w.block.size())
+        Flush(w);
+    if (length > w.block.size())
+    {
+        w.file.write(text, (std::streamsize)length);
+        return;
+    }
+    memcpy(w.block.data() + w.used, text, length);
+    w.used += length;
+}
+
+// Each value preceded by a space
+static void Floats(PbrtWriter& w, std::initializer_list<float> values)
+{
+    for (float value : values)
+    {
+        if (w.used + PBRT_MAX_FLOAT_CHARS > w.block.size())
+            Flush(w);
+        char* out = w.block.data() + w.used;
+        *out++ = ' ';
+        out = std::to_chars(out, w.block.data() + w.block.size(), value).ptr;
+        w.used = out - w.block.data();
+    }
+}
+
+// Car box in PBRT space: scaled to halfSize, rotated by angle (radians) about
+// Y, then moved to position, like Translate / Rotate / Scale on the unit cube
+static void AppendBox(PlyMesh& mesh, const float* halfSize, float angle, const Vec3& position)
+{
+    float c = cosf(angle), s = sinf(angle);
+    uint32_t first = (uint32_t)(mesh.positions.size() / 3);
+    for (const float* corner : g_BoxCorners)
+    {
+        float x = corner[0] * halfSize[0], y = corner[1] * halfSize[1], z = corner[2] * halfSize[2];
+        mesh.positions.push_back(position.x + c * x + s * z);
+        mesh.positions.push_back(position.y + y);
+        mesh.positions.push_back(position.z - s * x + c * z);
+    }
+    for (uint32_t index : g_BoxTriangles)
+        mesh.indices.push_back(first + index);
+}
+
+// outputPath without its extension, followed by suffix
+static std::string GetSiblingPath(const char* outputPath, const char* suffix)
+{
+    std::string path = outputPath;
+    size_t dot = path.rfind('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        path.resize(dot);
+    return path + suffix;
+}
+
+// pbrt looks files up next to the scene file, so references use the name only
+static const char* GetFileName(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return path.c_str() + ((slash == std::string::npos) ? 0 : slash + 1);
+}
+
+// Writes mesh next to outputPath as <name><suffix> and references it as a plymesh
+static bool WritePlyShape(PbrtWriter& w, const char* outputPath, const char* suffix, const PlyMesh& mesh,
+                          const char* indent)
+{
+    std::string path = GetSiblingPath(outputPath, suffix);
+    if (!PlyMesh_Write(path.c_str(), mesh))
+        return false;
+
+    Text(w, indent);
+    Text(w, "Shape \"plymesh\" \"string filename\" \"");
+    Text(w, GetFileName(path));
+    Text(w, "\"\n");
+    return true;
+}
+
+// The block is kept when one writer produces several files
+static bool OpenWriter(PbrtWriter& w, const char* path)
+{
+    w.file.open(path, std::ios::binary);
+    if (!w.file.is_open())
+        return false;
+    w.block.resize(PBRT_WRITE_BLOCK_SIZE);
+    w.used = 0;
+    return true;
+}
+
+static bool CloseWriter(PbrtWriter& w)
+{
+    Flush(w);
+    bool ok = w.file.good();
+    w.file.close();
+    return ok;
+}
+
+// Film, sampler, integrator and camera (everything before WorldBegin)
+static void WriteCamera(PbrtWriter& w, const Camera& cam, const char* filmFilename)
+{
+    Text(w, "# PBRT scene exported from cl3d\n");
+    Text(w, "# Render with: pbrt scene.pbrt\n\n");
+
+    // Film settings (match our window size)
+    Text(w, "Film \"rgb\"\n");
+    Text(w, "    \"integer xresolution\" [ 1280 ]\n");
+    Text(w, "    \"integer yresolution\" [ 720 ]\n");
+    Text(w, "    \"string filename\" \"");
+    Text(w, filmFilename);
+    Text(w, "\"\n\n");
+
+    // Sampler for quality - higher samples = less noise
+    Text(w, "Sampler \"halton\" \"integer pixelsamples\" [ 512 ]\n\n");
+
+    // Integrator - direct lighting only (maxdepth 1 = no bounces)
+    Text(w, "Integrator \"volpath\" \"integer maxdepth\" [ 1 ]\n\n");
+
+    // Camera - negate X to convert from D3D12 left-handed to PBRT right-handed
+    Vec3 forward = cam.getForward();
+    Vec3 lookAt = cam.position + forward;
+
+    Text(w, "LookAt");
+    Floats(w, { -cam.position.x, cam.position.y, cam.position.z });
+    Text(w, "  # eye\n      ");
+    Floats(w, { -lookAt.x, lookAt.y, lookAt.z });
+    Text(w, "  # look at\n");
+    Text(w, "       0 1 0  # up\n\n");
+
+    Text(w, "Camera \"perspective\"\n");
+    Text(w, "    \"float fov\" [ 60 ]\n\n");
+}
+
+// Ambient light and ground plane
+static bool WriteEnvironment(PbrtWriter& w, const SceneState& scene, const char* outputPath,
+                             const PbrtExportOptions& options)
+{
+    // Ambient light - scale down to avoid bright background (PBRT illuminates everything)
+    // cl3d ground ambient = 0.3 * 0.3 = 0.09, but we want darker background
+    float ambient = scene.ambientIntensity * 0.2f;  // Scale down significantly
+    Text(w, "# Ambient light (scaled from");
+    Floats(w, { scene.ambientIntensity });
+    Text(w, ")\n");
+    Text(w, "LightSource \"infinite\" \"rgb L\" [");
+    Floats(w, { ambient, ambient, ambient });
+    Text(w, " ]\n\n");
+
+    // Ground plane - lower reflectance for darker ambient areas
+    Text(w, "# Ground plane\n");
+    Text(w, "AttributeBegin\n");
+    float groundReflectance = 0.15f;  // Keep dark in unlit areas
+    Text(w, "    Material \"diffuse\" \"rgb reflectance\" [");
+    Floats(w, { groundReflectance, groundReflectance, groundReflectance });
+    Text(w, " ]\n");
+    if (options.plyGeometry)
+    {
+        PlyMesh ground;
+        ground.positions = { -500, 0, -500,  500, 0, -500,  500, 0, 500,  -500, 0, 500 };
+        ground.indices = { 0, 1, 2,  0, 2, 3 };
+        if (!WritePlyShape(w, outputPath, "_ground.ply", ground, "    "))
+            return false;
+    }
+    else
+    {
+        Text(w, "    Shape \"trianglemesh\"\n");
+        Text(w, "        \"point3 P\" [ -500 0 -500  500 0 -500  500 0 500  -500 0 500 ]\n");
+        Text(w, "        \"integer indices\" [ 0 1 2  0 2 3 ]\n");
+    }
+    Text(w, "AttributeEnd\n\n");
+    return true;
+}
+
+// The "car" object when instanced, or every car box already placed in the PLY
+// sidecar; nothing for inline boxes (WriteCarPlacements writes them)
+static bool WriteCarShapes(PbrtWriter& w, const SceneState& scene, const char* outputPath,
+                           const PbrtExportOptions& options)
+{
+    Text(w, "# Cars (boxes on oval track)\n");
+    const float halfSize[3] = { CAR_WIDTH * 0.5f, CAR_HEIGHT * 0.5f, CAR_LENGTH * 0.5f };
+
+    if (options.plyGeometry)
+    {
+        // One shape for all cars, or the box object the instances place
+        PlyMesh cars;
+        if (options.instanceCars)
+        {
+            AppendBox(cars, halfSize, 0.0f, Vec3());
+        }
+        else
+        {
+            cars.positions.reserve((size_t)scene.numCars * 8 * 3);
+            cars.indices.reserve((size_t)scene.numCars * 36);
+            for (uint32_t i = 0; i < scene.numCars; i++)
+            {
+                Vec3 carPos, carDir, carRight;
+                Simulation_GetCarPose(&scene, i, carPos, carDir, carRight);
+                AppendBox(cars, halfSize, atan2f(-carDir.x, carDir.z), Vec3(-carPos.x, carPos.y, carPos.z));
+            }
+        }
+
+        Text(w, "AttributeBegin\n");
+        Text(w, "    Material \"diffuse\" \"rgb reflectance\" [ 0.8 0.8 0.8 ]\n");  // Match cl3d car color
+        if (options.instanceCars)
+            Text(w, "    ObjectBegin \"car\"\n");
+        if (!WritePlyShape(w, outputPath, "_cars.ply", cars, "    "))
+            return false;
+        if (options.instanceCars)
+            Text(w, "    ObjectEnd\n");
+        Text(w, "AttributeEnd\n\n");
+    }
+    else if (options.instanceCars)
+    {
+        // The box once, already scaled to the car size (Material is bound at definition)
+        Text(w, "AttributeBegin\n");
+        Text(w, "    Material \"diffuse\" \"rgb reflectance\" [ 0.8 0.8 0.8 ]\n");  // Match cl3d car color
+        Text(w, "    ObjectBegin \"car\"\n");
+        Text(w, "    Shape \"trianglemesh\"\n");
+        Text(w, "        \"point3 P\" [\n           ");
+        for (const float* corner : g_BoxCorners)
+            Floats(w, { corner[0] * halfSize[0], corner[1] * halfSize[1], corner[2] * halfSize[2] });
+        Text(w, "\n        ]\n");
+        Text(w, g_BoxIndices);
+        Text(w, "    ObjectEnd\n");
+        Text(w, "AttributeEnd\n\n");
+    }
+    return true;
+}
+
+// One instance line per car, or the full box mesh per car when not instanced
+static void WriteCarPlacements(PbrtWriter& w, const SceneState& scene, const PbrtExportOptions& options)
+{
+    const float PI = 3.14159265f;
+    const float halfSize[3] = { CAR_WIDTH * 0.5f, CAR_HEIGHT * 0.5f, CAR_LENGTH * 0.5f };
+
+    // Pre-transformed PLY boxes need no per-car lines
+    uint32_t placedCars = (options.plyGeometry && !options.instanceCars) ? 0 : scene.numCars;
+    for (uint32_t i = 0; i < placedCars; i++)
+    {
+        Vec3 carPos, carDir, carRight;
+        Simulation_GetCarPose(&scene, i, carPos, carDir, carRight);
+
+        // Transform: translate then rotate to align with track direction
+        // Negate X for coordinate system conversion
+        float angle = atan2f(-carDir.x, carDir.z) * 180.0f / PI;
+
+        if (options.instanceCars)
+        {
+            // One line per car
+            Text(w, "AttributeBegin Translate");
+            Floats(w, { -carPos.x, carPos.y, carPos.z });
+            Text(w, " Rotate");
+            Floats(w, { angle });
+            Text(w, " 0 1 0 ObjectInstance \"car\" AttributeEnd\n");
+            continue;
+        }
+
+        Text(w, "AttributeBegin\n");
+        Text(w, "    Material \"diffuse\" \"rgb reflectance\" [ 0.8 0.8 0.8 ]\n");  // Match cl3d car color
+        Text(w, "    Translate");
+        Floats(w, { -carPos.x, carPos.y, carPos.z });
+        Text(w, "\n    Rotate");
+        Floats(w, { angle });
+        Text(w, " 0 1 0\n");
+        Text(w, "    Scale");
+        Floats(w, { halfSize[0], halfSize[1], halfSize[2] });
+        Text(w, "\n");
+
+        // Unit cube centered at origin
+        Text(w, "    Shape \"trianglemesh\"\n");
+        Text(w, "        \"point3 P\" [\n");
+        Text(w, "            -1 -1 -1  1 -1 -1  1 1 -1  -1 1 -1\n");
+        Text(w, "            -1 -1  1  1 -1  1  1 1  1  -1 1  1\n");
+        Text(w, "        ]\n");
+        Text(w, g_BoxIndices);
+        Text(w, "AttributeEnd\n\n");
+    }
+    if (options.instanceCars && placedCars > 0)
+        Text(w, "\n");
+}
+
+// Headlights (same order as the renderer: left/right per car), one line each
+static void WriteLights(PbrtWriter& w, const SceneState& scene)
+{
+    const float PI = 3.14159265f;
+    Text(w, "# Headlights (spotlights)\n");
+    int numLights = (scene.activeLightCount > 0) ? scene.activeLightCount : (int)scene.numConeLights;
+    if (numLights > (int)scene.numConeLights) numLights = (int)scene.numConeLights;
+
+    for (int i = 0; i < numLights; i++)
+    {
+        // Negate X for coordinate system conversion
+        const ConeLight& light = scene.coneLights[i];
+        Vec3 lightPos = Simulation_GetLightPosition(&scene, i);
+        Vec3 lightTarget = lightPos + Simulation_GetLightDirection(&scene, i) * 10.0f;
+        float coneAngle = light.outerAngle * 180.0f / PI;
+        float power = scene.coneLightIntensity * scene.headlightRange * scene.headlightRange * 1.0f;
+
+        Text(w, "AttributeBegin LightSource \"spot\" \"point3 from\" [");
+        Floats(w, { -lightPos.x, lightPos.y, lightPos.z });
+        Text(w, " ] \"point3 to\" [");
+        Floats(w, { -lightTarget.x, lightTarget.y, lightTarget.z });
+        Text(w, " ] \"float coneangle\" [");
+        Floats(w, { coneAngle });
+        Text(w, " ] \"float conedeltaangle\" [ 5 ] \"rgb I\" [");
+        Floats(w, { light.color.x * power, light.color.y * power, light.color.z * power });
+        Text(w, " ] AttributeEnd\n");
+    }
+}
+
+// Export scene to PBRT format for reference raytracer
+bool ExportToPBRT(const SceneState& scene, const char* outputPath, const PbrtExportOptions& options)
+{
+    PbrtWriter w;
+    if (!OpenWriter(w, outputPath))
+        return false;
+
+    WriteCamera(w, scene.camera, "render.exr");
+
+    // Begin world
+    Text(w, "WorldBegin\n\n");
+    if (!WriteEnvironment(w, scene, outputPath, options) || !WriteCarShapes(w, scene, outputPath, options))
+        return false;
+    WriteCarPlacements(w, scene, options);
+    WriteLights(w, scene);
+
+    // pbrt-v4 no WorldEnd
+    return CloseWriter(w);
+}
+
+// Linear between the keys around frame, held before the first and after the last
+static void InterpolateCamera(const std::vector<PbrtCameraKey>& keys, uint32_t frame, Camera* camera)
+{
+    size_t next = 0;
+    while (next < keys.size() && keys[next].frame <= frame)
+        next++;
+    const PbrtCameraKey& a = keys[(next > 0) ? next - 1 : 0];
+    const PbrtCameraKey& b = keys[(next < keys.size()) ? next : keys.size() - 1];
+    float t = (b.frame > a.frame) ? (float)(frame - a.frame) / (float)(b.frame - a.frame) : 0.0f;
+
+    camera->position = a.position + (b.position - a.position) * t;
+    camera->yaw = a.yaw + (b.yaw - a.yaw) * t;
+    camera->pitch = a.pitch + (b.pitch - a.pitch) * t;
+}
+
+bool ExportAnimationToPBRT(SceneState* scene, const char* outputPath, const PbrtAnimationOptions& animation)
+{
+    // Frames only move instances, so the car box is always one shared object
+    PbrtExportOptions options = animation.exportOptions;
+    options.instanceCars = true;
+
+    PbrtWriter w;
+    std::string sharedPath = GetSiblingPath(outputPath, "_shared.pbrt");
+    if (!OpenWriter(w, sharedPath.c_str()))
+        return false;
+    Text(w, "# Geometry shared by the frames of a cl3d animation export\n\n");
+    if (!WriteEnvironment(w, *scene, outputPath, options) || !WriteCarShapes(w, *scene, outputPath, options) ||
+        !CloseWriter(w))
+        return false;
+
+    Camera camera = scene->camera;
+    uint64_t stepsDone = 0;
+    char suffix[32];
+    for (uint32_t frame = 0; frame < animation.frameCount; ++frame)
+    {
+        // Steps counted from the first frame so rounding does not drift
+        double time = (double)frame * animation.frameStep;
+        uint64_t steps = (time > 0.0) ? (uint64_t)llround(time / SIMULATION_STEP) : 0;
+        if (steps > stepsDone)
+        {
+            Simulation_AdvanceSteps(scene, steps - stepsDone);
+            stepsDone = steps;
+        }
+        if (!animation.cameraKeys.empty())
+            InterpolateCamera(animation.cameraKeys, frame, &camera);
+
+        snprintf(suffix, sizeof(suffix), "_%04u.exr", frame);
+        std::string filmPath = GetSiblingPath(outputPath, suffix);
+        snprintf(suffix, sizeof(suffix), "_%04u.pbrt", frame);
+        std::string framePath = GetSiblingPath(outputPath, suffix);
+        if (!OpenWriter(w, framePath.c_str()))
+            return false;
+
+        WriteCamera(w, camera, GetFileName(filmPath));
+        Text(w, "WorldBegin\n\n");
+        Text(w, "Include \"");
+        Text(w, GetFileName(sharedPath));
+        Text(w, "\"\n\n");
+        WriteCarPlacements(w, *scene, options);
+        WriteLights(w, *scene);
+        if (!CloseWriter(w))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Export of the current scene to a pbrt-v4 scene file, used to render the
+// reference images for test_runner.py
+//
+// The file is assembled in one large block with numbers formatted in place
+// (std::to_chars), and the block is written out whenever it fills, so large
+// scenes cost a few writes instead of millions of stream insertions.
+//
+// Animations split the scene in two: <name>_shared.pbrt holds what does not
+// change (ambient light, ground, the car object) and is written once; each
+// <name>_NNNN.pbrt frame includes it and adds only its camera, car instance
+// transforms and headlights, so a frame costs about as much as the instance
+// and light lines alone.
+
+#include "scene.h"
+#include <vector>
+
+struct PbrtExportOptions
+{
+    // Car boxes as one shared object (ObjectBegin) placed per car with
+    // ObjectInstance, instead of a full triangle mesh per car
+    bool instanceCars = true;
+
+    // Ground and car geometry in binary PLY sidecars next to outputPath
+    // (<name>_ground.ply, <name>_cars.ply) read with Shape "plymesh", instead
+    // of inline text. Without instancing the car file holds every box already
+    // transformed, so the scene file has no per-car lines at all.
+    bool plyGeometry = false;
+};
+
+// Writes camera, ground, cars and the active headlights to outputPath.
+// Car and light placement is read from the simulation state.
+bool ExportToPBRT(const SceneState& scene, const char* outputPath, const PbrtExportOptions& options = PbrtExportOptions());
+
+// Camera pose at one frame of an animation
+struct PbrtCameraKey
+{
+    uint32_t frame;
+    Vec3 position;
+    float yaw;
+    float pitch;
+};
+
+struct PbrtAnimationOptions
+{
+    uint32_t frameCount = 1;
+
+    // Simulated seconds between frames (rounded to whole SIMULATION_STEPs from
+    // the first frame), 0 for a still scene
+    float frameStep = 1.0f / 30.0f;
+
+    // Sorted by frame, interpolated linearly in position, yaw and pitch; the
+    // scene's camera for every frame when empty
+    std::vector<PbrtCameraKey> cameraKeys;
+
+    // Cars are always instanced (frames differ only in instance transforms)
+    PbrtExportOptions exportOptions;
+};
+
+// Writes frameCount frames starting at the current simulation state, which is
+// advanced in place (scene is left at the last frame). Film names follow the
+// frames (<name>_NNNN.exr).
+bool ExportAnimationToPBRT(SceneState* scene, const char* outputPath, const PbrtAnimationOptions& animation);
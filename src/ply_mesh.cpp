@@ -0,0 +1,121 @@
+#include "ply_mesh.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Bytes per vertex (3 floats) and per face (count byte + 3 ints)
+static constexpr size_t PLY_VERTEX_SIZE = 12;
+static constexpr size_t PLY_FACE_SIZE = 13;
+
+// Lines of the header PlyMesh_Write produces
+static constexpr int PLY_MAX_HEADER_LINES = 10;
+
+// Little-endian regardless of the host
+static void PutUint32(uint8_t* out, uint32_t v)
+{
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+    out[2] = (uint8_t)(v >> 16);
+    out[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t GetUint32(const uint8_t* in)
+{
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static std::string GetHeader(size_t vertexCount, size_t faceCount)
+{
+    char header[256];
+    snprintf(header, sizeof(header),
+             "ply\n"
+             "format binary_little_endian 1.0\n"
+             "element vertex %zu\n"
+             "property float x\n"
+             "property float y\n"
+             "property float z\n"
+             "element face %zu\n"
+             "property list uchar int vertex_indices\n"
+             "end_header\n",
+             vertexCount, faceCount);
+    return header;
+}
+
+bool PlyMesh_Write(const char* path, const PlyMesh& mesh)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    size_t vertexCount = mesh.positions.size() / 3;
+    size_t faceCount = mesh.indices.size() / 3;
+    std::string header = GetHeader(vertexCount, faceCount);
+
+    // Whole file in one block
+    std::vector<uint8_t> data(header.size() + vertexCount * PLY_VERTEX_SIZE + faceCount * PLY_FACE_SIZE);
+    memcpy(data.data(), header.data(), header.size());
+    uint8_t* out = data.data() + header.size();
+    for (size_t i = 0; i < vertexCount * 3; ++i, out += 4)
+    {
+        uint32_t bits;
+        memcpy(&bits, &mesh.positions[i], sizeof(bits));
+        PutUint32(out, bits);
+    }
+    for (size_t f = 0; f < faceCount; ++f)
+    {
+        *out++ = 3;
+        for (int k = 0; k < 3; ++k, out += 4)
+            PutUint32(out, mesh.indices[f * 3 + k]);
+    }
+
+    file.write((const char*)data.data(), (std::streamsize)data.size());
+    return file.good();
+}
+
+bool PlyMesh_Read(const char* path, PlyMesh* mesh)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    // The header must be exactly what PlyMesh_Write produces for its counts
+    std::string header, line;
+    size_t vertexCount = 0, faceCount = 0;
+    for (int i = 0; i < PLY_MAX_HEADER_LINES && line != "end_header"; ++i)
+    {
+        if (!std::getline(file, line))
+            return false;
+        header += line + "\n";
+        sscanf(line.c_str(), "element vertex %zu", &vertexCount);
+        sscanf(line.c_str(), "element face %zu", &faceCount);
+    }
+    if (header != GetHeader(vertexCount, faceCount))
+        return false;
+
+    std::vector<uint8_t> data(vertexCount * PLY_VERTEX_SIZE + faceCount * PLY_FACE_SIZE);
+    if (!file.read((char*)data.data(), (std::streamsize)data.size()) || file.peek() != EOF)
+        return false;
+
+    const uint8_t* in = data.data();
+    mesh->positions.resize(vertexCount * 3);
+    for (size_t i = 0; i < vertexCount * 3; ++i, in += 4)
+    {
+        uint32_t bits = GetUint32(in);
+        memcpy(&mesh->positions[i], &bits, sizeof(bits));
+    }
+    mesh->indices.resize(faceCount * 3);
+    for (size_t f = 0; f < faceCount; ++f)
+    {
+        if (*in++ != 3)
+            return false;
+        for (int k = 0; k < 3; ++k, in += 4)
+        {
+            uint32_t index = GetUint32(in);
+            if (index >= vertexCount)
+                return false;
+            mesh->indices[f * 3 + k] = index;
+        }
+    }
+    return true;
+}
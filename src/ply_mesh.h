@@ -0,0 +1,21 @@
+#pragma once
+
+// Triangle meshes as binary little-endian PLY files (float x, y, z per vertex,
+// uchar / int index lists per face), the layout pbrt's "plymesh" shape parses
+// fastest. The PBRT export writes large scenes' geometry as PLY sidecars.
+
+#include <cstdint>
+#include <vector>
+
+struct PlyMesh
+{
+    std::vector<float> positions;       // x, y, z per vertex
+    std::vector<uint32_t> indices;      // Three per triangle
+};
+
+// Writes mesh to path, false if the file cannot be written
+bool PlyMesh_Write(const char* path, const PlyMesh& mesh);
+
+// Reads a file in the layout PlyMesh_Write produces (any other element or
+// property layout is rejected), false on errors
+bool PlyMesh_Read(const char* path, PlyMesh* mesh);
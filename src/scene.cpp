@@ -0,0 +1,538 @@
+#include "scene.h"
+#include "simd.h"
+#include <cmath>
+
+// Add a rotated box aligned to a direction (forward = direction of travel)
+static void AddOrientedBox(std::vector<Vertex>& verts, std::vector<uint32_t>& inds,
+                           const Vec3& center, const Vec3& forward, float sx, float sy, float sz)
+{
+    // Build orientation basis
+    Vec3 fwd = forward.normalized();
+    Vec3 up(0, 1, 0);
+    Vec3 right = cross(up, fwd).normalized();  // Changed order for correct handedness
+
+    // Box half-sizes: X=width, Y=height, Z=length (forward)
+    float hx = sx * 0.5f;
+    float hy = sy * 0.5f;
+    float hz = sz * 0.5f;
+
+    uint32_t base = (uint32_t)verts.size();
+
+    // Helper to transform local position to world
+    auto toWorld = [&](float lx, float ly, float lz) -> Vec3 {
+        return center + right * lx + up * ly + fwd * lz;
+    };
+
+    // Helper to transform local normal to world
+    auto normalToWorld = [&](float nx, float ny, float nz) -> Vec3 {
+        return (right * nx + up * ny + fwd * nz).normalized();
+    };
+
+    // Front face (forward +Z local = +fwd world)
+    Vec3 nFront = normalToWorld(0, 0, 1);
+    Vec3 p0 = toWorld(-hx, -hy, hz); verts.push_back({{p0.x, p0.y, p0.z}, {nFront.x, nFront.y, nFront.z}, {0,0}});
+    Vec3 p1 = toWorld( hx, -hy, hz); verts.push_back({{p1.x, p1.y, p1.z}, {nFront.x, nFront.y, nFront.z}, {1,0}});
+    Vec3 p2 = toWorld( hx,  hy, hz); verts.push_back({{p2.x, p2.y, p2.z}, {nFront.x, nFront.y, nFront.z}, {1,1}});
+    Vec3 p3 = toWorld(-hx,  hy, hz); verts.push_back({{p3.x, p3.y, p3.z}, {nFront.x, nFront.y, nFront.z}, {0,1}});
+
+    // Back face (-Z local = -fwd world)
+    Vec3 nBack = normalToWorld(0, 0, -1);
+    Vec3 p4 = toWorld( hx, -hy, -hz); verts.push_back({{p4.x, p4.y, p4.z}, {nBack.x, nBack.y, nBack.z}, {0,0}});
+    Vec3 p5 = toWorld(-hx, -hy, -hz); verts.push_back({{p5.x, p5.y, p5.z}, {nBack.x, nBack.y, nBack.z}, {1,0}});
+    Vec3 p6 = toWorld(-hx,  hy, -hz); verts.push_back({{p6.x, p6.y, p6.z}, {nBack.x, nBack.y, nBack.z}, {1,1}});
+    Vec3 p7 = toWorld( hx,  hy, -hz); verts.push_back({{p7.x, p7.y, p7.z}, {nBack.x, nBack.y, nBack.z}, {0,1}});
+
+    // Right face (+X local = +right world)
+    Vec3 nRight = normalToWorld(1, 0, 0);
+    Vec3 p8  = toWorld(hx, -hy,  hz); verts.push_back({{p8.x,  p8.y,  p8.z},  {nRight.x, nRight.y, nRight.z}, {0,0}});
+    Vec3 p9  = toWorld(hx, -hy, -hz); verts.push_back({{p9.x,  p9.y,  p9.z},  {nRight.x, nRight.y, nRight.z}, {1,0}});
+    Vec3 p10 = toWorld(hx,  hy, -hz); verts.push_back({{p10.x, p10.y, p10.z}, {nRight.x, nRight.y, nRight.z}, {1,1}});
+    Vec3 p11 = toWorld(hx,  hy,  hz); verts.push_back({{p11.x, p11.y, p11.z}, {nRight.x, nRight.y, nRight.z}, {0,1}});
+
+    // Left face (-X local = -right world)
+    Vec3 nLeft = normalToWorld(-1, 0, 0);
+    Vec3 p12 = toWorld(-hx, -hy, -hz); verts.push_back({{p12.x, p12.y, p12.z}, {nLeft.x, nLeft.y, nLeft.z}, {0,0}});
+    Vec3 p13 = toWorld(-hx, -hy,  hz); verts.push_back({{p13.x, p13.y, p13.z}, {nLeft.x, nLeft.y, nLeft.z}, {1,0}});
+    Vec3 p14 = toWorld(-hx,  hy,  hz); verts.push_back({{p14.x, p14.y, p14.z}, {nLeft.x, nLeft.y, nLeft.z}, {1,1}});
+    Vec3 p15 = toWorld(-hx,  hy, -hz); verts.push_back({{p15.x, p15.y, p15.z}, {nLeft.x, nLeft.y, nLeft.z}, {0,1}});
+
+    // Top face (+Y local = +up world)
+    Vec3 nTop = normalToWorld(0, 1, 0);
+    Vec3 p16 = toWorld(-hx, hy,  hz); verts.push_back({{p16.x, p16.y, p16.z}, {nTop.x, nTop.y, nTop.z}, {0,0}});
+    Vec3 p17 = toWorld( hx, hy,  hz); verts.push_back({{p17.x, p17.y, p17.z}, {nTop.x, nTop.y, nTop.z}, {1,0}});
+    Vec3 p18 = toWorld( hx, hy, -hz); verts.push_back({{p18.x, p18.y, p18.z}, {nTop.x, nTop.y, nTop.z}, {1,1}});
+    Vec3 p19 = toWorld(-hx, hy, -hz); verts.push_back({{p19.x, p19.y, p19.z}, {nTop.x, nTop.y, nTop.z}, {0,1}});
+
+    // Bottom face (-Y local = -up world)
+    Vec3 nBottom = normalToWorld(0, -1, 0);
+    Vec3 p20 = toWorld(-hx, -hy, -hz); verts.push_back({{p20.x, p20.y, p20.z}, {nBottom.x, nBottom.y, nBottom.z}, {0,0}});
+    Vec3 p21 = toWorld( hx, -hy, -hz); verts.push_back({{p21.x, p21.y, p21.z}, {nBottom.x, nBottom.y, nBottom.z}, {1,0}});
+    Vec3 p22 = toWorld( hx, -hy,  hz); verts.push_back({{p22.x, p22.y, p22.z}, {nBottom.x, nBottom.y, nBottom.z}, {1,1}});
+    Vec3 p23 = toWorld(-hx, -hy,  hz); verts.push_back({{p23.x, p23.y, p23.z}, {nBottom.x, nBottom.y, nBottom.z}, {0,1}});
+
+    // Indices for 6 faces (2 triangles each)
+    uint32_t faceIndices[] = {
+        0, 2, 1, 0, 3, 2,       // front
+        4, 6, 5, 4, 7, 6,       // back
+        8, 10, 9, 8, 11, 10,    // right
+        12, 14, 13, 12, 15, 14, // left
+        16, 18, 17, 16, 19, 18, // top
+        20, 22, 21, 20, 23, 22  // bottom
+    };
+
+    for (uint32_t i : faceIndices)
+        inds.push_back(base + i);
+}
+
+// Ground plane quad (SCENE_GROUND_VERTEX_COUNT vertices, SCENE_GROUND_INDEX_COUNT indices)
+static void AddGroundPlane(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    const float planeSize = 1000.0f;
+    const float halfPlane = planeSize * 0.5f;
+
+    uint32_t planeBase = (uint32_t)vertices.size();
+    vertices.push_back({{ -halfPlane, 0, -halfPlane }, { 0, 1, 0 }, { 0, 0 }});
+    vertices.push_back({{  halfPlane, 0, -halfPlane }, { 0, 1, 0 }, { 1, 0 }});
+    vertices.push_back({{  halfPlane, 0,  halfPlane }, { 0, 1, 0 }, { 1, 1 }});
+    vertices.push_back({{ -halfPlane, 0,  halfPlane }, { 0, 1, 0 }, { 0, 1 }});
+
+    indices.push_back(planeBase + 0);
+    indices.push_back(planeBase + 1);
+    indices.push_back(planeBase + 2);
+    indices.push_back(planeBase + 0);
+    indices.push_back(planeBase + 2);
+    indices.push_back(planeBase + 3);
+}
+
+// Initializes the simulation if needed and derives the car AABB, the top-down
+// view and the horizon map bounds from the track
+static void SetupSceneBounds(SceneState* scene)
+{
+    // Cars and headlights come from the simulation (kept if already set up for
+    // the requested size, e.g. after loading a config that changed it)
+    if (Simulation_NeedsInit(scene))
+        Simulation_Init(scene);
+
+    // Initialize AABB for track bounds, widened when extra outer lanes are in use
+    const float straightLength = scene->trackStraightLength;
+    const float radius = scene->trackRadius;
+    float laneExtent = Simulation_GetLaneOffset(scene, scene->numLanes - 1) + CAR_LENGTH;
+    float margin = (laneExtent > 20.0f) ? laneExtent : 20.0f;
+    scene->carAABB.min = Vec3(-straightLength * 0.5f - radius - margin, 0, -radius - margin);
+    scene->carAABB.max = Vec3(straightLength * 0.5f + radius + margin, CAR_HEIGHT, radius + margin);
+
+    // Calculate top-down orthographic view-projection matrix from AABB
+    float padding = 20.0f;
+    float halfWidth = (scene->carAABB.max.x - scene->carAABB.min.x) * 0.5f + padding;
+    float halfDepth = (scene->carAABB.max.z - scene->carAABB.min.z) * 0.5f + padding;
+
+    // Use the larger dimension for both axes to maintain 1:1 world space aspect ratio
+    float halfSize = (halfWidth > halfDepth) ? halfWidth : halfDepth;
+
+    // Create top-down view matrix (looking down from above)
+    float viewHeight = scene->carAABB.max.y + 50.0f;
+    Vec3 eyePos(
+        (scene->carAABB.min.x + scene->carAABB.max.x) * 0.5f,
+        viewHeight,
+        (scene->carAABB.min.z + scene->carAABB.max.z) * 0.5f
+    );
+    Vec3 targetPos(eyePos.x, 0, eyePos.z);
+    Vec3 upDir(0, 0, -1);  // Z- is "up" when looking down
+
+    Mat4 topDownView = Mat4::lookAt(eyePos, targetPos, upDir);
+
+    // Orthographic projection bounds are in view space after lookAt transform
+    // View X = world X, View Y = world -Z, View Z = world -Y (depth)
+    // Use same size for both axes for 1:1 aspect ratio
+    float nearZ = 0.1f;
+    float farZ = viewHeight + 10.0f;  // Far enough to capture ground
+
+    Mat4 topDownProj = Mat4::orthographic(-halfSize, halfSize, -halfSize, halfSize, nearZ, farZ);
+    scene->topDownViewProj = topDownProj * topDownView;
+
+    // Store horizon mapping world bounds (matches the top-down view)
+    scene->horizonWorldMin = Vec3(eyePos.x - halfSize, 0, eyePos.z - halfSize);
+    scene->horizonWorldSize = halfSize * 2.0f;
+
+    // World Y values at the top-down depth buffer extremes (orthographic, so depth is linear)
+    scene->topDownNearPlaneY = viewHeight - nearZ;
+    scene->topDownFarPlaneY = viewHeight - farZ;
+}
+
+void Scene_BuildGeometry(SceneState* scene, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    vertices.clear();
+    indices.clear();
+    AddGroundPlane(vertices, indices);
+    SetupSceneBounds(scene);
+
+    // Add car boxes aligned to track direction
+    for (uint32_t i = 0; i < scene->numCars; i++)
+    {
+        Vec3 carPos, carDir, carRight;
+        Simulation_GetCarPose(scene, i, carPos, carDir, carRight);
+        AddOrientedBox(vertices, indices, carPos, carDir, CAR_WIDTH, CAR_HEIGHT, CAR_LENGTH);
+    }
+}
+
+void Scene_BuildInstancedGeometry(SceneState* scene, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    vertices.clear();
+    indices.clear();
+    AddGroundPlane(vertices, indices);
+    SetupSceneBounds(scene);
+
+    // One car box in car space: centered on the car's XZ position, resting on
+    // the ground, facing +Z
+    AddOrientedBox(vertices, indices, Vec3(0.0f, CAR_HEIGHT * 0.5f, 0.0f), Vec3(0.0f, 0.0f, 1.0f),
+                   CAR_WIDTH, CAR_HEIGHT, CAR_LENGTH);
+}
+
+// Update a single oriented box's vertices in place
+static void UpdateOrientedBoxVertices(Vertex* verts, const Vec3& center, const Vec3& forward,
+                                       float sx, float sy, float sz)
+{
+    // Build orientation basis
+    Vec3 fwd = forward.normalized();
+    Vec3 up(0, 1, 0);
+    Vec3 right = cross(up, fwd).normalized();  // Changed order for correct handedness
+
+    // Box half-sizes: X=width, Y=height, Z=length (forward)
+    float hx = sx * 0.5f;
+    float hy = sy * 0.5f;
+    float hz = sz * 0.5f;
+
+    // Helper to transform local position to world
+    auto toWorld = [&](float lx, float ly, float lz) -> Vec3 {
+        return center + right * lx + up * ly + fwd * lz;
+    };
+
+    // Helper to transform local normal to world
+    auto normalToWorld = [&](float nx, float ny, float nz) -> Vec3 {
+        return (right * nx + up * ny + fwd * nz).normalized();
+    };
+
+    int v = 0;
+
+    // Front face (forward +Z local = +fwd world)
+    Vec3 nFront = normalToWorld(0, 0, 1);
+    Vec3 p0 = toWorld(-hx, -hy, hz); verts[v++] = {{p0.x, p0.y, p0.z}, {nFront.x, nFront.y, nFront.z}, {0,0}};
+    Vec3 p1 = toWorld( hx, -hy, hz); verts[v++] = {{p1.x, p1.y, p1.z}, {nFront.x, nFront.y, nFront.z}, {1,0}};
+    Vec3 p2 = toWorld( hx,  hy, hz); verts[v++] = {{p2.x, p2.y, p2.z}, {nFront.x, nFront.y, nFront.z}, {1,1}};
+    Vec3 p3 = toWorld(-hx,  hy, hz); verts[v++] = {{p3.x, p3.y, p3.z}, {nFront.x, nFront.y, nFront.z}, {0,1}};
+
+    // Back face (-Z local = -fwd world)
+    Vec3 nBack = normalToWorld(0, 0, -1);
+    Vec3 p4 = toWorld( hx, -hy, -hz); verts[v++] = {{p4.x, p4.y, p4.z}, {nBack.x, nBack.y, nBack.z}, {0,0}};
+    Vec3 p5 = toWorld(-hx, -hy, -hz); verts[v++] = {{p5.x, p5.y, p5.z}, {nBack.x, nBack.y, nBack.z}, {1,0}};
+    Vec3 p6 = toWorld(-hx,  hy, -hz); verts[v++] = {{p6.x, p6.y, p6.z}, {nBack.x, nBack.y, nBack.z}, {1,1}};
+    Vec3 p7 = toWorld( hx,  hy, -hz); verts[v++] = {{p7.x, p7.y, p7.z}, {nBack.x, nBack.y, nBack.z}, {0,1}};
+
+    // Right face (+X local = +right world)
+    Vec3 nRight = normalToWorld(1, 0, 0);
+    Vec3 p8  = toWorld(hx, -hy,  hz); verts[v++] = {{p8.x,  p8.y,  p8.z},  {nRight.x, nRight.y, nRight.z}, {0,0}};
+    Vec3 p9  = toWorld(hx, -hy, -hz); verts[v++] = {{p9.x,  p9.y,  p9.z},  {nRight.x, nRight.y, nRight.z}, {1,0}};
+    Vec3 p10 = toWorld(hx,  hy, -hz); verts[v++] = {{p10.x, p10.y, p10.z}, {nRight.x, nRight.y, nRight.z}, {1,1}};
+    Vec3 p11 = toWorld(hx,  hy,  hz); verts[v++] = {{p11.x, p11.y, p11.z}, {nRight.x, nRight.y, nRight.z}, {0,1}};
+
+    // Left face (-X local = -right world)
+    Vec3 nLeft = normalToWorld(-1, 0, 0);
+    Vec3 p12 = toWorld(-hx, -hy, -hz); verts[v++] = {{p12.x, p12.y, p12.z}, {nLeft.x, nLeft.y, nLeft.z}, {0,0}};
+    Vec3 p13 = toWorld(-hx, -hy,  hz); verts[v++] = {{p13.x, p13.y, p13.z}, {nLeft.x, nLeft.y, nLeft.z}, {1,0}};
+    Vec3 p14 = toWorld(-hx,  hy,  hz); verts[v++] = {{p14.x, p14.y, p14.z}, {nLeft.x, nLeft.y, nLeft.z}, {1,1}};
+    Vec3 p15 = toWorld(-hx,  hy, -hz); verts[v++] = {{p15.x, p15.y, p15.z}, {nLeft.x, nLeft.y, nLeft.z}, {0,1}};
+
+    // Top face (+Y local = +up world)
+    Vec3 nTop = normalToWorld(0, 1, 0);
+    Vec3 p16 = toWorld(-hx, hy,  hz); verts[v++] = {{p16.x, p16.y, p16.z}, {nTop.x, nTop.y, nTop.z}, {0,0}};
+    Vec3 p17 = toWorld( hx, hy,  hz); verts[v++] = {{p17.x, p17.y, p17.z}, {nTop.x, nTop.y, nTop.z}, {1,0}};
+    Vec3 p18 = toWorld( hx, hy, -hz); verts[v++] = {{p18.x, p18.y, p18.z}, {nTop.x, nTop.y, nTop.z}, {1,1}};
+    Vec3 p19 = toWorld(-hx, hy, -hz); verts[v++] = {{p19.x, p19.y, p19.z}, {nTop.x, nTop.y, nTop.z}, {0,1}};
+
+    // Bottom face (-Y local = -up world)
+    Vec3 nBottom = normalToWorld(0, -1, 0);
+    Vec3 p20 = toWorld(-hx, -hy, -hz); verts[v++] = {{p20.x, p20.y, p20.z}, {nBottom.x, nBottom.y, nBottom.z}, {0,0}};
+    Vec3 p21 = toWorld( hx, -hy, -hz); verts[v++] = {{p21.x, p21.y, p21.z}, {nBottom.x, nBottom.y, nBottom.z}, {1,0}};
+    Vec3 p22 = toWorld( hx, -hy,  hz); verts[v++] = {{p22.x, p22.y, p22.z}, {nBottom.x, nBottom.y, nBottom.z}, {1,1}};
+    Vec3 p23 = toWorld(-hx, -hy,  hz); verts[v++] = {{p23.x, p23.y, p23.z}, {nBottom.x, nBottom.y, nBottom.z}, {0,1}};
+}
+
+void Scene_WriteCarVertices(const SceneState* scene, Vertex* carVertices)
+{
+    for (uint32_t i = 0; i < scene->numCars; i++)
+    {
+        Vec3 carPos, carDir, carRight;
+        Simulation_GetCarPose(scene, i, carPos, carDir, carRight);
+        UpdateOrientedBoxVertices(carVertices + (i * VERTS_PER_BOX), carPos, carDir, CAR_WIDTH, CAR_HEIGHT, CAR_LENGTH);
+    }
+}
+
+void Scene_WriteCarInstances(const SceneState* scene, CarInstance* instances)
+{
+    // Identity: right = +X, forward = +Z
+    instances[0] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    for (uint32_t i = 0; i < scene->numCars; i++)
+    {
+        Vec3 dir = Vec3(scene->carDirX[i], 0.0f, scene->carDirZ[i]).normalized();
+        instances[SCENE_FIRST_CAR_INSTANCE + i] = { scene->carPosX[i], scene->carPosZ[i], dir.x, dir.z };
+    }
+}
+
+void Scene_TransformInstanceVertex(const CarInstance& instance, const Vertex& local, Vertex& out)
+{
+    // right = cross(up, forward), same basis as AddOrientedBox
+    float rightX = instance.dirZ, rightZ = -instance.dirX;
+    const float* p = local.position;
+    const float* n = local.normal;
+    out.position[0] = instance.posX + rightX * p[0] + instance.dirX * p[2];
+    out.position[1] = p[1];
+    out.position[2] = instance.posZ + rightZ * p[0] + instance.dirZ * p[2];
+    out.normal[0] = rightX * n[0] + instance.dirX * n[2];
+    out.normal[1] = n[1];
+    out.normal[2] = rightZ * n[0] + instance.dirZ * n[2];
+    out.uv[0] = local.uv[0];
+    out.uv[1] = local.uv[1];
+}
+
+void Scene_BuildDebugConeMesh(std::vector<DebugVertex>& vertices)
+{
+    vertices.clear();
+    const DebugVertex apex = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f } };
+
+    // Unit circle at z = 1, computed once here instead of per light
+    DebugVertex circle[SCENE_DEBUG_CONE_SEGMENTS + 1];
+    for (uint32_t j = 0; j <= SCENE_DEBUG_CONE_SEGMENTS; ++j)
+    {
+        float angle = (float)j / (float)SCENE_DEBUG_CONE_SEGMENTS * 6.28318f;
+        circle[j] = { { cosf(angle), sinf(angle), 1.0f }, { 1.0f, 1.0f, 0.0f } };
+    }
+
+    for (uint32_t j = 0; j < SCENE_DEBUG_CONE_SEGMENTS; ++j)
+    {
+        // Line from apex to edge
+        vertices.push_back(apex);
+        vertices.push_back(circle[j]);
+
+        // Line around the circle edge
+        vertices.push_back(circle[j]);
+        vertices.push_back(circle[j + 1]);
+    }
+
+    // Direction line (center axis)
+    vertices.push_back({ { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } });
+    vertices.push_back({ { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f } });
+}
+
+void Scene_WriteDebugConeInstances(const SceneState* scene, DebugConeInstance* instances)
+{
+    float range = scene->headlightRange;
+    for (uint32_t i = 0; i < scene->numConeLights; ++i)
+    {
+        Vec3 pos = Simulation_GetLightPosition(scene, i);
+        Vec3 dir = Simulation_GetLightDirection(scene, i);
+
+        // Basis perpendicular to the direction
+        Vec3 up = (fabsf(dir.y) < 0.99f) ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+        Vec3 right = cross(dir, up).normalized();
+        up = cross(right, dir).normalized();
+
+        // Cone end radius at range distance
+        float endRadius = range * tanf(scene->coneLights[i].outerAngle);
+        Vec3 axisX = right * endRadius;
+        Vec3 axisY = up * endRadius;
+        Vec3 axisZ = dir * range;
+
+        DebugConeInstance& instance = instances[i];
+        instance = { { axisX.x, axisX.y, axisX.z }, { axisY.x, axisY.y, axisY.z },
+                     { axisZ.x, axisZ.y, axisZ.z }, { pos.x, pos.y, pos.z } };
+    }
+}
+
+uint32_t Scene_GetActiveLightCount(const SceneState* scene)
+{
+    // Use activeLightCount for rendering (debug slider)
+    uint32_t lightCount = (uint32_t)scene->activeLightCount;
+    if (lightCount > scene->numConeLights) lightCount = scene->numConeLights;
+    return lightCount;
+}
+
+uint32_t Scene_GetShadowedLightCount(const SceneState* scene)
+{
+    uint32_t lightCount = Scene_GetActiveLightCount(scene);
+    // The angular horizon map and the shadow atlas are shared by every light
+    if (!scene->useHorizonMapping || scene->useAngularHorizon)
+        return lightCount;
+    return (lightCount < SCENE_MAX_HORIZON_SLICES) ? lightCount : SCENE_MAX_HORIZON_SLICES;
+}
+
+void Scene_FillCameraConstants(const SceneState* scene, float aspect, CameraConstants* cb)
+{
+    cb->viewProjection = scene->camera.getViewProjectionMatrix(aspect);
+    cb->cameraPos = scene->camera.position;
+    cb->numConeLights = (float)Scene_GetActiveLightCount(scene);
+    cb->ambientIntensity = scene->ambientIntensity;
+    cb->coneLightIntensity = scene->coneLightIntensity;
+    cb->shadowBias = scene->shadowBias;
+    cb->falloffExponent = scene->headlightFalloff;
+    cb->debugLightOverlap = scene->showLightOverlap ? 1.0f : 0.0f;
+    cb->overlapMaxCount = scene->overlapMaxCount;
+    cb->disableShadows = scene->disableShadows ? 1.0f : 0.0f;
+    cb->useHorizonMapping = scene->useHorizonMapping ? 1.0f : 0.0f;
+    cb->useAngularHorizon = scene->useAngularHorizon ? 1.0f : 0.0f;
+    cb->showGrid = scene->showGrid ? 1.0f : 0.0f;
+    cb->horizonWorldMinX = scene->horizonWorldMin.x;
+    cb->horizonWorldMinZ = scene->horizonWorldMin.z;
+    cb->horizonWorldSize = scene->horizonWorldSize;
+    cb->shadowedLightCount = (float)Scene_GetShadowedLightCount(scene);
+    cb->cameraForward = scene->camera.getForward();
+    cb->lightCullingMode = (float)scene->lightCullingMode;
+}
+
+// Projection terms shared by every light of a frame (square, near 0.1, far = range)
+struct LightProjection
+{
+    float zScale;       // farZ / (nearZ - farZ)
+    float zOffset;      // nearZ * farZ / (nearZ - farZ)
+
+    // Lights usually share a cone angle: tanf only runs when it changes
+    float lastFov = -1.0f;
+    float lastTanHalfFov = 0.0f;
+};
+
+// View-projections of the lights on one side (0 = left, 1 = right) of cars
+// [car, car + F::WIDTH), as Mat4 elements in lanes[16]. The same operations
+// as Mat4::perspective(outerAngle * 2, 1, 0.1, range) * Mat4::lookAt(...) in
+// Scene_FillConeLights, with every term that is known to be zero left out:
+// headlights point horizontally (direction y = 0, so up is +Y), the view's
+// last row is (0, 0, 0, 1) and the projection has five non-zero entries.
+// Equal to the full product up to the sign of zero elements.
+template <typename F>
+static inline void BuildHeadlightMatrices(const SceneState* scene, uint32_t car, uint32_t side, float range,
+                                          LightProjection& projection, float lanes[16][F::WIDTH])
+{
+    // Field of view from the outer cone angle (tanf has no lane version, one
+    // call per light, skipped while the angle repeats)
+    float tanHalfFov[F::WIDTH];
+    for (uint32_t k = 0; k < F::WIDTH; ++k)
+    {
+        float fov = scene->coneLights[2 * (car + k) + side].outerAngle * 2.0f;
+        if (fov != projection.lastFov)
+        {
+            projection.lastFov = fov;
+            projection.lastTanHalfFov = tanf(fov * 0.5f);
+        }
+        tanHalfFov[k] = projection.lastTanHalfFov;
+    }
+
+    const F zero = F::Set(0.0f);
+    const F one = F::Set(1.0f);
+    const std::vector<float>& posX = side ? scene->headlightRightX : scene->headlightLeftX;
+    const std::vector<float>& posZ = side ? scene->headlightRightZ : scene->headlightLeftZ;
+
+    // Forward: target - eye, with target = eye + direction * range
+    F ex = F::Load(&posX[car]), ez = F::Load(&posZ[car]);
+    F ey = F::Set(HEADLIGHT_HEIGHT);
+    F fx = (ex + F::Load(&scene->carDirX[car]) * F::Set(range)) - ex;
+    F fz = (ez + F::Load(&scene->carDirZ[car]) * F::Set(range)) - ez;
+    F length = Sqrt(fx * fx + fz * fz);
+    auto valid = length > zero;
+    fx = Select(valid, fx / length, zero);
+    fz = Select(valid, fz / length, zero);
+
+    // Right = cross(forward, +Y), up = cross(right, forward) = (0, uy, 0)
+    F rx = zero - fz, rz = fx;
+    length = Sqrt(rx * rx + rz * rz);
+    valid = length > zero;
+    rx = Select(valid, rx / length, zero);
+    rz = Select(valid, rz / length, zero);
+    F uy = rz * fx - rx * fz;
+
+    F xyScale = one / F::Load(tanHalfFov);
+    F zScale = F::Set(projection.zScale);
+
+    F forwardDotEye = fx * ex + fz * ez;
+    F m[16] = {
+        xyScale * rx, zero, zScale * -fx, fx,
+        zero, xyScale * uy, zero, zero,
+        xyScale * rz, zero, zScale * -fz, fz,
+        xyScale * -(rx * ex + rz * ez), xyScale * -(uy * ey), zScale * forwardDotEye + F::Set(projection.zOffset), -forwardDotEye,
+    };
+    for (int e = 0; e < 16; ++e)
+        m[e].Store(lanes[e]);
+}
+
+// Writes matrix k of lanes to out (and copy)
+template <uint32_t WIDTH>
+static inline void StoreLightMatrix(const float lanes[16][WIDTH], uint32_t k, Mat4* out, Mat4* copy)
+{
+    Mat4 matrix;
+    for (int e = 0; e < 16; ++e)
+        matrix.m[e] = lanes[e][k];
+    *out = matrix;
+    if (copy)
+        *copy = matrix;
+}
+
+void Scene_FillLightMatrices(const SceneState* scene, Mat4* outViewProj, Mat4* outCopy)
+{
+    const float range = scene->headlightRange;
+    const float nearZ = 0.1f;
+    LightProjection projection;
+    projection.zScale = range / (nearZ - range);
+    projection.zOffset = (nearZ * range) / (nearZ - range);
+
+    // Both headlights of FloatXN::WIDTH cars at a time, stored in light order
+    const uint32_t lightCount = scene->numConeLights;
+    const uint32_t width = FloatXN::WIDTH;
+    uint32_t car = 0;
+    for (; 2 * (car + width) <= lightCount; car += width)
+    {
+        float left[16][width], right[16][width];
+        BuildHeadlightMatrices<FloatXN>(scene, car, 0, range, projection, left);
+        BuildHeadlightMatrices<FloatXN>(scene, car, 1, range, projection, right);
+        for (uint32_t k = 0; k < width; ++k)
+        {
+            uint32_t light = 2 * (car + k);
+            StoreLightMatrix<width>(left, k, outViewProj + light, outCopy ? outCopy + light : nullptr);
+            StoreLightMatrix<width>(right, k, outViewProj + light + 1, outCopy ? outCopy + light + 1 : nullptr);
+        }
+    }
+    for (uint32_t light = 2 * car; light < lightCount; ++light)
+    {
+        float lanes[16][1];
+        BuildHeadlightMatrices<FloatX1>(scene, light / 2, light & 1, range, projection, lanes);
+        StoreLightMatrix<1>(lanes, 0, outViewProj + light, outCopy ? outCopy + light : nullptr);
+    }
+}
+
+void Scene_FillConeLights(const SceneState* scene, ConeLightGPU* outLights, Mat4* outViewProj)
+{
+    // Use slider-controlled range
+    float currentRange = scene->headlightRange;
+    for (uint32_t i = 0; i < scene->numConeLights; ++i)
+    {
+        const ConeLight& light = scene->coneLights[i];
+        Vec3 lightPos = Simulation_GetLightPosition(scene, i);
+        Vec3 lightDir = Simulation_GetLightDirection(scene, i);
+        outLights[i].position[0] = lightPos.x;
+        outLights[i].position[1] = lightPos.y;
+        outLights[i].position[2] = lightPos.z;
+        outLights[i].position[3] = currentRange;  // Use slider value
+        outLights[i].direction[0] = lightDir.x;
+        outLights[i].direction[1] = lightDir.y;
+        outLights[i].direction[2] = lightDir.z;
+        outLights[i].direction[3] = cosf(light.outerAngle);
+        outLights[i].color[0] = light.color.x;
+        outLights[i].color[1] = light.color.y;
+        outLights[i].color[2] = light.color.z;
+        outLights[i].color[3] = cosf(light.innerAngle);
+        // Assigned by ShadowAtlas_FillLights
+        outLights[i].shadowTile[0] = 0.0f;
+        outLights[i].shadowTile[1] = 0.0f;
+        outLights[i].shadowTile[2] = 0.0f;
+        outLights[i].shadowTile[3] = 0.0f;
+    }
+
+    if (outViewProj)
+        Scene_FillLightMatrices(scene, outViewProj, nullptr);
+}
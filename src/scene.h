@@ -0,0 +1,209 @@
+#pragma once
+
+// Platform-independent scene description shared by the D3D12 renderer and the
+// headless software renderer. Nothing in here may include Windows headers.
+
+#include <cstdint>
+#include <vector>
+
+#include "math_utils.h"
+#include "simulation.h"
+
+// The ground plane is always the first quad in the scene geometry
+static constexpr uint32_t SCENE_GROUND_VERTEX_COUNT = 4;
+static constexpr uint32_t SCENE_GROUND_INDEX_COUNT = 6;
+
+// Number of vertices / indices per oriented box (6 faces * 4 vertices, 2 triangles)
+static constexpr uint32_t VERTS_PER_BOX = 24;
+static constexpr uint32_t INDICES_PER_BOX = 36;
+
+// Per-light horizon slices. A slice is 4 MB, so only the first lights get
+// horizon shadows; the rest are shaded unshadowed. Shadow maps live in the
+// shadow atlas (shadow_atlas.h), which decides per frame which lights get one.
+static constexpr uint32_t SCENE_MAX_HORIZON_SLICES = 128;
+
+// How the main pass finds the lights that can reach a pixel
+enum LightCullingMode
+{
+    LIGHT_CULLING_NONE = 0,       // Loop over all active lights
+    LIGHT_CULLING_CLUSTERED = 1,  // Per-froxel light lists (light_clusters.h)
+    LIGHT_CULLING_GRID = 2,       // Top-down XZ cell lists (light_grid.h)
+};
+
+struct ConeLightGPU
+{
+    float position[4];
+    float direction[4];
+    float color[4];
+    float shadowTile[4];    // Shadow atlas texel x, y, size (0 = no shadow map)
+};
+
+struct Vertex
+{
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+// Per-instance data of the instanced car mesh (Scene_BuildInstancedGeometry):
+// XZ position and the forward direction as a unit XZ vector (yaw). All cars
+// share one size, which is baked into the mesh.
+struct CarInstance
+{
+    float posX, posZ;
+    float dirX, dirZ;
+};
+
+// Instance 0 is the identity, so the ground plane draws from the same buffers;
+// car i is instance SCENE_FIRST_CAR_INSTANCE + i
+static constexpr uint32_t SCENE_FIRST_CAR_INSTANCE = 1;
+
+struct DebugVertex
+{
+    float position[3];
+    float color[3];
+};
+
+// Per-light transform of the unit debug cone (Scene_BuildDebugConeMesh): cone
+// space x / y / z scale axisX / axisY / axisZ, the apex goes to origin
+struct DebugConeInstance
+{
+    float axisX[3];
+    float axisY[3];
+    float axisZ[3];
+    float origin[3];
+};
+
+// Segments of the debug cone's end circle
+static constexpr uint32_t SCENE_DEBUG_CONE_SEGMENTS = 16;
+
+struct CameraConstants
+{
+    Mat4 viewProjection;
+    Vec3 cameraPos;
+    float numConeLights;
+    float ambientIntensity;
+    float coneLightIntensity;
+    float shadowBias;
+    float falloffExponent;
+    float debugLightOverlap;  // 1.0 = show light overlap visualization
+    float overlapMaxCount;    // Max count for heat map coloring
+    float disableShadows;     // 1.0 = skip shadow map sampling
+    float useHorizonMapping;  // 1.0 = use horizon mapping instead of shadow maps
+    float showGrid;           // 1.0 = show grid pattern on ground
+    float horizonWorldMinX;   // Horizon map world space bounds
+    float horizonWorldMinZ;
+    float horizonWorldSize;
+    float shadowedLightCount; // Lights [0, shadowedLightCount) may be shadowed (shadow maps: if they have a tile)
+    Vec3 cameraForward;       // View depth = dot(worldPos - cameraPos, cameraForward)
+    float lightCullingMode;   // LightCullingMode
+    float clusterTileSize;    // Light cluster grid, see LightClusters_FillConstants
+    float clusterCountX;
+    float clusterCountY;
+    float clusterCountZ;
+    float clusterNearZ;
+    float clusterDepthScale;
+    float lightGridSize;      // Cells per side of the top-down light grid
+    float useAngularHorizon;  // 1.0 = horizon mapping uses the shared angular map
+};
+
+struct AABB
+{
+    Vec3 min;
+    Vec3 max;
+};
+
+// Everything that describes what is drawn, independent of the graphics API.
+// Cars, lights and the track live in the SimulationState base.
+struct SceneState : SimulationState
+{
+    int activeLightCount = 0;  // For debug slider
+
+    // Camera
+    Camera camera;
+
+    // Debug visualization
+    bool showDebugLights = false;
+    bool showCasterBounds = false;   // Car AABBs tested by the shadow culling
+    bool showShadowFrusta = false;   // Frusta and tile sizes of lights with an atlas tile
+    bool showLightGridCells = false; // Non-empty light grid cells (grid culling mode)
+    bool showLightOverlap = false;  // Heat map of light cone overlaps
+    float overlapMaxCount = 10.0f;  // Max count for heat map (maps to red)
+
+    // Lighting controls
+    float ambientIntensity = 0.3f;
+    float coneLightIntensity = 1.0f;
+    float shadowBias = 0.0f;
+    float headlightRange = 30.0f;  // Range in meters (20-300)
+    float headlightFalloff = 2.0f; // Distance falloff exponent (lower = less falloff)
+    bool disableShadows = false;   // Skip shadow map sampling
+    bool showGrid = true;          // Show grid pattern on ground
+    int lightCullingMode = LIGHT_CULLING_CLUSTERED;
+
+    // Car AABB for top-down rendering
+    AABB carAABB;
+    Mat4 topDownViewProj;
+    float topDownNearPlaneY = 0.0f;    // World Y at top-down depth=0
+    float topDownFarPlaneY = 0.0f;     // World Y at top-down depth=1
+
+    // Top-down depth map (1024x1024)
+    static constexpr uint32_t SHADOW_MAP_SIZE = 1024;
+    bool showShadowMapDebug = false;
+    int debugShadowMapIndex = 0;  // Which light's shadow atlas tile to visualize
+
+    // Horizon Mapping shadow technique
+    bool useHorizonMapping = false;
+    bool useAngularHorizon = false;  // One angular map for all lights instead of per-light slices
+    static constexpr uint32_t HORIZON_MAP_SIZE = 1024;
+    float                           horizonWorldSize = 0.0f;   // World space size covered by horizon map
+    Vec3                            horizonWorldMin;           // World space min corner of horizon map
+};
+
+// Initializes the simulation (unless it already matches carCount / lightCount),
+// builds the ground plane and the car boxes, and derives the top-down / horizon
+// map bounds. Car boxes start at SCENE_GROUND_VERTEX_COUNT.
+void Scene_BuildGeometry(SceneState* scene, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Same as Scene_BuildGeometry, but with a single car box in car space (centered
+// on the origin in XZ, facing +Z) that is drawn once per CarInstance
+void Scene_BuildInstancedGeometry(SceneState* scene, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Rewrites the car boxes (numCars * VERTS_PER_BOX vertices) from the current
+// simulation state
+void Scene_WriteCarVertices(const SceneState* scene, Vertex* carVertices);
+
+// Writes the identity instance and one instance per car (numCars + 1 in total)
+// from the current simulation state
+void Scene_WriteCarInstances(const SceneState* scene, CarInstance* instances);
+
+// Car space to world space, as done by the vertex shaders for instanced cars
+void Scene_TransformInstanceVertex(const CarInstance& instance, const Vertex& local, Vertex& out);
+
+// Unit debug cone as a line list: apex at the origin, opening along +Z to a
+// unit circle at z = 1 (yellow), plus the axis (red)
+void Scene_BuildDebugConeMesh(std::vector<DebugVertex>& vertices);
+
+// One debug cone instance per cone light: apex at the headlight, end circle
+// at headlightRange with the light's outer angle
+void Scene_WriteDebugConeInstances(const SceneState* scene, DebugConeInstance* instances);
+
+// Number of lights actually shaded this frame (debug slider clamped to scene)
+uint32_t Scene_GetActiveLightCount(const SceneState* scene);
+
+// Number of active lights that can be shadowed in the current shadow mode
+// (with shadow maps a light also needs a shadow atlas tile)
+uint32_t Scene_GetShadowedLightCount(const SceneState* scene);
+
+// Fills the per-frame constants for the main camera
+void Scene_FillCameraConstants(const SceneState* scene, float aspect, CameraConstants* cb);
+
+// Fills the GPU light records and per-light view-projection matrices for all
+// lights (outViewProj may be null to only fill the records)
+void Scene_FillConeLights(const SceneState* scene, ConeLightGPU* outLights, Mat4* outViewProj);
+
+// Per-light view-projection matrices: each light looks along its direction
+// with a square perspective of twice its outer cone angle, from 0.1 to the
+// headlight range. Built across SIMD lanes and written once, in order, so
+// outViewProj can be mapped upload memory; outCopy (optional) gets the same
+// matrices for CPU-side users.
+void Scene_FillLightMatrices(const SceneState* scene, Mat4* outViewProj, Mat4* outCopy);
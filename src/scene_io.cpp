@@ -0,0 +1,370 @@
+#include "scene_io.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+
+// Config values, parsed from the text after '=' (surrounding whitespace
+// removed). value is only written if the whole text is a valid number, so a
+// bad line leaves the setting as it was.
+template <typename T>
+static bool ParseNumber(std::string_view text, T& value)
+{
+    T parsed;
+    const char* end = text.data() + text.size();
+    std::from_chars_result result = std::from_chars(text.data(), end, parsed);
+    if (result.ec != std::errc() || result.ptr != end)
+        return false;
+    value = parsed;
+    return true;
+}
+
+static bool ParseValue(std::string_view text, float& value)
+{
+    return ParseNumber(text, value);
+}
+
+static bool ParseValue(std::string_view text, int& value)
+{
+    return ParseNumber(text, value);
+}
+
+static bool ParseValue(std::string_view text, uint32_t& value)
+{
+    return ParseNumber(text, value);
+}
+
+// Any integer, nonzero = true
+static bool ParseValue(std::string_view text, bool& value)
+{
+    int number;
+    if (!ParseNumber(text, number))
+        return false;
+    value = (number != 0);
+    return true;
+}
+
+// Also rejects values outside [minValue, maxValue] (and NaN) without writing
+template <typename T>
+static bool ParseValue(std::string_view text, T& value, double minValue, double maxValue)
+{
+    T parsed;
+    if (!ParseValue(text, parsed) || !((double)parsed >= minValue && (double)parsed <= maxValue))
+        return false;
+    value = parsed;
+    return true;
+}
+
+template <typename T>
+static void WriteValue(std::ostream& out, const T& value)
+{
+    out << value;
+}
+
+static void WriteValue(std::ostream& out, const bool& value)
+{
+    out << (value ? 1 : 0);
+}
+
+// One serialized setting: the key is the member's path in SceneState, and the
+// parse / write functions are picked by the member's type. Values outside
+// [minValue, maxValue] are bad values, like text that does not parse.
+struct ConfigField
+{
+    const char* key;
+    bool (*parse)(SceneState& scene, std::string_view text, double minValue, double maxValue);
+    void (*write)(const SceneState& scene, std::ostream& out);
+    double minValue;
+    double maxValue;
+};
+
+#define CONFIG_FIELD_RANGE(member, minValue, maxValue)                                       \
+    {                                                                                        \
+        #member,                                                                             \
+        [](SceneState& scene, std::string_view text, double lo, double hi)                   \
+        { return ParseValue(text, scene.member, lo, hi); },                                  \
+        [](const SceneState& scene, std::ostream& out) { WriteValue(out, scene.member); },   \
+        (double)(minValue), (double)(maxValue)                                               \
+    }
+
+#define CONFIG_FIELD(member) CONFIG_FIELD_RANGE(member, -HUGE_VAL, HUGE_VAL)
+
+// Every setting SerializeState writes and DeserializeState reads, in file order
+static const ConfigField g_ConfigFields[] = {
+    // Camera position and orientation
+    CONFIG_FIELD(camera.position.x),
+    CONFIG_FIELD(camera.position.y),
+    CONFIG_FIELD(camera.position.z),
+    CONFIG_FIELD(camera.yaw),
+    CONFIG_FIELD(camera.pitch),
+
+    // Lighting settings
+    CONFIG_FIELD(ambientIntensity),
+    CONFIG_FIELD(coneLightIntensity),
+    CONFIG_FIELD(headlightRange),
+    CONFIG_FIELD(headlightFalloff),
+    CONFIG_FIELD(shadowBias),
+    CONFIG_FIELD(disableShadows),
+    CONFIG_FIELD(useHorizonMapping),
+    CONFIG_FIELD(useAngularHorizon),
+    CONFIG_FIELD(showGrid),
+    CONFIG_FIELD_RANGE(lightCullingMode, LIGHT_CULLING_NONE, LIGHT_CULLING_GRID),
+
+    // Scene size
+    CONFIG_FIELD_RANGE(carCount, 0, SIMULATION_MAX_CARS),
+    CONFIG_FIELD_RANGE(lightCount, 0, 2 * SIMULATION_MAX_CARS),
+
+    // Animation settings
+    CONFIG_FIELD(carSpeed),
+    CONFIG_FIELD(carSpacing),
+
+    // Debug settings
+    CONFIG_FIELD(showDebugLights),
+    CONFIG_FIELD(showCasterBounds),
+    CONFIG_FIELD(showShadowFrusta),
+    CONFIG_FIELD(showLightGridCells),
+    CONFIG_FIELD(showLightOverlap),
+    CONFIG_FIELD(overlapMaxCount),
+    CONFIG_FIELD(activeLightCount),
+    CONFIG_FIELD(showShadowMapDebug),
+    CONFIG_FIELD(debugShadowMapIndex),
+};
+
+#undef CONFIG_FIELD
+#undef CONFIG_FIELD_RANGE
+
+// g_ConfigFields sorted by key, built on first use
+static const std::vector<const ConfigField*>& GetSortedConfigFields()
+{
+    static const std::vector<const ConfigField*> sorted = []()
+    {
+        std::vector<const ConfigField*> fields;
+        for (const ConfigField& field : g_ConfigFields)
+            fields.push_back(&field);
+        std::sort(fields.begin(), fields.end(), [](const ConfigField* a, const ConfigField* b)
+        {
+            return std::string_view(a->key) < std::string_view(b->key);
+        });
+        return fields;
+    }();
+    return sorted;
+}
+
+// Binary search of the sorted table, nullptr for an unknown key
+static const ConfigField* FindConfigField(std::string_view key)
+{
+    const std::vector<const ConfigField*>& fields = GetSortedConfigFields();
+    auto it = std::lower_bound(fields.begin(), fields.end(), key, [](const ConfigField* field, std::string_view k)
+    {
+        return std::string_view(field->key) < k;
+    });
+    return (it != fields.end() && (*it)->key == key) ? *it : nullptr;
+}
+
+// Keys handled outside the table
+static constexpr std::string_view CONFIG_VERSION_KEY = "version";
+static constexpr std::string_view CONFIG_SIMULATION_TIME_KEY = "simulationTime";
+
+static std::string_view Trim(std::string_view text)
+{
+    static const char* whitespace = " \t\r";
+    size_t first = text.find_first_not_of(whitespace);
+    if (first == std::string_view::npos)
+        return std::string_view();
+    return text.substr(first, text.find_last_not_of(whitespace) - first + 1);
+}
+
+// Appends "<source>:<line>: <message> (<text>)" to errors, "line <line>: ..."
+// without a source
+static void ReportError(std::string* errors, const char* source, size_t lineNumber, const char* message,
+                        std::string_view text)
+{
+    if (!errors)
+        return;
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s%s%zu: %s (%.*s)\n", source ? source : "line", source ? ":" : " ", lineNumber,
+             message, (int)std::min<size_t>(text.size(), 128), text.data());
+    *errors += buffer;
+}
+
+// Serialize all settings to a string
+std::string SerializeState(const SceneState& scene)
+{
+    std::ostringstream ss;
+    ss << std::setprecision(8);
+
+    // Version for future compatibility
+    ss << CONFIG_VERSION_KEY << "=1\n";
+
+    for (const ConfigField& field : g_ConfigFields)
+    {
+        ss << field.key << "=";
+        field.write(scene, ss);
+        ss << "\n";
+    }
+
+    // Simulation time (first car's track progress as reference)
+    ss << CONFIG_SIMULATION_TIME_KEY << "=" << scene.carTrackProgress[0] << "\n";
+
+    return ss.str();
+}
+
+// Applies every valid line; bad lines are reported and skipped
+static bool Deserialize(SceneState& scene, std::string_view data, const char* source, std::string* errors)
+{
+    bool ok = true;
+    float simulationTime = -1.0f;
+
+    size_t lineNumber = 0;
+    for (size_t pos = 0; pos < data.size(); )
+    {
+        size_t lineEnd = data.find('\n', pos);
+        if (lineEnd == std::string_view::npos)
+            lineEnd = data.size();
+        std::string_view line = Trim(data.substr(pos, lineEnd - pos));
+        pos = lineEnd + 1;
+        lineNumber++;
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t eqPos = line.find('=');
+        if (eqPos == std::string_view::npos)
+        {
+            ReportError(errors, source, lineNumber, "expected key=value", line);
+            ok = false;
+            continue;
+        }
+        std::string_view key = Trim(line.substr(0, eqPos));
+        std::string_view value = Trim(line.substr(eqPos + 1));
+
+        bool parsed;
+        if (key == CONFIG_SIMULATION_TIME_KEY)
+        {
+            parsed = ParseValue(value, simulationTime);
+        }
+        else if (key == CONFIG_VERSION_KEY)
+        {
+            int version;
+            parsed = ParseValue(value, version);
+        }
+        else
+        {
+            const ConfigField* field = FindConfigField(key);
+            if (!field)
+            {
+                ReportError(errors, source, lineNumber, "unknown key", line);
+                ok = false;
+                continue;
+            }
+            parsed = field->parse(scene, value, field->minValue, field->maxValue);
+        }
+        if (!parsed)
+        {
+            ReportError(errors, source, lineNumber, "bad value", line);
+            ok = false;
+        }
+    }
+
+    // A different car/light count restarts the simulation with the new size;
+    // the renderer picks that up and reallocates its per-car/per-light resources
+    if (Simulation_NeedsInit(&scene))
+        Simulation_Init(&scene);
+
+    // Apply simulation time delta to all cars (also re-derives the headlights
+    // so a loaded carSpacing takes effect immediately)
+    float oldSimTime = scene.carTrackProgress[0];
+    float delta = (simulationTime >= 0.0f) ? simulationTime - oldSimTime : 0.0f;
+    Simulation_ShiftProgress(&scene, delta);
+
+    return ok;
+}
+
+// Deserialize settings from a string
+bool DeserializeState(SceneState& scene, const std::string& data, std::string* errors)
+{
+    return Deserialize(scene, data, nullptr, errors);
+}
+
+// Save state to a file
+bool SaveStateToFile(const SceneState& scene, const char* filename)
+{
+    std::ofstream file(filename);
+    if (!file.is_open())
+        return false;
+    file << SerializeState(scene);
+    return true;
+}
+
+// Load state from a file
+bool LoadStateFromFile(SceneState& scene, const char* filename, std::string* errors)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+    {
+        if (errors)
+            *errors += std::string(filename) + ": cannot open\n";
+        return false;
+    }
+
+    // Whole file in one read
+    file.seekg(0, std::ios::end);
+    std::string data((size_t)file.tellg(), '\0');
+    file.seekg(0, std::ios::beg);
+    file.read(&data[0], (std::streamsize)data.size());
+    return Deserialize(scene, data, filename, errors);
+}
+
+// Write TGA file (uncompressed, 32-bit BGRA)
+bool WriteTGA(const char* filename, uint32_t width, uint32_t height, const uint8_t* pixels)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    // TGA header
+    uint8_t header[18] = {};
+    header[2] = 2;  // Uncompressed true-color
+    header[12] = width & 0xFF;
+    header[13] = (width >> 8) & 0xFF;
+    header[14] = height & 0xFF;
+    header[15] = (height >> 8) & 0xFF;
+    header[16] = 32;  // 32 bits per pixel
+    header[17] = 0x20;  // Top-left origin
+
+    file.write((char*)header, sizeof(header));
+    file.write((char*)pixels, width * height * 4);
+
+    return true;
+}
+
+// Generate output filename from config filename
+// "config.cfg" -> "config_test_out.tga"
+std::string GenerateTestOutputFilename(const std::string& configFile)
+{
+    std::string result = configFile;
+
+    // Remove .cfg extension if present
+    size_t dotPos = result.rfind(".cfg");
+    if (dotPos != std::string::npos && dotPos == result.length() - 4)
+    {
+        result = result.substr(0, dotPos);
+    }
+
+    // Also remove path, keep just the filename
+    size_t slashPos = result.rfind('/');
+    size_t backslashPos = result.rfind('\\');
+    size_t pathEnd = 0;
+    if (slashPos != std::string::npos) pathEnd = slashPos + 1;
+    if (backslashPos != std::string::npos && backslashPos >= pathEnd) pathEnd = backslashPos + 1;
+    if (pathEnd > 0) result = result.substr(pathEnd);
+
+    return result + "_test_out.tga";
+}
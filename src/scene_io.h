@@ -0,0 +1,33 @@
+#pragma once
+
+// Config (.cfg) and image file I/O shared by the windowed and headless builds
+//
+// Config files are key=value lines. The keys come from one table of SceneState
+// members in scene_io.cpp that both directions use, so adding a setting is one
+// table entry. Values are parsed in place with std::from_chars.
+
+#include <cstdint>
+#include <string>
+
+#include "scene.h"
+
+// Serialize all settings to a string
+std::string SerializeState(const SceneState& scene);
+
+// Deserialize settings from a string. Lines that are not key=value, unknown
+// keys, values that do not parse completely and values out of range (scene
+// size, culling mode) are skipped and appended to errors as "line N: ..."
+// (file loads: "file.cfg:N: ..."); the result is false if there were any.
+// The other lines still apply.
+bool DeserializeState(SceneState& scene, const std::string& data, std::string* errors = nullptr);
+
+// Save / load state to a .cfg file
+bool SaveStateToFile(const SceneState& scene, const char* filename);
+bool LoadStateFromFile(SceneState& scene, const char* filename, std::string* errors = nullptr);
+
+// Write TGA file (uncompressed, 32-bit BGRA)
+bool WriteTGA(const char* filename, uint32_t width, uint32_t height, const uint8_t* pixels);
+
+// Generate output filename from config filename
+// "config.cfg" -> "config_test_out.tga"
+std::string GenerateTestOutputFilename(const std::string& configFile);
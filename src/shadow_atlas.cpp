@@ -0,0 +1,162 @@
+#include "shadow_atlas.h"
+#include "light_clusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Every other bit of v, starting at bit 0, packed into the low bits
+static uint32_t CompactBits(uint32_t v)
+{
+    v &= 0x55555555u;
+    v = (v | (v >> 1)) & 0x33333333u;
+    v = (v | (v >> 2)) & 0x0f0f0f0fu;
+    v = (v | (v >> 4)) & 0x00ff00ffu;
+    v = (v | (v >> 8)) & 0x0000ffffu;
+    return v;
+}
+
+// Atlas area of a tile in minimum-size tiles
+static uint32_t GetTileUnits(uint32_t size)
+{
+    uint32_t side = size / SHADOW_ATLAS_MIN_TILE;
+    return side * side;
+}
+
+float ShadowAtlas_GetImportance(const SceneState* scene, uint32_t lightIndex, uint32_t width, uint32_t height,
+                                uint32_t* requestedSize)
+{
+    const Camera& camera = scene->camera;
+    *requestedSize = 0;
+
+    Vec3 center;
+    float radius;
+    LightClusters_GetConeBounds(Simulation_GetLightPosition(scene, lightIndex), Simulation_GetLightDirection(scene, lightIndex),
+                                scene->headlightRange, cosf(scene->coneLights[lightIndex].outerAngle), center, radius);
+
+    // View basis, same as Mat4::lookAt
+    Vec3 forward = camera.getForward();
+    Vec3 right = cross(forward, camera.getUp()).normalized();
+    Vec3 up = cross(right, forward);
+
+    Vec3 rel = center - camera.position;
+    float x = dot(rel, right);
+    float y = dot(rel, up);
+    float z = dot(rel, forward);
+    if (z + radius < camera.nearZ || z - radius > camera.farZ)
+        return 0.0f;
+
+    // Side planes of the frustum pass through the eye: x = +-scaleX * z, same for y
+    float tanHalfFov = tanf(camera.fov * 0.5f);
+    float scaleX = tanHalfFov * (float)width / (float)height;
+    float scaleY = tanHalfFov;
+    if ((fabsf(x) - scaleX * z) / sqrtf(1.0f + scaleX * scaleX) > radius ||
+        (fabsf(y) - scaleY * z) / sqrtf(1.0f + scaleY * scaleY) > radius)
+        return 0.0f;
+
+    // Reaching to the near plane: close enough for the largest tile
+    if (z - radius <= camera.nearZ)
+    {
+        *requestedSize = SHADOW_ATLAS_MAX_TILE;
+        return 1.0f;
+    }
+
+    // Screen rect of the sphere (radius from the tangent cone), clipped to the screen
+    float projRadius = radius / sqrtf(z * z - radius * radius);
+    float centerX = x / z / scaleX, centerY = y / z / scaleY;
+    float radiusX = projRadius / scaleX, radiusY = projRadius / scaleY;
+    float x0 = std::max(centerX - radiusX, -1.0f), x1 = std::min(centerX + radiusX, 1.0f);
+    float y0 = std::max(centerY - radiusY, -1.0f), y1 = std::min(centerY + radiusY, 1.0f);
+    float coverage = std::max(x1 - x0, 0.0f) * std::max(y1 - y0, 0.0f) * 0.25f;
+    if (coverage <= 0.0f)
+        return 0.0f;
+
+    // Resolution follows the unclipped size on screen (nearest power of two)
+    float texels = radiusY * (float)height * SHADOW_ATLAS_TEXELS_PER_PIXEL;
+    uint32_t size = SHADOW_ATLAS_MIN_TILE;
+    while (size < SHADOW_ATLAS_MAX_TILE && (float)size * 1.41421356f < texels)
+        size *= 2;
+    *requestedSize = size;
+    return coverage;
+}
+
+void ShadowAtlas_Build(const SceneState* scene, uint32_t width, uint32_t height, ShadowAtlas* atlas)
+{
+    uint32_t lightCount = Scene_GetActiveLightCount(scene);
+    atlas->tiles.assign(lightCount, ShadowAtlasTile());
+    atlas->importance.resize(lightCount);
+
+    // Visible lights, most important first (index breaks ties, so the result is
+    // deterministic)
+    std::vector<uint32_t>& order = atlas->order;
+    order.clear();
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        atlas->importance[i] = ShadowAtlas_GetImportance(scene, i, width, height, &atlas->tiles[i].size);
+        if (atlas->tiles[i].size > 0)
+            order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+    {
+        if (atlas->importance[a] != atlas->importance[b])
+            return atlas->importance[a] > atlas->importance[b];
+        return a < b;
+    });
+
+    // Only as many lights as minimum tiles fit; the least important go without
+    const uint32_t capacity = GetTileUnits(SHADOW_ATLAS_SIZE);
+    size_t keptCount = std::min<size_t>(order.size(), capacity);
+    for (size_t k = keptCount; k < order.size(); ++k)
+        atlas->tiles[order[k]].size = 0;
+    atlas->droppedCount = (uint32_t)(order.size() - keptCount);
+    order.resize(keptCount);
+
+    // Most important first, each light gets the largest tile up to its request
+    // that leaves a minimum tile for every light after it. A light that gets
+    // less than it asked for caps the lights after it, so a less important
+    // light never ends up with a larger tile than a lowered one.
+    uint32_t maxTile = SHADOW_ATLAS_MAX_TILE;
+    uint32_t usedUnits = 0;
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+        uint32_t& size = atlas->tiles[order[k]].size;
+        uint32_t remaining = (uint32_t)(order.size() - k - 1);
+        uint32_t requested = size;
+        size = std::min(size, maxTile);
+        while (size > SHADOW_ATLAS_MIN_TILE && usedUnits + GetTileUnits(size) + remaining > capacity)
+            size /= 2;
+        if (size < requested)
+            maxTile = size;
+        usedUnits += GetTileUnits(size);
+    }
+
+    // Largest first: every tile then starts at a Morton offset aligned to its size
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+    {
+        return atlas->tiles[a].size > atlas->tiles[b].size;
+    });
+    uint32_t offset = 0;
+    atlas->usedTexels = 0;
+    atlas->maxTileSize = order.empty() ? 0 : atlas->tiles[order[0]].size;
+    for (uint32_t i : order)
+    {
+        ShadowAtlasTile& tile = atlas->tiles[i];
+        tile.x = CompactBits(offset) * SHADOW_ATLAS_MIN_TILE;
+        tile.y = CompactBits(offset >> 1) * SHADOW_ATLAS_MIN_TILE;
+        offset += GetTileUnits(tile.size);
+        atlas->usedTexels += (uint64_t)tile.size * tile.size;
+    }
+
+    atlas->tileCount = (uint32_t)order.size();
+}
+
+void ShadowAtlas_FillLights(const ShadowAtlas* atlas, ConeLightGPU* lights, uint32_t lightCount)
+{
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        ShadowAtlasTile tile = (i < atlas->tiles.size()) ? atlas->tiles[i] : ShadowAtlasTile();
+        lights[i].shadowTile[0] = (float)tile.x;
+        lights[i].shadowTile[1] = (float)tile.y;
+        lights[i].shadowTile[2] = (float)tile.size;
+        lights[i].shadowTile[3] = 0.0f;
+    }
+}
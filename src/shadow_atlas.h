@@ -0,0 +1,63 @@
+#pragma once
+
+// Shadow atlas: all cone light shadow maps share one square depth texture.
+// Every frame each active light gets a square tile sized by how large it
+// appears on screen; lights that cannot reach a visible pixel get none. Built
+// on the CPU, shared by both renderers.
+//
+// Tiles are powers of two between SHADOW_ATLAS_MIN_TILE and
+// SHADOW_ATLAS_MAX_TILE. Placed from largest to smallest, each tile starts at
+// the next free position in Morton order, which is always aligned to its size,
+// so the packing never leaves holes. If the requests do not fit, the most
+// important lights keep theirs and the least important are lowered first,
+// down to minimum tiles; if even those do not fit, the least important lights
+// go without. The space left over is then less than three tiles of the first
+// lowered size.
+
+#include <cstdint>
+#include <vector>
+
+#include "scene.h"
+
+// Atlas texels per side, and the tile size range
+static constexpr uint32_t SHADOW_ATLAS_SIZE = 4096;
+static constexpr uint32_t SHADOW_ATLAS_MIN_TILE = 64;
+static constexpr uint32_t SHADOW_ATLAS_MAX_TILE = 1024;
+
+// Shadow map texels per screen pixel across the light's projected bounding sphere
+static constexpr float SHADOW_ATLAS_TEXELS_PER_PIXEL = 1.0f;
+
+// Texel rect of one light's shadow map; size 0 = no shadow map
+struct ShadowAtlasTile
+{
+    uint32_t x = 0, y = 0;
+    uint32_t size = 0;
+};
+
+struct ShadowAtlas
+{
+    std::vector<ShadowAtlasTile> tiles;     // Per active light
+    std::vector<float> importance;          // Per active light, see ShadowAtlas_GetImportance
+
+    // Stats of the last build
+    uint32_t tileCount = 0;
+    uint32_t droppedCount = 0;              // Visible lights left without a tile
+    uint32_t maxTileSize = 0;               // Largest tile given out
+    uint64_t usedTexels = 0;
+
+    // Scratch reused between builds
+    std::vector<uint32_t> order;
+};
+
+// Fraction of the screen covered by the light's bounding sphere (0 if it is
+// outside the view frustum), and the tile size it asks for (0 if none).
+// width / height is the view the scene camera renders.
+float ShadowAtlas_GetImportance(const SceneState* scene, uint32_t lightIndex, uint32_t width, uint32_t height,
+                                uint32_t* requestedSize);
+
+// Assigns tiles to the scene's active lights for a width x height view
+void ShadowAtlas_Build(const SceneState* scene, uint32_t width, uint32_t height, ShadowAtlas* atlas);
+
+// Writes each light's tile to ConeLightGPU::shadowTile (lights without a tile,
+// or beyond the active count, get a zero tile)
+void ShadowAtlas_FillLights(const ShadowAtlas* atlas, ConeLightGPU* lights, uint32_t lightCount);
@@ -0,0 +1,152 @@
+#include "shadow_culling.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <cstring>
+
+// FNV-1a over the bytes of a value
+template <typename T>
+static void HashValue(uint64_t& hash, const T& value)
+{
+    unsigned char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    for (unsigned char b : bytes)
+        hash = (hash ^ b) * 1099511628211ull;
+}
+
+void ShadowCulling_GetFrustum(const Mat4& viewProj, ShadowFrustum* frustum)
+{
+    // Row r of the column-major matrix is (m[r], m[4 + r], m[8 + r], m[12 + r])
+    const float* m = viewProj.m;
+    float rowX[4] = { m[0], m[4], m[8], m[12] };
+    float rowY[4] = { m[1], m[5], m[9], m[13] };
+    float rowZ[4] = { m[2], m[6], m[10], m[14] };
+    float rowW[4] = { m[3], m[7], m[11], m[15] };
+
+    // w + x, w - x, w + y, w - y, z, w - z >= 0
+    float (*planes)[4] = frustum->planes;
+    for (int k = 0; k < 4; ++k)
+    {
+        planes[0][k] = rowW[k] + rowX[k];
+        planes[1][k] = rowW[k] - rowX[k];
+        planes[2][k] = rowW[k] + rowY[k];
+        planes[3][k] = rowW[k] - rowY[k];
+        planes[4][k] = rowZ[k];
+        planes[5][k] = rowW[k] - rowZ[k];
+    }
+}
+
+bool ShadowCulling_IsBoxVisible(const ShadowFrustum& frustum, const Vec3& center, const Vec3& extents)
+{
+    // Outside if even the corner furthest along the plane normal is behind it
+    for (const float* p : frustum.planes)
+    {
+        float distance = p[0] * center.x + p[1] * center.y + p[2] * center.z + p[3];
+        float radius = fabsf(p[0]) * extents.x + fabsf(p[1]) * extents.y + fabsf(p[2]) * extents.z;
+        if (distance + radius < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void ShadowCulling_GetCarBounds(const SceneState* scene, uint32_t carIndex, Vec3& outCenter, Vec3& outExtents)
+{
+    Vec3 dir, right;
+    Simulation_GetCarPose(scene, carIndex, outCenter, dir, right);
+
+    // Same box as AddOrientedBox: width along right, length along dir
+    const float halfWidth = CAR_WIDTH * 0.5f;
+    const float halfLength = CAR_LENGTH * 0.5f;
+    outExtents = Vec3(fabsf(right.x) * halfWidth + fabsf(dir.x) * halfLength,
+                      CAR_HEIGHT * 0.5f,
+                      fabsf(right.z) * halfWidth + fabsf(dir.z) * halfLength);
+}
+
+void ShadowCulling_Build(const SceneState* scene, const Mat4* lightViewProj, const ShadowAtlas* atlas,
+                         ShadowCasterLists* lists)
+{
+    uint32_t lightCount = (uint32_t)atlas->tiles.size();
+    uint32_t carCount = scene->numCars;
+    lists->lightRuns.resize(lightCount);
+    lists->redraw.assign(lightCount, 0);
+    if (lists->tileKeys.size() < lightCount)
+        lists->tileKeys.resize(lightCount);
+
+    // Car bounds once, then one light per work item
+    std::vector<Vec3> centers(carCount), extents(carCount);
+    for (uint32_t c = 0; c < carCount; ++c)
+        ShadowCulling_GetCarBounds(scene, c, centers[c], extents[c]);
+
+    ParallelFor(lightCount, [&](uint32_t i)
+    {
+        std::vector<ShadowCasterRun>& runs = lists->lightRuns[i];
+        runs.clear();
+        if (atlas->tiles[i].size == 0)
+            return;
+
+        ShadowFrustum frustum;
+        ShadowCulling_GetFrustum(lightViewProj[i], &frustum);
+        for (uint32_t c = 0; c < carCount; ++c)
+        {
+            if (!ShadowCulling_IsBoxVisible(frustum, centers[c], extents[c]))
+                continue;
+            if (!runs.empty() && runs.back().firstCar + runs.back().carCount == c)
+                runs.back().carCount++;
+            else
+                runs.push_back({ c, 1 });
+        }
+
+        // Everything the tile's depth depends on
+        uint64_t hash = 14695981039346656037ull;
+        HashValue(hash, lightViewProj[i]);
+        for (const ShadowCasterRun& run : runs)
+        {
+            for (uint32_t c = run.firstCar; c < run.firstCar + run.carCount; ++c)
+            {
+                HashValue(hash, c);
+                HashValue(hash, scene->carPosX[c]);
+                HashValue(hash, scene->carPosZ[c]);
+                HashValue(hash, scene->carDirX[c]);
+                HashValue(hash, scene->carDirZ[c]);
+            }
+        }
+
+        const ShadowAtlasTile& tile = atlas->tiles[i];
+        ShadowTileKey& key = lists->tileKeys[i];
+        bool sameTile = key.tile.x == tile.x && key.tile.y == tile.y && key.tile.size == tile.size;
+        lists->redraw[i] = !(key.valid && sameTile && key.hash == hash);
+        key.valid = true;
+        key.tile = tile;
+        key.hash = hash;
+    });
+
+    // Lights without a tile keep nothing; another light may draw over their old rect
+    for (uint32_t i = 0; i < (uint32_t)lists->tileKeys.size(); ++i)
+    {
+        if (i >= lightCount || atlas->tiles[i].size == 0)
+            lists->tileKeys[i].valid = false;
+    }
+
+    // Compact into one array
+    lists->ranges.resize(lightCount);
+    lists->runs.clear();
+    lists->testedCasters = 0;
+    lists->visibleCasters = 0;
+    lists->redrawnTiles = 0;
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        const std::vector<ShadowCasterRun>& runs = lists->lightRuns[i];
+        lists->ranges[i] = { (uint32_t)lists->runs.size(), (uint32_t)runs.size() };
+        lists->runs.insert(lists->runs.end(), runs.begin(), runs.end());
+        if (atlas->tiles[i].size > 0)
+            lists->testedCasters += carCount;
+        for (const ShadowCasterRun& run : runs)
+            lists->visibleCasters += run.carCount;
+        lists->redrawnTiles += lists->redraw[i];
+    }
+}
+
+void ShadowCulling_Invalidate(ShadowCasterLists* lists)
+{
+    lists->tileKeys.clear();
+}
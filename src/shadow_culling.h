@@ -0,0 +1,84 @@
+#pragma once
+
+// Per-light shadow caster culling: before the cone shadow pass every car's
+// world AABB is tested against the frustum of each light that has a shadow
+// atlas tile, so a light only draws the cars it can see instead of all of
+// them. Built on the CPU every frame, shared by both renderers.
+//
+// Visible cars are stored as runs of consecutive car indices, which map
+// directly to index ranges of the car boxes (one draw per run).
+//
+// The atlas keeps its contents between frames. Each light's inputs (matrix,
+// tile and the poses of its visible cars) are hashed; a tile whose light had
+// the same tile and hash last frame still holds the right depth and is not
+// cleared or drawn again, so static scenes skip the shadow pass entirely.
+
+#include <cstdint>
+#include <vector>
+
+#include "scene.h"
+#include "shadow_atlas.h"
+
+// Cars [firstCar, firstCar + carCount) are visible to a light
+struct ShadowCasterRun
+{
+    uint32_t firstCar;
+    uint32_t carCount;
+};
+
+// Runs of one light: runs[offset, offset + count)
+struct ShadowCasterRange
+{
+    uint32_t offset;
+    uint32_t count;
+};
+
+// What a light's tile was last rendered with
+struct ShadowTileKey
+{
+    bool valid = false;
+    ShadowAtlasTile tile;
+    uint64_t hash = 0;
+};
+
+struct ShadowCasterLists
+{
+    std::vector<ShadowCasterRange> ranges;  // Per active light (empty without a tile)
+    std::vector<ShadowCasterRun> runs;
+    std::vector<uint8_t> redraw;            // Per active light: tile must be cleared and drawn
+
+    // Persistent between builds: what each light's tile currently holds
+    std::vector<ShadowTileKey> tileKeys;
+
+    // Stats of the last build
+    uint64_t testedCasters = 0;             // Lights with a tile x cars
+    uint64_t visibleCasters = 0;
+    uint32_t redrawnTiles = 0;
+
+    // Per-light scratch lists reused between builds
+    std::vector<std::vector<ShadowCasterRun>> lightRuns;
+};
+
+// Planes (a, b, c, d) of a view-projection frustum, inside where ax + by + cz + d >= 0
+struct ShadowFrustum
+{
+    float planes[6][4];
+};
+
+// Frustum of a view-projection matrix (D3D clip space, 0 <= z <= w)
+void ShadowCulling_GetFrustum(const Mat4& viewProj, ShadowFrustum* frustum);
+
+// False if the box (center, half extents) lies completely outside the frustum
+bool ShadowCulling_IsBoxVisible(const ShadowFrustum& frustum, const Vec3& center, const Vec3& extents);
+
+// World AABB of a car box as center and half extents
+void ShadowCulling_GetCarBounds(const SceneState* scene, uint32_t carIndex, Vec3& outCenter, Vec3& outExtents);
+
+// Lists the visible cars of every active light with an atlas tile and marks
+// the tiles that changed since the last build (assumes the caller renders
+// every marked tile). lightViewProj holds the matrices from Scene_FillLightMatrices.
+void ShadowCulling_Build(const SceneState* scene, const Mat4* lightViewProj, const ShadowAtlas* atlas,
+                         ShadowCasterLists* lists);
+
+// Forgets all tile contents (atlas recreated); the next build redraws every tile
+void ShadowCulling_Invalidate(ShadowCasterLists* lists);
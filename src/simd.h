@@ -0,0 +1,153 @@
+#pragma once
+
+// SIMD lane types shared by the vectorized CPU kernels (track evaluation,
+// horizon tracing, batch matrix math)
+//
+// Each lane type wraps one register of floats (1, 4, 8 or 16 wide) with a
+// small set of operations, so every ISA runs the exact same branchless kernel.
+// The widest type the compiler targets is picked at compile time
+// (/arch:AVX512, /arch:AVX2 or -mavx512f / -mavx2); x64 always has SSE2.
+// Leftover elements go through the scalar type.
+//
+// Every operation is a single IEEE operation per lane, so a kernel computes
+// bit-identical results at every width as long as it keeps the order of
+// operations. That includes its scalar reference: GCC / Clang fuse a * b + c
+// into FMA once it is enabled (-mavx512f, -mfma), build with -ffp-contract=off.
+
+#include <cmath>
+#include <cstdint>
+
+struct FloatX1
+{
+    static constexpr uint32_t WIDTH = 1;
+    float v;
+
+    static FloatX1 Set(float x) { return { x }; }
+    static FloatX1 Load(const float* p) { return { *p }; }
+    void Store(float* p) const { *p = v; }
+};
+struct MaskX1 { bool m; };
+
+static inline FloatX1 operator+(FloatX1 a, FloatX1 b) { return { a.v + b.v }; }
+static inline FloatX1 operator-(FloatX1 a, FloatX1 b) { return { a.v - b.v }; }
+static inline FloatX1 operator*(FloatX1 a, FloatX1 b) { return { a.v * b.v }; }
+static inline FloatX1 operator/(FloatX1 a, FloatX1 b) { return { a.v / b.v }; }
+static inline FloatX1 operator-(FloatX1 a) { return { -a.v }; }
+static inline MaskX1 operator>=(FloatX1 a, FloatX1 b) { return { a.v >= b.v }; }
+static inline MaskX1 operator<(FloatX1 a, FloatX1 b) { return { a.v < b.v }; }
+static inline MaskX1 operator<=(FloatX1 a, FloatX1 b) { return { a.v <= b.v }; }
+static inline MaskX1 operator>(FloatX1 a, FloatX1 b) { return { a.v > b.v }; }
+static inline MaskX1 operator&(MaskX1 a, MaskX1 b) { return { a.m && b.m }; }
+static inline bool Any(MaskX1 mask) { return mask.m; }
+static inline FloatX1 Select(MaskX1 mask, FloatX1 a, FloatX1 b) { return mask.m ? a : b; }
+static inline FloatX1 Sqrt(FloatX1 a) { return { sqrtf(a.v) }; }
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_HAS_SSE2 1
+
+struct FloatX4
+{
+    static constexpr uint32_t WIDTH = 4;
+    __m128 v;
+
+    static FloatX4 Set(float x) { return { _mm_set1_ps(x) }; }
+    static FloatX4 Load(const float* p) { return { _mm_loadu_ps(p) }; }
+    void Store(float* p) const { _mm_storeu_ps(p, v); }
+};
+struct MaskX4 { __m128 m; };
+
+static inline FloatX4 operator+(FloatX4 a, FloatX4 b) { return { _mm_add_ps(a.v, b.v) }; }
+static inline FloatX4 operator-(FloatX4 a, FloatX4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+static inline FloatX4 operator*(FloatX4 a, FloatX4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+static inline FloatX4 operator/(FloatX4 a, FloatX4 b) { return { _mm_div_ps(a.v, b.v) }; }
+static inline FloatX4 operator-(FloatX4 a) { return { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; }
+static inline MaskX4 operator>=(FloatX4 a, FloatX4 b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+static inline MaskX4 operator<(FloatX4 a, FloatX4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+static inline MaskX4 operator<=(FloatX4 a, FloatX4 b) { return { _mm_cmple_ps(a.v, b.v) }; }
+static inline MaskX4 operator>(FloatX4 a, FloatX4 b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+static inline MaskX4 operator&(MaskX4 a, MaskX4 b) { return { _mm_and_ps(a.m, b.m) }; }
+static inline bool Any(MaskX4 mask) { return _mm_movemask_ps(mask.m) != 0; }
+static inline FloatX4 Select(MaskX4 mask, FloatX4 a, FloatX4 b)
+{
+    // No blendv before SSE4.1
+    return { _mm_or_ps(_mm_and_ps(mask.m, a.v), _mm_andnot_ps(mask.m, b.v)) };
+}
+static inline FloatX4 Sqrt(FloatX4 a) { return { _mm_sqrt_ps(a.v) }; }
+#endif
+
+#if defined(__AVX__)
+#define SIMD_HAS_AVX 1
+
+struct FloatX8
+{
+    static constexpr uint32_t WIDTH = 8;
+    __m256 v;
+
+    static FloatX8 Set(float x) { return { _mm256_set1_ps(x) }; }
+    static FloatX8 Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+    void Store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+struct MaskX8 { __m256 m; };
+
+static inline FloatX8 operator+(FloatX8 a, FloatX8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+static inline FloatX8 operator-(FloatX8 a, FloatX8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+static inline FloatX8 operator*(FloatX8 a, FloatX8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+static inline FloatX8 operator/(FloatX8 a, FloatX8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+static inline FloatX8 operator-(FloatX8 a) { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) }; }
+static inline MaskX8 operator>=(FloatX8 a, FloatX8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+static inline MaskX8 operator<(FloatX8 a, FloatX8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+static inline MaskX8 operator<=(FloatX8 a, FloatX8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+static inline MaskX8 operator>(FloatX8 a, FloatX8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+static inline MaskX8 operator&(MaskX8 a, MaskX8 b) { return { _mm256_and_ps(a.m, b.m) }; }
+static inline bool Any(MaskX8 mask) { return _mm256_movemask_ps(mask.m) != 0; }
+static inline FloatX8 Select(MaskX8 mask, FloatX8 a, FloatX8 b) { return { _mm256_blendv_ps(b.v, a.v, mask.m) }; }
+static inline FloatX8 Sqrt(FloatX8 a) { return { _mm256_sqrt_ps(a.v) }; }
+#endif
+
+#if defined(__AVX512F__)
+#define SIMD_HAS_AVX512 1
+
+struct FloatX16
+{
+    static constexpr uint32_t WIDTH = 16;
+    __m512 v;
+
+    static FloatX16 Set(float x) { return { _mm512_set1_ps(x) }; }
+    static FloatX16 Load(const float* p) { return { _mm512_loadu_ps(p) }; }
+    void Store(float* p) const { _mm512_storeu_ps(p, v); }
+};
+struct MaskX16 { __mmask16 m; };
+
+static inline FloatX16 operator+(FloatX16 a, FloatX16 b) { return { _mm512_add_ps(a.v, b.v) }; }
+static inline FloatX16 operator-(FloatX16 a, FloatX16 b) { return { _mm512_sub_ps(a.v, b.v) }; }
+static inline FloatX16 operator*(FloatX16 a, FloatX16 b) { return { _mm512_mul_ps(a.v, b.v) }; }
+static inline FloatX16 operator/(FloatX16 a, FloatX16 b) { return { _mm512_div_ps(a.v, b.v) }; }
+static inline FloatX16 operator-(FloatX16 a)
+{
+    // Flip the sign bit (xor_ps needs AVX512DQ)
+    return { _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a.v), _mm512_set1_epi32((int)0x80000000))) };
+}
+static inline MaskX16 operator>=(FloatX16 a, FloatX16 b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ) }; }
+static inline MaskX16 operator<(FloatX16 a, FloatX16 b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ) }; }
+static inline MaskX16 operator<=(FloatX16 a, FloatX16 b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ) }; }
+static inline MaskX16 operator>(FloatX16 a, FloatX16 b) { return { _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ) }; }
+static inline MaskX16 operator&(MaskX16 a, MaskX16 b) { return { (__mmask16)(a.m & b.m) }; }
+static inline bool Any(MaskX16 mask) { return mask.m != 0; }
+static inline FloatX16 Select(MaskX16 mask, FloatX16 a, FloatX16 b) { return { _mm512_mask_blend_ps(mask.m, b.v, a.v) }; }
+static inline FloatX16 Sqrt(FloatX16 a) { return { _mm512_sqrt_ps(a.v) }; }
+#endif
+
+// Widest lane type available
+#if defined(SIMD_HAS_AVX512)
+typedef FloatX16 FloatXN;
+#elif defined(SIMD_HAS_AVX)
+typedef FloatX8 FloatXN;
+#elif defined(SIMD_HAS_SSE2)
+typedef FloatX4 FloatXN;
+#else
+typedef FloatX1 FloatXN;
+#endif
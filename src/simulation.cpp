@@ -0,0 +1,339 @@
+#include "simulation.h"
+#include "simd.h"
+#include <cmath>
+
+// Helper function to get position and direction on the oval track
+// Progress: 0-1 around the track
+// Returns position and forward direction
+void Simulation_GetTrackPositionAndDirection(float progress, float straightLength, float radius,
+                                             Vec3& outPos, Vec3& outDir)
+{
+    const float PI = 3.14159265f;
+
+    // Track layout (counterclockwise):
+    // - Bottom straight: progress 0 to 0.25 (going +X)
+    // - Right semicircle: progress 0.25 to 0.5 (turning around)
+    // - Top straight: progress 0.5 to 0.75 (going -X)
+    // - Left semicircle: progress 0.75 to 1.0 (turning around)
+
+    float totalStraight = straightLength * 2.0f;
+    float totalCurve = 2.0f * PI * radius;
+    float totalLength = totalStraight + totalCurve;
+
+    float straightFraction = totalStraight / totalLength;
+    float curveFraction = totalCurve / totalLength;
+    float singleStraightFrac = straightFraction * 0.5f;
+    float singleCurveFrac = curveFraction * 0.5f;
+
+    float halfStraight = straightLength * 0.5f;
+
+    if (progress < singleStraightFrac)
+    {
+        // Bottom straight (going +X direction)
+        float t = progress / singleStraightFrac;
+        outPos = Vec3(-halfStraight + t * straightLength, 0, -radius);
+        outDir = Vec3(1, 0, 0);
+    }
+    else if (progress < singleStraightFrac + singleCurveFrac)
+    {
+        // Right semicircle
+        float t = (progress - singleStraightFrac) / singleCurveFrac;
+        float angle = -PI * 0.5f + t * PI;  // -90 to +90 degrees
+        outPos = Vec3(halfStraight + cosf(angle) * radius, 0, sinf(angle) * radius);
+        outDir = Vec3(-sinf(angle), 0, cosf(angle));
+    }
+    else if (progress < 2.0f * singleStraightFrac + singleCurveFrac)
+    {
+        // Top straight (going -X direction)
+        float t = (progress - singleStraightFrac - singleCurveFrac) / singleStraightFrac;
+        outPos = Vec3(halfStraight - t * straightLength, 0, radius);
+        outDir = Vec3(-1, 0, 0);
+    }
+    else
+    {
+        // Left semicircle
+        float t = (progress - 2.0f * singleStraightFrac - singleCurveFrac) / singleCurveFrac;
+        float angle = PI * 0.5f + t * PI;  // +90 to +270 degrees
+        outPos = Vec3(-halfStraight + cosf(angle) * radius, 0, sinf(angle) * radius);
+        outDir = Vec3(-sinf(angle), 0, cosf(angle));
+    }
+}
+
+// Progress along the track between consecutive cars of a lane
+static float GetSpacingFraction(const SimulationState* sim)
+{
+    // At spacing=1: cars evenly spread (maxSpacing)
+    // At spacing=0: cars close together (minGap = 0.5m between cars)
+    const uint32_t carsPerLane = (sim->numCars + sim->numLanes - 1) / sim->numLanes;
+    float maxSpacingMeters = sim->trackLength / (float)carsPerLane;  // Max distance between cars in each lane
+    float minSpacingMeters = CAR_LENGTH + SIMULATION_MIN_CAR_GAP;  // Minimum: car length + 0.5m gap
+    float currentSpacingMeters = minSpacingMeters + (maxSpacingMeters - minSpacingMeters) * sim->carSpacing;
+    return currentSpacingMeters / sim->trackLength;  // As fraction of track
+}
+
+// ---------------------------------------------------------------------------
+// Vectorized track evaluation
+//
+// EvaluateCars is written against the lane types in simd.h, so every ISA runs
+// the exact same branchless kernel. Leftover cars go through the scalar type.
+// ---------------------------------------------------------------------------
+
+// Track constants shared by all lanes
+struct TrackConstants
+{
+    float halfStraight;
+    float straightLength;
+    float radius;
+    float singleStraightFrac;   // Progress covered by one straight
+    float halfTrackFrac;        // Progress covered by one straight + one semicircle
+    float invStraightFrac;
+    float invCurveFrac;
+};
+
+static TrackConstants GetTrackConstants(const SimulationState* sim)
+{
+    const float PI = 3.14159265f;
+
+    float totalStraight = sim->trackStraightLength * 2.0f;
+    float totalCurve = 2.0f * PI * sim->trackRadius;
+    float totalLength = totalStraight + totalCurve;
+    float singleStraightFrac = totalStraight / totalLength * 0.5f;
+    float singleCurveFrac = totalCurve / totalLength * 0.5f;
+
+    TrackConstants tc;
+    tc.halfStraight = sim->trackStraightLength * 0.5f;
+    tc.straightLength = sim->trackStraightLength;
+    tc.radius = sim->trackRadius;
+    tc.singleStraightFrac = singleStraightFrac;
+    tc.halfTrackFrac = singleStraightFrac + singleCurveFrac;
+    tc.invStraightFrac = 1.0f / singleStraightFrac;
+    tc.invCurveFrac = 1.0f / singleCurveFrac;
+    return tc;
+}
+
+// sin/cos for |x| <= pi/4 (Cephes minimax polynomials, ~1 ulp)
+template <typename F>
+static inline void SinCosQuarterPi(F x, F& outSin, F& outCos)
+{
+    F z = x * x;
+    F sinPoly = F::Set(-1.9515295891e-4f) * z + F::Set(8.3321608736e-3f);
+    sinPoly = sinPoly * z + F::Set(-1.6666654611e-1f);
+    outSin = x + x * z * sinPoly;
+
+    F cosPoly = F::Set(2.443315711809948e-5f) * z + F::Set(-1.388731625493765e-3f);
+    cosPoly = cosPoly * z + F::Set(4.166664568298827e-2f);
+    outCos = F::Set(1.0f) - F::Set(0.5f) * z + z * z * cosPoly;
+}
+
+// Evaluates F::WIDTH cars starting at index i. Same layout as
+// Simulation_GetTrackPositionAndDirection, written without branches:
+// the second half of the oval is the first half rotated by 180 degrees.
+template <typename F>
+static inline void EvaluateCars(SimulationState* sim, const TrackConstants& tc, uint32_t i)
+{
+    const F one = F::Set(1.0f);
+    const F zero = F::Set(0.0f);
+
+    F progress = F::Load(&sim->carProgress[i]);
+
+    // Fold the second half onto the first: sign = -1 rotates by 180 degrees
+    auto secondHalf = progress >= F::Set(tc.halfTrackFrac);
+    F sign = Select(secondHalf, F::Set(-1.0f), one);
+    F p = Select(secondHalf, progress - F::Set(tc.halfTrackFrac), progress);
+    auto onCurve = p >= F::Set(tc.singleStraightFrac);
+
+    // Straight: -halfStraight -> +halfStraight at z = -radius, heading +X
+    F t = p * F::Set(tc.invStraightFrac);
+    F straightX = sign * (t * F::Set(tc.straightLength) - F::Set(tc.halfStraight));
+    F straightZ = sign * F::Set(-tc.radius);
+
+    // Semicircle around (halfStraight, 0), angle -90 -> +90 degrees. Evaluated
+    // as double-angle of a quarter-range sin/cos.
+    F u = (p - F::Set(tc.singleStraightFrac)) * F::Set(tc.invCurveFrac);
+    F halfAngle = (u - F::Set(0.5f)) * F::Set(3.14159265f * 0.5f);
+    F sinHalf, cosHalf;
+    SinCosQuarterPi(halfAngle, sinHalf, cosHalf);
+    F sinA = F::Set(2.0f) * sinHalf * cosHalf;
+    F cosA = one - F::Set(2.0f) * sinHalf * sinHalf;
+    F curveX = sign * (F::Set(tc.halfStraight) + cosA * F::Set(tc.radius));
+    F curveZ = sign * sinA * F::Set(tc.radius);
+
+    F trackX = Select(onCurve, curveX, straightX);
+    F trackZ = Select(onCurve, curveZ, straightZ);
+    F dirX = Select(onCurve, zero - sign * sinA, sign);
+    F dirZ = Select(onCurve, sign * cosA, zero);
+
+    // Lane offset along the right vector (dir.z, -dir.x)
+    F rightX = dirZ;
+    F rightZ = zero - dirX;
+    F lane = F::Load(&sim->carLane[i]);
+    F posX = trackX + rightX * lane;
+    F posZ = trackZ + rightZ * lane;
+
+    // Headlights at the car front, HEADLIGHT_SPACING to either side
+    F frontX = posX + dirX * F::Set(CAR_LENGTH * 0.5f);
+    F frontZ = posZ + dirZ * F::Set(CAR_LENGTH * 0.5f);
+    F offsetX = rightX * F::Set(HEADLIGHT_SPACING);
+    F offsetZ = rightZ * F::Set(HEADLIGHT_SPACING);
+
+    posX.Store(&sim->carPosX[i]);
+    posZ.Store(&sim->carPosZ[i]);
+    dirX.Store(&sim->carDirX[i]);
+    dirZ.Store(&sim->carDirZ[i]);
+    rightX.Store(&sim->carRightX[i]);
+    rightZ.Store(&sim->carRightZ[i]);
+    (frontX - offsetX).Store(&sim->headlightLeftX[i]);
+    (frontZ - offsetZ).Store(&sim->headlightLeftZ[i]);
+    (frontX + offsetX).Store(&sim->headlightRightX[i]);
+    (frontZ + offsetZ).Store(&sim->headlightRightZ[i]);
+}
+
+// Re-derives car poses and headlight positions from the track progress
+static void UpdatePoses(SimulationState* sim)
+{
+    // Cars follow their lane leader (car 0..numLanes-1) at the configured spacing
+    float spacingFraction = GetSpacingFraction(sim);
+    for (uint32_t i = 0; i < sim->numCars; i++)
+    {
+        float progress = sim->carTrackProgress[i % sim->numLanes] + (float)(i / sim->numLanes) * spacingFraction;
+        if (progress >= 1.0f) progress -= 1.0f;
+        sim->carProgress[i] = progress;
+    }
+
+    TrackConstants tc = GetTrackConstants(sim);
+    uint32_t i = 0;
+    for (; i + FloatXN::WIDTH <= sim->numCars; i += FloatXN::WIDTH)
+        EvaluateCars<FloatXN>(sim, tc, i);
+    for (; i < sim->numCars; i++)
+        EvaluateCars<FloatX1>(sim, tc, i);
+}
+
+// Moves every car forward by one step's worth of progress
+static void AdvanceProgress(SimulationState* sim, float progressDelta)
+{
+    for (uint32_t i = 0; i < sim->numCars; i++)
+    {
+        sim->carTrackProgress[i] += progressDelta;
+        if (sim->carTrackProgress[i] >= 1.0f)
+            sim->carTrackProgress[i] -= 1.0f;
+    }
+}
+
+void Simulation_Init(SimulationState* sim)
+{
+    const float PI = 3.14159265f;
+
+    // Calculate total track length
+    sim->trackLength = sim->trackStraightLength * 2.0f + 2.0f * PI * sim->trackRadius;
+
+    // Fill lanes up to bumper-to-bumper capacity; at least an inner and an outer lane
+    const uint32_t numCars = (sim->carCount > 0) ? sim->carCount : 1;
+    const uint32_t maxCarsPerLane = (uint32_t)(sim->trackLength / (CAR_LENGTH + SIMULATION_MIN_CAR_GAP));
+    uint32_t numLanes = (numCars + maxCarsPerLane - 1) / maxCarsPerLane;
+    if (numLanes < 2) numLanes = 2;
+    const uint32_t carsPerLane = (numCars + numLanes - 1) / numLanes;
+    sim->numCars = numCars;
+    sim->numLanes = numLanes;
+
+    sim->carTrackProgress.resize(numCars);
+    sim->carLane.resize(numCars);
+    sim->carProgress.resize(numCars);
+    sim->carPosX.resize(numCars);
+    sim->carPosZ.resize(numCars);
+    sim->carDirX.resize(numCars);
+    sim->carDirZ.resize(numCars);
+    sim->carRightX.resize(numCars);
+    sim->carRightZ.resize(numCars);
+    sim->headlightLeftX.resize(numCars);
+    sim->headlightLeftZ.resize(numCars);
+    sim->headlightRightX.resize(numCars);
+    sim->headlightRightZ.resize(numCars);
+
+    for (uint32_t i = 0; i < numCars; i++)
+    {
+        uint32_t lane = i % numLanes;
+        uint32_t posInLane = i / numLanes;
+
+        // Initial progress along track (evenly spaced within each lane)
+        sim->carTrackProgress[i] = (float)posInLane / (float)carsPerLane;
+
+        // Lane offset (negative = inner, positive = outer)
+        sim->carLane[i] = Simulation_GetLaneOffset(sim, lane);
+    }
+
+    // Headlights, placed by UpdatePoses
+    ConeLight headlight;
+    headlight.color = Vec3(1.5f, 1.4f, 1.2f);
+    headlight.range = 30.0f;
+    headlight.innerAngle = 0.15f;
+    headlight.outerAngle = 0.35f;
+
+    sim->numConeLights = Simulation_GetRequestedLightCount(sim);
+    sim->coneLights.assign(sim->numConeLights, headlight);
+
+    sim->stepAccumulator = 0.0f;
+    sim->stepCount = 0;
+    UpdatePoses(sim);
+}
+
+uint32_t Simulation_GetRequestedLightCount(const SimulationState* sim)
+{
+    uint32_t maxLights = 2 * ((sim->carCount > 0) ? sim->carCount : 1);
+    if (sim->lightCount == 0 || sim->lightCount > maxLights)
+        return maxLights;
+    return sim->lightCount;
+}
+
+bool Simulation_NeedsInit(const SimulationState* sim)
+{
+    uint32_t numCars = (sim->carCount > 0) ? sim->carCount : 1;
+    return sim->numCars != numCars || sim->numConeLights != Simulation_GetRequestedLightCount(sim);
+}
+
+void Simulation_Step(SimulationState* sim)
+{
+    Simulation_AdvanceSteps(sim, 1);
+}
+
+void Simulation_AdvanceSteps(SimulationState* sim, uint64_t numSteps)
+{
+    float progressDelta = (sim->carSpeed * SIMULATION_STEP) / sim->trackLength;
+    for (uint64_t s = 0; s < numSteps; s++)
+        AdvanceProgress(sim, progressDelta);
+
+    sim->stepCount += numSteps;
+    UpdatePoses(sim);
+}
+
+void Simulation_Update(SimulationState* sim, float deltaTime)
+{
+    sim->stepAccumulator += deltaTime;
+
+    uint32_t numSteps = 0;
+    while (sim->stepAccumulator >= SIMULATION_STEP && numSteps < SIMULATION_MAX_STEPS_PER_UPDATE)
+    {
+        sim->stepAccumulator -= SIMULATION_STEP;
+        numSteps++;
+    }
+
+    // Drop whatever time we couldn't catch up on
+    if (numSteps == SIMULATION_MAX_STEPS_PER_UPDATE && sim->stepAccumulator > SIMULATION_STEP)
+        sim->stepAccumulator = 0.0f;
+
+    // Still re-derive poses on zero-step frames so spacing changes apply immediately
+    Simulation_AdvanceSteps(sim, numSteps);
+}
+
+void Simulation_ShiftProgress(SimulationState* sim, float progressDelta)
+{
+    for (uint32_t i = 0; i < sim->numCars; i++)
+    {
+        sim->carTrackProgress[i] += progressDelta;
+        // Wrap to [0, 1)
+        while (sim->carTrackProgress[i] >= 1.0f)
+            sim->carTrackProgress[i] -= 1.0f;
+        while (sim->carTrackProgress[i] < 0.0f)
+            sim->carTrackProgress[i] += 1.0f;
+    }
+    UpdatePoses(sim);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+// Car / headlight simulation on the oval track. Single source of truth for the
+// D3D12 renderer, the software renderer and the PBRT exporter. Portable: no
+// Windows or graphics API headers.
+
+#include <cstdint>
+#include <vector>
+
+#include "math_utils.h"
+
+// Default scene size. Both counts are runtime settings (carCount / lightCount).
+static constexpr uint32_t SIMULATION_DEFAULT_CARS = 60;
+
+// Largest carCount a config may request (lightCount: two per car)
+static constexpr uint32_t SIMULATION_MAX_CARS = 65536;
+
+// Gap between consecutive cars of a lane at carSpacing = 0
+static constexpr float SIMULATION_MIN_CAR_GAP = 0.5f;
+
+// Fixed simulation time step (seconds)
+static constexpr float SIMULATION_STEP = 1.0f / 60.0f;
+
+// Upper bound on steps per Simulation_Update so a long hitch (debugger,
+// window drag) doesn't stall the frame catching up
+static constexpr uint32_t SIMULATION_MAX_STEPS_PER_UPDATE = 8;
+
+// Car-sized boxes: 4m long, 2m wide, 1.5m tall
+static constexpr float CAR_LENGTH = 4.0f;
+static constexpr float CAR_WIDTH = 2.0f;
+static constexpr float CAR_HEIGHT = 1.5f;
+
+// Headlight placement relative to the car front
+static constexpr float HEADLIGHT_HEIGHT = 0.6f;
+static constexpr float HEADLIGHT_SPACING = 0.7f;
+
+// Static per-light parameters. Positions and directions are derived from the
+// car poses every step, see Simulation_GetLightPosition/Direction.
+struct ConeLight
+{
+    Vec3 color;
+    float range;
+    float innerAngle;
+    float outerAngle;
+};
+
+struct SimulationState
+{
+    // Requested scene size, applied by Simulation_Init. lightCount = 0 means two
+    // headlights per car; more than that is clamped.
+    uint32_t carCount = SIMULATION_DEFAULT_CARS;
+    uint32_t lightCount = 0;
+
+    // Cone lights (two headlights per car: light 2*i is the left one of car i)
+    std::vector<ConeLight>          coneLights;
+    uint32_t                        numConeLights = 0;
+
+    // Car animation. Car i drives in lane i % numLanes.
+    uint32_t numCars = 0;
+    uint32_t numLanes = 0;
+    std::vector<float> carTrackProgress;  // 0-1 progress along the oval track
+    std::vector<float> carLane;           // Lane offset from the centerline
+    float carSpeed = 20.0f;            // Speed in meters per second
+    float carSpacing = 1.0f;           // 0-1: 0=close (0.5m gap), 1=max spread
+
+    // Derived car poses (SoA, rewritten every step). Cars sit at y = CAR_HEIGHT / 2
+    // and headlights at y = HEADLIGHT_HEIGHT, so only XZ is stored.
+    std::vector<float> carProgress;       // Effective progress including lane spacing
+    std::vector<float> carPosX;
+    std::vector<float> carPosZ;
+    std::vector<float> carDirX;
+    std::vector<float> carDirZ;
+    std::vector<float> carRightX;
+    std::vector<float> carRightZ;
+    std::vector<float> headlightLeftX;
+    std::vector<float> headlightLeftZ;
+    std::vector<float> headlightRightX;
+    std::vector<float> headlightRightZ;
+
+    // Track parameters
+    float trackLength = 0.0f;          // Total track length in meters
+    float trackStraightLength = 150.0f;
+    float trackRadius = 50.0f;
+    float trackLaneWidth = 3.0f;
+
+    // Fixed-step bookkeeping
+    float stepAccumulator = 0.0f;      // Unsimulated time carried to the next update
+    uint64_t stepCount = 0;            // Fixed steps simulated since Simulation_Init
+};
+
+// Position and forward direction on the track centerline for progress in [0, 1).
+// Scalar reference for the vectorized evaluation in Simulation_Step.
+void Simulation_GetTrackPositionAndDirection(float progress, float straightLength, float radius,
+                                             Vec3& outPos, Vec3& outDir);
+
+// Places carCount cars at the start of the track and creates their headlights.
+// Cars that don't fit into two lanes bumper to bumper spill into extra lanes
+// further out.
+void Simulation_Init(SimulationState* sim);
+
+// Number of headlights Simulation_Init creates for the requested counts
+uint32_t Simulation_GetRequestedLightCount(const SimulationState* sim);
+
+// True when carCount / lightCount no longer match the initialized scene
+bool Simulation_NeedsInit(const SimulationState* sim);
+
+// Offset of a lane from the track centerline (lane 0 inside, lane 1 outside,
+// further lanes outward from there)
+inline float Simulation_GetLaneOffset(const SimulationState* sim, uint32_t lane)
+{
+    return ((float)lane - 0.5f) * sim->trackLaneWidth;
+}
+
+// World-space center (at half car height), forward and right vectors of a car
+inline void Simulation_GetCarPose(const SimulationState* sim, uint32_t carIndex, Vec3& outPos, Vec3& outDir, Vec3& outRight)
+{
+    outPos = Vec3(sim->carPosX[carIndex], CAR_HEIGHT * 0.5f, sim->carPosZ[carIndex]);
+    outDir = Vec3(sim->carDirX[carIndex], 0.0f, sim->carDirZ[carIndex]);
+    outRight = Vec3(sim->carRightX[carIndex], 0.0f, sim->carRightZ[carIndex]);
+}
+
+inline Vec3 Simulation_GetLightPosition(const SimulationState* sim, uint32_t lightIndex)
+{
+    uint32_t car = lightIndex / 2;
+    if (lightIndex & 1)
+        return Vec3(sim->headlightRightX[car], HEADLIGHT_HEIGHT, sim->headlightRightZ[car]);
+    return Vec3(sim->headlightLeftX[car], HEADLIGHT_HEIGHT, sim->headlightLeftZ[car]);
+}
+
+inline Vec3 Simulation_GetLightDirection(const SimulationState* sim, uint32_t lightIndex)
+{
+    uint32_t car = lightIndex / 2;
+    return Vec3(sim->carDirX[car], 0.0f, sim->carDirZ[car]);
+}
+
+// Advances by exactly one SIMULATION_STEP
+void Simulation_Step(SimulationState* sim);
+
+// Advances by numSteps fixed steps. Progress is integrated step by step (same
+// result as calling Simulation_Step numSteps times), car poses and lights are
+// only derived once at the end.
+void Simulation_AdvanceSteps(SimulationState* sim, uint64_t numSteps);
+
+// Accumulates real frame time and runs as many fixed steps as it covers
+void Simulation_Update(SimulationState* sim, float deltaTime);
+
+// Shifts all cars along the track by a progress delta (wrapped to [0, 1))
+// and refreshes the lights. Used when loading a saved simulation time.
+void Simulation_ShiftProgress(SimulationState* sim, float progressDelta);
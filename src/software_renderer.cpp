@@ -0,0 +1,825 @@
+#include "software_renderer.h"
+#include "horizon.h"
+#include "light_clusters.h"
+#include "light_grid.h"
+#include "light_pack.h"
+#include "parallel.h"
+#include "shadow_atlas.h"
+#include "shadow_culling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Tile size for binning the main pass and the top-down depth pass
+static constexpr int TILE_SIZE = 64;
+
+// Sub-pixel precision of the rasterizer (8 bits, same as D3D hardware)
+static constexpr int SUBPIXEL_BITS = 8;
+static constexpr float SUBPIXEL_SCALE = (float)(1 << SUBPIXEL_BITS);
+
+// Interpolated attributes: worldPos (3), normal (3), uv (2)
+static constexpr int NUM_ATTRIBUTES = 8;
+
+// Clip planes x 1 extra vertex each, plus the original triangle
+static constexpr int MAX_CLIP_VERTS = 9;
+
+struct ClipVertex
+{
+    float pos[4];               // Clip space position
+    float attr[NUM_ATTRIBUTES];
+};
+
+// Triangle after clipping, viewport transform and culling
+struct ScreenTriangle
+{
+    int64_t x[3], y[3];         // Window position in sub-pixel units
+    float z[3];                 // Depth after perspective divide
+    float invW[3];
+    float attr[3][NUM_ATTRIBUTES];
+    int64_t area;               // Twice the signed area, > 0
+    int minX, minY, maxX, maxY; // Pixel bounds, inclusive
+};
+
+struct ShadeContext
+{
+    CameraConstants cb;
+    const ConeLightGPU* lights;
+    const Mat4* lightMatrices;
+    int lightCount;
+    const float* shadowAtlas;           // SHADOW_ATLAS_SIZE^2 depth values
+    const HorizonSlice* horizonSlices;
+    const HorizonAngularMap* angularHorizon;
+    const LightClusterGrid* clusters;   // Only with LIGHT_CULLING_CLUSTERED
+    const LightGrid* lightGrid;         // Only with LIGHT_CULLING_GRID
+};
+
+// Lights to shade for one pixel: indices[0, count), or lights [0, count) when
+// indices is null (no culling)
+struct PixelLights
+{
+    const uint32_t* indices;
+    uint32_t count;
+};
+
+// ---------------------------------------------------------------------------
+// HLSL helpers
+// ---------------------------------------------------------------------------
+
+static float Saturate(float v)
+{
+    // Matches HLSL saturate, which maps NaN to 0
+    if (!(v > 0.0f)) return 0.0f;
+    return v < 1.0f ? v : 1.0f;
+}
+
+static float Lerp(float a, float b, float t)
+{
+    return a + (b - a) * t;
+}
+
+static float Frac(float v)
+{
+    return v - floorf(v);
+}
+
+static void TransformPoint(const Mat4& m, const float* p, float* out)
+{
+    for (int r = 0; r < 4; ++r)
+        out[r] = m.m[0 * 4 + r] * p[0] + m.m[1 * 4 + r] * p[1] + m.m[2 * 4 + r] * p[2] + m.m[3 * 4 + r];
+}
+
+static Vec3 HSVtoRGB(float h, float s, float v)
+{
+    Vec3 rgb;
+    float c = v * s;
+    float hPrime = h * 6.0f;
+    float x = c * (1.0f - fabsf(fmodf(hPrime, 2.0f) - 1.0f));
+    float m = v - c;
+
+    if (hPrime < 1.0f)
+        rgb = Vec3(c, x, 0.0f);
+    else if (hPrime < 2.0f)
+        rgb = Vec3(x, c, 0.0f);
+    else if (hPrime < 3.0f)
+        rgb = Vec3(0.0f, c, x);
+    else if (hPrime < 4.0f)
+        rgb = Vec3(0.0f, x, c);
+    else if (hPrime < 5.0f)
+        rgb = Vec3(x, 0.0f, c);
+    else
+        rgb = Vec3(c, 0.0f, x);
+
+    return rgb + Vec3(m, m, m);
+}
+
+static Vec3 IntensityToHeatColor(float intensity)
+{
+    float hue = Saturate(intensity) * 0.9f;
+    return HSVtoRGB(hue, 1.0f, 1.0f);
+}
+
+// ---------------------------------------------------------------------------
+// Triangle setup
+// ---------------------------------------------------------------------------
+
+static float ClipDistance(const float* pos, int plane)
+{
+    switch (plane)
+    {
+    case 0: return pos[2];            // z >= 0
+    case 1: return pos[3] - pos[2];   // z <= w
+    case 2: return pos[3] + pos[0];   // x >= -w
+    case 3: return pos[3] - pos[0];   // x <= w
+    case 4: return pos[3] + pos[1];   // y >= -w
+    default: return pos[3] - pos[1];  // y <= w
+    }
+}
+
+// Sutherland-Hodgman against the D3D view volume. Returns the vertex count of
+// the clipped convex polygon (0 if fully outside).
+static int ClipPolygon(ClipVertex* verts, int count)
+{
+    ClipVertex temp[MAX_CLIP_VERTS];
+
+    for (int plane = 0; plane < 6 && count > 0; ++plane)
+    {
+        int outCount = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            const ClipVertex& a = verts[i];
+            const ClipVertex& b = verts[(i + 1) % count];
+            float da = ClipDistance(a.pos, plane);
+            float db = ClipDistance(b.pos, plane);
+
+            if (da >= 0.0f)
+                temp[outCount++] = a;
+
+            if ((da >= 0.0f) != (db >= 0.0f))
+            {
+                float t = da / (da - db);
+                ClipVertex& v = temp[outCount++];
+                for (int k = 0; k < 4; ++k)
+                    v.pos[k] = Lerp(a.pos[k], b.pos[k], t);
+                for (int k = 0; k < NUM_ATTRIBUTES; ++k)
+                    v.attr[k] = Lerp(a.attr[k], b.attr[k], t);
+            }
+        }
+
+        count = outCount;
+        memcpy(verts, temp, count * sizeof(ClipVertex));
+    }
+
+    return count;
+}
+
+static bool IsInsideAllPlanes(const ClipVertex& v)
+{
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        if (ClipDistance(v.pos, plane) < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// Viewport transform + back-face cull (clockwise in window space is front,
+// matching the D3D12 default FrontCounterClockwise = FALSE)
+static bool EmitTriangle(const ClipVertex* v0, const ClipVertex* v1, const ClipVertex* v2,
+                         int width, int height, std::vector<ScreenTriangle>& out)
+{
+    const ClipVertex* src[3] = { v0, v1, v2 };
+    ScreenTriangle tri;
+    float minXf = 1e30f, minYf = 1e30f, maxXf = -1e30f, maxYf = -1e30f;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        float invW = 1.0f / src[i]->pos[3];
+        float sx = (src[i]->pos[0] * invW * 0.5f + 0.5f) * (float)width;
+        float sy = (0.5f - src[i]->pos[1] * invW * 0.5f) * (float)height;
+
+        tri.x[i] = (int64_t)llroundf(sx * SUBPIXEL_SCALE);
+        tri.y[i] = (int64_t)llroundf(sy * SUBPIXEL_SCALE);
+        tri.z[i] = src[i]->pos[2] * invW;
+        tri.invW[i] = invW;
+        memcpy(tri.attr[i], src[i]->attr, sizeof(tri.attr[i]));
+
+        minXf = std::min(minXf, sx); maxXf = std::max(maxXf, sx);
+        minYf = std::min(minYf, sy); maxYf = std::max(maxYf, sy);
+    }
+
+    tri.area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+    if (tri.area <= 0)
+        return false;
+
+    tri.minX = std::max(0, (int)floorf(minXf));
+    tri.minY = std::max(0, (int)floorf(minYf));
+    tri.maxX = std::min(width - 1, (int)ceilf(maxXf));
+    tri.maxY = std::min(height - 1, (int)ceilf(maxYf));
+    if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+        return false;
+
+    out.push_back(tri);
+    return true;
+}
+
+// Transforms, clips and culls indexed triangles [firstIndex, firstIndex + indexCount)
+static void SetupTriangles(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                           uint32_t firstIndex, uint32_t indexCount, const Mat4& viewProj,
+                           int width, int height, std::vector<ScreenTriangle>& out)
+{
+    ClipVertex poly[MAX_CLIP_VERTS];
+    uint32_t endIndex = std::min(firstIndex + indexCount, (uint32_t)indices.size());
+
+    for (uint32_t i = firstIndex; i + 2 < endIndex; i += 3)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            const Vertex& v = vertices[indices[i + k]];
+            TransformPoint(viewProj, v.position, poly[k].pos);
+            memcpy(&poly[k].attr[0], v.position, sizeof(v.position));
+            memcpy(&poly[k].attr[3], v.normal, sizeof(v.normal));
+            memcpy(&poly[k].attr[6], v.uv, sizeof(v.uv));
+        }
+
+        int count = 3;
+        if (!IsInsideAllPlanes(poly[0]) || !IsInsideAllPlanes(poly[1]) || !IsInsideAllPlanes(poly[2]))
+            count = ClipPolygon(poly, 3);
+
+        // Fan triangulation keeps the winding of the source triangle
+        for (int k = 1; k + 1 < count; ++k)
+            EmitTriangle(&poly[0], &poly[k], &poly[k + 1], width, height, out);
+    }
+}
+
+// Calls fn(x, y, z, b0, b1, b2) for every covered pixel center inside
+// [rectX0, rectX1] x [rectY0, rectY1] using the D3D top-left fill rule
+template <typename Fn>
+static void RasterizeTriangle(const ScreenTriangle& tri, int rectX0, int rectY0, int rectX1, int rectY1, Fn&& fn)
+{
+    int x0 = std::max(tri.minX, rectX0);
+    int y0 = std::max(tri.minY, rectY0);
+    int x1 = std::min(tri.maxX, rectX1);
+    int y1 = std::min(tri.maxY, rectY1);
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    // Edge i is opposite vertex i: edge 0 = v1->v2, edge 1 = v2->v0, edge 2 = v0->v1
+    int64_t stepX[3], stepY[3], rowStart[3], bias[3];
+    const int64_t half = 1 << (SUBPIXEL_BITS - 1);
+    const int64_t px = (int64_t)x0 * (1 << SUBPIXEL_BITS) + half;
+    const int64_t py = (int64_t)y0 * (1 << SUBPIXEL_BITS) + half;
+
+    for (int e = 0; e < 3; ++e)
+    {
+        int a = (e + 1) % 3;
+        int b = (e + 2) % 3;
+        int64_t dx = tri.x[b] - tri.x[a];
+        int64_t dy = tri.y[b] - tri.y[a];
+
+        stepX[e] = -dy << SUBPIXEL_BITS;
+        stepY[e] = dx << SUBPIXEL_BITS;
+        rowStart[e] = dx * (py - tri.y[a]) - dy * (px - tri.x[a]);
+
+        // Top-left rule: pixels exactly on a top or left edge are inside
+        bool topLeft = (dy < 0) || (dy == 0 && dx > 0);
+        bias[e] = topLeft ? 0 : -1;
+    }
+
+    const float invArea = 1.0f / (float)tri.area;
+    const float dz1 = tri.z[1] - tri.z[0];
+    const float dz2 = tri.z[2] - tri.z[0];
+
+    for (int y = y0; y <= y1; ++y)
+    {
+        int64_t e0 = rowStart[0], e1 = rowStart[1], e2 = rowStart[2];
+        for (int x = x0; x <= x1; ++x)
+        {
+            if ((e0 + bias[0]) >= 0 && (e1 + bias[1]) >= 0 && (e2 + bias[2]) >= 0)
+            {
+                float b1 = (float)e1 * invArea;
+                float b2 = (float)e2 * invArea;
+                float b0 = 1.0f - b1 - b2;
+                float z = tri.z[0] + b1 * dz1 + b2 * dz2;
+                fn(x, y, z, b0, b1, b2);
+            }
+            e0 += stepX[0]; e1 += stepX[1]; e2 += stepX[2];
+        }
+        rowStart[0] += stepY[0]; rowStart[1] += stepY[1]; rowStart[2] += stepY[2];
+    }
+}
+
+// Groups triangles by the tiles their bounds touch, preserving submission order
+static void BinTriangles(const std::vector<ScreenTriangle>& tris, int tilesX, int tilesY,
+                         std::vector<std::vector<uint32_t>>& bins)
+{
+    bins.assign(tilesX * tilesY, std::vector<uint32_t>());
+    for (uint32_t t = 0; t < (uint32_t)tris.size(); ++t)
+    {
+        const ScreenTriangle& tri = tris[t];
+        for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ++ty)
+        {
+            for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; ++tx)
+                bins[ty * tilesX + tx].push_back(t);
+        }
+    }
+}
+
+// Depth-only pass with LESS test into a cleared (1.0) buffer
+static void RasterizeDepth(const std::vector<ScreenTriangle>& tris, int width, int height, float* depth)
+{
+    std::fill(depth, depth + (size_t)width * height, 1.0f);
+
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    std::vector<std::vector<uint32_t>> bins;
+    BinTriangles(tris, tilesX, tilesY, bins);
+
+    ParallelFor(tilesX * tilesY, [&](uint32_t tile)
+    {
+        int rectX0 = (int)(tile % tilesX) * TILE_SIZE;
+        int rectY0 = (int)(tile / tilesX) * TILE_SIZE;
+        int rectX1 = std::min(rectX0 + TILE_SIZE, width) - 1;
+        int rectY1 = std::min(rectY0 + TILE_SIZE, height) - 1;
+
+        for (uint32_t t : bins[tile])
+        {
+            RasterizeTriangle(tris[t], rectX0, rectY0, rectX1, rectY1,
+                [&](int x, int y, float z, float, float, float)
+                {
+                    float& d = depth[(size_t)y * width + x];
+                    if (z < d) d = z;
+                });
+        }
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Pixel shading (port of PSMain in g_ShaderSource)
+// ---------------------------------------------------------------------------
+
+static float HorizonClearance(float lightY, float requiredHeight)
+{
+    float bias = 0.1f;
+    float softness = 1.5f;
+    return Saturate((lightY - (requiredHeight + bias)) / softness);
+}
+
+// Port of CalculateAngularHorizonShadow: bilinear over the 4 nearest texels,
+// linear between the 2 directions around the light
+static float CalculateAngularHorizonShadow(const ShadeContext& ctx, const Vec3& worldPos, const Vec3& lightPos)
+{
+    const int size = HORIZON_ANGULAR_MAP_SIZE;
+    float u = (worldPos.x - ctx.cb.horizonWorldMinX) / ctx.cb.horizonWorldSize;
+    float v = (worldPos.z - ctx.cb.horizonWorldMinZ) / ctx.cb.horizonWorldSize;
+
+    if (u < 0.0f || u > 1.0f || v < 0.0f || v > 1.0f)
+        return 1.0f;
+
+    float dx = lightPos.x - worldPos.x;
+    float dz = lightPos.z - worldPos.z;
+    float distToLight = sqrtf(dx * dx + dz * dz);
+    if (distToLight < 0.001f)
+        return 1.0f;
+
+    float azimuth = atan2f(dz, dx) * (float)HORIZON_ANGLE_COUNT / 6.28318530718f;
+    if (azimuth < 0.0f)
+        azimuth += (float)HORIZON_ANGLE_COUNT;
+    int dir0 = std::min((int)azimuth, HORIZON_ANGLE_COUNT - 1);
+    int dir1 = (dir0 + 1) % HORIZON_ANGLE_COUNT;
+    float dirWeight = azimuth - (float)dir0;
+
+    float px = u * (float)size - 0.5f;
+    float py = v * (float)size - 0.5f;
+    float fx = floorf(px);
+    float fy = floorf(py);
+    float wx = px - fx;
+    float wy = py - fy;
+
+    float shadow = 0.0f;
+    for (int j = 0; j < 2; ++j)
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            int x = std::min(std::max((int)fx + i, 0), size - 1);
+            int y = std::min(std::max((int)fy + j, 0), size - 1);
+            float s0 = HorizonClearance(lightPos.y, Horizon_GetAngularRequiredHeight(*ctx.angularHorizon, x, y, dir0, distToLight));
+            float s1 = HorizonClearance(lightPos.y, Horizon_GetAngularRequiredHeight(*ctx.angularHorizon, x, y, dir1, distToLight));
+            float weight = (i ? wx : 1.0f - wx) * (j ? wy : 1.0f - wy);
+            shadow += weight * (s0 + (s1 - s0) * dirWeight);
+        }
+    }
+    return shadow;
+}
+
+static float CalculateHorizonShadow(const ShadeContext& ctx, const Vec3& worldPos, const Vec3& lightPos, int lightIndex)
+{
+    if (ctx.cb.useAngularHorizon > 0.5f)
+        return CalculateAngularHorizonShadow(ctx, worldPos, lightPos);
+
+    float u = (worldPos.x - ctx.cb.horizonWorldMinX) / ctx.cb.horizonWorldSize;
+    float v = (worldPos.z - ctx.cb.horizonWorldMinZ) / ctx.cb.horizonWorldSize;
+
+    if (u < 0.0f || u > 1.0f || v < 0.0f || v > 1.0f)
+        return 1.0f;
+
+    // horizonMaps has a single mip, so the shader's SampleLevel(..., 2.0) resolves to mip 0
+    float requiredHeight = Horizon_Sample(ctx.horizonSlices[lightIndex], (int)SceneState::HORIZON_MAP_SIZE, u, v);
+    return HorizonClearance(lightPos.y, requiredHeight);
+}
+
+static float CalculateConeShadow(const ShadeContext& ctx, const Vec3& worldPos, int lightIndex)
+{
+    const float* tile = ctx.lights[lightIndex].shadowTile;
+    const int size = (int)tile[2];
+    float p[3] = { worldPos.x, worldPos.y, worldPos.z };
+    float lightSpacePos[4];
+    TransformPoint(ctx.lightMatrices[lightIndex], p, lightSpacePos);
+
+    float projX = lightSpacePos[0] / lightSpacePos[3];
+    float projY = lightSpacePos[1] / lightSpacePos[3];
+    float projZ = lightSpacePos[2] / lightSpacePos[3];
+
+    float shadowU = projX * 0.5f + 0.5f;
+    float shadowV = 1.0f - (projY * 0.5f + 0.5f);
+
+    // int() truncates toward zero; outside the tile reads 0, like an
+    // out-of-bounds Load from a texture of the tile's size
+    float fx = shadowU * (float)size;
+    float fy = shadowV * (float)size;
+    float shadowDepth = 0.0f;
+    if (fx > -1.0f && fy > -1.0f && fx < (float)size && fy < (float)size)
+    {
+        int tx = (int)tile[0] + (int)fx;
+        int ty = (int)tile[1] + (int)fy;
+        shadowDepth = ctx.shadowAtlas[(size_t)ty * SHADOW_ATLAS_SIZE + tx];
+    }
+
+    return (projZ <= shadowDepth + ctx.cb.shadowBias) ? 1.0f : 0.0f;
+}
+
+static Vec3 CalculateConeLightContribution(const ShadeContext& ctx, const Vec3& worldPos, const Vec3& normal, int lightIndex)
+{
+    const ConeLightGPU& light = ctx.lights[lightIndex];
+    Vec3 lightPos(light.position[0], light.position[1], light.position[2]);
+    float range = light.position[3];
+    Vec3 lightDir(light.direction[0], light.direction[1], light.direction[2]);
+    float cosOuter = light.direction[3];
+    Vec3 lightColor(light.color[0], light.color[1], light.color[2]);
+    float cosInner = light.color[3];
+
+    Vec3 toLight = lightPos - worldPos;
+    float dist = toLight.length();
+    if (dist > range) return Vec3();
+
+    Vec3 toLightNorm = toLight * (1.0f / dist);
+    float cosAngle = -dot(toLightNorm, lightDir);
+    if (cosAngle < cosOuter) return Vec3();
+
+    float coneAtten = Saturate((cosAngle - cosOuter) / (cosInner - cosOuter));
+    float distAtten = Saturate(1.0f - dist / range);
+    distAtten = powf(distAtten, ctx.cb.falloffExponent);
+    float ndotl = Saturate(dot(normal, toLightNorm));
+
+    float shadow = 1.0f;
+    if (ctx.cb.disableShadows < 0.5f && (float)lightIndex < ctx.cb.shadowedLightCount)
+    {
+        if (ctx.cb.useHorizonMapping > 0.5f)
+            shadow = CalculateHorizonShadow(ctx, worldPos, lightPos, lightIndex);
+        else if (light.shadowTile[2] > 0.0f)
+            shadow = CalculateConeShadow(ctx, worldPos, lightIndex);
+    }
+
+    return lightColor * (ndotl * coneAtten * distAtten * shadow);
+}
+
+static PixelLights GetPixelLights(const ShadeContext& ctx, float pixelX, float pixelY, const Vec3& worldPos)
+{
+    PixelLights lights = { nullptr, (uint32_t)ctx.lightCount };
+    if ((int)ctx.cb.lightCullingMode == LIGHT_CULLING_CLUSTERED)
+    {
+        float viewDepth = dot(worldPos - ctx.cb.cameraPos, ctx.cb.cameraForward);
+        const LightClusterRange& range = ctx.clusters->ranges[LightClusters_GetClusterIndex(ctx.clusters, pixelX, pixelY, viewDepth)];
+        lights.indices = ctx.clusters->lightIndices.data() + range.offset;
+        lights.count = range.count;
+    }
+    else if ((int)ctx.cb.lightCullingMode == LIGHT_CULLING_GRID)
+    {
+        const LightClusterRange& range = ctx.lightGrid->ranges[LightGrid_GetCellIndex(ctx.lightGrid, worldPos.x, worldPos.z)];
+        lights.indices = ctx.lightGrid->lightIndices.data() + range.offset;
+        lights.count = range.count;
+    }
+    return lights;
+}
+
+static Vec3 ShadePixel(const ShadeContext& ctx, const PixelLights& lights, const Vec3& worldPos, const Vec3& normal, float u, float v)
+{
+    if (ctx.cb.debugLightOverlap > 0.5f)
+    {
+        float overlapCount = 0.0f;
+        for (uint32_t j = 0; j < lights.count; ++j)
+        {
+            int i = lights.indices ? (int)lights.indices[j] : (int)j;
+            Vec3 contribution = CalculateConeLightContribution(ctx, worldPos, normal, i);
+            float total = contribution.x + contribution.y + contribution.z;
+            overlapCount += (total >= 0.000001f) ? 1.0f : 0.0f;
+        }
+
+        float t = Saturate(overlapCount / ctx.cb.overlapMaxCount);
+        return IntensityToHeatColor(t);
+    }
+
+    Vec3 color;
+    bool isGround = (normal.y > 0.9f && fabsf(worldPos.y) < 0.1f);
+
+    if (isGround)
+    {
+        Vec3 baseColor(0.3f, 0.3f, 0.3f);
+        if (ctx.cb.showGrid > 0.5f)
+        {
+            float gridX = Frac(u * 100.0f);
+            float gridY = Frac(v * 100.0f);
+            float lineWidth = 0.02f;
+            float gridLine = (gridX < lineWidth || gridY < lineWidth) ? 1.0f : 0.0f;
+            Vec3 lineColor(0.2f, 0.2f, 0.2f);
+            color = (baseColor + (lineColor - baseColor) * gridLine) * ctx.cb.ambientIntensity;
+        }
+        else
+        {
+            color = baseColor * ctx.cb.ambientIntensity;
+        }
+    }
+    else
+    {
+        Vec3 lightDir = Vec3(0.5f, 1.0f, 0.3f).normalized();
+        float ndotl = Saturate(dot(normal, lightDir));
+        Vec3 boxColor(0.85f, 0.85f, 0.85f);
+        color = boxColor * (ctx.cb.ambientIntensity + (1.0f - ctx.cb.ambientIntensity) * ndotl);
+    }
+
+    for (uint32_t j = 0; j < lights.count; ++j)
+    {
+        int i = lights.indices ? (int)lights.indices[j] : (int)j;
+        color += CalculateConeLightContribution(ctx, worldPos, normal, i) * ctx.cb.coneLightIntensity;
+    }
+
+    float dist = (worldPos - ctx.cb.cameraPos).length();
+    float fog = Saturate(dist / 2000.0f);
+    Vec3 fogColor(0.5f, 0.6f, 0.7f);
+    return color + (fogColor - color) * fog;
+}
+
+static void StorePixel(uint8_t* dst, const Vec3& color)
+{
+    // UNORM conversion: saturate, scale and round to nearest
+    dst[0] = (uint8_t)(Saturate(color.z) * 255.0f + 0.5f);
+    dst[1] = (uint8_t)(Saturate(color.y) * 255.0f + 0.5f);
+    dst[2] = (uint8_t)(Saturate(color.x) * 255.0f + 0.5f);
+    dst[3] = 255;
+}
+
+// ---------------------------------------------------------------------------
+// Passes
+// ---------------------------------------------------------------------------
+
+static void RenderShadowAtlas(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                              const Mat4* lightMatrices, const ShadowAtlas& atlas, const ShadowCasterLists& casters,
+                              std::vector<float>& depth)
+{
+    const size_t atlasSize = SHADOW_ATLAS_SIZE;
+    depth.assign(atlasSize * atlasSize, 1.0f);
+
+    // One light per work item; each tile is small enough to rasterize in one go
+    ParallelFor((uint32_t)atlas.tiles.size(), [&](uint32_t i)
+    {
+        const ShadowAtlasTile& tile = atlas.tiles[i];
+        if (tile.size == 0)
+            return;
+
+        // Only the cars inside the light's frustum
+        const int size = (int)tile.size;
+        std::vector<ScreenTriangle> tris;
+        const ShadowCasterRange& range = casters.ranges[i];
+        for (uint32_t r = range.offset; r < range.offset + range.count; ++r)
+        {
+            const ShadowCasterRun& run = casters.runs[r];
+            SetupTriangles(vertices, indices, SCENE_GROUND_INDEX_COUNT + run.firstCar * INDICES_PER_BOX,
+                           run.carCount * INDICES_PER_BOX, lightMatrices[i], size, size, tris);
+        }
+
+        float* tileDepth = &depth[(size_t)tile.y * atlasSize + tile.x];
+        for (const ScreenTriangle& tri : tris)
+        {
+            RasterizeTriangle(tri, 0, 0, size - 1, size - 1,
+                [&](int x, int y, float z, float, float, float)
+                {
+                    float& d = tileDepth[(size_t)y * atlasSize + x];
+                    if (z < d) d = z;
+                });
+        }
+    });
+}
+
+static void RenderShadowMapDebug(const std::vector<float>& atlasDepth, const ShadowAtlasTile& tile,
+                                 uint32_t width, uint32_t height, uint8_t* outPixels)
+{
+    const int atlasSize = (int)SHADOW_ATLAS_SIZE;
+
+    ParallelFor(height, [&](uint32_t y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            float depth = 1.0f;
+            if (tile.size > 0)
+            {
+                // The tile stretched over the screen; bilinear, clamp to the
+                // atlas (depthSampler in g_FullscreenShaderSource)
+                float u = ((float)tile.x + ((float)x + 0.5f) / (float)width * (float)tile.size) / (float)atlasSize;
+                float v = ((float)tile.y + ((float)y + 0.5f) / (float)height * (float)tile.size) / (float)atlasSize;
+                float fx = u * (float)atlasSize - 0.5f;
+                float fy = v * (float)atlasSize - 0.5f;
+                int ix = (int)floorf(fx);
+                int iy = (int)floorf(fy);
+                float tx = fx - (float)ix;
+                float ty = fy - (float)iy;
+                int ix0 = std::min(std::max(ix, 0), atlasSize - 1), ix1 = std::min(std::max(ix + 1, 0), atlasSize - 1);
+                int iy0 = std::min(std::max(iy, 0), atlasSize - 1), iy1 = std::min(std::max(iy + 1, 0), atlasSize - 1);
+                const float* d = atlasDepth.data();
+                depth = Lerp(Lerp(d[(size_t)iy0 * atlasSize + ix0], d[(size_t)iy0 * atlasSize + ix1], tx),
+                             Lerp(d[(size_t)iy1 * atlasSize + ix0], d[(size_t)iy1 * atlasSize + ix1], tx), ty);
+            }
+
+            float visualDepth = powf(Saturate(1.0f - depth), 0.3f);
+            StorePixel(&outPixels[((size_t)y * width + x) * 4], Vec3(visualDepth, visualDepth, visualDepth));
+        }
+    });
+}
+
+static void RenderMainPass(const ShadeContext& ctx, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                           uint32_t width, uint32_t height, uint8_t* outPixels)
+{
+    std::vector<ScreenTriangle> tris;
+    SetupTriangles(vertices, indices, 0, (uint32_t)indices.size(), ctx.cb.viewProjection, (int)width, (int)height, tris);
+
+    int tilesX = ((int)width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = ((int)height + TILE_SIZE - 1) / TILE_SIZE;
+    std::vector<std::vector<uint32_t>> bins;
+    BinTriangles(tris, tilesX, tilesY, bins);
+
+    const Vec3 skyColor(0.5f, 0.6f, 0.7f);
+
+    ParallelFor(tilesX * tilesY, [&](uint32_t tile)
+    {
+        int rectX0 = (int)(tile % tilesX) * TILE_SIZE;
+        int rectY0 = (int)(tile / tilesX) * TILE_SIZE;
+        int rectX1 = std::min(rectX0 + TILE_SIZE, (int)width) - 1;
+        int rectY1 = std::min(rectY0 + TILE_SIZE, (int)height) - 1;
+
+        // Visibility buffer: resolve depth first, then shade each pixel once
+        float depth[TILE_SIZE * TILE_SIZE];
+        int32_t triangleId[TILE_SIZE * TILE_SIZE];
+        float bary[TILE_SIZE * TILE_SIZE][2];
+        std::fill(depth, depth + TILE_SIZE * TILE_SIZE, 1.0f);
+        std::fill(triangleId, triangleId + TILE_SIZE * TILE_SIZE, -1);
+
+        for (uint32_t t : bins[tile])
+        {
+            RasterizeTriangle(tris[t], rectX0, rectY0, rectX1, rectY1,
+                [&](int x, int y, float z, float, float b1, float b2)
+                {
+                    int local = (y - rectY0) * TILE_SIZE + (x - rectX0);
+                    if (z < depth[local])
+                    {
+                        depth[local] = z;
+                        triangleId[local] = (int32_t)t;
+                        bary[local][0] = b1;
+                        bary[local][1] = b2;
+                    }
+                });
+        }
+
+        for (int y = rectY0; y <= rectY1; ++y)
+        {
+            for (int x = rectX0; x <= rectX1; ++x)
+            {
+                int local = (y - rectY0) * TILE_SIZE + (x - rectX0);
+                uint8_t* dst = &outPixels[((size_t)y * width + x) * 4];
+                if (triangleId[local] < 0)
+                {
+                    StorePixel(dst, skyColor);
+                    continue;
+                }
+
+                // Perspective-correct attribute interpolation
+                const ScreenTriangle& tri = tris[triangleId[local]];
+                float b1 = bary[local][0];
+                float b2 = bary[local][1];
+                float w0 = (1.0f - b1 - b2) * tri.invW[0];
+                float w1 = b1 * tri.invW[1];
+                float w2 = b2 * tri.invW[2];
+                float norm = 1.0f / (w0 + w1 + w2);
+                w0 *= norm; w1 *= norm; w2 *= norm;
+
+                float attr[NUM_ATTRIBUTES];
+                for (int k = 0; k < NUM_ATTRIBUTES; ++k)
+                    attr[k] = tri.attr[0][k] * w0 + tri.attr[1][k] * w1 + tri.attr[2][k] * w2;
+
+                Vec3 worldPos(attr[0], attr[1], attr[2]);
+                Vec3 normal(attr[3], attr[4], attr[5]);
+                PixelLights lights = GetPixelLights(ctx, (float)x + 0.5f, (float)y + 0.5f, worldPos);
+                StorePixel(dst, ShadePixel(ctx, lights, worldPos, normal, attr[6], attr[7]));
+            }
+        }
+    });
+}
+
+void Software_RenderHeightMap(const SceneState* scene, const std::vector<Vertex>& vertices,
+                              const std::vector<uint32_t>& indices, std::vector<float>& heightMap)
+{
+    const int mapSize = (int)SceneState::HORIZON_MAP_SIZE;
+    std::vector<ScreenTriangle> tris;
+    SetupTriangles(vertices, indices, 0, (uint32_t)indices.size(), scene->topDownViewProj, mapSize, mapSize, tris);
+
+    heightMap.resize((size_t)mapSize * mapSize);
+    RasterizeDepth(tris, mapSize, mapSize, heightMap.data());
+}
+
+void Software_Render(const SceneState* scene, const std::vector<Vertex>& vertices,
+                     const std::vector<uint32_t>& indices, uint32_t width, uint32_t height,
+                     uint8_t* outPixels, HorizonCache* horizonCache)
+{
+    float aspect = (float)width / (float)height;
+    uint32_t shadowedCount = Scene_GetShadowedLightCount(scene);
+
+    ShadeContext ctx = {};
+    Scene_FillCameraConstants(scene, aspect, &ctx.cb);
+
+    std::vector<ConeLightGPU> lights(scene->numConeLights);
+    std::vector<Mat4> lightMatrices(scene->numConeLights);
+    Scene_FillConeLights(scene, lights.data(), lightMatrices.data());
+
+    // Shadow atlas tiles for this view, same as the GPU path
+    ShadowAtlas atlas;
+    ShadowAtlas_Build(scene, width, height, &atlas);
+    ShadowAtlas_FillLights(&atlas, lights.data(), scene->numConeLights);
+
+    // Shade the quantized lights the GPU gets
+    LightPack pack;
+    LightPack_Encode(lights.data(), scene->numConeLights, &pack);
+    LightPack_DecodeAll(&pack, lights.data());
+
+    ctx.lights = lights.data();
+    ctx.lightMatrices = lightMatrices.data();
+    ctx.lightCount = (int)ctx.cb.numConeLights;
+
+    // Cone light shadow maps (only sampled without horizon mapping, or by the
+    // debug view, which shows them even in horizon mode)
+    std::vector<float> atlasDepth;
+    bool needConeShadows = scene->showShadowMapDebug || (!scene->disableShadows && !scene->useHorizonMapping);
+    if (needConeShadows)
+    {
+        ShadowCasterLists casters;
+        ShadowCulling_Build(scene, lightMatrices.data(), &atlas, &casters);
+        RenderShadowAtlas(vertices, indices, lightMatrices.data(), atlas, casters, atlasDepth);
+    }
+    ctx.shadowAtlas = atlasDepth.data();
+
+    if (scene->showShadowMapDebug)
+    {
+        int index = scene->debugShadowMapIndex;
+        ShadowAtlasTile tile = (index >= 0 && (size_t)index < atlas.tiles.size()) ? atlas.tiles[index] : ShadowAtlasTile();
+        RenderShadowMapDebug(atlasDepth, tile, width, height, outPixels);
+        return;
+    }
+
+    // Top-down height map + per-light horizon trace or angular map (incremental
+    // when the caller keeps a cache between frames)
+    HorizonCache localHorizon;
+    HorizonCache* horizon = horizonCache ? horizonCache : &localHorizon;
+    if (scene->useHorizonMapping && !scene->disableShadows)
+    {
+        std::vector<float> heightMap;
+        Software_RenderHeightMap(scene, vertices, indices, heightMap);
+        Horizon_Update(horizon, scene, heightMap.data(), shadowedCount);
+    }
+    ctx.horizonSlices = horizon->slices.data();
+    ctx.angularHorizon = &horizon->angular;
+
+    // Per-froxel or per-cell light lists for the main pass
+    LightClusterGrid clusters;
+    LightGrid lightGrid;
+    if (scene->lightCullingMode == LIGHT_CULLING_CLUSTERED)
+    {
+        LightClusters_Build(scene, width, height, &clusters);
+        LightClusters_FillConstants(&clusters, &ctx.cb);
+    }
+    else if (scene->lightCullingMode == LIGHT_CULLING_GRID)
+    {
+        LightGrid_Build(scene, &lightGrid);
+        LightGrid_FillConstants(&lightGrid, &ctx.cb);
+    }
+    ctx.clusters = &clusters;
+    ctx.lightGrid = &lightGrid;
+
+    RenderMainPass(ctx, vertices, indices, width, height, outPixels);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Headless CPU reference of D3D12_Render. A tile-based, multithreaded
+// rasterizer consumes the same vertex/index data as the GPU path and evaluates
+// the PSMain / CalculateConeLightContribution logic in C++, including the
+// cone shadow maps and the horizon mapping compute pass. Used by -test on
+// machines without a GPU (Linux regression farm).
+//
+// Not reproduced: the headlight debug wireframes and the ImGui overlay.
+
+#include <cstdint>
+#include <vector>
+
+#include "horizon.h"
+#include "scene.h"
+
+// Renders one frame into outPixels (width * height * 4 bytes, BGRA with a
+// top-left origin, i.e. the same layout D3D12_CaptureBackbuffer returns).
+// vertices/indices are the buffers built by Scene_BuildGeometry, with the car
+// boxes kept current by Scene_WriteCarVertices. A horizonCache kept across
+// frames makes the horizon trace incremental; without one every shadowed light
+// is traced in full.
+void Software_Render(const SceneState* scene, const std::vector<Vertex>& vertices,
+                     const std::vector<uint32_t>& indices, uint32_t width, uint32_t height,
+                     uint8_t* outPixels, HorizonCache* horizonCache = nullptr);
+
+// Top-down depth pass: the horizon height map (HORIZON_MAP_SIZE^2 depth values)
+void Software_RenderHeightMap(const SceneState* scene, const std::vector<Vertex>& vertices,
+                              const std::vector<uint32_t>& indices, std::vector<float>& heightMap);
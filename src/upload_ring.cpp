@@ -0,0 +1,48 @@
+#include "upload_ring.h"
+
+#include <algorithm>
+
+void UploadRing_Init(UploadRing* ring, uint32_t frameCount)
+{
+    ring->frames.assign(frameCount, UploadRingFrame());
+    ring->current = 0;
+    ring->peakUsed = 0;
+    ring->growCount = 0;
+}
+
+uint64_t UploadRing_GetAllocationSize(uint64_t size)
+{
+    size = std::max<uint64_t>(size, 1);
+    return (size + UPLOAD_RING_ALIGNMENT - 1) & ~(UPLOAD_RING_ALIGNMENT - 1);
+}
+
+bool UploadRing_BeginFrame(UploadRing* ring, uint32_t frameIndex, uint64_t requiredBytes)
+{
+    ring->current = frameIndex;
+    UploadRingFrame& frame = ring->frames[frameIndex];
+    frame.used = 0;
+    frame.reserved = requiredBytes;
+    if (frame.capacity >= requiredBytes)
+        return false;
+
+    // Grow by powers of two so a slowly rising load does not recreate every frame
+    uint64_t capacity = std::max(frame.capacity, UPLOAD_RING_MIN_CAPACITY);
+    while (capacity < requiredBytes)
+        capacity *= 2;
+    frame.capacity = capacity;
+    ring->growCount++;
+    return true;
+}
+
+uint64_t UploadRing_Allocate(UploadRing* ring, uint64_t size)
+{
+    UploadRingFrame& frame = ring->frames[ring->current];
+    uint64_t allocationSize = UploadRing_GetAllocationSize(size);
+    if (frame.used + allocationSize > frame.reserved)
+        return UPLOAD_RING_INVALID_OFFSET;
+
+    uint64_t offset = frame.used;
+    frame.used += allocationSize;
+    ring->peakUsed = std::max(ring->peakUsed, frame.used);
+    return offset;
+}
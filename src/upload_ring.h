@@ -0,0 +1,58 @@
+#pragma once
+
+// Per-frame upload ring: all dynamic data of a frame (constants, cone lights,
+// light matrices, light lists, car and debug cone instances) is sub-allocated
+// linearly from one upload buffer per frame in flight. A frame only reuses its buffer after
+// the GPU finished the frame that last used it, so the CPU never writes data
+// the GPU may still read, and growing a buffer never waits for the queue.
+//
+// A frame first adds up what it will upload (UploadRing_GetAllocationSize),
+// then begins with that total; the allocations that follow always fit.
+// Only the offsets are tracked here, the buffers belong to the renderer.
+
+#include <cstdint>
+#include <vector>
+
+// Every allocation starts at this alignment (D3D12 constant buffer placement;
+// also enough for root SRVs and vertex buffers)
+static constexpr uint64_t UPLOAD_RING_ALIGNMENT = 256;
+
+// Smallest buffer a frame gets; buffers grow to the next power of two
+static constexpr uint64_t UPLOAD_RING_MIN_CAPACITY = 64 * 1024;
+
+// Returned by UploadRing_Allocate when the frame did not reserve enough
+static constexpr uint64_t UPLOAD_RING_INVALID_OFFSET = ~0ull;
+
+// One frame in flight: capacity of its buffer and how much of it is in use
+struct UploadRingFrame
+{
+    uint64_t capacity = 0;
+    uint64_t used = 0;
+    uint64_t reserved = 0;      // Total passed to UploadRing_BeginFrame
+};
+
+struct UploadRing
+{
+    std::vector<UploadRingFrame> frames;
+    uint32_t current = 0;       // Frame being filled
+
+    // Stats
+    uint64_t peakUsed = 0;      // Largest frame so far
+    uint32_t growCount = 0;     // Buffers (re)created
+};
+
+// frameCount frames in flight, no buffers yet
+void UploadRing_Init(UploadRing* ring, uint32_t frameCount);
+
+// Bytes an allocation of size bytes takes from a frame (aligned; empty
+// allocations still take one slot so their address is valid)
+uint64_t UploadRing_GetAllocationSize(uint64_t size);
+
+// Starts filling frameIndex's buffer with up to requiredBytes. Returns true if
+// the buffer must be (re)created first, with frames[frameIndex].capacity bytes.
+// The GPU must have finished the frame that last used it.
+bool UploadRing_BeginFrame(UploadRing* ring, uint32_t frameIndex, uint64_t requiredBytes);
+
+// Offset of size bytes in the current frame's buffer, or
+// UPLOAD_RING_INVALID_OFFSET if they exceed what the frame reserved
+uint64_t UploadRing_Allocate(UploadRing* ring, uint64_t size);
@@ -6,7 +6,8 @@ Usage:
   python test_runner.py generate [filter]  - Generate PBRT reference images
   python test_runner.py test [filter]      - Run cl3d and compare to references
 
-Optional filter argument runs only tests containing that string.
+Optional filter argument runs only tests containing that string. Tests whose
+reference image is listed in test/stale_refs.txt fail unless --allow-stale.
 """
 
 import argparse
@@ -25,9 +26,15 @@ from skimage.metrics import structural_similarity as ssim
 SCRIPT_DIR = Path(__file__).parent.resolve()
 TEST_DIR = SCRIPT_DIR / "test"
 TEMP_DIR = SCRIPT_DIR / "_temp"
+STALE_REFS_FILE = TEST_DIR / "stale_refs.txt"
 BIN_DIR = SCRIPT_DIR / "bin" / "Debug"
 
-CL3D_EXE = BIN_DIR / "cl3d.exe"
+# Without Windows/D3D12 the tests render with the CPU software renderer
+# (see src/headless_main.cpp for the build command)
+if os.name == "nt":
+    CL3D_EXE = BIN_DIR / "cl3d.exe"
+else:
+    CL3D_EXE = SCRIPT_DIR / "bin" / "cl3d_headless"
 PBRT_EXE = Path("D:/git/pbrt-v4/build/Release/pbrt.exe")
 IMGTOOL_EXE = Path("D:/git/pbrt-v4/build/Release/imgtool.exe")
 
@@ -70,6 +77,28 @@ def calculate_ssim(img1_path, img2_path):
     return score
 
 
+def load_stale_refs():
+    """Names of tests whose reference image predates their .pbrt file."""
+    if not STALE_REFS_FILE.exists():
+        return set()
+    names = set()
+    for line in STALE_REFS_FILE.read_text().splitlines():
+        line = line.strip()
+        if line and not line.startswith("#"):
+            names.add(line)
+    return names
+
+
+def clear_stale_ref(cfg_name):
+    """Remove a re-rendered test from the stale list (comments are kept)."""
+    if not STALE_REFS_FILE.exists():
+        return
+    lines = STALE_REFS_FILE.read_text().splitlines()
+    kept = [line for line in lines if line.strip() != cfg_name]
+    if len(kept) != len(lines):
+        STALE_REFS_FILE.write_text("\n".join(kept) + "\n")
+
+
 # =============================================================================
 # Part 1: Generate PBRT reference images
 # =============================================================================
@@ -134,6 +163,9 @@ def generate_reference(cfg_path, work_dir):
     dest_pbrt = cfg_path.parent / f"{cfg_name}.pbrt"
     shutil.copy(pbrt_file, dest_pbrt)
 
+    # Image and scene file match again
+    clear_stale_ref(cfg_name)
+
     return True
 
 
@@ -145,7 +177,7 @@ def cmd_generate(filter_str=None):
 
     # Check prerequisites
     if not CL3D_EXE.exists():
-        print(f"ERROR: cl3d.exe not found at {CL3D_EXE}")
+        print(f"ERROR: {CL3D_EXE.name} not found at {CL3D_EXE}")
         return 1
     if not PBRT_EXE.exists():
         print(f"ERROR: pbrt.exe not found at {PBRT_EXE}")
@@ -262,15 +294,18 @@ def run_test(cfg_path, output_dir):
         return None
 
 
-def cmd_test(filter_str=None):
-    """Run cl3d tests and compare to reference images."""
+def cmd_test(filter_str=None, allow_stale=False):
+    """Run cl3d tests and compare to reference images.
+
+    Tests with a stale reference image fail unless allow_stale is set.
+    """
     print("=" * 60)
     print("cl3d Test Runner")
     print("=" * 60)
 
     # Check prerequisites
     if not CL3D_EXE.exists():
-        print(f"ERROR: cl3d.exe not found at {CL3D_EXE}")
+        print(f"ERROR: {CL3D_EXE.name} not found at {CL3D_EXE}")
         return 1
     if not TEST_DIR.exists():
         print(f"ERROR: Test directory not found at {TEST_DIR}")
@@ -300,8 +335,13 @@ def cmd_test(filter_str=None):
     print()
 
     # Run tests
+    stale_refs = load_stale_refs()
     results = {}
     for cfg_path in sorted(cfg_files):
+        if cfg_path.stem in stale_refs:
+            print(f"  {'WARNING' if allow_stale else 'ERROR'}: {cfg_path.stem}_ref.png is stale "
+                  f"(see {STALE_REFS_FILE.name}), re-render with "
+                  f"'python test_runner.py generate {cfg_path.stem}'")
         score = run_test(cfg_path, output_dir)
         results[cfg_path.stem] = score
         print()
@@ -314,23 +354,28 @@ def cmd_test(filter_str=None):
     print("-" * 42)
 
     for name, score in sorted(results.items()):
-        if score is not None:
+        if score is not None and name in stale_refs:
+            status = "stale reference, allowed" if allow_stale else "FAILED: stale reference"
+            print(f"{name:<30} {score:>10.4f}  ({status})")
+        elif score is not None:
             print(f"{name:<30} {score:>10.4f}")
         else:
             print(f"{name:<30} {'FAILED':>10}")
 
-    # Overall stats
+    # Overall stats (a stale reference is no ground truth, so it does not pass)
     valid_scores = [s for s in results.values() if s is not None]
+    passed = [name for name, s in results.items()
+              if s is not None and (allow_stale or name not in stale_refs)]
     if valid_scores:
         avg_ssim = sum(valid_scores) / len(valid_scores)
         print("-" * 42)
         print(f"{'Average':<30} {avg_ssim:>10.4f}")
-        print(f"{'Tests passed':<30} {len(valid_scores):>10}/{len(results)}")
+    print(f"{'Tests passed':<30} {len(passed):>10}/{len(results)}")
 
     print()
     print(f"Results saved to: {output_dir}")
 
-    return 0 if len(valid_scores) == len(results) else 1
+    return 0 if len(passed) == len(results) else 1
 
 
 # =============================================================================
@@ -350,6 +395,7 @@ Examples:
   python test_runner.py generate              # Generate all reference images
   python test_runner.py test                  # Run all tests
   python test_runner.py test intensity        # Run only tests containing 'intensity'
+  python test_runner.py test --allow-stale    # Don't fail tests with stale references
   python test_runner.py generate shadow       # Generate only tests containing 'shadow'
 """
     )
@@ -364,13 +410,18 @@ Examples:
         default=None,
         help="Optional filter string - only run tests containing this string"
     )
+    parser.add_argument(
+        "--allow-stale",
+        action="store_true",
+        help="Pass tests whose reference image is listed in test/stale_refs.txt (they fail by default)"
+    )
 
     args = parser.parse_args()
 
     if args.command == "generate":
         return cmd_generate(args.filter)
     elif args.command == "test":
-        return cmd_test(args.filter)
+        return cmd_test(args.filter, args.allow_stale)
     else:
         parser.print_help()
         return 1